@@ -49,7 +49,9 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/device.cpp \
 	core/dive.c \
 	core/divecomputer.c \
+	core/divefeatures.cpp \
 	core/divefilter.cpp \
+	core/diveindex.cpp \
 	core/event.c \
 	core/eventname.cpp \
 	core/filterconstraint.cpp \
@@ -58,7 +60,10 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/divelog.cpp \
 	core/gas-model.c \
 	core/gaspressures.c \
+	core/geoindex.cpp \
 	core/git-access.c \
+	core/gitsnapshot.cpp \
+	core/gitsync.cpp \
 	core/globals.cpp \
 	core/liquivision.c \
 	core/load-git.c \
@@ -75,6 +80,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/import-csv.c \
 	core/save-html.c \
 	core/statistics.c \
+	core/statisticscache.cpp \
 	core/worldmap-save.c \
 	core/libdivecomputer.c \
 	core/version.c \
@@ -142,6 +148,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	stats/scatterseries.cpp \
 	stats/statsaxis.cpp \
 	stats/statscolors.cpp \
+	stats/statsdives.cpp \
 	stats/statsgrid.cpp \
 	stats/statshelper.cpp \
 	stats/statsselection.cpp \
@@ -168,6 +175,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	qt-models/filterconstraintmodel.cpp \
 	qt-models/filterpresetmodel.cpp \
 	profile-widget/qmlprofile.cpp \
+	profile-widget/columndecimator.cpp \
 	profile-widget/divecartesianaxis.cpp \
 	profile-widget/diveeventitem.cpp \
 	profile-widget/divepercentageitem.cpp \
@@ -205,6 +213,8 @@ HEADERS += \
 	core/eventname.h \
 	core/extradata.h \
 	core/git-access.h \
+	core/gitsnapshot.h \
+	core/gitsync.h \
 	core/globals.h \
 	core/owning_ptrs.h \
 	core/pref.h \
@@ -213,6 +223,7 @@ HEADERS += \
 	core/range.h \
 	core/save-html.h \
 	core/statistics.h \
+	core/statisticscache.h \
 	core/units.h \
 	core/version.h \
 	core/picture.h \
@@ -225,7 +236,9 @@ HEADERS += \
 	core/configuredivecomputer.h \
 	core/datatrak.h \
 	core/deco.h \
+	core/divefeatures.h \
 	core/divefilter.h \
+	core/diveindex.h \
 	core/filterconstraint.h \
 	core/filterpreset.h \
 	core/divelist.h \
@@ -236,6 +249,7 @@ HEADERS += \
 	core/file.h \
 	core/fulltext.h \
 	core/gaspressures.h \
+	core/geoindex.h \
 	core/gettext.h \
 	core/gettextfromc.h \
 	core/membuffer.h \
@@ -296,6 +310,7 @@ HEADERS += \
 	stats/scatterseries.h \
 	stats/statsaxis.h \
 	stats/statscolors.h \
+	stats/statsdives.h \
 	stats/statsgrid.h \
 	stats/statshelper.h \
 	stats/statsselection.h \
@@ -328,6 +343,7 @@ HEADERS += \
 	qt-models/filterconstraintmodel.h \
 	qt-models/filterpresetmodel.h \
 	profile-widget/qmlprofile.h \
+	profile-widget/columndecimator.h \
 	profile-widget/divepercentageitem.h \
 	profile-widget/diveprofileitem.h \
 	profile-widget/profilescene.h \
@@ -33,6 +33,7 @@ QAction *undoAction(QObject *parent);	// Create an undo action.
 QAction *redoAction(QObject *parent);	// Create a redo action.
 QString changesMade();			// Return a string with the texts from all commands on the undo stack -> for commit message.
 bool placingCommand();			// Currently executing a new command -> might not have to update the field the user just edited.
+size_t undoMemoryUsage();		// Estimate of the memory used by the commands on the undo stack, in bytes.
 
 // 2) Dive-list related commands
 
@@ -113,6 +113,19 @@ QString changesMade()
 	return changeTexts;
 }
 
+size_t Base::memoryUsage() const
+{
+	return sizeof(*this);
+}
+
+size_t undoMemoryUsage()
+{
+	size_t res = 0;
+	for (int i = 0; i < undoStack->count(); ++i)
+		res += static_cast<const Base *>(undoStack->command(i))->memoryUsage();
+	return res;
+}
+
 static bool executingCommand = false;
 bool execute(Base *cmd)
 {
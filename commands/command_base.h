@@ -162,6 +162,10 @@ public:
 	// Check whether work is to be done.
 	// TODO: replace by setObsolete (>Qt5.9)
 	virtual bool workToBeDone() = 0;
+
+	// Estimate of the memory kept alive by this command, in bytes.
+	// Commands owning dives or profiles override this.
+	virtual size_t memoryUsage() const;
 };
 
 // Put a command on the undoStack (and take ownership), but test whether there
@@ -284,6 +284,19 @@ static OwningTripPtr moveDiveToTrip(DiveToTrip &diveToTrip)
 	return res;
 }
 
+// Estimate of the memory used by the dives, trips and sites owned by a command.
+static size_t ownedMemoryUsage(const DivesAndTripsToAdd &toAdd)
+{
+	size_t res = 0;
+	for (const DiveToAdd &d: toAdd.dives) {
+		if (d.dive)
+			res += dive_memory_usage(d.dive.get());
+	}
+	res += toAdd.trips.size() * sizeof(dive_trip);
+	res += toAdd.sites.size() * sizeof(dive_site);
+	return res;
+}
+
 // This helper function moves a set of dives between trips using the
 // moveDiveToTrip function. Before doing so, it adds the necessary trips to
 // the core. Trips that are removed from the core because they are empty
@@ -445,6 +458,11 @@ bool AddDive::workToBeDone()
 	return true;
 }
 
+size_t AddDive::memoryUsage() const
+{
+	return sizeof(*this) + ownedMemoryUsage(divesToAdd);
+}
+
 void AddDive::redoit()
 {
 	// Remember selection so that we can undo it
@@ -528,6 +546,11 @@ bool ImportDives::workToBeDone()
 	return !divesToAdd.dives.empty();
 }
 
+size_t ImportDives::memoryUsage() const
+{
+	return sizeof(*this) + ownedMemoryUsage(divesToAdd);
+}
+
 void ImportDives::redoit()
 {
 	// Remember selection so that we can undo it
@@ -601,6 +624,11 @@ bool DeleteDive::workToBeDone()
 	return !divesToDelete.dives.empty();
 }
 
+size_t DeleteDive::memoryUsage() const
+{
+	return sizeof(*this) + ownedMemoryUsage(divesToAdd);
+}
+
 void DeleteDive::undoit()
 {
 	divesToDelete = addDives(divesToAdd);
@@ -841,6 +869,11 @@ bool SplitDivesBase::workToBeDone()
 	return !diveToSplit.dives.empty();
 }
 
+size_t SplitDivesBase::memoryUsage() const
+{
+	return sizeof(*this) + ownedMemoryUsage(splitDives) + ownedMemoryUsage(unsplitDive);
+}
+
 void SplitDivesBase::redoit()
 {
 	divesToUnsplit = addDives(splitDives);
@@ -925,6 +958,11 @@ bool DiveComputerBase::workToBeDone()
 	return !diveToRemove.dives.empty() || !diveToAdd.dives.empty();
 }
 
+size_t DiveComputerBase::memoryUsage() const
+{
+	return sizeof(*this) + ownedMemoryUsage(diveToAdd);
+}
+
 void DiveComputerBase::redoit()
 {
 	DivesAndSitesToRemove addedDive = addDives(diveToAdd);
@@ -1051,6 +1089,11 @@ bool MergeDives::workToBeDone()
 	return !mergedDive.dives.empty();
 }
 
+size_t MergeDives::memoryUsage() const
+{
+	return sizeof(*this) + ownedMemoryUsage(mergedDive) + ownedMemoryUsage(unmergedDives);
+}
+
 void MergeDives::redoit()
 {
 	renumberDives(divesToRenumber);
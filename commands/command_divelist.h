@@ -84,6 +84,7 @@ private:
 	void undoit() override;
 	void redoit() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 
 	// For redo
 	// Note: we a multi-dive structure even though we add only a single dive, so
@@ -104,6 +105,7 @@ private:
 	void undoit() override;
 	void redoit() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 
 	// For redo and undo
 	DivesAndTripsToAdd	divesToAdd;
@@ -129,6 +131,7 @@ private:
 	void undoit() override;
 	void redoit() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 
 	// For redo
 	DivesAndSitesToRemove divesToDelete;
@@ -201,6 +204,7 @@ private:
 	void undoit() override;
 	void redoit() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 
 	// For redo
 	// For each dive to split, we remove one from and put two dives into the backend
@@ -242,6 +246,7 @@ private:
 	void undoit() override;
 	void redoit() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 
 protected:
 	// For redo and undo
@@ -267,6 +272,7 @@ private:
 	void undoit() override;
 	void redoit() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 
 	// For redo
 	// Add one and remove a batch of dives
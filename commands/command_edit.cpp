@@ -841,6 +841,14 @@ bool ReplanDive::workToBeDone()
 	return !!d;
 }
 
+size_t ReplanDive::memoryUsage() const
+{
+	size_t res = sizeof(*this) + cylinders.allocated * sizeof(cylinder_t);
+	for (const struct divecomputer *it = &dc; it; it = it->next)
+		res += dc_memory_usage(it);
+	return res;
+}
+
 void ReplanDive::undo()
 {
 	std::swap(d->when, when);
@@ -901,8 +909,9 @@ EditProfile::EditProfile(const dive *source, int dcNr, EditProfileType type, int
 	meandepth = source->meandepth;
 	duration = source->duration;
 
+	// Only the samples are exchanged. They are shared with the source dive,
+	// so that we only pay for them once the source is changed.
 	copy_samples(sdc, &dc);
-	copy_events(sdc, &dc);
 
 	setText(editProfileTypeToString(type, count) + diveNumberOrDate(d));
 }
@@ -917,6 +926,11 @@ bool EditProfile::workToBeDone()
 	return !!d;
 }
 
+size_t EditProfile::memoryUsage() const
+{
+	return sizeof(*this) + dc_memory_usage(&dc);
+}
+
 void EditProfile::undo()
 {
 	struct divecomputer *sdc = get_dive_dc(d, dcNr);
@@ -1363,6 +1377,7 @@ EditSensors::EditSensors(int toCylinderIn, int fromCylinderIn, int dcNr)
 
 void EditSensors::mapSensors(int toCyl, int fromCyl)
 {
+	unshare_samples(dc);
 	for (int i = 0; i < dc->samples; ++i) {
 		for (int s = 0; s < MAX_SENSORS; ++s) {
 			if (dc->sample[i].pressure[s].mbar && dc->sample[i].sensor[s] == fromCyl)
@@ -1538,6 +1553,11 @@ bool EditDive::workToBeDone()
 	return true;
 }
 
+size_t EditDive::memoryUsage() const
+{
+	return sizeof(*this) + (newDive ? dive_memory_usage(newDive.get()) : 0);
+}
+
 #endif // SUBSURFACE_MOBILE
 
 } // namespace Command
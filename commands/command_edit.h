@@ -341,6 +341,7 @@ private:
 	void undo() override;
 	void redo() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 };
 
 class EditProfile : public Base {
@@ -358,6 +359,7 @@ private:
 	void undo() override;
 	void redo() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 };
 
 class AddWeight : public EditDivesBase {
@@ -478,6 +480,7 @@ private:
 	void undo() override;
 	void redo() override;
 	bool workToBeDone() override;
+	size_t memoryUsage() const override;
 
 	void exchangeDives();
 	void editDs();
@@ -15,6 +15,9 @@
  * clear_deco()
  * cache_deco_state()
  * restore_deco_state()
+ * save_tissue_snapshot()
+ * restore_tissue_snapshot()
+ * buehlmann_stop_time()
  * dump_tissues()
  */
 #include <math.h>
@@ -217,11 +220,30 @@ static double vpmb_tolerated_ambient_pressure(struct deco_state *ds, double refe
 	return ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure - total_gradient;
 }
 
+/* The ambient pressure tolerated by a compartment with the given Bühlmann coefficients and
+ * inert gas tension, with the gradient factor interpolated between gf_low at gf_low_pressure
+ * and gf_high at the surface. Returns false if the compartment doesn't limit the ascent. */
+static bool buehlmann_tolerated_pressure(double a, double b, double tension, double gf_low_pressure, double surface, double *tolerated)
+{
+	double gf_high = buehlmann_config.gf_high;
+	double gf_low = buehlmann_config.gf_low;
+
+	if (!((surface / b + a - surface) * gf_high + surface < (gf_low_pressure / b + a - gf_low_pressure) * gf_low + gf_low_pressure))
+		return false;
+
+	*tolerated = (-a * b * (gf_high * gf_low_pressure - gf_low * surface) -
+		      (1.0 - b) * (gf_high - gf_low) * gf_low_pressure * surface +
+		      b * (gf_low_pressure - surface) * tension) /
+		     (-a * b * (gf_high - gf_low) +
+		      (1.0 - b) * (gf_low * gf_low_pressure - gf_high * surface) +
+		      b * (gf_low_pressure - surface));
+	return true;
+}
+
 double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure, bool in_planner)
 {
 	int ci = -1;
 	double ret_tolerance_limit_ambient_pressure = 0.0;
-	double gf_high = buehlmann_config.gf_high;
 	double gf_low = buehlmann_config.gf_low;
 	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
 	double lowest_ceiling = 0.0;
@@ -247,15 +269,8 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 		for (ci = 0; ci < 16; ci++) {
 			double tolerated;
 
-			if ((surface / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - surface) * gf_high + surface <
-			    (ds->gf_low_pressure_this_dive / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - ds->gf_low_pressure_this_dive) * gf_low + ds->gf_low_pressure_this_dive)
-				tolerated = (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high * ds->gf_low_pressure_this_dive - gf_low * surface) -
-					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_high - gf_low) * ds->gf_low_pressure_this_dive * surface +
-					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface) * ds->tissue_inertgas_saturation[ci]) /
-					    (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high - gf_low) +
-					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_low * ds->gf_low_pressure_this_dive - gf_high * surface) +
-					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface));
-			else
+			if (!buehlmann_tolerated_pressure(ds->buehlmann_inertgas_a[ci], ds->buehlmann_inertgas_b[ci], ds->tissue_inertgas_saturation[ci],
+							  ds->gf_low_pressure_this_dive, surface, &tolerated))
 				tolerated = ret_tolerance_limit_ambient_pressure;
 
 
@@ -550,6 +565,119 @@ void restore_deco_state(struct deco_state *data, struct deco_state *target, bool
 
 }
 
+#define SNAPSHOT_FIELDS(COPY) \
+	COPY(tissue_n2_sat); \
+	COPY(tissue_he_sat); \
+	COPY(tolerated_by_tissue); \
+	COPY(tissue_inertgas_saturation); \
+	COPY(buehlmann_inertgas_a); \
+	COPY(buehlmann_inertgas_b); \
+	COPY(max_n2_crushing_pressure); \
+	COPY(max_he_crushing_pressure); \
+	COPY(crushing_onset_tension); \
+	COPY(max_ambient_pressure); \
+	COPY(ci_pointing_to_guiding_tissue); \
+	COPY(gf_low_pressure_this_dive); \
+	COPY(icd_warning); \
+	COPY(sum1); \
+	COPY(sumx); \
+	COPY(sumxx); \
+	COPY(sumy); \
+	COPY(sumxy); \
+	COPY(plot_depth)
+
+/* The fields are either scalars or arrays of the same type in both structs */
+#define COPY_TO_SNAPSHOT(field) memcpy(&snapshot->field, &ds->field, sizeof(snapshot->field))
+#define COPY_FROM_SNAPSHOT(field) memcpy(&ds->field, &snapshot->field, sizeof(ds->field))
+
+void save_tissue_snapshot(const struct deco_state *ds, struct deco_tissue_snapshot *snapshot)
+{
+	SNAPSHOT_FIELDS(COPY_TO_SNAPSHOT);
+}
+
+void restore_tissue_snapshot(const struct deco_tissue_snapshot *snapshot, struct deco_state *ds)
+{
+	SNAPSHOT_FIELDS(COPY_FROM_SNAPSHOT);
+}
+
+#undef COPY_TO_SNAPSHOT
+#undef COPY_FROM_SNAPSHOT
+#undef SNAPSHOT_FIELDS
+
+/* The inert gas tensions of a compartment at constant pressure and gas */
+struct compartment_approach {
+	double n2, he;			// tensions at the start
+	double n2_delta, he_delta;	// total change of the tensions
+	double n2_k, he_k;		// rate constants in 1/s
+};
+
+static double approach_excess(const struct compartment_approach *c, int ci, double t, double gf_low_pressure, double surface, double target_pressure)
+{
+	double n2 = c->n2 + c->n2_delta * (1.0 - exp(-c->n2_k * t));
+	double he = c->he + c->he_delta * (1.0 - exp(-c->he_k * t));
+	double a = (buehlmann_N2_a[ci] * n2 + buehlmann_He_a[ci] * he) / (n2 + he);
+	double b = (buehlmann_N2_b[ci] * n2 + buehlmann_He_b[ci] * he) / (n2 + he);
+	double tolerated;
+
+	if (!buehlmann_tolerated_pressure(a, b, n2 + he, gf_low_pressure, surface, &tolerated))
+		return -1.0;
+	return tolerated - target_pressure;
+}
+
+/* Estimate the time in seconds that has to be spent at the given pressure, breathing
+ * gasmix, until the Bühlmann ceiling is at or above target_pressure. At constant pressure
+ * and gas, the inert gas tensions of each compartment approach the inspired pressures
+ * exponentially. Thus, instead of simulating the stop, the tolerated pressure of each
+ * compartment can be calculated for any time in closed form and the time at which it
+ * reaches the target pressure is found with a few Newton steps.
+ * This does not account for the on- and off-gassing during the ascent, so the result
+ * has to be verified by the caller.
+ * Returns 0 if no time is needed and a negative value if the time could not be
+ * determined, e.g. because the ceiling never clears the target. */
+double buehlmann_stop_time(const struct deco_state *ds, const struct dive *dive, double pressure, double target_pressure,
+			   struct gasmix gasmix, int ccpo2, enum divemode_t divemode)
+{
+	int ci;
+	struct gas_pressures pressures;
+	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
+	double res = 0.0;
+
+	fill_pressures(&pressures, pressure - WV_PRESSURE, gasmix, (double) ccpo2 / 1000.0, divemode);
+
+	for (ci = 0; ci < 16; ci++) {
+		struct compartment_approach c;
+		c.n2 = ds->tissue_n2_sat[ci];
+		c.he = ds->tissue_he_sat[ci];
+		c.n2_delta = pressures.n2 - c.n2;
+		c.he_delta = pressures.he - c.he;
+		c.n2_delta *= c.n2_delta > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+		c.he_delta *= c.he_delta > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+		c.n2_k = log(2.0) / (buehlmann_N2_t_halflife[ci] * 60.0);
+		c.he_k = log(2.0) / (buehlmann_He_t_halflife[ci] * 60.0);
+
+		double t = 0.0;
+		int i;
+		for (i = 0; i < 20; i++) {
+			double excess = approach_excess(&c, ci, t, ds->gf_low_pressure_this_dive, surface, target_pressure);
+			if (excess <= 0.0 && t == 0.0)
+				break;		/* This compartment doesn't hold us back */
+			double slope = approach_excess(&c, ci, t + 1.0, ds->gf_low_pressure_this_dive, surface, target_pressure) - excess;
+			if (slope >= 0.0)
+				return -1.0;	/* The ceiling doesn't go up */
+			double next = MAX(t - excess / slope, 0.0);
+			if (fabs(next - t) < 1.0) {
+				t = next;
+				break;
+			}
+			t = next;
+		}
+		if (i == 20)
+			return -1.0;
+		res = MAX(res, t);
+	}
+	return res;
+}
+
 int deco_allowed_depth(double tissues_tolerance, double surface_pressure, const struct dive *dive, bool smooth)
 {
 	int depth;
@@ -47,9 +47,34 @@ struct deco_state {
 	int plot_depth;
 };
 
+/* The part of the deco state that is changed by add_segment(), tissue_tolerance_calc()
+ * and update_regression(). The planner uses this to try out ascents, which happens
+ * thousands of times per plan, without copying (or allocating) the whole deco state. */
+struct deco_tissue_snapshot {
+	double tissue_n2_sat[16];
+	double tissue_he_sat[16];
+	double tolerated_by_tissue[16];
+	double tissue_inertgas_saturation[16];
+	double buehlmann_inertgas_a[16];
+	double buehlmann_inertgas_b[16];
+	double max_n2_crushing_pressure[16];
+	double max_he_crushing_pressure[16];
+	double crushing_onset_tension[16];
+	double max_ambient_pressure;
+	int ci_pointing_to_guiding_tissue;
+	double gf_low_pressure_this_dive;
+	bool icd_warning;
+	int sum1;
+	long sumx, sumxx;
+	double sumy, sumxy;
+	int plot_depth;
+};
+
 extern const double buehlmann_N2_t_halflife[];
 
 extern int deco_allowed_depth(double tissues_tolerance, double surface_pressure, const struct dive *dive, bool smooth);
+extern double buehlmann_stop_time(const struct deco_state *ds, const struct dive *dive, double pressure, double target_pressure,
+				  struct gasmix gasmix, int ccpo2, enum divemode_t divemode);
 
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive);
 extern void clear_deco(struct deco_state *ds, double surface_pressure, bool in_planner);
@@ -58,6 +83,8 @@ extern void set_gf(short gflow, short gfhigh);
 extern void set_vpmb_conservatism(short conservatism);
 extern void cache_deco_state(struct deco_state *source, struct deco_state **datap);
 extern void restore_deco_state(struct deco_state *data, struct deco_state *target, bool keep_vpmb_state);
+extern void save_tissue_snapshot(const struct deco_state *ds, struct deco_tissue_snapshot *snapshot);
+extern void restore_tissue_snapshot(const struct deco_tissue_snapshot *snapshot, struct deco_state *ds);
 extern void nuclear_regeneration(struct deco_state *ds, double time);
 extern void vpmb_start_gradient(struct deco_state *ds);
 extern void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure, bool in_planner);
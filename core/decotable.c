@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-2.0
+/* decotable.c
+ *
+ * Calculate tables of dive plans over grids of depths, bottom times, gases
+ * and conservatism settings.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "decotable.h"
+#include "deco.h"
+#include "dive.h"
+#include "equipment.h"
+#include "membuffer.h"
+#include "planner.h"
+#include "pref.h"
+#include "qthelper.h"
+#include "sample.h"
+
+struct deco_table_job {
+	const struct deco_table_request *request;
+	struct deco_table *table;
+	int setting;
+};
+
+static int cell_index(const struct deco_table_request *request, int setting, int gas, int depth, int time)
+{
+	return ((setting * request->nr_gases + gas) * request->nr_depths + depth) * request->nr_times + time;
+}
+
+const struct deco_table_cell *get_deco_table_cell(const struct deco_table *table, int setting, int gas, int depth, int time)
+{
+	return &table->cells[cell_index(&table->request, setting, gas, depth, time)];
+}
+
+/* The deco gases are switched to at their MOD for the deco pO2, like in the planner */
+static void setup_plan(struct diveplan *diveplan, struct dive *dive, const struct deco_table_gases *gases,
+		       const struct deco_table_setting *setting, int depth, int time)
+{
+	pressure_t po2 = { .mbar = prefs.decopo2 };
+	int descent = depth / prefs.descrate;
+	int i;
+
+	memset(diveplan, 0, sizeof(*diveplan));
+	diveplan->salinity = SEAWATER_SALINITY;
+	diveplan->surface_pressure = SURFACE_PRESSURE;
+	diveplan->gflow = setting->gflow;
+	diveplan->gfhigh = setting->gfhigh;
+	diveplan->vpmb_conservatism = setting->vpmb_conservatism;
+	diveplan->bottomsac = prefs.bottomsac;
+	diveplan->decosac = prefs.decosac;
+
+	for (i = 0; i < gases->nr_deco; i++)
+		plan_add_segment(diveplan, 0, gas_mod(gases->deco[i], po2, dive, M_OR_FT(3, 10)).mm, i + 1, 0, true, OC);
+	plan_add_segment(diveplan, descent, depth, 0, 0, true, OC);
+	plan_add_segment(diveplan, time - descent, depth, 0, 0, true, OC);
+}
+
+/* Consecutive entries at the same depth are merged (oxygen breaks), gas switches without stop are skipped */
+static void fill_cell(struct deco_table_cell *cell, const struct dive *dive, const struct decostop *stoptable)
+{
+	const struct decostop *stop;
+
+	cell->valid = true;
+	cell->runtime = dive->dc.duration.seconds;
+	cell->nr_stops = 0;
+	for (stop = stoptable; stop->depth > 0; stop++) {
+		if (!stop->time)
+			continue;
+		if (cell->nr_stops && cell->stops[cell->nr_stops - 1].depth == stop->depth) {
+			cell->stops[cell->nr_stops - 1].time += stop->time;
+			continue;
+		}
+		if (cell->nr_stops == MAX_DECO_TABLE_STOPS)
+			break;
+		cell->stops[cell->nr_stops++] = *stop;
+	}
+}
+
+/* One row of the table: all bottom times for one gas and depth. The bottom times are
+ * planned in increasing order, so that each plan continues the tissue state at the
+ * end of the bottom phase of the previous one. */
+static void calculate_deco_table_row(int idx, void *data)
+{
+	struct deco_table_job *job = data;
+	const struct deco_table_request *request = job->request;
+	int gas = idx / request->nr_depths, depth = idx % request->nr_depths;
+	const struct deco_table_gases *gases = &request->gases[gas];
+	const struct deco_table_setting *setting = &request->settings[job->setting];
+	struct dive *dive = alloc_dive();
+	struct deco_state ds = {}, *cache = NULL;
+	struct tissue_cache tissue_cache = {};
+	int *order = malloc(request->nr_times * sizeof(*order));
+	int i, j;
+
+	dive->surface_pressure.mbar = SURFACE_PRESSURE;
+	dive->salinity = SEAWATER_SALINITY;
+	get_or_create_cylinder(dive, 0)->gasmix = gases->bottom;
+	for (i = 0; i < gases->nr_deco; i++)
+		get_or_create_cylinder(dive, i + 1)->gasmix = gases->deco[i];
+
+	/* Sort the bottom times, the request may give them in any order */
+	for (i = 0; i < request->nr_times; i++) {
+		for (j = i; j > 0 && request->times[order[j - 1]] > request->times[i]; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+
+	for (i = 0; i < request->nr_times; i++) {
+		struct deco_table_cell *cell = &job->table->cells[cell_index(request, job->setting, gas, depth, order[i])];
+		int time = request->times[order[i]];
+		struct decostop stoptable[60];
+		struct diveplan diveplan;
+
+		if (time <= request->depths[depth] / prefs.descrate)
+			continue;
+		setup_plan(&diveplan, dive, gases, setting, request->depths[depth], time);
+		plan_with_tissue_cache(&ds, &diveplan, dive, DECOTIMESTEP, stoptable, &cache, &tissue_cache, true, false);
+		fill_cell(cell, dive, stoptable);
+		free_dps(&diveplan);
+	}
+
+	free(order);
+	free_tissue_cache(&tissue_cache);
+	free(cache);
+	free_dive(dive);
+}
+
+/* The planner works on the global deco model settings (gradient factors, VPM-B
+ * conservatism). Therefore only the plans of one setting are calculated in parallel.
+ * The settings are set before the plans, which don't write them, and the planner lock
+ * keeps the profile calculation from changing them in the meantime.
+ * The gas switches of the plans remember their event name in a table that is
+ * shared with the GUI thread and protected by its own lock (see eventname.cpp). */
+void calculate_deco_table(const struct deco_table_request *request, struct deco_table *table)
+{
+	int setting;
+
+	table->request = *request;
+	table->cells = calloc(request->nr_settings * request->nr_gases * request->nr_depths * request->nr_times, sizeof(*table->cells));
+	lock_planner();
+	for (setting = 0; setting < request->nr_settings; setting++) {
+		struct deco_table_job job = { request, table, setting };
+		set_gf(request->settings[setting].gflow, request->settings[setting].gfhigh);
+		set_vpmb_conservatism(request->settings[setting].vpmb_conservatism);
+		parallel_for(request->nr_gases * request->nr_depths, calculate_deco_table_row, &job);
+	}
+	set_gf(prefs.gflow, prefs.gfhigh);
+	set_vpmb_conservatism(prefs.vpmb_conservatism);
+	unlock_planner();
+}
+
+void free_deco_table(struct deco_table *table)
+{
+	free(table->cells);
+	table->cells = NULL;
+}
+
+void get_deco_table_gases_string(const struct deco_table_gases *gases, char *buf, int len)
+{
+	int i, used;
+
+	get_gas_string(gases->bottom, buf, len);
+	for (i = 0; i < gases->nr_deco; i++) {
+		used = strlen(buf);
+		if (used + 1 >= len)
+			return;
+		buf[used] = '+';
+		get_gas_string(gases->deco[i], buf + used + 1, len - used - 1);
+	}
+}
+
+static void put_setting(struct membuffer *b, const struct deco_table_setting *setting, const char *pre, const char *post)
+{
+	if (decoMode(true) == VPMB)
+		put_format(b, "%s+%d%s", pre, setting->vpmb_conservatism, post);
+	else
+		put_format(b, "%s%d/%d%s", pre, setting->gflow, setting->gfhigh, post);
+}
+
+/* One line per plan, the stops are given as depth:minutes from the deepest to the shallowest.
+ * Like the runtime, the stop times are rounded up to full minutes. */
+void save_deco_table_csv(struct membuffer *b, const struct deco_table *table)
+{
+	const struct deco_table_request *request = &table->request;
+	int setting, gas, depth, time, i;
+	char gasstring[MAX_DECO_TABLE_GASES * 16];
+
+	put_string(b, "setting,gases,depth [m],bottom time [min],runtime [min],stops\n");
+	for (setting = 0; setting < request->nr_settings; setting++) {
+		for (gas = 0; gas < request->nr_gases; gas++) {
+			get_deco_table_gases_string(&request->gases[gas], gasstring, sizeof(gasstring));
+			for (depth = 0; depth < request->nr_depths; depth++) {
+				for (time = 0; time < request->nr_times; time++) {
+					const struct deco_table_cell *cell = get_deco_table_cell(table, setting, gas, depth, time);
+					if (!cell->valid)
+						continue;
+					put_setting(b, &request->settings[setting], "", ",");
+					put_format(b, "%s,", gasstring);
+					put_milli(b, "", request->depths[depth], ",");
+					put_format(b, "%d,%d,", request->times[time] / 60, (cell->runtime + 59) / 60);
+					for (i = 0; i < cell->nr_stops; i++) {
+						put_milli(b, i ? " " : "", cell->stops[i].depth, ":");
+						put_format(b, "%d", (cell->stops[i].time + 59) / 60);
+					}
+					put_string(b, "\n");
+				}
+			}
+		}
+	}
+}
+
+void save_deco_table_json(struct membuffer *b, const struct deco_table *table)
+{
+	const struct deco_table_request *request = &table->request;
+	int setting, gas, depth, time, i;
+	bool first = true;
+	char gasstring[MAX_DECO_TABLE_GASES * 16];
+
+	put_format(b, "{\"model\":\"%s\",\"plans\":[", decoMode(true) == VPMB ? "VPM-B" : "Buehlmann");
+	for (setting = 0; setting < request->nr_settings; setting++) {
+		for (gas = 0; gas < request->nr_gases; gas++) {
+			get_deco_table_gases_string(&request->gases[gas], gasstring, sizeof(gasstring));
+			for (depth = 0; depth < request->nr_depths; depth++) {
+				for (time = 0; time < request->nr_times; time++) {
+					const struct deco_table_cell *cell = get_deco_table_cell(table, setting, gas, depth, time);
+					if (!cell->valid)
+						continue;
+					put_string(b, first ? "\n" : ",\n");
+					first = false;
+					put_setting(b, &request->settings[setting], "{\"setting\":\"", "\",");
+					put_format(b, "\"gases\":\"%s\",\"depth\":%d,\"time\":%d,\"runtime\":%d,\"stops\":[",
+						   gasstring, request->depths[depth], request->times[time], cell->runtime);
+					for (i = 0; i < cell->nr_stops; i++)
+						put_format(b, "%s{\"depth\":%d,\"time\":%d}", i ? "," : "", cell->stops[i].depth, cell->stops[i].time);
+					put_string(b, "]}");
+				}
+			}
+		}
+	}
+	put_string(b, "\n]}\n");
+}
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef DECOTABLE_H
+#define DECOTABLE_H
+
+#include "gas.h"
+#include "planner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_DECO_TABLE_GASES 8
+#define MAX_DECO_TABLE_STOPS 30
+
+/* A bottom gas and the deco gases that are carried with it */
+struct deco_table_gases {
+	struct gasmix bottom;
+	int nr_deco;
+	struct gasmix deco[MAX_DECO_TABLE_GASES];
+};
+
+/* The gradient factors are used for Bühlmann, the conservatism for VPM-B */
+struct deco_table_setting {
+	int gflow, gfhigh;
+	short vpmb_conservatism;
+};
+
+/* The axes of a table of plans. Bottom times are in seconds and include the descent,
+ * depths are in mm. The deco model and the ascent rates are taken from the preferences. */
+struct deco_table_request {
+	int nr_depths;
+	const int *depths;
+	int nr_times;
+	const int *times;
+	int nr_gases;
+	const struct deco_table_gases *gases;
+	int nr_settings;
+	const struct deco_table_setting *settings;
+};
+
+/* One plan of the table. Plans whose bottom time is shorter than the descent are not valid. */
+struct deco_table_cell {
+	bool valid;
+	int runtime;
+	int nr_stops;
+	struct decostop stops[MAX_DECO_TABLE_STOPS];
+};
+
+/* The table refers to the axes of the request, which must outlive it */
+struct deco_table {
+	struct deco_table_request request;
+	struct deco_table_cell *cells;
+};
+
+extern void calculate_deco_table(const struct deco_table_request *request, struct deco_table *table);
+extern void free_deco_table(struct deco_table *table);
+extern const struct deco_table_cell *get_deco_table_cell(const struct deco_table *table, int setting, int gas, int depth, int time);
+extern void get_deco_table_gases_string(const struct deco_table_gases *gases, char *buf, int len);
+
+struct membuffer;
+extern void save_deco_table_csv(struct membuffer *b, const struct deco_table *table);
+extern void save_deco_table_json(struct membuffer *b, const struct deco_table *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DECOTABLE_H
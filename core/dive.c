@@ -158,8 +158,8 @@ struct gasmix get_gasmix_from_event(const struct dive *dive, const struct event
 int dive_getUniqID()
 {
 	static int maxId = 83529;
-	maxId += 3;
-	return maxId;
+	// Dives may be allocated by parsers running on multiple threads
+	return __atomic_add_fetch(&maxId, 3, __ATOMIC_RELAXED);
 }
 
 struct dive *alloc_dive(void)
@@ -286,6 +286,19 @@ void copy_dive(const struct dive *s, struct dive *d)
 	STRUCTURED_LIST_COPY(struct divecomputer, s->dc.next, d->dc.next, copy_dc);
 }
 
+/* Estimate of the memory used by a dive. Samples shared with other dives,
+ * e.g. with copies kept by the undo system, are accounted for proportionally. */
+size_t dive_memory_usage(const struct dive *d)
+{
+	size_t res = sizeof(*d) - sizeof(d->dc);
+	for (const struct divecomputer *dc = &d->dc; dc; dc = dc->next)
+		res += dc_memory_usage(dc);
+	res += d->cylinders.allocated * sizeof(cylinder_t);
+	res += d->weightsystems.allocated * sizeof(weightsystem_t);
+	res += d->pictures.allocated * sizeof(struct picture);
+	return res;
+}
+
 static void copy_dive_onedc(const struct dive *s, const struct divecomputer *sdc, struct dive *d)
 {
 	copy_dive_nodc(s, d);
@@ -645,6 +658,8 @@ void update_setpoint_events(const struct dive *dive, struct divecomputer *dc)
 		struct gasmix gasmix = get_gasmix_from_event(dive, ev);
 		const struct event *next = get_next_event(ev, "gaschange");
 
+		unshare_samples(dc);
+
 		for (int i = 0; i < dc->samples; i++) {
 			struct gas_pressures pressures;
 			if (next && dc->sample[i].time.seconds >= next->time.seconds) {
@@ -1244,6 +1259,14 @@ static void fixup_dc_sample_sensors(struct dive *dive, struct divecomputer *dc)
 
 static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 {
+	/* The fixups may write to the samples. If these are shared, work on
+	 * a private copy. Usually, nothing changes (e.g. the dive was fixed up
+	 * before). In that case, go back to the shared samples at the end. */
+	struct divecomputer shared = { 0 };
+	if (samples_shared(dc))
+		copy_samples(dc, &shared);
+	unshare_samples(dc);
+
 	/* Fixup duration and mean depth */
 	fixup_dc_duration(dc);
 
@@ -1273,6 +1296,11 @@ static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 	/* If there are no samples, generate a fake profile based on depth and time */
 	if (!dc->samples)
 		fake_dc(dc);
+
+	if (shared.sample) {
+		share_equal_samples(dc, &shared);
+		free_samples(&shared);
+	}
 }
 
 struct dive *fixup_dive(struct dive *dive)
@@ -1723,6 +1751,7 @@ static void renumber_last_sample(struct divecomputer *dc, const int mapping[])
 
 	if (dc->samples <= 0)
 		return;
+	unshare_samples(dc);
 	idx = dc->samples - 1;
 	sample_renumber(dc->sample + idx, idx, mapping);
 }
@@ -1742,6 +1771,7 @@ static void dc_cylinder_renumber(struct dive *dive, struct divecomputer *dc, con
 	struct event *ev;
 
 	/* Remap or delete the sensor indices */
+	unshare_samples(dc);
 	for (i = 0; i < dc->samples; i++)
 		sample_renumber(dc->sample + i, i, mapping);
 
@@ -2780,6 +2810,12 @@ static int split_dive_at(const struct dive *dive, int a, int b, struct dive **ou
 	 * so the algorithm keeps splitting the dive further */
 	d1->selected = false;
 
+	/* The samples of d2 are moved and shifted in place below, so they must
+	 * not be shared with the original dive, which is kept for undo. The
+	 * samples of d1 are only truncated. */
+	for (dc2 = &d2->dc; dc2; dc2 = dc2->next)
+		unshare_samples(dc2);
+
 	dc1 = &d1->dc;
 	dc2 = &d2->dc;
 	/*
@@ -11,6 +11,105 @@
 #include <string.h>
 #include <stdlib.h>
 
+/*
+ * The sample arrays are reference counted, so that copies of a dive computer
+ * (notably the ones kept by the undo commands) can share the samples instead
+ * of duplicating them. The reference count is stored in front of the samples.
+ *
+ * Shared samples must not be modified: call unshare_samples() before writing
+ * to existing samples. Adding samples via alloc_samples() or prepare_sample()
+ * takes care of that.
+ */
+struct sample_buffer {
+	int refcount;
+	struct sample samples[];
+};
+
+static struct sample_buffer *get_sample_buffer(const struct divecomputer *dc)
+{
+	return (struct sample_buffer *)((char *)dc->sample - offsetof(struct sample_buffer, samples));
+}
+
+static void release_samples(struct divecomputer *dc)
+{
+	if (!dc->sample)
+		return;
+	struct sample_buffer *buf = get_sample_buffer(dc);
+	if (__atomic_sub_fetch(&buf->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+		free(buf);
+	dc->sample = NULL;
+}
+
+/* Reallocate the sample array with space for num samples. If the
+ * samples are shared, this creates a private copy. */
+static void resize_samples(struct divecomputer *dc, int num)
+{
+	struct sample_buffer *buf;
+	size_t size = offsetof(struct sample_buffer, samples) + num * sizeof(struct sample);
+
+	if (dc->sample && !samples_shared(dc)) {
+		buf = realloc(get_sample_buffer(dc), size);
+		if (!buf)
+			free(get_sample_buffer(dc));
+	} else {
+		buf = malloc(size);
+		if (buf) {
+			buf->refcount = 1;
+			if (dc->samples)
+				memcpy(buf->samples, dc->sample, MIN(dc->samples, num) * sizeof(struct sample));
+		}
+		release_samples(dc);
+	}
+	if (!buf) {
+		dc->sample = NULL;
+		dc->samples = dc->alloc_samples = 0;
+		return;
+	}
+	dc->sample = buf->samples;
+	dc->alloc_samples = num;
+}
+
+bool samples_shared(const struct divecomputer *dc)
+{
+	return dc->sample && __atomic_load_n(&get_sample_buffer(dc)->refcount, __ATOMIC_ACQUIRE) > 1;
+}
+
+void unshare_samples(struct divecomputer *dc)
+{
+	if (samples_shared(dc))
+		resize_samples(dc, dc->alloc_samples);
+}
+
+/* If the samples of dc are the same as the samples of orig, replace them by
+ * a reference to the samples of orig. Used to restore sharing after operations
+ * that had to unshare the samples, but typically don't change them. */
+void share_equal_samples(struct divecomputer *dc, const struct divecomputer *orig)
+{
+	if (!orig->sample || dc->sample == orig->sample || dc->samples != orig->samples ||
+	    memcmp(dc->sample, orig->sample, dc->samples * sizeof(struct sample)))
+		return;
+	release_samples(dc);
+	copy_samples(orig, dc);
+}
+
+/* The memory used by the samples. Shared samples are accounted for proportionally. */
+size_t dc_samples_memory(const struct divecomputer *dc)
+{
+	if (!dc->sample)
+		return 0;
+	int refcount = __atomic_load_n(&get_sample_buffer(dc)->refcount, __ATOMIC_ACQUIRE);
+	return (offsetof(struct sample_buffer, samples) + dc->alloc_samples * sizeof(struct sample)) / refcount;
+}
+
+/* Estimate of the memory used by a dive computer, not counting the strings. */
+size_t dc_memory_usage(const struct divecomputer *dc)
+{
+	size_t res = sizeof(*dc) + dc_samples_memory(dc);
+	for (const struct event *ev = dc->events; ev; ev = ev->next)
+		res += sizeof(*ev) + strlen(ev->name) + 1;
+	return res;
+}
+
 /*
  * Good fake dive profiles are hard.
  *
@@ -246,19 +345,16 @@ void free_dive_dcs(struct divecomputer *dc)
  * array is reallocated and the existing samples are copied. */
 void alloc_samples(struct divecomputer *dc, int num)
 {
-	if (num > dc->alloc_samples) {
-		dc->alloc_samples = (num * 3) / 2 + 10;
-		dc->sample = realloc(dc->sample, dc->alloc_samples * sizeof(struct sample));
-		if (!dc->sample)
-			dc->samples = dc->alloc_samples = 0;
-	}
+	if (num > dc->alloc_samples)
+		resize_samples(dc, (num * 3) / 2 + 10);
+	else
+		unshare_samples(dc);
 }
 
 void free_samples(struct divecomputer *dc)
 {
 	if (dc) {
-		free(dc->sample);
-		dc->sample = 0;
+		release_samples(dc);
 		dc->samples = 0;
 		dc->alloc_samples = 0;
 	}
@@ -398,26 +494,23 @@ void copy_events(const struct divecomputer *s, struct divecomputer *d)
 	*pev = NULL;
 }
 
+/* The samples are not duplicated, but shared. See unshare_samples(). */
 void copy_samples(const struct divecomputer *s, struct divecomputer *d)
 {
-	/* instead of carefully copying them one by one and calling add_sample
-	 * over and over again, let's just copy the whole blob */
 	if (!s || !d)
 		return;
-	int nr = s->samples;
-	d->samples = nr;
-	d->alloc_samples = nr;
-	// We expect to be able to read the memory in the other end of the pointer
-	// if its a valid pointer, so don't expect malloc() to return NULL for
-	// zero-sized malloc, do it ourselves.
+	d->samples = 0;
+	d->alloc_samples = 0;
 	d->sample = NULL;
 
-	if(!nr)
+	// Don't keep empty arrays alive.
+	if (!s->sample || !s->samples)
 		return;
 
-	d->sample = malloc(nr * sizeof(struct sample));
-	if (d->sample)
-		memcpy(d->sample, s->sample, nr * sizeof(struct sample));
+	__atomic_add_fetch(&get_sample_buffer(s)->refcount, 1, __ATOMIC_RELAXED);
+	d->sample = s->sample;
+	d->samples = s->samples;
+	d->alloc_samples = s->alloc_samples;
 }
 
 void add_event_to_dc(struct divecomputer *dc, struct event *ev)
@@ -534,7 +627,7 @@ static void free_extra_data(struct extra_data *ed)
 
 void free_dc_contents(struct divecomputer *dc)
 {
-	free(dc->sample);
+	release_samples(dc);
 	free((void *)dc->model);
 	free((void *)dc->serial);
 	free((void *)dc->fw_version);
@@ -4,6 +4,7 @@
 
 #include "divemode.h"
 #include "units.h"
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -63,6 +64,11 @@ extern unsigned int dc_watertemp(const struct divecomputer *dc);
 extern void copy_events(const struct divecomputer *s, struct divecomputer *d);
 extern void swap_event(struct divecomputer *dc, struct event *from, struct event *to);
 extern void copy_samples(const struct divecomputer *s, struct divecomputer *d);
+extern bool samples_shared(const struct divecomputer *dc);
+extern void unshare_samples(struct divecomputer *dc);
+extern void share_equal_samples(struct divecomputer *dc, const struct divecomputer *orig);
+extern size_t dc_samples_memory(const struct divecomputer *dc);
+extern size_t dc_memory_usage(const struct divecomputer *dc);
 extern void add_event_to_dc(struct divecomputer *dc, struct event *ev);
 extern struct event *add_event(struct divecomputer *dc, unsigned int time, int type, int flags, int value, const char *name);
 extern void remove_event_from_dc(struct divecomputer *dc, struct event *event);
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "divefeatures.h"
+#include "dive.h"
+#include "divelog.h"
+#include "gas.h"
+#include "subsurface-qt/divelistnotifier.h"
+
+#include <algorithm>
+#include <tuple>
+
+DiveFeatures *DiveFeatures::instance()
+{
+	static DiveFeatures self;
+	return &self;
+}
+
+DiveFeatures::DiveFeatures() : valid(false), numDives(0)
+{
+	// Adding and removing dives shifts the rows, so rebuild everything
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &DiveFeatures::invalidate);
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &DiveFeatures::invalidate);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &DiveFeatures::invalidate);
+
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this,
+		[this](const QVector<dive *> &dives, DiveField) { updateDives(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &DiveFeatures::updateDives);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, this, &DiveFeatures::updateDives);
+	connect(&diveListNotifier, &DiveListNotifier::weightAdded, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::weightRemoved, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::weightEdited, this, [this](dive *d, int) { updateDive(d); });
+}
+
+// The O2 or He content of one of the cylinders. If max_he is true, the gas with
+// the highest He and lowest O2 content ("bottom gas") is taken, otherwise the
+// gas with the highest O2 content.
+static int gas_content(const struct dive *d, bool he, bool max_he)
+{
+	if (d->cylinders.nr <= 0)
+		return DiveFeatures::NoValue;
+	auto comp = max_he ? [] (const cylinder_t &c1, const cylinder_t &c2)
+				{ return std::make_tuple(get_he(c1.gasmix), -get_o2(c1.gasmix)) <
+					 std::make_tuple(get_he(c2.gasmix), -get_o2(c2.gasmix)); }
+			   : [] (const cylinder_t &c1, const cylinder_t &c2)
+				{ return get_o2(c1.gasmix) < get_o2(c2.gasmix); };
+	auto it = std::max_element(d->cylinders.cylinders, d->cylinders.cylinders + d->cylinders.nr, comp);
+	return he ? get_he(it->gasmix) : get_o2(it->gasmix);
+}
+
+int DiveFeatures::calculate(const dive *d, DiveFeature feature)
+{
+	switch (feature) {
+	case DiveFeature::TotalWeight:
+		return total_weight(d);
+	case DiveFeature::MaxO2:
+		return gas_content(d, false, false);
+	case DiveFeature::BottomGasO2:
+		return gas_content(d, false, true);
+	case DiveFeature::MaxHe:
+		return gas_content(d, true, true);
+	default:
+		return NoValue;
+	}
+}
+
+void DiveFeatures::invalidate()
+{
+	valid = false;
+}
+
+void DiveFeatures::build()
+{
+	dives.assign(divelog.dives->dives, divelog.dives->dives + divelog.dives->nr);
+	std::sort(dives.begin(), dives.end());
+	for (int f = 0; f < (int)DiveFeature::Count; ++f) {
+		std::vector<int> &column = columns[f];
+		column.resize(dives.size());
+		for (size_t i = 0; i < dives.size(); ++i)
+			column[i] = calculate(dives[i], (DiveFeature)f);
+	}
+	numDives = (int)dives.size();
+	valid = true;
+}
+
+// Returns -1 if the dive is not in the dive list
+int DiveFeatures::row(const dive *d) const
+{
+	auto it = std::lower_bound(dives.begin(), dives.end(), d);
+	return it != dives.end() && *it == d ? it - dives.begin() : -1;
+}
+
+int DiveFeatures::get(const dive *d, DiveFeature feature)
+{
+	// Changes that are not signalled are caught by the dive count
+	if (!valid || numDives != divelog.dives->nr)
+		build();
+	int idx = row(d);
+	return idx >= 0 ? columns[(int)feature][idx] : calculate(d, feature);
+}
+
+void DiveFeatures::updateDive(dive *d)
+{
+	if (!valid)
+		return;
+	int idx = row(d);
+	if (idx < 0)
+		return;
+	for (int f = 0; f < (int)DiveFeature::Count; ++f)
+		columns[f][idx] = calculate(d, (DiveFeature)f);
+}
+
+void DiveFeatures::updateDives(const QVector<dive *> &dives)
+{
+	for (dive *d: dives)
+		updateDive(d);
+}
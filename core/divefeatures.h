@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0
+// Values that are derived from the equipment of a dive, such as the total weight or the
+// gas contents. They are read by the filter, which calls them for every dive and every
+// filter change. Therefore, they are calculated once and stored in one array per value,
+// with one row per dive of the dive list. The arrays are rebuilt when dives are added or
+// removed and the rows of edited dives are recalculated.
+//
+// The cache is only used on the GUI thread, where the dive list is changed. Code that runs
+// on other threads, such as the statistics, uses calculate() on its own copies of the dives.
+#ifndef DIVEFEATURES_H
+#define DIVEFEATURES_H
+
+#include <QObject>
+#include <QVector>
+#include <limits>
+#include <vector>
+
+struct dive;
+
+enum class DiveFeature {
+	TotalWeight = 0,	// in grams
+	MaxO2,			// in permille, of the gas with the most O2
+	BottomGasO2,		// in permille, of the gas with the most He and the least O2
+	MaxHe,			// in permille, of the gas with the most He and the least O2
+	Count
+};
+
+class DiveFeatures : public QObject {
+	Q_OBJECT
+public:
+	// Returned for the gas contents of dives without cylinders
+	static constexpr int NoValue = std::numeric_limits<int>::max();
+
+	static DiveFeatures *instance();
+
+	// Must only be called on the GUI thread.
+	// Dives that are not in the dive list are calculated on the fly.
+	int get(const dive *d, DiveFeature feature);
+
+	// Calculates the value from scratch. May be called on any thread, as long as the dive is not changed.
+	static int calculate(const dive *d, DiveFeature feature);
+private:
+	DiveFeatures();
+	void invalidate();
+	void build();
+	int row(const dive *d) const;
+	void updateDive(dive *d);
+	void updateDives(const QVector<dive *> &dives);
+
+	bool valid;
+	int numDives;
+	std::vector<const dive *> dives;	// Sorted by pointer for quick lookup
+	std::vector<int> columns[(int)DiveFeature::Count];
+};
+
+#endif
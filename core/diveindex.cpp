@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "diveindex.h"
+#include "dive.h"
+#include "divelist.h"
+
+#include <unordered_map>
+#include <vector>
+
+struct dive_index {
+	std::unordered_map<uint64_t, dive *> ids;
+	std::unordered_map<timestamp_t, std::vector<dive *>> times;
+};
+
+static uint64_t id_key(uint32_t deviceid, uint32_t diveid)
+{
+	return (uint64_t)deviceid << 32 | diveid;
+}
+
+extern "C" struct dive_index *dive_index_create(const struct dive_table *table)
+{
+	dive_index *index = new dive_index;
+	index->ids.reserve(table->nr);
+	index->times.reserve(table->nr);
+	for (int i = 0; i < table->nr; ++i)
+		dive_index_add(index, table->dives[i]);
+	return index;
+}
+
+extern "C" void dive_index_free(struct dive_index *index)
+{
+	delete index;
+}
+
+extern "C" void dive_index_add(struct dive_index *index, struct dive *d)
+{
+	for (const divecomputer *dc = &d->dc; dc; dc = dc->next) {
+		// Keep the first dive with a given id, like a linear search would.
+		index->ids.emplace(id_key(dc->deviceid, dc->diveid), d);
+		std::vector<dive *> &v = index->times[dc->when];
+		if (v.empty() || v.back() != d)
+			v.push_back(d);
+	}
+}
+
+extern "C" struct dive *dive_index_find_id(const struct dive_index *index, uint32_t deviceid, uint32_t diveid)
+{
+	auto it = index->ids.find(id_key(deviceid, diveid));
+	return it != index->ids.end() ? it->second : nullptr;
+}
+
+extern "C" int dive_index_find_time(const struct dive_index *index, timestamp_t when, struct dive *const **dives)
+{
+	auto it = index->times.find(when);
+	if (it == index->times.end()) {
+		*dives = nullptr;
+		return 0;
+	}
+	*dives = it->second.data();
+	return (int)it->second.size();
+}
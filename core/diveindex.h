@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0
+// An index of dives by dive computer identity and start time, used to
+// quickly detect dives that were already downloaded or imported.
+#ifndef DIVEINDEX_H
+#define DIVEINDEX_H
+
+#include "units.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dive;
+struct dive_index;
+struct dive_table;
+
+// The index does not track changes of the dive table. It is meant to be
+// built for the duration of a download or import, during which the table
+// is not modified, or to be updated with dive_index_add().
+extern struct dive_index *dive_index_create(const struct dive_table *table);
+extern void dive_index_free(struct dive_index *index);
+extern void dive_index_add(struct dive_index *index, struct dive *d);
+
+// Find the first dive that has a dive computer with the given device and dive ids.
+extern struct dive *dive_index_find_id(const struct dive_index *index, uint32_t deviceid, uint32_t diveid);
+
+// Find the dives that have a dive computer starting at the given time.
+// Returns the number of dives. The array is valid until the index is changed.
+extern int dive_index_find_time(const struct dive_index *index, timestamp_t when, struct dive *const **dives);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -617,6 +617,20 @@ void update_cylinder_related_info(struct dive *dive)
 	}
 }
 
+static void update_cylinder_related_info_cb(int idx, void *data)
+{
+	UNUSED(data);
+	update_cylinder_related_info(get_dive(idx));
+}
+
+/* Recalculate the derived data of all dives. The CNS of a dive depends on the
+ * preceding dives, therefore this has to be done once the dive table is final.
+ * The calculation of one dive only writes to that dive, so do it in parallel. */
+static void update_all_cylinder_related_info()
+{
+	parallel_for(divelog.dives->nr, update_cylinder_related_info_cb, NULL);
+}
+
 /* Like strcmp(), but don't crash on null-pointers */
 static int safe_strcmp(const char *s1, const char *s2)
 {
@@ -786,6 +800,8 @@ void process_loaded_dives()
 	/* Autogroup dives if desired by user. */
 	autogroup_dives(divelog.dives, divelog.trips);
 
+	update_all_cylinder_related_info();
+
 	fulltext_populate();
 
 	/* Inform frontend of reset data. This should reset all the models. */
@@ -1019,6 +1035,8 @@ void add_imported_dives(struct divelog *import_log, int flags)
 
 	free_device_table(devices_to_add);
 
+	update_all_cylinder_related_info();
+
 	/* Inform frontend of reset data. This should reset all the models. */
 	emit_reset_signal();
 }
@@ -9,6 +9,7 @@
 #include "qthelper.h"
 #include "units.h"
 #include "statistics.h"
+#include "statisticscache.h"
 #include "string-format.h"
 #include "save-html.h"
 
@@ -79,7 +80,10 @@ static void exportHTMLstatistics(const QString filename, struct htmlExportSettin
 
 	stats_t total_stats;
 
-	calculate_stats_summary(&stats, hes.selectedOnly);
+	if (hes.selectedOnly)
+		calculate_stats_summary(&stats, true);
+	else
+		StatisticsCache::instance()->summary(&stats);
 	total_stats.selection_size = 0;
 	total_stats.total_time.seconds = 0;
 
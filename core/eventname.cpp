@@ -2,6 +2,7 @@
 #include "eventname.h"
 #include "subsurface-string.h"
 
+#include <QMutex>
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -12,6 +13,8 @@ struct event_name {
 };
 
 static std::vector<event_name> event_names;
+// Event names are remembered by the parsers and the planner, which may run on multiple threads
+static QMutex lock;
 
 // Small helper so that we can compare events to C-strings
 static bool operator==(const event_name &en, const char *s)
@@ -21,6 +24,7 @@ static bool operator==(const event_name &en, const char *s)
 
 extern "C" void clear_event_names()
 {
+	QMutexLocker l(&lock);
 	event_names.clear();
 }
 
@@ -28,6 +32,7 @@ extern "C" void remember_event_name(const char *eventname)
 {
 	if (empty_string(eventname))
 		return;
+	QMutexLocker l(&lock);
 	if (std::find(event_names.begin(), event_names.end(), eventname) != event_names.end())
 		return;
 	event_names.push_back({ eventname, true });
@@ -35,18 +40,21 @@ extern "C" void remember_event_name(const char *eventname)
 
 extern "C" bool is_event_hidden(const char *eventname)
 {
+	QMutexLocker l(&lock);
 	auto it = std::find(event_names.begin(), event_names.end(), eventname);
 	return it != event_names.end() && !it->plot;
 }
 
 extern "C" void show_all_events()
 {
+	QMutexLocker l(&lock);
 	for (event_name &en: event_names)
 		en.plot = true;
 }
 
 extern "C" bool any_events_hidden()
 {
+	QMutexLocker l(&lock);
 	return std::any_of(event_names.begin(), event_names.end(),
 			   [] (const event_name &en) { return !en.plot; });
 }
@@ -444,7 +444,10 @@ int easyexif::EXIFInfo::parseFrom(const unsigned char *buf, unsigned len) {
     return PARSE_EXIF_ERROR_CORRUPT;
   offs += 2;
 
-  return parseFromEXIFSegment(buf + offs, len - offs);
+  int res = parseFromEXIFSegment(buf + offs, len - offs);
+  // Make the thumbnail offset relative to the start of the JPEG buffer
+  if (ThumbnailLength) ThumbnailOffset += offs;
+  return res;
 }
 
 int easyexif::EXIFInfo::parseFrom(const string &data) {
@@ -568,6 +571,44 @@ int easyexif::EXIFInfo::parseFromEXIFSegment(const unsigned char *buf,
     }
   }
 
+  // The IFD0 is followed by the offset to the next IFD (IFD1), which
+  // describes the embedded thumbnail image. We only record the location
+  // of the JPEG data, so that it can be decoded instead of the full image.
+  if (offs + 4 <= len) {
+    unsigned ifd1_offset = parse_value<uint32_t>(buf + offs, alignIntel);
+    if (ifd1_offset && ifd1_offset < len &&
+        tiff_header_start + ifd1_offset + 2 <= len) {
+      unsigned thumb_offs = tiff_header_start + ifd1_offset;
+      int thumb_entries = parse_value<uint16_t>(buf + thumb_offs, alignIntel);
+      unsigned thumbnail_offset = 0, thumbnail_length = 0;
+      thumb_offs += 2;
+      if (thumb_offs + 12 * thumb_entries <= len) {
+        while (--thumb_entries >= 0) {
+          IFEntry result =
+              parseIFEntry(buf, thumb_offs, alignIntel, tiff_header_start, len);
+          thumb_offs += 12;
+          switch (result.tag()) {
+            case 0x201:
+              // Offset to JPEG thumbnail data (JPEGInterchangeFormat)
+              if (result.format() == 4) thumbnail_offset = result.data();
+              break;
+
+            case 0x202:
+              // Length of JPEG thumbnail data (JPEGInterchangeFormatLength)
+              if (result.format() == 4) thumbnail_length = result.data();
+              break;
+          }
+        }
+      }
+      if (thumbnail_offset && thumbnail_length &&
+          thumbnail_offset < len && thumbnail_length < len &&
+          tiff_header_start + thumbnail_offset + thumbnail_length <= len) {
+        this->ThumbnailOffset = tiff_header_start + thumbnail_offset;
+        this->ThumbnailLength = thumbnail_length;
+      }
+    }
+  }
+
   // Jump to the EXIF SubIFD if it exists and parse all the information
   // there. Note that it's possible that the EXIF SubIFD doesn't exist.
   // The EXIF SubIFD contains most of the interesting information that a
@@ -855,6 +896,8 @@ void easyexif::EXIFInfo::clear() {
   MeteringMode = 0;
   ImageWidth = 0;
   ImageHeight = 0;
+  ThumbnailOffset = 0;
+  ThumbnailLength = 0;
 
   // Geolocation
   GeoLocation.Latitude = 0;
@@ -97,6 +97,10 @@ class EXIFInfo {
                                     // 5: multi-segment
   unsigned ImageWidth;              // Image width reported in EXIF data
   unsigned ImageHeight;             // Image height reported in EXIF data
+  unsigned ThumbnailOffset;         // Offset of the embedded JPEG thumbnail, relative
+                                    // to the start of the parsed buffer
+  unsigned ThumbnailLength;         // Length of the embedded JPEG thumbnail
+                                    // (0 if there is no thumbnail)
   struct Geolocation_t {            // GPS information embedded in file
     double Latitude;                  // Image latitude expressed as decimal
     double Longitude;                 // Image longitude expressed as decimal
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "filterconstraint.h"
 #include "dive.h"
+#include "divefeatures.h"
 #include "divesite.h"
 #include "errorhelper.h"
 #include "gettextfromc.h"
@@ -1068,7 +1069,7 @@ bool filter_constraint_match_dive(const filter_constraint &c, const struct dive
 	case FILTER_CONSTRAINT_DURATION:
 		return check_numerical_range(c, d->duration.seconds);
 	case FILTER_CONSTRAINT_WEIGHT:
-		return check_numerical_range(c, total_weight(d));
+		return check_numerical_range(c, DiveFeatures::instance()->get(d, DiveFeature::TotalWeight));
 	case FILTER_CONSTRAINT_WATER_TEMP:
 		return check_numerical_range(c, d->watertemp.mkelvin);
 	case FILTER_CONSTRAINT_AIR_TEMP:
@@ -11,11 +11,12 @@
  *                                  -> fill_missing_tank_pressures() -> fill_missing_segment_pressures()
  *                                                                   -> get_pr_interpolate_data()
  *
- *  The pr_track_t related functions below implement a linked list that is used by
- *  the majority of the functions below. The linked list covers a part of the dive profile
- *  for which there are no cylinder pressure data. Each element in the linked list
+ *  The pr_track_t related functions below implement a table that is used by
+ *  the majority of the functions below. The table covers a part of the dive profile
+ *  for which there are no cylinder pressure data. Each element in the table
  *  represents a segment between two consecutive points on the dive profile.
- *  pr_track_t is defined in gaspressures.h
+ *  The segments are in chronological order, so that they can be processed
+ *  in a single pass together with the plot entries.
  */
 
 #include "ssrf.h"
@@ -24,6 +25,8 @@
 #include "profile.h"
 #include "gaspressures.h"
 #include "pref.h"
+#include "subsurface-string.h"
+#include "table.h"
 
 #include <stdlib.h>
 
@@ -38,7 +41,11 @@ struct pr_track_struct {
 	int t_start;
 	int t_end;
 	int pressure_time;
-	pr_track_t *next;
+};
+
+struct pr_track_table {
+	int nr, allocated;
+	pr_track_t *tracks;
 };
 
 typedef struct pr_interpolate_struct pr_interpolate_t;
@@ -51,61 +58,33 @@ struct pr_interpolate_struct {
 
 enum interpolation_strategy {SAC, TIME, CONSTANT};
 
-static pr_track_t *pr_track_alloc(int start, int t_start)
+static MAKE_GROW_TABLE(pr_track_table, pr_track_t, tracks)
+
+/* returns the index of the new segment, pointers into the table are invalidated */
+static int pr_track_add(struct pr_track_table *table, int start, int t_start)
 {
-	pr_track_t *pt = malloc(sizeof(pr_track_t));
+	pr_track_t *pt = &grow_pr_track_table(table)[table->nr];
 	pt->start = start;
 	pt->end = 0;
 	pt->t_start = pt->t_end = t_start;
 	pt->pressure_time = 0;
-	pt->next = NULL;
-	return pt;
-}
-
-/* poor man's linked list */
-static pr_track_t *list_last(pr_track_t *list)
-{
-	pr_track_t *tail = list;
-	if (!tail)
-		return NULL;
-	while (tail->next) {
-		tail = tail->next;
-	}
-	return tail;
-}
-
-static pr_track_t *list_add(pr_track_t *list, pr_track_t *element)
-{
-	pr_track_t *tail = list_last(list);
-	if (!tail)
-		return element;
-	tail->next = element;
-	return list;
-}
-
-static void list_free(pr_track_t *list)
-{
-	if (!list)
-		return;
-	list_free(list->next);
-	free(list);
+	return table->nr++;
 }
 
 #ifdef DEBUG_PR_TRACK
-static void dump_pr_track(int cyl, pr_track_t *track_pr)
+static void dump_pr_track(int cyl, const struct pr_track_table *track_pr)
 {
-	pr_track_t *list;
+	int i;
 
 	printf("cyl%d:\n", cyl);
-	list = track_pr;
-	while (list) {
+	for (i = 0; i < track_pr->nr; i++) {
+		const pr_track_t *list = &track_pr->tracks[i];
 		printf("   start %f end %f t_start %d:%02d t_end %d:%02d pt %d\n",
 		       mbar_to_PSI(list->start),
 		       mbar_to_PSI(list->end),
 		       FRACTION(list->t_start, 60),
 		       FRACTION(list->t_end, 60),
 		       list->pressure_time);
-		list = list->next;
 	}
 }
 #endif
@@ -128,11 +107,12 @@ static void dump_pr_track(int cyl, pr_track_t *track_pr)
  * segments according to how big of a time_pressure area
  * they have.
  */
-static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_strategy strategy)
+static void fill_missing_segment_pressures(pr_track_t *track, int nr, enum interpolation_strategy strategy)
 {
 	double magic;
+	pr_track_t *list = track, *last = track + nr - 1;
 
-	while (list) {
+	while (list <= last) {
 		int start = list->start, end;
 		pr_track_t *tmp = list;
 		int pt_sum = 0, pt = 0;
@@ -143,9 +123,9 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 			if (end)
 				break;
 			end = start;
-			if (!tmp->next)
+			if (tmp == last)
 				break;
-			tmp = tmp->next;
+			tmp++;
 		}
 
 		if (!start)
@@ -172,7 +152,7 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 				list->end = pressure;
 				if (list == tmp)
 					break;
-				list = list->next;
+				list++;
 				list->start = pressure;
 			}
 			break;
@@ -189,7 +169,7 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 		}
 
 		/* Ok, we've done that set of segments */
-		list = list->next;
+		list++;
 	}
 }
 
@@ -202,55 +182,63 @@ void dump_pr_interpolate(int i, pr_interpolate_t interpolate_pr)
 #endif
 
 
-static struct pr_interpolate_struct get_pr_interpolate_data(pr_track_t *segment, struct plot_info *pi, int cur)
+/* The pressure-time of a segment is the sum of the pressure-times of the plot entries from
+ * the first entry at or after its start to the first entry at or after its end. The part up
+ * to entry cur is accumulated. pt_sum[i] is the sum of the pressure-times of the entries before
+ * entry i. Since the segments are processed in order, the index of the first entry of the
+ * segment (*first) only moves forward. */
+static struct pr_interpolate_struct get_pr_interpolate_data(const pr_track_t *segment, const struct plot_info *pi,
+							    const int *pt_sum, int *first, int cur)
 { // cur = index to pi->entry corresponding to t_end of segment;
 	struct pr_interpolate_struct interpolate;
-	int i;
-	struct plot_data *entry;
+	int last, end, acc_end;
+
+	while (*first < pi->nr && pi->entry[*first].sec < segment->t_start)
+		(*first)++;
+	for (last = *first; last < pi->nr && pi->entry[last].sec < segment->t_end; last++)
+		;
+	end = last < pi->nr ? last + 1 : pi->nr;
+	acc_end = MIN(last, cur + 1);
 
 	interpolate.start = segment->start;
 	interpolate.end = segment->end;
-	interpolate.acc_pressure_time = 0;
-	interpolate.pressure_time = 0;
-
-	for (i = 0; i < pi->nr; i++) {
-		entry = pi->entry + i;
-
-		if (entry->sec < segment->t_start)
-			continue;
-		interpolate.pressure_time += entry->pressure_time;
-		if (entry->sec >= segment->t_end)
-			break;
-		if (i <= cur)
-			interpolate.acc_pressure_time += entry->pressure_time;
-	}
+	interpolate.pressure_time = pt_sum[end] - pt_sum[*first];
+	interpolate.acc_pressure_time = acc_end > *first ? pt_sum[acc_end] - pt_sum[*first] : 0;
 	return interpolate;
 }
 
-static void fill_missing_tank_pressures(const struct dive *dive, struct plot_info *pi, pr_track_t *track_pr, int cyl)
+static void fill_missing_tank_pressures(const struct dive *dive, struct plot_info *pi, struct pr_track_table *track_pr, int cyl)
 {
 	int i;
 	struct plot_data *entry;
 	pr_interpolate_t interpolate = { 0, 0, 0, 0 };
 	pr_track_t *last_segment = NULL;
 	int cur_pr;
+	int *pt_sum;
+	int segment_idx = 0, first_entry = 0;
 	enum interpolation_strategy strategy;
 
 	/* no segment where this cylinder is used */
-	if (!track_pr)
+	if (!track_pr->nr)
 		return;
 
 	if (get_cylinder(dive, cyl)->cylinder_use == OC_GAS)
 		strategy = SAC;
 	else
 		strategy = TIME;
-	fill_missing_segment_pressures(track_pr, strategy); // Interpolate the missing tank pressure values ..
-	cur_pr = track_pr->start;			       // in the pr_track_t lists of structures
-							       // and keep the starting pressure for each cylinder.
+	fill_missing_segment_pressures(track_pr->tracks, track_pr->nr, strategy); // Interpolate the missing tank pressure values ..
+	cur_pr = track_pr->tracks[0].start;	     // in the pr_track_t table
+						     // and keep the starting pressure for each cylinder.
 #ifdef DEBUG_PR_TRACK
 	dump_pr_track(cyl, track_pr);
 #endif
 
+	/* Prefix sums of the pressure-times of the plot entries */
+	pt_sum = malloc((pi->nr + 1) * sizeof(*pt_sum));
+	pt_sum[0] = 0;
+	for (i = 0; i < pi->nr; i++)
+		pt_sum[i + 1] = pt_sum[i] + pi->entry[i].pressure_time;
+
 	/* Transfer interpolated cylinder pressures from pr_track strucktures to plotdata
 	 * Go down the list of tank pressures in plot_info. Align them with the start &
 	 * end times of each profile segment represented by a pr_track_t structure. Get
@@ -277,13 +265,14 @@ static void fill_missing_tank_pressures(const struct dive *dive, struct plot_inf
 		}
 		// If there is NO valid pressure value..
 		// Find the pressure segment corresponding to this entry..
-		segment = track_pr;
-		while (segment && segment->t_end < entry->sec) // Find the track_pr with end time..
-			segment = segment->next;	       // ..that matches the plot_info time (entry->sec)
+		// The entries are in chronological order, so continue from the previous segment.
+		while (segment_idx < track_pr->nr && track_pr->tracks[segment_idx].t_end < entry->sec) // Find the track_pr with end time..
+			segment_idx++;									// ..that matches the plot_info time (entry->sec)
 
 		// After last segment? All done.
-		if (!segment)
+		if (segment_idx == track_pr->nr)
 			break;
+		segment = &track_pr->tracks[segment_idx];
 
 		// Before first segment, or between segments.. Go on, no interpolation.
 		if (segment->t_start > entry->sec)
@@ -300,7 +289,7 @@ static void fill_missing_tank_pressures(const struct dive *dive, struct plot_inf
 			interpolate.acc_pressure_time += entry->pressure_time;
 		} else {
 			// Set up an interpolation structure
-			interpolate = get_pr_interpolate_data(segment, pi, i);
+			interpolate = get_pr_interpolate_data(segment, pi, pt_sum, &first_entry, i);
 			last_segment = segment;
 		}
 
@@ -320,6 +309,7 @@ static void fill_missing_tank_pressures(const struct dive *dive, struct plot_inf
 		}
 		set_plot_pressure_data(pi, i, INTERPOLATED_PR, cyl, cur_pr); // and store the interpolated data in plot_info
 	}
+	free(pt_sum);
 }
 
 
@@ -357,11 +347,11 @@ static void debug_print_pressures(struct plot_info *pi)
 
 /* This function goes through the list of tank pressures, of structure plot_info for the dive profile where each
  * item in the list corresponds to one point (node) of the profile. It finds values for which there are no tank
- * pressures (pressure==0). For each missing item (node) of tank pressure it creates a pr_track_alloc structure
- * that represents a segment on the dive profile and that contains tank pressures. There is a linked list of
- * pr_track_alloc structures for each cylinder. These pr_track_alloc structures ultimately allow for filling
+ * pressures (pressure==0). For each missing item (node) of tank pressure it creates a pr_track_t structure
+ * that represents a segment on the dive profile and that contains tank pressures. There is a table of
+ * pr_track_t structures for each cylinder. These pr_track_t structures ultimately allow for filling
  * the missing tank pressure values on the dive profile using the depth_pressure of the dive. To do this, it
- * calculates the summed pressure-time value for the duration of the dive and stores these * in the pr_track_alloc
+ * calculates the summed pressure-time value for the duration of the dive and stores these * in the pr_track_t
  * structures. This function is called by create_plot_info_new() in profile.c
  */
 void populate_pressure_information(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, int sensor)
@@ -369,10 +359,10 @@ void populate_pressure_information(const struct dive *dive, const struct divecom
 	UNUSED(dc);
 	int first, last, cyl;
 	cylinder_t *cylinder = get_cylinder(dive, sensor);
-	pr_track_t *track = NULL;
+	struct pr_track_table track = { 0 };
 	pr_track_t *current = NULL;
 	const struct event *ev, *b_ev;
-	int missing_pr = 0, dense = 1;
+	int missing_pr = 0, dense = 1, idx;
 	enum divemode_t dmode = dc->divemode;
 	const double gasfactor[5] = {1.0, 0.0, prefs.pscr_ratio/1000.0, 1.0, 1.0 };
 
@@ -471,18 +461,18 @@ void populate_pressure_information(const struct dive *dive, const struct divecom
 		// missing entries that need to be interpolated.
 		// Or maybe we didn't have a previous one at all,
 		// and this is the first pressure entry.
-		current = pr_track_alloc(pressure, entry->sec);
-		track = list_add(track, current);
+		idx = pr_track_add(&track, pressure, entry->sec);
+		current = &track.tracks[idx];
 		dense = 1;
 	}
 
 	if (missing_pr) {
-		fill_missing_tank_pressures(dive, pi, track, sensor);
+		fill_missing_tank_pressures(dive, pi, &track, sensor);
 	}
 
 #ifdef PRINT_PRESSURES_DEBUG
 	debug_print_pressures(pi);
 #endif
 
-	list_free(track);
+	free(track.tracks);
 }
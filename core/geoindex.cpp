@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "geoindex.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Leaves are split when they contain more entries. At the maximum depth, the
+// cells are a few meters wide, therefore deeper nodes would be pointless.
+static const int bucket_size = 8;
+static const int max_depth = 24;
+
+// Same radius as used by QGeoCoordinate
+static const double earth_mean_radius = 6371007.2;
+static const double max_mercator_latitude = 85.05112878;
+
+static double radians(double degrees)
+{
+	return degrees * M_PI / 180.0;
+}
+
+static double degrees(double radians)
+{
+	return radians * 180.0 / M_PI;
+}
+
+static double clamp_unit(double v)
+{
+	return std::clamp(v, 0.0, std::nextafter(1.0, 0.0));
+}
+
+static double mercator_x(double longitude)
+{
+	return clamp_unit((longitude + 180.0) / 360.0);
+}
+
+static double mercator_y(double latitude)
+{
+	latitude = std::clamp(latitude, -max_mercator_latitude, max_mercator_latitude);
+	return clamp_unit(0.5 - log(tan(M_PI / 4.0 + radians(latitude) / 2.0)) / (2.0 * M_PI));
+}
+
+bool GeoIndex::Area::contains(const Area &a) const
+{
+	if (a.north > north || a.south < south)
+		return false;
+	if (width >= 360.0)
+		return true;
+	if (a.width > width)
+		return false;
+	double offset = fmod(a.west - west + 720.0, 360.0);
+	return offset + a.width <= width;
+}
+
+GeoIndex::Area GeoIndex::Area::expanded(double factor) const
+{
+	double margin = (north - south) * factor;
+	Area res;
+	res.north = std::min(north + margin, 90.0);
+	res.south = std::max(south - margin, -90.0);
+	res.width = width * (1.0 + 2.0 * factor);
+	if (res.width >= 360.0) {
+		res.west = -180.0;
+		res.width = 360.0;
+	} else {
+		res.west = fmod(west - width * factor + 540.0, 360.0) - 180.0;
+	}
+	return res;
+}
+
+GeoIndex::Area GeoIndex::Area::world()
+{
+	return { 90.0, -90.0, -180.0, 360.0 };
+}
+
+double GeoIndex::distance(double latitude1, double longitude1, double latitude2, double longitude2)
+{
+	double haversine_dlat = sin(radians(latitude2 - latitude1) / 2.0);
+	double haversine_dlon = sin(radians(longitude2 - longitude1) / 2.0);
+	double y = haversine_dlat * haversine_dlat +
+		   cos(radians(latitude1)) * cos(radians(latitude2)) * haversine_dlon * haversine_dlon;
+	return 2.0 * asin(sqrt(y)) * earth_mean_radius;
+}
+
+void GeoIndex::build(std::vector<Point> points)
+{
+	entries.clear();
+	nodes.clear();
+	entries.reserve(points.size());
+	for (const Point &p: points)
+		entries.push_back({ mercator_x(p.longitude), mercator_y(p.latitude), p });
+	if (!entries.empty())
+		buildNode(0, (int)entries.size(), 0.0, 0.0, 0);
+}
+
+bool GeoIndex::empty() const
+{
+	return entries.empty();
+}
+
+// The entries of every node are stored consecutively. Returns the index of the new node.
+int GeoIndex::buildNode(int begin, int end, double x, double y, int depth)
+{
+	int idx = (int)nodes.size();
+	nodes.push_back({ begin, end, { -1, -1, -1, -1 }, true, 0.0, 0.0 });
+	for (int i = begin; i < end; i++) {
+		nodes[idx].sumLatitude += entries[i].p.latitude;
+		nodes[idx].sumLongitude += entries[i].p.longitude;
+	}
+	if (end - begin <= bucket_size || depth >= max_depth)
+		return idx;
+	nodes[idx].leaf = false;
+
+	double half = ldexp(1.0, -depth - 1);
+	auto first = entries.begin();
+	int mid = std::partition(first + begin, first + end, [y, half](const Entry &e) { return e.y < y + half; }) - first;
+	int q1 = std::partition(first + begin, first + mid, [x, half](const Entry &e) { return e.x < x + half; }) - first;
+	int q3 = std::partition(first + mid, first + end, [x, half](const Entry &e) { return e.x < x + half; }) - first;
+	int bounds[5] = { begin, q1, mid, q3, end };
+	for (int i = 0; i < 4; i++) {
+		if (bounds[i] == bounds[i + 1])
+			continue;
+		int child = buildNode(bounds[i], bounds[i + 1], x + (i % 2) * half, y + (i / 2) * half, depth + 1);
+		nodes[idx].children[i] = child;
+	}
+	return idx;
+}
+
+// The area in map coordinates. If it crosses the antimeridian, it is split in two.
+std::vector<GeoIndex::Rect> GeoIndex::rects(const Area &area)
+{
+	double y1 = mercator_y(area.north);
+	double y2 = mercator_y(area.south);
+	if (area.width >= 360.0)
+		return { { 0.0, y1, 1.0, y2 } };
+	double x1 = fmod((area.west + 180.0) / 360.0 + 1.0, 1.0);
+	double x2 = x1 + area.width / 360.0;
+	if (x2 <= 1.0)
+		return { { x1, y1, x2, y2 } };
+	return { { x1, y1, 1.0, y2 }, { 0.0, y1, x2 - 1.0, y2 } };
+}
+
+// Calls f(node, depth) for all nodes that overlap the rectangles, starting at the root.
+// The children of a node are only visited if f returns true.
+template <typename F>
+void GeoIndex::visit(int node, double x, double y, int depth, const std::vector<Rect> &r, F &f) const
+{
+	double size = ldexp(1.0, -depth);
+	if (std::none_of(r.begin(), r.end(), [x, y, size](const Rect &rect)
+			 { return x <= rect.x2 && x + size >= rect.x1 && y <= rect.y2 && y + size >= rect.y1; }))
+		return;
+	if (!f(nodes[node], depth) || nodes[node].leaf)
+		return;
+	double half = size / 2.0;
+	for (int i = 0; i < 4; i++) {
+		if (nodes[node].children[i] >= 0)
+			visit(nodes[node].children[i], x + (i % 2) * half, y + (i / 2) * half, depth + 1, r, f);
+	}
+}
+
+bool GeoIndex::inside(double x, double y, const std::vector<Rect> &rects)
+{
+	return std::any_of(rects.begin(), rects.end(), [x, y](const Rect &r)
+			   { return x >= r.x1 && x <= r.x2 && y >= r.y1 && y <= r.y2; });
+}
+
+// The clusters are the cells of the quadtree at the level where the cells are at least clusterSize wide.
+int GeoIndex::clusterLevel(double clusterSize)
+{
+	if (clusterSize <= 0.0)
+		return max_depth + 1;
+	return std::clamp((int)floor(-log2(clusterSize)), 0, max_depth);
+}
+
+std::vector<GeoIndex::Cluster> GeoIndex::clusters(const Area &area, double clusterSize) const
+{
+	std::vector<Cluster> res;
+	if (entries.empty())
+		return res;
+	std::vector<Rect> r = rects(area);
+	int level = clusterLevel(clusterSize);
+	double cell = ldexp(1.0, -level);
+	auto f = [&](const Node &node, int depth) {
+		if (depth >= level) {
+			int count = node.end - node.begin;
+			res.push_back({ node.sumLatitude / count, node.sumLongitude / count, count, entries[node.begin].p.id });
+			return false;
+		}
+		if (!node.leaf)
+			return true;
+		// A leaf that is larger than a cluster: sort its few entries into the cells of the cluster level
+		size_t first = res.size();
+		std::vector<std::pair<double, double>> cells;
+		for (int i = node.begin; i < node.end; i++) {
+			const Entry &e = entries[i];
+			if (!inside(e.x, e.y, r))
+				continue;
+			std::pair<double, double> c(floor(e.x / cell), floor(e.y / cell));
+			auto it = level > max_depth ? cells.end() : std::find(cells.begin(), cells.end(), c);
+			if (it == cells.end()) {
+				cells.push_back(c);
+				res.push_back({ e.p.latitude, e.p.longitude, 1, e.p.id });
+				continue;
+			}
+			Cluster &cluster = res[first + (it - cells.begin())];
+			cluster.latitude += e.p.latitude;
+			cluster.longitude += e.p.longitude;
+			cluster.count++;
+		}
+		for (size_t i = first; i < res.size(); i++) {
+			res[i].latitude /= res[i].count;
+			res[i].longitude /= res[i].count;
+		}
+		return false;
+	};
+	visit(0, 0.0, 0.0, 0, r, f);
+	return res;
+}
+
+std::vector<int> GeoIndex::withinRadius(double latitude, double longitude, double radius) const
+{
+	std::vector<int> res;
+	if (entries.empty())
+		return res;
+
+	// The bounding box of the circle. Towards the poles, the degrees of longitude get shorter.
+	double dlat = degrees(radius / earth_mean_radius);
+	Area area;
+	area.north = std::min(latitude + dlat, 90.0);
+	area.south = std::max(latitude - dlat, -90.0);
+	double c = cos(radians(std::max(fabs(area.north), fabs(area.south))));
+	double dlon = c > 0.0 ? dlat / c : 360.0;
+	if (area.north >= 90.0 || area.south <= -90.0 || dlon >= 180.0) {
+		area.west = -180.0;
+		area.width = 360.0;
+	} else {
+		area.west = longitude - dlon;
+		area.width = 2.0 * dlon;
+	}
+
+	std::vector<Rect> r = rects(area);
+	auto f = [&](const Node &node, int) {
+		if (!node.leaf)
+			return true;
+		for (int i = node.begin; i < node.end; i++) {
+			const Entry &e = entries[i];
+			if (inside(e.x, e.y, r) && distance(latitude, longitude, e.p.latitude, e.p.longitude) < radius)
+				res.push_back(e.p.id);
+		}
+		return false;
+	};
+	visit(0, 0.0, 0.0, 0, r, f);
+	return res;
+}
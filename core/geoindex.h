@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0
+// A quadtree of points on the map. It is used to cluster the dive sites that
+// are shown at the current zoom level of the map and to find the dive sites
+// within a radius of a location. The points are given in degrees and indexed
+// in the projection of the map (Web Mercator), normalized to the unit square.
+#ifndef GEOINDEX_H
+#define GEOINDEX_H
+
+#include <vector>
+
+class GeoIndex {
+public:
+	struct Point {
+		double latitude, longitude;
+		int id;
+	};
+	struct Cluster {
+		double latitude, longitude;	// The mean position of the points
+		int count;
+		int id;				// The id of one of the points
+	};
+	// A part of the map. Since the map wraps around at the antimeridian,
+	// the east border is given as width in degrees, which may be up to 360.
+	struct Area {
+		double north, south;
+		double west, width;
+		bool contains(const Area &a) const;
+		Area expanded(double factor) const; // Each border is moved out by factor times the size of the area
+		static Area world();
+	};
+
+	void build(std::vector<Point> points);
+	bool empty() const;
+
+	// Points that are closer than clusterSize, given as fraction of the width of the map, are
+	// merged into clusters. Clusters are aligned to a grid, so that they don't change when the
+	// map is moved. Thus, clusters in different cells can be slightly closer than clusterSize.
+	// A clusterSize of 0 returns every point as a cluster of its own.
+	std::vector<Cluster> clusters(const Area &area, double clusterSize) const;
+	static int clusterLevel(double clusterSize);
+
+	// The ids of the points within radius meters of a position.
+	std::vector<int> withinRadius(double latitude, double longitude, double radius) const;
+
+	// The great-circle distance in meters, same as QGeoCoordinate::distanceTo().
+	static double distance(double latitude1, double longitude1, double latitude2, double longitude2);
+private:
+	struct Entry {
+		double x, y;
+		Point p;
+	};
+	struct Node {
+		int begin, end;		// The entries of this node are entries[begin, end)
+		int children[4];	// -1 if that quadrant is empty or if this is a leaf
+		bool leaf;
+		double sumLatitude, sumLongitude;
+	};
+	struct Rect {
+		double x1, y1, x2, y2;
+	};
+	int buildNode(int begin, int end, double x, double y, int depth);
+	template <typename F>
+	void visit(int node, double x, double y, int depth, const std::vector<Rect> &r, F &f) const;
+	static std::vector<Rect> rects(const Area &area);
+	static bool inside(double x, double y, const std::vector<Rect> &r);
+	std::vector<Entry> entries;
+	std::vector<Node> nodes;
+};
+
+#endif
@@ -37,6 +37,10 @@ bool git_local_only = false;
 #endif
 bool git_remote_sync_successful = false;
 
+// libgit2 can fetch a limited history (shallow clones) since version 1.7
+#if LIBGIT2_VER_MAJOR > 1 || (LIBGIT2_VER_MAJOR == 1 && LIBGIT2_VER_MINOR >= 7)
+#define HAVE_SHALLOW_CLONE 1
+#endif
 
 int (*update_progress_cb)(const char *) = NULL;
 
@@ -74,13 +78,38 @@ int git_storage_update_progress(const char *text)
 	return ret;
 }
 
+// Background syncs report their progress to the git_info instead of the text callback.
+// Returns nonzero if the sync was canceled, either now or earlier.
+static int sync_progress(struct git_info *info, enum git_sync_stage stage, unsigned int objects, unsigned int total_objects, size_t bytes)
+{
+	struct git_sync_progress progress = { stage, objects, total_objects, bytes };
+
+	if (!info->canceled && info->sync_progress(&progress, info->sync_payload)) {
+		SSRF_INFO("git storage: sync canceled");
+		info->canceled = true;
+	}
+	return info->canceled ? GIT_EUSER : 0;
+}
+
+// Progress messages of the sync. For background syncs, only check for cancellation.
+static int sync_update_progress(struct git_info *info, enum git_sync_stage stage, const char *text)
+{
+	if (info->sync_progress)
+		return sync_progress(info, stage, 0, 0, 0);
+	(void)git_storage_update_progress(text);
+	return 0;
+}
+
 // the checkout_progress_cb doesn't allow canceling of the operation
 // map the git progress to 20% of overall progress
 static void progress_cb(const char *path, size_t completed_steps, size_t total_steps, void *payload)
 {
 	UNUSED(path);
-	UNUSED(payload);
+	struct git_info *info = payload;
 	char buf[80];
+
+	if (info && info->sync_progress)
+		return;
 	snprintf(buf, sizeof(buf),  translate("gettextFromC", "Checkout from storage (%lu/%lu)"), completed_steps, total_steps);
 	(void)git_storage_update_progress(buf);
 }
@@ -90,13 +119,15 @@ static void progress_cb(const char *path, size_t completed_steps, size_t total_s
 // if the user cancels the dialog this is passed back to libgit2
 static int transfer_progress_cb(const git_transfer_progress *stats, void *payload)
 {
-	UNUSED(payload);
+	struct git_info *info = payload;
 
 	static int last_done = -1;
 	char buf[80];
 	int done = 0;
 	int total = 0;
 
+	if (info && info->sync_progress)
+		return sync_progress(info, GIT_SYNC_FETCH, stats->received_objects, stats->total_objects, stats->received_bytes);
 	if (stats->total_objects) {
 		total = 60;
 		done = 60 * stats->received_objects / stats->total_objects;
@@ -121,9 +152,11 @@ static int transfer_progress_cb(const git_transfer_progress *stats, void *payloa
 // the initial push to sync the repos is mapped to 10% of overall progress
 static int push_transfer_progress_cb(unsigned int current, unsigned int total, size_t bytes, void *payload)
 {
-	UNUSED(bytes);
-	UNUSED(payload);
+	struct git_info *info = payload;
 	char buf[80];
+
+	if (info && info->sync_progress)
+		return sync_progress(info, GIT_SYNC_PUSH, current, total, bytes);
 	snprintf(buf, sizeof(buf), translate("gettextFromC", "Transfer to storage (%d/%d)"), current, total);
 	return git_storage_update_progress(buf);
 }
@@ -185,6 +218,7 @@ static int reset_to_remote(struct git_info *info, git_reference *local, const gi
 {
 	git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
 	opts.progress_cb = &progress_cb;
+	opts.progress_payload = info;
 	git_object *target;
 
 	if (verbose)
@@ -229,12 +263,12 @@ static int reset_to_remote(struct git_info *info, git_reference *local, const gi
 	return 0;
 }
 
-static int auth_attempt = 0;
 static const int max_auth_attempts = 2;
 
-static bool exceeded_auth_attempts()
+/* The attempts are counted per git_info, a background sync may authenticate while the dives are loaded or saved */
+static bool exceeded_auth_attempts(struct git_info *info)
 {
-	if (auth_attempt++ > max_auth_attempts) {
+	if (info->auth_attempt++ > max_auth_attempts) {
 		SSRF_INFO("git storage: authentication to cloud storage failed");
 		report_error("Authentication to cloud storage failed.");
 		return true;
@@ -249,8 +283,8 @@ int credential_ssh_cb(git_cred **out,
 		  void *payload)
 {
 	UNUSED(url);
-	UNUSED(payload);
 	UNUSED(username_from_url);
+	struct git_info *info = payload;
 
 	const char *username = prefs.cloud_storage_email_encoded;
 	const char *passphrase = prefs.cloud_storage_password ? prefs.cloud_storage_password : "";
@@ -259,7 +293,7 @@ int credential_ssh_cb(git_cred **out,
 	if (allowed_types & GIT_CREDTYPE_SSH_KEY) {
 		char *priv_key = format_string("%s/%s", system_default_directory(), "ssrf_remote.key");
 		if (!access(priv_key, F_OK)) {
-			if (exceeded_auth_attempts())
+			if (exceeded_auth_attempts(info))
 				return GIT_EUSER;
 			int ret = git_cred_ssh_key_new(out, username, NULL, priv_key, passphrase);
 			free(priv_key);
@@ -269,7 +303,7 @@ int credential_ssh_cb(git_cred **out,
 	}
 
 	if (allowed_types & GIT_CREDTYPE_USERPASS_PLAINTEXT) {
-		if (exceeded_auth_attempts())
+		if (exceeded_auth_attempts(info))
 			return GIT_EUSER;
 		return git_cred_userpass_plaintext_new(out, username, passphrase);
 	}
@@ -289,10 +323,10 @@ int credential_https_cb(git_cred **out,
 {
 	UNUSED(url);
 	UNUSED(username_from_url);
-	UNUSED(payload);
 	UNUSED(allowed_types);
+	struct git_info *info = payload;
 
-	if (exceeded_auth_attempts())
+	if (exceeded_auth_attempts(info))
 		return GIT_EUSER;
 
 	const char *username = prefs.cloud_storage_email_encoded;
@@ -329,11 +363,15 @@ static int update_remote(struct git_info *info, git_remote *origin, git_referenc
 	if (verbose)
 		SSRF_INFO("git storage: update remote\n");
 
+	if (sync_update_progress(info, GIT_SYNC_PUSH, translate("gettextFromC", "Push local changes to cloud storage")))
+		return -1;
+
 	refspec.count = 1;
 	refspec.strings = (char **)&name;
 
-	auth_attempt = 0;
+	info->auth_attempt = 0;
 	opts.callbacks.push_transfer_progress = &push_transfer_progress_cb;
+	opts.callbacks.payload = info;
 	if (info->transport == RT_SSH)
 		opts.callbacks.credentials = credential_ssh_cb;
 	else if (info->transport == RT_HTTPS)
@@ -341,6 +379,8 @@ static int update_remote(struct git_info *info, git_remote *origin, git_referenc
 	opts.callbacks.certificate_check = certificate_check_cb;
 
 	if (git_remote_push(origin, &refspec, &opts)) {
+		if (info->canceled)
+			return -1;
 		const char *msg = giterr_last()->message;
 		SSRF_INFO("git storage: unable to update remote with current local cache state, error: %s", msg);
 		if (info->is_subsurface_cloud)
@@ -460,7 +500,9 @@ static int try_to_git_merge(struct git_info *info, git_reference **local_p, git_
 	}
 	if (git_reference_set_target(local_p, *local_p, &commit_oid, "Subsurface merge event"))
 		goto write_error;
-	set_git_id(&commit_oid);
+	// in the background, the loaded data doesn't contain the merge yet
+	if (!info->sync_progress)
+		set_git_id(&commit_oid);
 	git_signature_free(author);
 	if (verbose)
 		SSRF_INFO("git storage: successfully merged repositories");
@@ -478,6 +520,26 @@ write_error:
 // if accessing the local cache of Subsurface cloud storage fails, we simplify things
 // for the user and simply move the cache away (in case they want to try and extract data)
 // and ask them to retry the operation (which will then refresh the data from the cloud server)
+/*
+ * Merge a commit into the local branch, which has moved on from the parent of
+ * the commit (base) in the meantime, e.g. by a merge of a sync with the remote
+ * in the background. The branch is set to the merge, which is returned in *merge.
+ * Must be called under the git storage lock.
+ */
+int git_merge_into_branch(struct git_info *info, git_reference **branch, const git_oid *base, const git_oid *commit, git_oid *merge)
+{
+	git_oid base_id = *base;
+	git_oid tip = *git_reference_target(*branch);
+	int ret;
+
+	if (verbose)
+		SSRF_INFO("git storage: branch %s moved on since the data was loaded, merge the save into it", info->branch);
+	ret = try_to_git_merge(info, branch, NULL, &base_id, commit, &tip);
+	if (!ret)
+		*merge = *git_reference_target(*branch);
+	return ret;
+}
+
 static int cleanup_local_cache(struct git_info *info)
 {
 	char *backup_path = move_local_cache(info);
@@ -488,8 +550,14 @@ static int cleanup_local_cache(struct git_info *info)
 	return -1;
 }
 
-static int try_to_update(struct git_info *info, git_remote *origin, git_reference *local, git_reference *remote)
+/*
+ * Bring the local branch up to date with the remote. If the remote has to be
+ * updated afterwards, *push is set. This only works on the local repository,
+ * the caller pushes.
+ */
+static int try_to_update(struct git_info *info, git_reference **local_p, git_reference *remote, bool *push)
 {
+	git_reference *local = *local_p;
 	git_oid base;
 	const git_oid *local_id, *remote_id;
 	int ret = 0;
@@ -538,7 +606,8 @@ static int try_to_update(struct git_info *info, git_remote *origin, git_referenc
 	if (git_oid_equal(&base, local_id)) {
 		if (verbose)
 			SSRF_INFO("git storage: remote is newer than local, update local");
-		git_storage_update_progress(translate("gettextFromC", "Update local storage to match cloud storage"));
+		if (sync_update_progress(info, GIT_SYNC_MERGE, translate("gettextFromC", "Update local storage to match cloud storage")))
+			return -1;
 		return reset_to_remote(info, local, remote_id);
 	}
 
@@ -546,8 +615,8 @@ static int try_to_update(struct git_info *info, git_remote *origin, git_referenc
 	if (git_oid_equal(&base, remote_id)) {
 		if (verbose)
 			SSRF_INFO("git storage: local is newer than remote, update remote");
-		git_storage_update_progress(translate("gettextFromC", "Push local changes to cloud storage"));
-		return update_remote(info, origin, local, remote);
+		*push = true;
+		return 0;
 	}
 	/* Merging a bare repository always needs user action */
 	if (git_repository_is_bare(info->repo)) {
@@ -566,12 +635,11 @@ static int try_to_update(struct git_info *info, git_remote *origin, git_referenc
 			return report_error("Local and remote do not match, local branch not HEAD - cannot update");
 	}
 	/* Ok, let's try to merge these */
-	git_storage_update_progress(translate("gettextFromC", "Try to merge local changes into cloud storage"));
-	ret = try_to_git_merge(info, &local, remote, &base, local_id, remote_id);
-	if (ret == 0)
-		return update_remote(info, origin, local, remote);
-	else
-		return ret;
+	if (sync_update_progress(info, GIT_SYNC_MERGE, translate("gettextFromC", "Try to merge local changes into cloud storage")))
+		return -1;
+	ret = try_to_git_merge(info, local_p, remote, &base, local_id, remote_id);
+	*push = ret == 0;
+	return ret;
 
 cloud_data_error:
 	// since we are working with Subsurface cloud storage we want to make the user interaction
@@ -583,41 +651,56 @@ cloud_data_error:
 static int check_remote_status(struct git_info *info, git_remote *origin)
 {
 	int error = 0;
+	bool push = false;
 
 	git_reference *local_ref, *remote_ref;
 
 	if (verbose)
 		SSRF_INFO("git storage: check remote status\n");
 
+	/* The local branch must not change while we update it, a save may happen at the same time */
+	lock_git_storage();
 	if (git_branch_lookup(&local_ref, info->repo, info->branch, GIT_BRANCH_LOCAL)) {
 		SSRF_INFO("git storage: branch %s is missing in local repo", info->branch);
 		if (info->is_subsurface_cloud)
-			return cleanup_local_cache(info);
+			error = cleanup_local_cache(info);
 		else
-			return report_error("Git cache branch %s no longer exists", info->branch);
+			error = report_error("Git cache branch %s no longer exists", info->branch);
+		unlock_git_storage();
+		return error;
 	}
 	if (git_branch_upstream(&remote_ref, local_ref)) {
+		unlock_git_storage();
 		/* so there is no upstream branch for our branch; that's a problem.
 		 * let's push our branch */
 		SSRF_INFO("git storage: branch %s is missing in remote, pushing branch", info->branch);
 		git_strarray refspec;
 		git_reference_list(&refspec, info->repo);
 		git_push_options opts = GIT_PUSH_OPTIONS_INIT;
-		opts.callbacks.transfer_progress = &transfer_progress_cb;
-		auth_attempt = 0;
+		opts.callbacks.push_transfer_progress = &push_transfer_progress_cb;
+		opts.callbacks.payload = info;
+		info->auth_attempt = 0;
 		if (info->transport == RT_SSH)
 			opts.callbacks.credentials = credential_ssh_cb;
 		else if (info->transport == RT_HTTPS)
 			opts.callbacks.credentials = credential_https_cb;
 		opts.callbacks.certificate_check = certificate_check_cb;
-		git_storage_update_progress(translate("gettextFromC", "Store data into cloud storage"));
-		error = git_remote_push(origin, &refspec, &opts);
+		if (sync_update_progress(info, GIT_SYNC_PUSH, translate("gettextFromC", "Store data into cloud storage")))
+			error = -1;
+		else
+			error = git_remote_push(origin, &refspec, &opts);
+		git_strarray_free(&refspec);
 	} else {
-		error = try_to_update(info, origin, local_ref, remote_ref);
+		error = try_to_update(info, &local_ref, remote_ref, &push);
+		unlock_git_storage();
+		if (!error && push)
+			error = update_remote(info, origin, local_ref, remote_ref);
 		git_reference_free(remote_ref);
 	}
 	git_reference_free(local_ref);
-	git_remote_sync_successful = (error == 0);
+	// background syncs report their result to their caller
+	if (!info->sync_progress)
+		git_remote_sync_successful = (error == 0);
 	return error;
 }
 
@@ -632,7 +715,9 @@ void delete_remote_branch(git_repository *repo, const char *remote, const char *
 	char *proxy_string;
 	git_remote *origin;
 	git_config *conf;
+	struct git_info info; /* only counts the authentication attempts */
 
+	memset(&info, 0, sizeof(info));
 	/* set up the config and proxy information in order to connect to the server */
 	git_repository_config(&conf, repo);
 	if (getProxyString(&proxy_string)) {
@@ -647,8 +732,8 @@ void delete_remote_branch(git_repository *repo, const char *remote, const char *
 	}
 	/* fetch the remote state */
 	git_fetch_options f_opts = GIT_FETCH_OPTIONS_INIT;
-	auth_attempt = 0;
 	f_opts.callbacks.credentials = credential_https_cb;
+	f_opts.callbacks.payload = &info;
 	error = git_remote_fetch(origin, NULL, &f_opts, NULL);
 	if (error) {
 		SSRF_INFO("git storage: remote fetch failed (%s)\n", giterr_last() ? giterr_last()->message : "authentication failed");
@@ -660,8 +745,9 @@ void delete_remote_branch(git_repository *repo, const char *remote, const char *
 	refspec.count = 1;
 	refspec.strings = &branch_ref;
 	git_push_options p_opts = GIT_PUSH_OPTIONS_INIT;
-	auth_attempt = 0;
+	info.auth_attempt = 0;
 	p_opts.callbacks.credentials = credential_https_cb;
+	p_opts.callbacks.payload = &info;
 	error = git_remote_push(origin, &refspec, &p_opts);
 	free(branch_ref);
 	if (error) {
@@ -672,21 +758,17 @@ void delete_remote_branch(git_repository *repo, const char *remote, const char *
 	return;
 }
 
-int sync_with_remote(struct git_info *info)
+static int do_sync_with_remote(struct git_info *info)
 {
 	int error;
 	git_remote *origin;
 	char *proxy_string;
 	git_config *conf;
 
-	if (git_local_only) {
-		if (verbose)
-			SSRF_INFO("git storage: don't sync with remote - read from cache only\n");
-		return 0;
-	}
 	if (verbose)
 		SSRF_INFO("git storage: sync with remote %s[%s]\n", info->url, info->branch);
-	git_storage_update_progress(translate("gettextFromC", "Sync with cloud storage"));
+	if (sync_update_progress(info, GIT_SYNC_FETCH, translate("gettextFromC", "Sync with cloud storage")))
+		return -1;
 	git_repository_config(&conf, info->repo);
 	if (info->transport == RT_HTTPS && getProxyString(&proxy_string)) {
 		if (verbose)
@@ -714,11 +796,12 @@ int sync_with_remote(struct git_info *info)
 
 	// we know that we already checked for the cloud server, but to give a decent warning message
 	// here in case none of them are reachable, let's check one more time
-	if (info->is_subsurface_cloud && !canReachCloudServer(info)) {
+	// (not in the background, that check may switch the server and go offline - there the fetch just fails)
+	if (info->is_subsurface_cloud && !info->sync_progress && !canReachCloudServer(info)) {
 		// this is not an error, just a warning message, so return 0
 		SSRF_INFO("git storage: cannot connect to remote server");
 		report_error("Cannot connect to cloud server, working with local copy");
-		git_storage_update_progress(translate("gettextFromC", "Can't reach cloud server, working with local data"));
+		sync_update_progress(info, GIT_SYNC_FETCH, translate("gettextFromC", "Can't reach cloud server, working with local data"));
 		return 0;
 	}
 
@@ -726,33 +809,69 @@ int sync_with_remote(struct git_info *info)
 		SSRF_INFO("git storage: fetch remote %s\n", git_remote_url(origin));
 	git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
 	opts.callbacks.transfer_progress = &transfer_progress_cb;
-	auth_attempt = 0;
+	opts.callbacks.payload = info;
+	info->auth_attempt = 0;
 	if (info->transport == RT_SSH)
 		opts.callbacks.credentials = credential_ssh_cb;
 	else if (info->transport == RT_HTTPS)
 		opts.callbacks.credentials = credential_https_cb;
 	opts.callbacks.certificate_check = certificate_check_cb;
-	git_storage_update_progress(translate("gettextFromC", "Successful cloud connection, fetch remote"));
-	error = git_remote_fetch(origin, NULL, &opts, NULL);
+	if (sync_update_progress(info, GIT_SYNC_FETCH, translate("gettextFromC", "Successful cloud connection, fetch remote")))
+		error = -1;
+	else
+		error = git_remote_fetch(origin, NULL, &opts, NULL);
 	// NOTE! A fetch error is not fatal, we just report it
-	if (error) {
+	if (info->canceled) {
+		SSRF_INFO("git storage: sync with remote canceled\n");
+		error = -1;
+	} else if (error) {
 		if (info->is_subsurface_cloud)
 			report_error("Cannot sync with cloud server, working with offline copy");
 		else
 			report_error("Unable to fetch remote '%s'", info->url);
 		// If we returned GIT_EUSER during authentication, giterr_last() returns NULL
 		SSRF_INFO("git storage: remote fetch failed (%s)\n", giterr_last() ? giterr_last()->message : "authentication failed");
-		// Since we failed to sync with online repository, enter offline mode
-		git_local_only = true;
-		error = 0;
+		// Since we failed to sync with online repository, enter offline mode.
+		// Background syncs fail instead, they are simply retried later.
+		if (info->sync_progress) {
+			error = -1;
+		} else {
+			git_local_only = true;
+			error = 0;
+		}
 	} else {
 		error = check_remote_status(info, origin);
 	}
 	git_remote_free(origin);
-	git_storage_update_progress(translate("gettextFromC", "Done syncing with cloud storage"));
+	if (!info->sync_progress)
+		git_storage_update_progress(translate("gettextFromC", "Done syncing with cloud storage"));
 	return error;
 }
 
+int sync_with_remote(struct git_info *info)
+{
+	if (git_local_only || info->local_only) {
+		if (verbose)
+			SSRF_INFO("git storage: don't sync with remote - read from cache only\n");
+		return 0;
+	}
+	return do_sync_with_remote(info);
+}
+
+/*
+ * Sync the local cache with the remote, even if git_local_only is set. This is
+ * used by background syncs, which open their own handle of the local cache.
+ */
+int git_sync_repository(struct git_info *info)
+{
+	if (!info->repo && git_repository_open(&info->repo, info->localdir)) {
+		const char *msg = giterr_last()->message;
+		SSRF_INFO("git storage: unable to open local cache at %s: %s", info->localdir, msg);
+		return report_error("Unable to open git cache repository at %s: %s", info->localdir, msg);
+	}
+	return do_sync_with_remote(info);
+}
+
 static bool update_local_repo(struct git_info *info)
 {
 	git_reference *head;
@@ -858,8 +977,9 @@ static bool create_local_repo(struct git_info *info)
 	if (verbose)
 		SSRF_INFO("git storage: create_local_repo\n");
 
-	auth_attempt = 0;
+	info->auth_attempt = 0;
 	opts.fetch_opts.callbacks.transfer_progress = &transfer_progress_cb;
+	opts.fetch_opts.callbacks.payload = info;
 	if (info->transport == RT_SSH)
 		opts.fetch_opts.callbacks.credentials = credential_ssh_cb;
 	else if (info->transport == RT_HTTPS)
@@ -868,6 +988,15 @@ static bool create_local_repo(struct git_info *info)
 	opts.fetch_opts.callbacks.certificate_check = certificate_check_cb;
 
 	opts.checkout_branch = info->branch;
+	if (prefs.cloud_shallow_clone) {
+#ifdef HAVE_SHALLOW_CLONE
+		/* Only fetch the current commit. Later fetches continue from there,
+		 * merges only need the history since the clone. */
+		opts.fetch_opts.depth = 1;
+#else
+		SSRF_INFO("git storage: libgit2 %s doesn't support shallow clones, fetching the whole history", LIBGIT2_VERSION);
+#endif
+	}
 	if (info->is_subsurface_cloud && !canReachCloudServer(info)) {
 		SSRF_INFO("git storage: cannot reach remote server");
 		return false;
@@ -875,6 +1004,16 @@ static bool create_local_repo(struct git_info *info)
 	if (verbose > 1)
 		SSRF_INFO("git storage: calling git_clone()\n");
 	error = git_clone(&info->repo, info->url, info->localdir, &opts);
+#ifdef HAVE_SHALLOW_CLONE
+	/* Not every transport supports shallow fetches (e.g. the local one), fall back to a full clone */
+	if (error == GIT_ENOTSUPPORTED && opts.fetch_opts.depth) {
+		SSRF_INFO("git storage: shallow clone of %s failed (%s), fetching the whole history", info->url,
+			  giterr_last() ? giterr_last()->message : "(unspecified)");
+		opts.fetch_opts.depth = 0;
+		info->auth_attempt = 0;
+		error = git_clone(&info->repo, info->url, info->localdir, &opts);
+	}
+#endif
 	if (verbose > 1)
 		SSRF_INFO("git storage: returned from git_clone() with return value %d\n", error);
 	if (error) {
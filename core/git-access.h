@@ -24,6 +24,15 @@ struct git_oid;
 struct git_repository;
 struct divelog;
 
+/* Structured progress of a sync with the remote, see git_info.sync_progress */
+enum git_sync_stage { GIT_SYNC_FETCH, GIT_SYNC_MERGE, GIT_SYNC_PUSH };
+
+struct git_sync_progress {
+	enum git_sync_stage stage;
+	unsigned int objects, total_objects;
+	size_t bytes;
+};
+
 struct git_info {
 	const char *url;
 	const char *branch;
@@ -32,16 +41,31 @@ struct git_info {
 	struct git_repository *repo;
 	unsigned is_subsurface_cloud:1;
 	enum remote_transport transport;
+	/*
+	 * Used by syncs that run in the background (see gitsync.h): if set, the
+	 * sync reports its progress here instead of through the text callback and
+	 * leaves the id of the loaded commit alone. A nonzero return value cancels
+	 * the sync, which is then marked as canceled.
+	 */
+	int (*sync_progress)(const struct git_sync_progress *progress, void *payload);
+	void *sync_payload;
+	unsigned canceled:1;
+	/* Only save to the local cache, the caller syncs with the remote (see gitsync.h) */
+	unsigned local_only:1;
+	/* Authentication attempts of the current fetch or push, reset before each of them */
+	int auth_attempt;
 };
 
 extern bool is_git_repository(const char *filename, struct git_info *info);
 extern bool open_git_repository(struct git_info *info);
 extern bool remote_repo_uptodate(const char *filename, struct git_info *info);
 extern int sync_with_remote(struct git_info *);
+extern int git_sync_repository(struct git_info *);
 extern int git_save_dives(struct git_info *, bool select_only);
 extern int git_load_dives(struct git_info *, struct divelog *log);
 extern const char *get_sha(git_repository *repo, const char *branch);
 extern int do_git_save(struct git_info *, bool select_only, bool create_empty);
+extern int git_merge_into_branch(struct git_info *info, git_reference **branch, const git_oid *base, const git_oid *commit, git_oid *merge);
 extern void cleanup_git_info(struct git_info *);
 extern const char *saved_git_id;
 extern bool git_local_only;
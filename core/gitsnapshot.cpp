@@ -0,0 +1,433 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "gitsnapshot.h"
+#include "errorhelper.h"
+#include "qthelper.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The snapshot file consists of a header followed by one record per entry of the
+// tree. A record consists of a record header, the root and the name of the entry,
+// each terminated by a NUL byte, and the contents of the file. The record of a
+// tree is followed by the records of its entries, the length of which is stored
+// in the record header. Thus, a tree can be skipped or copied as a whole.
+// All numbers are in native byte order - this is a local cache, not an exchange format.
+static const char snapshotMagic[8] = { 'S', 'S', 'R', 'F', 'S', 'N', 'A', 'P' };
+static const quint32 snapshotVersion = 2;
+static const char snapshotName[] = "subsurface-snapshot";
+
+enum EntryType : quint32 {
+	ENTRY_FILE,
+	ENTRY_TREE
+};
+
+struct SnapshotHeader {
+	char magic[8];
+	quint32 version;
+	unsigned char commit[20];
+};
+
+struct RecordHeader {
+	unsigned char id[20];
+	quint32 type;
+	quint32 rootLength;	// Without the terminating NUL byte
+	quint32 nameLength;	// Likewise
+	quint32 size;		// Of the contents of a file
+	quint32 subtreeLength;	// Of the records of the entries of a tree
+};
+
+namespace {
+
+// Reads the entries of a tree from the repository in the order of git_tree_walk().
+// Used if no snapshot could be written, so that the load still works.
+class TreeReader {
+public:
+	TreeReader(git_repository *repo, git_tree *tree);
+	~TreeReader();
+	bool next(struct git_snapshot_entry *entry, bool skip);
+private:
+	struct Level {
+		git_tree *tree;
+		size_t index;
+		std::string root;	// Path of the tree, as passed by git_tree_walk()
+	};
+	git_repository *repo;
+	std::vector<Level> levels;
+	git_tree *subtree = nullptr;	// The tree of the last entry, entered by the next call unless skipped
+	std::string subtreeRoot;
+	git_blob *blob = nullptr;	// The contents of the last entry
+};
+
+}
+
+struct git_snapshot {
+	QFile file;		// The mapped snapshot
+	unsigned char commit[20];
+	const char *begin = nullptr, *end = nullptr;
+	const char *pos = nullptr;
+	const char *skip = nullptr;	// End of the entries of the last tree
+	std::unique_ptr<TreeReader> reader;	// If the entries are read from the repository instead
+};
+
+TreeReader::TreeReader(git_repository *repoIn, git_tree *tree) : repo(repoIn)
+{
+	levels.push_back({ tree, 0, std::string() });
+}
+
+TreeReader::~TreeReader()
+{
+	git_blob_free(blob);
+	git_tree_free(subtree);
+	for (Level &level: levels)
+		git_tree_free(level.tree);
+}
+
+bool TreeReader::next(struct git_snapshot_entry *entry, bool skip)
+{
+	git_blob_free(blob);
+	blob = nullptr;
+	if (subtree) {
+		if (skip)
+			git_tree_free(subtree);
+		else
+			levels.push_back({ subtree, 0, std::move(subtreeRoot) });
+		subtree = nullptr;
+	}
+	while (!levels.empty() && levels.back().index >= git_tree_entrycount(levels.back().tree)) {
+		git_tree_free(levels.back().tree);
+		levels.pop_back();
+	}
+	if (levels.empty())
+		return false;
+
+	Level &level = levels.back();
+	const git_tree_entry *treeEntry = git_tree_entry_byindex(level.tree, level.index++);
+	const git_oid *id = git_tree_entry_id(treeEntry);
+	entry->root = level.root.c_str();
+	entry->name = git_tree_entry_name(treeEntry);
+	memcpy(entry->id, id->id, sizeof(entry->id));
+	entry->is_tree = git_tree_entry_filemode(treeEntry) == GIT_FILEMODE_TREE;
+	entry->content = NULL;
+	entry->size = 0;
+	if (entry->is_tree) {
+		if (!git_tree_lookup(&subtree, repo, id))
+			subtreeRoot = level.root + entry->name + "/";
+	} else if (!git_blob_lookup(&blob, repo, id)) {
+		entry->content = (const char *)git_blob_rawcontent(blob);
+		entry->size = git_blob_rawsize(blob);
+	}
+	return true;
+}
+
+static qint64 recordLength(const RecordHeader &h)
+{
+	return (qint64)sizeof(h) + h.rootLength + 1 + h.nameLength + 1 + h.size;
+}
+
+static const char *recordRoot(const char *record)
+{
+	return record + sizeof(RecordHeader);
+}
+
+static const char *recordName(const char *record, const RecordHeader &h)
+{
+	return recordRoot(record) + h.rootLength + 1;
+}
+
+static const char *recordContent(const char *record, const RecordHeader &h)
+{
+	return recordName(record, h) + h.nameLength + 1;
+}
+
+// Returns the position of the next record or nullptr if the record doesn't fit into the snapshot
+static const char *readRecord(const char *record, const char *end, RecordHeader &h)
+{
+	if (end - record < (qint64)sizeof(h))
+		return nullptr;
+	memcpy(&h, record, sizeof(h));
+	qint64 length = recordLength(h);
+	if (h.type > ENTRY_TREE || end - record < length || end - record - length < h.subtreeLength)
+		return nullptr;
+	if (recordRoot(record)[h.rootLength] || recordName(record, h)[h.nameLength])
+		return nullptr;
+	return record + length;
+}
+
+static bool setData(git_snapshot *snapshot, const char *data, qint64 size)
+{
+	SnapshotHeader header;
+	if (size < (qint64)sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) || header.version != snapshotVersion)
+		return false;
+	const char *begin = data + sizeof(header);
+	const char *end = data + size;
+	// A damaged snapshot would give a partial dive log, so check all records beforehand.
+	// The entries of a tree must end on a record boundary inside of the containing tree.
+	RecordHeader h;
+	std::vector<const char *> subtreeEnds;
+	for (const char *p = begin; p < end;) {
+		while (!subtreeEnds.empty() && subtreeEnds.back() == p)
+			subtreeEnds.pop_back();
+		const char *limit = subtreeEnds.empty() ? end : subtreeEnds.back();
+		const char *next = readRecord(p, limit, h);
+		if (!next)
+			return false;
+		if (h.type == ENTRY_TREE)
+			subtreeEnds.push_back(next + h.subtreeLength);
+		else if (h.subtreeLength)
+			return false;
+		p = next;
+	}
+	memcpy(snapshot->commit, header.commit, sizeof(header.commit));
+	snapshot->begin = snapshot->pos = begin;
+	snapshot->end = end;
+	snapshot->skip = nullptr;
+	return true;
+}
+
+static QString snapshotFile(git_repository *repo)
+{
+	return QString::fromUtf8(git_repository_path(repo)) + snapshotName;
+}
+
+// Returns nullptr if there is no valid snapshot
+static git_snapshot *mapSnapshot(git_repository *repo)
+{
+	git_snapshot *snapshot = new git_snapshot;
+	snapshot->file.setFileName(snapshotFile(repo));
+	if (snapshot->file.open(QIODevice::ReadOnly)) {
+		qint64 size = snapshot->file.size();
+		const uchar *data = size > 0 ? snapshot->file.map(0, size) : nullptr;
+		if (data && setData(snapshot, (const char *)data, size))
+			return snapshot;
+	}
+	delete snapshot;
+	return nullptr;
+}
+
+namespace {
+
+// Writes the snapshot of a tree to a file, record by record, so that the contents
+// of the dive log are never kept in memory as a whole.
+class Builder {
+public:
+	Builder(git_repository *repo, const git_snapshot *old, QFileDevice &file);
+	bool build(git_tree *tree, const git_oid *commit);
+private:
+	static int walkCb(const char *root, const git_tree_entry *entry, void *payload);
+	int add(const char *root, const git_tree_entry *entry);
+	void closeTrees(const char *root);
+	bool write(const void *data, qint64 size);
+
+	struct OpenTree {
+		qint64 offset;
+		RecordHeader header;
+		std::string path;	// Root of the entries of the tree
+	};
+	git_repository *repo;
+	QFileDevice &file;
+	qint64 size;
+	QHash<QByteArray, const char *> oldRecords;	// Records of the previous snapshot by object id
+	std::vector<OpenTree> openTrees;
+	std::vector<OpenTree> closedTrees;		// Their headers are written at the end
+	bool unreadable;
+};
+
+}
+
+Builder::Builder(git_repository *repoIn, const git_snapshot *old, QFileDevice &fileIn) : repo(repoIn),
+	file(fileIn),
+	size(0),
+	unreadable(false)
+{
+	if (!old)
+		return;
+	// The keys point into the mapped old snapshot, which is kept until the build is done
+	RecordHeader h;
+	for (const char *p = old->begin; p < old->end; p = readRecord(p, old->end, h))
+		oldRecords.insert(QByteArray::fromRawData(p, sizeof(h.id)), p);
+}
+
+bool Builder::write(const void *data, qint64 length)
+{
+	if (file.write((const char *)data, length) != length)
+		return false;
+	size += length;
+	return true;
+}
+
+bool Builder::build(git_tree *tree, const git_oid *commit)
+{
+	SnapshotHeader header;
+	memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+	header.version = snapshotVersion;
+	memcpy(header.commit, commit->id, sizeof(header.commit));
+	if (!write(&header, sizeof(header)) || git_tree_walk(tree, GIT_TREEWALK_PRE, &walkCb, this))
+		return false;
+	closeTrees("");
+
+	// Fill in the lengths of the entries of the trees
+	for (OpenTree &t: closedTrees) {
+		if (!file.seek(t.offset) || file.write((const char *)&t.header, sizeof(t.header)) != sizeof(t.header))
+			return false;
+	}
+	return true;
+}
+
+int Builder::walkCb(const char *root, const git_tree_entry *entry, void *payload)
+{
+	return ((Builder *)payload)->add(root, entry);
+}
+
+// The entries of a tree end with the first entry that is not below the tree
+void Builder::closeTrees(const char *root)
+{
+	while (!openTrees.empty() && strncmp(root, openTrees.back().path.c_str(), openTrees.back().path.size())) {
+		OpenTree &t = openTrees.back();
+		t.header.subtreeLength = size - t.offset - recordLength(t.header);
+		closedTrees.push_back(std::move(t));
+		openTrees.pop_back();
+	}
+}
+
+int Builder::add(const char *root, const git_tree_entry *entry)
+{
+	closeTrees(root);
+
+	const git_oid *id = git_tree_entry_id(entry);
+	const char *name = git_tree_entry_name(entry);
+	bool isTree = git_tree_entry_filemode(entry) == GIT_FILEMODE_TREE;
+	const char *old = oldRecords.value(QByteArray::fromRawData((const char *)id->id, 20), nullptr);
+	RecordHeader oldHeader;
+	if (old)
+		memcpy(&oldHeader, old, sizeof(oldHeader));
+
+	// An unchanged tree at the same place is copied with all its entries, which are then skipped by the walk
+	if (isTree && old && oldHeader.type == ENTRY_TREE && !strcmp(recordRoot(old), root) && !strcmp(recordName(old, oldHeader), name))
+		return write(old, recordLength(oldHeader) + oldHeader.subtreeLength) ? 1 : -1;
+
+	RecordHeader h;
+	memcpy(h.id, id->id, sizeof(h.id));
+	h.rootLength = strlen(root);
+	h.nameLength = strlen(name);
+	h.size = 0;
+	h.subtreeLength = 0;
+	const char *content = nullptr;
+	git_blob *blob = nullptr;
+	if (isTree) {
+		h.type = ENTRY_TREE;
+	} else if (old && oldHeader.type == ENTRY_FILE) {
+		h.type = ENTRY_FILE;
+		h.size = oldHeader.size;
+		content = recordContent(old, oldHeader);
+	} else if (!git_blob_lookup(&blob, repo, id)) {
+		h.type = ENTRY_FILE;
+		h.size = git_blob_rawsize(blob);
+		content = (const char *)git_blob_rawcontent(blob);
+	} else {
+		// Don't keep a snapshot that lacks a file, the next load should try to read it again
+		unreadable = true;
+		return -1;
+	}
+
+	qint64 offset = size;
+	bool ok = write(&h, sizeof(h)) && write(root, h.rootLength + 1) && write(name, h.nameLength + 1) &&
+		  (!content || write(content, h.size));
+	git_blob_free(blob);
+	if (!ok)
+		return -1;
+	if (isTree)
+		openTrees.push_back({ offset, h, std::string(root) + name + "/" });
+	return 0;
+}
+
+// Write a new snapshot of the commit, reusing the contents of the old one, which is freed.
+// Returns false if the snapshot couldn't be written.
+static bool writeSnapshot(git_repository *repo, git_tree *tree, const git_oid *commit, git_snapshot *old)
+{
+	QSaveFile file(snapshotFile(repo));
+	bool ok = file.open(QIODevice::WriteOnly);
+	if (ok)
+		ok = Builder(repo, old, file).build(tree, commit);
+	// Unmap the old snapshot before replacing the file
+	delete old;
+	if (!ok) {
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
+
+// A snapshot that reads the entries from the repository. Takes ownership of the tree.
+static git_snapshot *treeSnapshot(git_repository *repo, git_tree *tree, const git_oid *commit)
+{
+	git_snapshot *snapshot = new git_snapshot;
+	memcpy(snapshot->commit, commit->id, sizeof(snapshot->commit));
+	snapshot->reader.reset(new TreeReader(repo, tree));
+	return snapshot;
+}
+
+extern "C" struct git_snapshot *git_snapshot_get(git_repository *repo, git_commit *commit, bool keep)
+{
+	const git_oid *id = git_commit_id(commit);
+	git_snapshot *old = keep ? mapSnapshot(repo) : nullptr;
+	if (old && !memcmp(old->commit, id->id, sizeof(old->commit)))
+		return old;
+
+	git_tree *tree;
+	if (git_commit_tree(&tree, commit)) {
+		delete old;
+		return nullptr;
+	}
+	if (!keep)
+		return treeSnapshot(repo, tree, id);
+
+	// The snapshot is made by the first load of a commit, not by the save that made it,
+	// so that saving isn't slowed down. The next loads then only map the file.
+	git_snapshot *snapshot = writeSnapshot(repo, tree, id, old) ? mapSnapshot(repo) : nullptr;
+	if (snapshot && !memcmp(snapshot->commit, id->id, sizeof(snapshot->commit))) {
+		git_tree_free(tree);
+		return snapshot;
+	}
+	delete snapshot;
+
+	// If the snapshot can't be written or is incomplete, read the repository this time
+	SSRF_INFO("git storage: couldn't write snapshot %s, reading the repository", qPrintable(snapshotFile(repo)));
+	return treeSnapshot(repo, tree, id);
+}
+
+extern "C" void git_snapshot_free(struct git_snapshot *snapshot)
+{
+	delete snapshot;
+}
+
+extern "C" bool git_snapshot_next(struct git_snapshot *snapshot, struct git_snapshot_entry *entry, bool skip)
+{
+	if (snapshot->reader)
+		return snapshot->reader->next(entry, skip);
+	if (skip && snapshot->skip)
+		snapshot->pos = snapshot->skip;
+	if (snapshot->pos >= snapshot->end)
+		return false;
+
+	// The records were checked when the snapshot was opened
+	RecordHeader h;
+	const char *record = snapshot->pos;
+	const char *next = readRecord(record, snapshot->end, h);
+	entry->root = recordRoot(record);
+	entry->name = recordName(record, h);
+	memcpy(entry->id, h.id, sizeof(entry->id));
+	entry->is_tree = h.type == ENTRY_TREE;
+	entry->content = h.type == ENTRY_FILE ? recordContent(record, h) : NULL;
+	entry->size = h.size;
+	snapshot->skip = entry->is_tree ? next + h.subtreeLength : nullptr;
+	snapshot->pos = next;
+	return true;
+}
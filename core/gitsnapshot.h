@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0
+// A snapshot of the tree of a commit in the git storage: the paths and the
+// contents of all entries, in the order of git_tree_walk(). Loading from the
+// snapshot instead of the repository saves looking up and decompressing every
+// object, which makes up most of the load time of large dive logs.
+//
+// The snapshot is kept in a file in the git directory of the repository and is
+// memory-mapped when loading the commit it was made from. Otherwise, the load
+// writes a new snapshot, record by record. Only the objects that are not in the
+// previous snapshot are read from the repository, so that the first load after
+// a save stays cheap. If the snapshot can't be written, the entries are read
+// from the repository directly.
+//
+// Snapshots are only kept for the local cache of the cloud storage. Other
+// repositories are managed by the user and are read directly, like before.
+#ifndef GITSNAPSHOT_H
+#define GITSNAPSHOT_H
+
+#include "git2.h"
+
+#ifdef __cplusplus
+extern "C" {
+#else
+#include <stdbool.h>
+#endif
+
+struct git_snapshot;
+
+struct git_snapshot_entry {
+	const char *root;		// Path of the containing tree, as passed by git_tree_walk()
+	const char *name;
+	unsigned char id[20];
+	bool is_tree;
+	const char *content;		// NULL for trees and for files that couldn't be read
+	unsigned int size;
+};
+
+// Returns NULL if the tree of the commit couldn't be read. If keep is not set,
+// the entries are read from the repository and no snapshot file is used.
+extern struct git_snapshot *git_snapshot_get(git_repository *repo, git_commit *commit, bool keep);
+extern void git_snapshot_free(struct git_snapshot *snapshot);
+// Get the next entry, returns false at the end. If skip is set and the
+// previous entry is a tree, the entries of that tree are skipped.
+extern bool git_snapshot_next(struct git_snapshot *snapshot, struct git_snapshot_entry *entry, bool skip);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "gitsync.h"
+#include "errorhelper.h"
+#include "qthelper.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <string.h>
+
+// Don't flood the receivers of the progress signal while large objects come in
+static const size_t progress_bytes_step = 64 * 1024;
+
+GitSync *GitSync::instance()
+{
+	static GitSync self;
+	return &self;
+}
+
+GitSync::GitSync() : havePending(false), running(false), done(false), generation(0)
+{
+}
+
+// Syncs that are still running when the application quits are canceled. Their commits
+// stay in the local cache and are pushed by the sync when the cache is loaded again.
+GitSync::~GitSync()
+{
+	{
+		QMutexLocker l(&lock);
+		++generation;
+		done = true;
+		cond.wakeOne();
+	}
+	wait();
+}
+
+void GitSync::sync(const QString &filename)
+{
+	struct git_info info;
+
+	QByteArray encoded = QFile::encodeName(filename);
+	if (!is_git_repository(encoded.constData(), &info) || info.transport == RT_LOCAL) {
+		cleanup_git_info(&info);
+		return;
+	}
+	queue({ info.url, info.branch, info.localdir, info.transport, info.is_subsurface_cloud != 0, 0 });
+	cleanup_git_info(&info);
+}
+
+void GitSync::sync(const QString &url, const QString &branch, const QString &localdir)
+{
+	enum remote_transport transport = RT_OTHER;
+	if (url.startsWith("ssh://"))
+		transport = RT_SSH;
+	else if (url.startsWith("https://"))
+		transport = RT_HTTPS;
+	queue({ QFile::encodeName(url).toStdString(), branch.toStdString(), QFile::encodeName(localdir).toStdString(),
+		transport, false, 0 });
+}
+
+void GitSync::queue(Request request)
+{
+	QMutexLocker l(&lock);
+	request.generation = generation;
+	next = std::move(request);
+	havePending = true;
+	if (!isRunning())
+		start();
+	cond.wakeOne();
+}
+
+void GitSync::cancel()
+{
+	QMutexLocker l(&lock);
+	++generation;
+}
+
+bool GitSync::pending()
+{
+	QMutexLocker l(&lock);
+	return havePending;
+}
+
+bool GitSync::busy()
+{
+	QMutexLocker l(&lock);
+	return running || havePending;
+}
+
+void GitSync::waitForFinished()
+{
+	QMutexLocker l(&lock);
+	while (running || havePending)
+		idle.wait(&lock);
+}
+
+void GitSync::run()
+{
+	for (;;) {
+		Request request;
+		{
+			QMutexLocker l(&lock);
+			while (!havePending && !done)
+				cond.wait(&lock);
+			if (!havePending)
+				return;
+			request = std::move(next);
+			havePending = false;
+			running = true;
+		}
+
+		int error;
+		bool canceled;
+		QString sha;
+		doSync(request, error, canceled, sha);
+		emit finished(error, canceled, sha);
+
+		bool allDone;
+		{
+			QMutexLocker l(&lock);
+			running = false;
+			allDone = !havePending;
+			if (allDone)
+				idle.wakeAll();
+		}
+		if (allDone)
+			emit allFinished();
+	}
+}
+
+int GitSync::progressCallback(const git_sync_progress *progress, void *payload)
+{
+	Job *job = (Job *)payload;
+	if (job->generation != job->self->generation)
+		return 1;
+	if (progress->stage != job->last.stage || progress->objects != job->last.objects ||
+	    progress->bytes >= job->last.bytes + progress_bytes_step) {
+		job->last = *progress;
+		emit job->self->progress(progress->stage, progress->objects, progress->total_objects, progress->bytes);
+	}
+	return 0;
+}
+
+// The sync works on its own handle of the local cache. The branch is only
+// updated under the git storage lock, so that it doesn't change under a save.
+void GitSync::doSync(const Request &request, int &error, bool &canceled, QString &sha)
+{
+	struct git_info info;
+	Job job = { this, request.generation, { GIT_SYNC_FETCH, 0, 0, 0 } };
+
+	memset(&info, 0, sizeof(info));
+	info.url = request.url.c_str();
+	info.branch = request.branch.c_str();
+	info.localdir = request.localdir.c_str();
+	info.transport = request.transport;
+	info.is_subsurface_cloud = request.isSubsurfaceCloud;
+	info.sync_progress = &progressCallback;
+	info.sync_payload = &job;
+
+	if (verbose)
+		SSRF_INFO("git storage: background sync with %s[%s]", info.url, info.branch);
+	error = git_sync_repository(&info);
+	canceled = info.canceled;
+
+	sha.clear();
+	if (info.repo) {
+		git_reference *ref;
+		if (!git_branch_lookup(&ref, info.repo, info.branch, GIT_BRANCH_LOCAL)) {
+			char id[GIT_OID_HEXSZ + 1];
+			git_oid_tostr(id, sizeof(id), git_reference_target(ref));
+			sha = id;
+			git_reference_free(ref);
+		}
+		git_repository_free(info.repo);
+	}
+}
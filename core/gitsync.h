@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0
+// Syncs the local cache of a remote git repository with the remote in a
+// background thread. The saves only commit to the local cache, so that they
+// return right away, and queue a sync that pushes the commit later.
+#ifndef GITSYNC_H
+#define GITSYNC_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <string>
+#include "git-access.h"
+
+class GitSync : public QThread {
+	Q_OBJECT
+public:
+	static GitSync *instance();
+	~GitSync();
+
+	// Queue a sync of the local cache of a remote repository given as url[branch].
+	// Returns immediately. If a sync is running, the next one is started when it
+	// is done. Requests that pile up in the meantime are merged into one.
+	void sync(const QString &filename);
+	// Same, but with the remote and the local cache given explicitly.
+	void sync(const QString &url, const QString &branch, const QString &localdir);
+	// Cancel the running sync and the queued one. The cancellation takes effect
+	// at the next progress report of libgit2 or between the stages of the sync.
+	void cancel();
+	// True if a sync is queued that hasn't started yet.
+	bool pending();
+	// True if a sync is running or queued.
+	bool busy();
+	// Wait until the running and the queued syncs are finished.
+	void waitForFinished();
+signals:
+	// stage is a git_sync_stage. For fetches, objects and totalObjects count the
+	// received objects, for pushes the objects written to the remote.
+	void progress(int stage, unsigned int objects, unsigned int totalObjects, qulonglong bytes);
+	// sha is the commit of the local branch after the sync, or empty if it couldn't be read.
+	// If it differs from the loaded commit, the sync brought in new data from the remote.
+	void finished(int error, bool canceled, const QString &sha);
+	// Emitted after the last running or queued sync is finished.
+	void allFinished();
+private:
+	struct Request {
+		std::string url, branch, localdir;
+		enum remote_transport transport;
+		bool isSubsurfaceCloud;
+		int generation;
+	};
+	struct Job {
+		GitSync *self;
+		int generation;
+		git_sync_progress last;
+	};
+	GitSync();
+	void queue(Request request);
+	void run() override;
+	void doSync(const Request &request, int &error, bool &canceled, QString &sha);
+	static int progressCallback(const git_sync_progress *progress, void *payload);
+
+	QMutex lock;
+	QWaitCondition cond;
+	QWaitCondition idle;
+	Request next;
+	bool havePending;
+	bool running;
+	bool done;
+	// Requests are canceled by incrementing the generation: jobs of an older generation stop.
+	std::atomic<int> generation;
+};
+
+#endif
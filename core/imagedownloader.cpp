@@ -7,14 +7,19 @@
 #include "videoframeextractor.h"
 #include "qt-models/divepicturemodel.h"
 #include "metadata.h"
+#include "exif.h"
+#include "thumbnailscheduler.h"
 #include <unistd.h>
 #include <QString>
 #include <QImageReader>
 #include <QSvgRenderer>
 #include <QDataStream>
 #include <QPainter>
+#include <QTransform>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
 
-#include <QtConcurrent>
 
 // Note: this is a global instead of a function-local variable on purpose.
 // We don't want this to be generated in a different thread context if
@@ -78,6 +83,77 @@ static bool hasVideoFileExtension(const QString &filename)
 	return false;
 }
 
+// Rotate an embedded EXIF thumbnail according to the EXIF orientation of the picture.
+// Only the rotations are supported, mirrored orientations are essentially never used.
+static QImage applyExifOrientation(const QImage &img, int orientation)
+{
+	QTransform transform;
+	switch (orientation) {
+	case 3: transform.rotate(180); break;
+	case 6: transform.rotate(90); break;
+	case 8: transform.rotate(270); break;
+	default: return img;
+	}
+	return img.transformed(transform);
+}
+
+// Fetch the thumbnail that cameras embed into the EXIF data of JPEG files.
+// The EXIF data is in the APP1 segment, which is at the beginning of the file
+// and limited to 64 kB, so we only have to read the first few kB of the file.
+// Returns a null image if there is no thumbnail or if it is too small or has
+// the wrong aspect ratio (many cameras add black bars to the thumbnail).
+static QImage loadExifThumbnail(const QString &filename, int size, bool autoTransform)
+{
+	QFile f(filename);
+	if (!f.open(QIODevice::ReadOnly))
+		return QImage();
+	QByteArray data = f.read(128 * 1024);
+	const unsigned char *buf = reinterpret_cast<const unsigned char *>(data.constData());
+
+	easyexif::EXIFInfo exif;
+	if (exif.parseFrom(buf, data.size()) != PARSE_EXIF_SUCCESS || exif.ThumbnailLength == 0)
+		return QImage();
+	QImage img = QImage::fromData(buf + exif.ThumbnailOffset, exif.ThumbnailLength, "JPG");
+	if (img.isNull() || std::max(img.width(), img.height()) < size)
+		return QImage();
+
+	if (exif.ImageWidth > 0 && exif.ImageHeight > 0) {
+		double imageRatio = (double)exif.ImageWidth / exif.ImageHeight;
+		double thumbnailRatio = (double)img.width() / img.height();
+		if (fabs(imageRatio - thumbnailRatio) > 0.02 * imageRatio)
+			return QImage();
+	}
+
+	// If the image reader rotates pictures, do the same for the thumbnail
+	return autoTransform ? applyExifOrientation(img, exif.Orientation) : img;
+}
+
+QImage loadThumbnailImage(const QString &filename, int size)
+{
+	QImage img;
+	QImageReader reader(filename);
+
+	// Cheapest: a large enough thumbnail embedded in the picture.
+	img = loadExifThumbnail(filename, size, reader.autoTransform());
+	if (!img.isNull())
+		return img.scaled(size, size, Qt::KeepAspectRatio);
+
+	// Otherwise, let the reader decode at reduced resolution. For
+	// JPEGs, this uses DCT scaling and is much faster than decoding
+	// the full picture.
+	QSize imageSize = reader.size();
+	if (imageSize.isValid() && (imageSize.width() > size || imageSize.height() > size))
+		reader.setScaledSize(imageSize.scaled(size, size, Qt::KeepAspectRatio));
+	if (reader.read(&img))
+		return img.scaled(size, size, Qt::KeepAspectRatio);
+
+	// Last resort: decode the full picture.
+	img = QImage(filename);
+	if (img.isNull())
+		return img;
+	return img.scaled(size, size, Qt::KeepAspectRatio);
+}
+
 // Fetch a picture from the given filename and determine its type (picture of video).
 // If this is a non-remote file, fetch it from disk. Remote files are fetched from the
 // net in a background thread. In such a case, the output-type is set to MEDIATYPE_STILL_LOADING.
@@ -100,12 +176,9 @@ Thumbnailer::Thumbnail Thumbnailer::fetchImage(const QString &urlfilename, const
 			return fetchVideoThumbnail(filename, originalFilename, md.duration);
 
 		// Try if Qt can parse this image. If it does, use this as a thumbnail.
-		QImage thumb(filename);
-		if (!thumb.isNull()) {
-			int size = maxThumbnailSize();
-			thumb = thumb.scaled(size, size, Qt::KeepAspectRatio);
+		QImage thumb = loadThumbnailImage(filename, maxThumbnailSize());
+		if (!thumb.isNull())
 			return addPictureThumbnailToCache(originalFilename, thumb);
-		}
 
 		// Neither our code, nor Qt could determine the type of this object from looking at the data.
 		// Try to check for a video-file extension. Since we couldn't parse the video file,
@@ -154,7 +227,8 @@ Thumbnailer::Thumbnail Thumbnailer::getHashedImage(const QString &filename, bool
 	return thumbnail;
 }
 
-Thumbnailer::Thumbnailer() : failImage(QPixmap(":filter-close").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()), // TODO: Don't misuse filter close icon
+Thumbnailer::Thumbnailer() : store(thumbnailDir()),
+			     failImage(QPixmap(":filter-close").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()), // TODO: Don't misuse filter close icon
 			     dummyImage(QPixmap(":camera-icon").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()),
 			     videoImage(QPixmap(":video-icon").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage()),
 			     unknownImage(QPixmap(":unknown-icon").scaled(maxThumbnailSize(), maxThumbnailSize(), Qt::KeepAspectRatio).toImage())
@@ -166,9 +240,6 @@ Thumbnailer::Thumbnailer() : failImage(QPixmap(":filter-close").scaled(maxThumbn
 	videoOverlayImage.fill(Qt::transparent);
 	QPainter painter(&videoOverlayImage);
 	videoOverlayRenderer.render(&painter);
-	// Currently, we only process one image at a time. Stefan Fuchs reported problems when
-	// calculating multiple thumbnails at once and this hopefully helps.
-	pool.setMaxThreadCount(1);
 	connect(ImageDownloader::instance(), &ImageDownloader::loaded, this, &Thumbnailer::imageDownloaded);
 	connect(ImageDownloader::instance(), &ImageDownloader::failed, this, &Thumbnailer::imageDownloadFailed);
 	connect(VideoFrameExtractor::instance(), &VideoFrameExtractor::extracted, this, &Thumbnailer::frameExtracted);
@@ -237,30 +308,25 @@ Thumbnailer::Thumbnail Thumbnailer::getVideoThumbnailFromStream(QDataStream &str
 // If Thumbnail::QImage is null, the thumbnail is scheduled for recreation.
 Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture_filename)
 {
-	QString filename = thumbnailFileName(picture_filename);
-	if (filename.isEmpty())
+	ThumbnailStore::Entry entry = store.get(picture_filename);
+	if (entry.data.isEmpty())
 		return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
-	QFile file(filename);
 
 	if (prefs.auto_recalculate_thumbnails) {
 		// Check if thumbnails is older than the (local) image file
 		QString filenameLocal = localFilePath(qPrintable(picture_filename));
 		QFileInfo pictureInfo(filenameLocal);
-		QFileInfo thumbnailInfo(file);
-		if (pictureInfo.exists() && thumbnailInfo.exists()) {
+		if (pictureInfo.exists()) {
 			QDateTime pictureTime = pictureInfo.lastModified();
-			QDateTime thumbnailTime = thumbnailInfo.lastModified();
-			if (pictureTime.isValid() && thumbnailTime.isValid() && thumbnailTime < pictureTime) {
-				// Both files exist, have valid timestamps and thumbnail was calculated before picture.
+			if (pictureTime.isValid() && entry.time < pictureTime.toMSecsSinceEpoch()) {
+				// Picture has a valid timestamp and thumbnail was calculated before picture.
 				// Return an empty thumbnail to signal recalculation of the thumbnail
 				return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
 			}
 		}
 	}
 
-	if (!file.open(QIODevice::ReadOnly))
-		return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
-	QDataStream stream(&file);
+	QDataStream stream(entry.data);
 
 	// Each thumbnail file is composed of a media-type and an image file.
 	quint32 type;
@@ -275,6 +341,11 @@ Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture
 	}
 }
 
+void Thumbnailer::addToCache(const QString &picture_filename, const QByteArray &data)
+{
+	store.put(picture_filename, QDateTime::currentMSecsSinceEpoch(), data);
+}
+
 Thumbnailer::Thumbnail Thumbnailer::addVideoThumbnailToCache(const QString &picture_filename, duration_t duration,
 							     const QImage &image, duration_t position)
 {
@@ -285,26 +356,22 @@ Thumbnailer::Thumbnail Thumbnailer::addVideoThumbnailToCache(const QString &pict
 	//	for each picture:
 	//		uint32	offset in msec from begining of video
 	//		QImage	frame
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
 
-		stream << (quint32)MEDIATYPE_VIDEO;
-		stream << (quint32)duration.seconds;
+	stream << (quint32)MEDIATYPE_VIDEO;
+	stream << (quint32)duration.seconds;
 
-		if (image.isNull()) {
-			// No image provided
-			stream << (quint32)0;
-		} else {
-			// Currently, we support at most one image
-			stream << (quint32)1;
-			stream << (quint32)position.seconds;
-			stream << image;
-		}
-
-		file.commit();
+	if (image.isNull()) {
+		// No image provided
+		stream << (quint32)0;
+	} else {
+		// Currently, we support at most one image
+		stream << (quint32)1;
+		stream << (quint32)position.seconds;
+		stream << image;
 	}
+	addToCache(picture_filename, data);
 	return { videoImage, MEDIATYPE_VIDEO, duration };
 }
 
@@ -327,26 +394,22 @@ Thumbnailer::Thumbnail Thumbnailer::addPictureThumbnailToCache(const QString &pi
 	// The format of a picture-thumbnail is very simple:
 	// 	uint32	MEDIATYPE_PICTURE
 	// 	QImage	thumbnail
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
-
-		stream << (quint32)MEDIATYPE_PICTURE;
-		stream << thumbnail;
-		file.commit();
-	}
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+
+	stream << (quint32)MEDIATYPE_PICTURE;
+	stream << thumbnail;
+	addToCache(picture_filename, data);
 	return { thumbnail, MEDIATYPE_PICTURE, zero_duration };
 }
 
 Thumbnailer::Thumbnail Thumbnailer::addUnknownThumbnailToCache(const QString &picture_filename)
 {
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
-		stream << (quint32)MEDIATYPE_UNKNOWN;
-	}
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+
+	stream << (quint32)MEDIATYPE_UNKNOWN;
+	addToCache(picture_filename, data);
 	return { unknownImage, MEDIATYPE_UNKNOWN, zero_duration };
 }
 
@@ -429,7 +492,9 @@ void Thumbnailer::imageDownloaded(QString filename)
 {
 	// Image was downloaded -> try thumbnailing again.
 	QMutexLocker l(&lock);
-	workingOn[filename] = QtConcurrent::run(&pool, [this, filename]() { processItem(filename, false); });
+	workingOn.insert(filename);
+	ThumbnailScheduler::instance()->add(this, filename, ThumbnailScheduler::JOB_PICTURE, ThumbnailScheduler::PRIORITY_NORMAL,
+					    [this, filename]() { processItem(filename, false); });
 }
 
 void Thumbnailer::imageDownloadFailed(QString filename)
@@ -460,8 +525,9 @@ QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous)
 
 	// We are not currently fetching this thumbnail - add it to the list.
 	if (!workingOn.contains(filename)) {
-		workingOn.insert(filename,
-				 QtConcurrent::run(&pool, [this, filename]() { processItem(filename, true); }));
+		workingOn.insert(filename);
+		ThumbnailScheduler::instance()->add(this, filename, ThumbnailScheduler::JOB_PICTURE, ThumbnailScheduler::PRIORITY_NORMAL,
+						    [this, filename]() { processItem(filename, true); });
 	}
 	return dummyImage;
 }
@@ -471,8 +537,9 @@ void Thumbnailer::calculateThumbnails(const QVector<QString> &filenames)
 	QMutexLocker l(&lock);
 	for (const QString &filename: filenames) {
 		if (!workingOn.contains(filename)) {
-			workingOn.insert(filename,
-					 QtConcurrent::run(&pool, [this, filename]() { recalculate(filename); }));
+			workingOn.insert(filename);
+			ThumbnailScheduler::instance()->add(this, filename, ThumbnailScheduler::JOB_PICTURE, ThumbnailScheduler::PRIORITY_BACKGROUND,
+							    [this, filename]() { recalculate(filename); });
 		}
 	}
 }
@@ -484,11 +551,15 @@ void Thumbnailer::clearWorkQueue()
 	VideoFrameExtractor::instance()->clearWorkQueue();
 
 	QMutexLocker l(&lock);
-	for (auto it = workingOn.begin(); it != workingOn.end(); ++it)
-		it->cancel();
+	ThumbnailScheduler::instance()->cancelAll(this);
 	workingOn.clear();
 }
 
+void Thumbnailer::setVisibleThumbnails(const QVector<QString> &filenames)
+{
+	ThumbnailScheduler::instance()->setVisible(filenames);
+}
+
 static const int maxZoom = 3;	// Maximum zoom: thrice of standard size
 
 int Thumbnailer::defaultThumbnailSize()
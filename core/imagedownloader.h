@@ -3,10 +3,10 @@
 #define IMAGEDOWNLOADER_H
 
 #include "metadata.h"
+#include "thumbnailstore.h"
 #include <QImage>
-#include <QFuture>
 #include <QNetworkReply>
-#include <QThreadPool>
+#include <QSet>
 
 class ImageDownloader : public QObject {
 	Q_OBJECT
@@ -24,6 +24,10 @@ private:
 	void saveImage(QNetworkReply *reply);
 };
 
+// Load a picture scaled to fit into a size x size square. Avoids decoding the
+// picture at full resolution if possible. Returns a null image on failure.
+QImage loadThumbnailImage(const QString &filename, int size);
+
 struct PictureEntry;
 class Thumbnailer : public QObject {
 	Q_OBJECT
@@ -44,6 +48,10 @@ public:
 
 	// If we change dive, clear all unfinished thumbnail creations
 	void clearWorkQueue();
+
+	// Thumbnails of these pictures are calculated before all others.
+	// Called by the views when the set of shown pictures changes.
+	void setVisibleThumbnails(const QVector<QString> &filenames);
 	static int maxThumbnailSize();
 	static int defaultThumbnailSize();
 	static int thumbnailSize(double zoomLevel);
@@ -68,6 +76,7 @@ private:
 	Thumbnail addPictureThumbnailToCache(const QString &picture_filename, const QImage &thumbnail);
 	Thumbnail addVideoThumbnailToCache(const QString &picture_filename, duration_t duration, const QImage &thumbnail, duration_t position);
 	Thumbnail addUnknownThumbnailToCache(const QString &picture_filename);
+	void addToCache(const QString &picture_filename, const QByteArray &data);
 	void recalculate(QString filename);
 	void processItem(QString filename, bool tryDownload);
 	Thumbnail getThumbnailFromCache(const QString &picture_filename);
@@ -78,14 +87,14 @@ private:
 	void markVideoThumbnail(QImage &img);
 
 	mutable QMutex lock;
-	QThreadPool pool;
+	ThumbnailStore store;
 	QImage failImage;		// Shown when image-fetching fails
 	QImage dummyImage;		// Shown before thumbnail is fetched
 	QImage videoImage;		// Place holder for videos
 	QImage videoOverlayImage;	// Overlay for video thumbnails
 	QImage unknownImage;		// Place holder for files where we couldn't determine the type
 
-	QMap<QString,QFuture<void>> workingOn;
+	QSet<QString> workingOn;
 };
 
 #endif // IMAGEDOWNLOADER_H
@@ -20,6 +20,7 @@
 #include "subsurface-string.h"
 #include "device.h"
 #include "dive.h"
+#include "diveindex.h"
 #include "errorhelper.h"
 #include "event.h"
 #include "sha1.h"
@@ -46,9 +47,27 @@ const char *progress_bar_text = "";
 void (*progress_callback)(const char *text) = NULL;
 double progress_bar_fraction = 0.0;
 
-static int stoptime, stopdepth, ndl, po2, cns, heartbeat, bearing;
-static bool in_deco, first_temp_is_air;
-static int current_gas_index;
+/*
+ * The state of the sample parser for one dive. Some values are only reported
+ * by the dive computer when they change, so they are copied from one sample
+ * to the next. Keeping this per parse, instead of in static variables, allows
+ * parsing multiple dives at the same time.
+ */
+struct sample_parse_state {
+	struct divecomputer *dc;
+	int stoptime, stopdepth, ndl, po2, cns, heartbeat, bearing;
+	bool in_deco;
+	int current_gas_index;
+	unsigned int nsensor;
+};
+
+static void init_sample_parse_state(struct sample_parse_state *state, struct divecomputer *dc)
+{
+	memset(state, 0, sizeof(*state));
+	state->dc = dc;
+	state->ndl = state->bearing = -1;
+	state->current_gas_index = -1;
+}
 
 /* logging bits from libdivecomputer */
 #ifndef __ANDROID__
@@ -96,6 +115,9 @@ const char *errmsg (dc_status_t rc)
 
 static dc_status_t create_parser(device_data_t *devdata, dc_parser_t **parser)
 {
+	// When replaying recorded dives, there is no device
+	if (!devdata->device)
+		return dc_parser_new2(parser, devdata->context, devdata->descriptor, devdata->devtime, devdata->systime);
 	return dc_parser_new(parser, devdata->device);
 }
 
@@ -247,8 +269,9 @@ static int parse_gasmixes(device_data_t *devdata, struct dive *dive, dc_parser_t
 	return DC_STATUS_SUCCESS;
 }
 
-static void handle_event(struct divecomputer *dc, struct sample *sample, dc_sample_value_t value)
+static void handle_event(struct sample_parse_state *state, struct sample *sample, dc_sample_value_t value)
 {
+	struct divecomputer *dc = state->dc;
 	int type, time;
 	struct event *ev;
 
@@ -303,23 +326,23 @@ static void handle_event(struct divecomputer *dc, struct sample *sample, dc_samp
 
 	ev = add_event(dc, time, type, value.event.flags, value.event.value, name);
 	if (event_is_gaschange(ev) && ev->gas.index >= 0)
-		current_gas_index = ev->gas.index;
+		state->current_gas_index = ev->gas.index;
 }
 
-static void handle_gasmix(struct divecomputer *dc, struct sample *sample, int idx)
+static void handle_gasmix(struct sample_parse_state *state, struct sample *sample, int idx)
 {
 	/* TODO: Verify that index is not higher than the number of cylinders */
 	if (idx < 0)
 		return;
-	add_event(dc, sample->time.seconds, SAMPLE_EVENT_GASCHANGE2, idx+1, 0, "gaschange");
-	current_gas_index = idx;
+	add_event(state->dc, sample->time.seconds, SAMPLE_EVENT_GASCHANGE2, idx+1, 0, "gaschange");
+	state->current_gas_index = idx;
 }
 
-void
+static void
 sample_cb(dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 {
-	static unsigned int nsensor = 0;
-	struct divecomputer *dc = userdata;
+	struct sample_parse_state *state = userdata;
+	struct divecomputer *dc = state->dc;
 	struct sample *sample;
 
 	/*
@@ -337,7 +360,7 @@ sample_cb(dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 
 	switch (type) {
 	case DC_SAMPLE_TIME:
-		nsensor = 0;
+		state->nsensor = 0;
 
 		// Create a new sample.
 		// Mark depth as negative
@@ -347,14 +370,14 @@ sample_cb(dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 		// The current sample gets some sticky values
 		// that may have been around from before, these
 		// values will be overwritten by new data if available
-		sample->in_deco = in_deco;
-		sample->ndl.seconds = ndl;
-		sample->stoptime.seconds = stoptime;
-		sample->stopdepth.mm = stopdepth;
-		sample->setpoint.mbar = po2;
-		sample->cns = cns;
-		sample->heartbeat = heartbeat;
-		sample->bearing.degrees = bearing;
+		sample->in_deco = state->in_deco;
+		sample->ndl.seconds = state->ndl;
+		sample->stoptime.seconds = state->stoptime;
+		sample->stopdepth.mm = state->stopdepth;
+		sample->setpoint.mbar = state->po2;
+		sample->cns = state->cns;
+		sample->heartbeat = state->heartbeat;
+		sample->bearing.degrees = state->bearing;
 		finish_sample(dc);
 		break;
 	case DC_SAMPLE_DEPTH:
@@ -364,13 +387,13 @@ sample_cb(dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 		add_sample_pressure(sample, value.pressure.tank, lrint(value.pressure.value * 1000));
 		break;
 	case DC_SAMPLE_GASMIX:
-		handle_gasmix(dc, sample, value.gasmix);
+		handle_gasmix(state, sample, value.gasmix);
 		break;
 	case DC_SAMPLE_TEMPERATURE:
 		sample->temperature.mkelvin = C_to_mkelvin(value.temperature);
 		break;
 	case DC_SAMPLE_EVENT:
-		handle_event(dc, sample, value);
+		handle_event(state, sample, value);
 		break;
 	case DC_SAMPLE_RBT:
 		sample->rbt.seconds = (!strncasecmp(dc->model, "suunto", 6)) ? value.rbt : value.rbt * 60;
@@ -381,10 +404,10 @@ sample_cb(dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 		break;
 #endif
 	case DC_SAMPLE_HEARTBEAT:
-		sample->heartbeat = heartbeat = value.heartbeat;
+		sample->heartbeat = state->heartbeat = value.heartbeat;
 		break;
 	case DC_SAMPLE_BEARING:
-		sample->bearing.degrees = bearing = value.bearing;
+		sample->bearing.degrees = state->bearing = value.bearing;
 		break;
 #ifdef DEBUG_DC_VENDOR
 	case DC_SAMPLE_VENDOR:
@@ -397,36 +420,36 @@ sample_cb(dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 #endif
 	case DC_SAMPLE_SETPOINT:
 		/* for us a setpoint means constant pO2 from here */
-		sample->setpoint.mbar = po2 = lrint(value.setpoint * 1000);
+		sample->setpoint.mbar = state->po2 = lrint(value.setpoint * 1000);
 		break;
 	case DC_SAMPLE_PPO2:
-		if (nsensor < 3)
-			sample->o2sensor[nsensor].mbar = lrint(value.ppo2 * 1000);
+		if (state->nsensor < 3)
+			sample->o2sensor[state->nsensor].mbar = lrint(value.ppo2 * 1000);
 		else
-			report_error("%d is more o2 sensors than we can handle", nsensor);
-		nsensor++;
+			report_error("%d is more o2 sensors than we can handle", state->nsensor);
+		state->nsensor++;
 		// Set the amount of detected o2 sensors
-		if (nsensor > dc->no_o2sensors)
-			dc->no_o2sensors = nsensor;
+		if (state->nsensor > dc->no_o2sensors)
+			dc->no_o2sensors = state->nsensor;
 		break;
 	case DC_SAMPLE_CNS:
-		sample->cns = cns = lrint(value.cns * 100);
+		sample->cns = state->cns = lrint(value.cns * 100);
 		break;
 	case DC_SAMPLE_DECO:
 		if (value.deco.type == DC_DECO_NDL) {
-			sample->ndl.seconds = ndl = value.deco.time;
-			sample->stopdepth.mm = stopdepth = lrint(value.deco.depth * 1000.0);
-			sample->in_deco = in_deco = false;
+			sample->ndl.seconds = state->ndl = value.deco.time;
+			sample->stopdepth.mm = state->stopdepth = lrint(value.deco.depth * 1000.0);
+			sample->in_deco = state->in_deco = false;
 		} else if (value.deco.type == DC_DECO_DECOSTOP ||
 			   value.deco.type == DC_DECO_DEEPSTOP) {
-			sample->stopdepth.mm = stopdepth = lrint(value.deco.depth * 1000.0);
-			sample->stoptime.seconds = stoptime = value.deco.time;
-			sample->in_deco = in_deco = stopdepth > 0;
-			ndl = 0;
+			sample->stopdepth.mm = state->stopdepth = lrint(value.deco.depth * 1000.0);
+			sample->stoptime.seconds = state->stoptime = value.deco.time;
+			sample->in_deco = state->in_deco = state->stopdepth > 0;
+			state->ndl = 0;
 		} else if (value.deco.type == DC_DECO_SAFETYSTOP) {
-			sample->in_deco = in_deco = false;
-			sample->stopdepth.mm = stopdepth = lrint(value.deco.depth * 1000.0);
-			sample->stoptime.seconds = stoptime = value.deco.time;
+			sample->in_deco = state->in_deco = false;
+			sample->stopdepth.mm = state->stopdepth = lrint(value.deco.depth * 1000.0);
+			sample->stoptime.seconds = state->stoptime = value.deco.time;
 		}
 	default:
 		break;
@@ -450,24 +473,25 @@ static void dev_info(device_data_t *devdata, const char *fmt, ...)
 		(*progress_callback)(buffer);
 }
 
-static int import_dive_number = 0;
-
-static void download_error(const char *fmt, ...)
+static void download_error(int number, const char *fmt, ...)
 {
-	static char buffer[1024];
+	char buffer[1024];
 	va_list ap;
 
 	va_start(ap, fmt);
 	vsnprintf(buffer, sizeof(buffer), fmt, ap);
 	va_end(ap);
-	report_error("Dive %d: %s", import_dive_number, buffer);
+	report_error("Dive %d: %s", number, buffer);
 }
 
 static int parse_samples(device_data_t *devdata, struct divecomputer *dc, dc_parser_t *parser)
 {
 	UNUSED(devdata);
+	struct sample_parse_state state;
+
 	// Parse the sample data.
-	return dc_parser_samples_foreach(parser, sample_cb, dc);
+	init_sample_parse_state(&state, dc);
+	return dc_parser_samples_foreach(parser, sample_cb, &state);
 }
 
 static int might_be_same_dc(struct divecomputer *a, struct divecomputer *b)
@@ -510,16 +534,17 @@ static int match_one_dive(struct divecomputer *a, struct dive *dive)
 }
 
 /*
- * Check if this dive already existed before the import
+ * Check if this dive already existed before the import. A dive can only
+ * match if it has a dive computer with the same start time (see
+ * match_one_dive()), so only those candidates have to be checked.
  */
-static int find_dive(struct divecomputer *match)
+static int find_dive(const struct dive_index *known, struct divecomputer *match)
 {
-	int i;
-
-	for (i = divelog.dives->nr - 1; i >= 0; i--) {
-		struct dive *old = divelog.dives->dives[i];
+	struct dive *const *dives;
+	int nr = dive_index_find_time(known, match->when, &dives);
 
-		if (match_one_dive(match, old))
+	for (int i = 0; i < nr; i++) {
+		if (match_one_dive(match, dives[i]))
 			return 1;
 	}
 	return 0;
@@ -598,7 +623,8 @@ static void parse_string_field(device_data_t *devdata, struct dive *dive, dc_fie
 	}
 }
 
-static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devdata, struct dive *dive)
+/* The number of the dive is only used for error messages */
+static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devdata, struct dive *dive, int number)
 {
 	dc_status_t rc = 0;
 	dc_datetime_t dt = { 0 };
@@ -606,7 +632,7 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 
 	rc = dc_parser_get_datetime(parser, &dt);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error parsing the datetime"));
+		download_error(number, translate("gettextFromC", "Error parsing the datetime"));
 		return rc;
 	}
 
@@ -624,14 +650,10 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	}
 
 	// Parse the divetime.
-	char *date_string = get_dive_date_c_string(dive->when);
-	dev_info(devdata, translate("gettextFromC", "Dive %d: %s"), import_dive_number, date_string);
-	free(date_string);
-
 	unsigned int divetime = 0;
 	rc = dc_parser_get_field(parser, DC_FIELD_DIVETIME, 0, &divetime);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error parsing the divetime"));
+		download_error(number, translate("gettextFromC", "Error parsing the divetime"));
 		return rc;
 	}
 	if (rc == DC_STATUS_SUCCESS)
@@ -641,7 +663,7 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	double maxdepth = 0.0;
 	rc = dc_parser_get_field(parser, DC_FIELD_MAXDEPTH, 0, &maxdepth);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error parsing the maxdepth"));
+		download_error(number, translate("gettextFromC", "Error parsing the maxdepth"));
 		return rc;
 	}
 	if (rc == DC_STATUS_SUCCESS)
@@ -655,7 +677,7 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	for (int i = 0; i < 3; i++) {
 		rc = dc_parser_get_field(parser, temp_fields[i], 0, &temperature);
 		if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-			download_error(translate("gettextFromC", "Error parsing temperature"));
+			download_error(number, translate("gettextFromC", "Error parsing temperature"));
 			return rc;
 		}
 		if (rc == DC_STATUS_SUCCESS)
@@ -674,7 +696,7 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	unsigned int ngases = 0;
 	rc = dc_parser_get_field(parser, DC_FIELD_GASMIX_COUNT, 0, &ngases);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error parsing the gas mix count"));
+		download_error(number, translate("gettextFromC", "Error parsing the gas mix count"));
 		return rc;
 	}
 
@@ -685,7 +707,7 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	};
 	rc = dc_parser_get_field(parser, DC_FIELD_SALINITY, 0, &salinity);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error obtaining water salinity"));
+		download_error(number, translate("gettextFromC", "Error obtaining water salinity"));
 		return rc;
 	}
 	if (rc == DC_STATUS_SUCCESS) {
@@ -707,7 +729,7 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	double surface_pressure = 0;
 	rc = dc_parser_get_field(parser, DC_FIELD_ATMOSPHERIC, 0, &surface_pressure);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error obtaining surface pressure"));
+		download_error(number, translate("gettextFromC", "Error obtaining surface pressure"));
 		return rc;
 	}
 	if (rc == DC_STATUS_SUCCESS)
@@ -729,7 +751,7 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	dc_divemode_t divemode;
 	rc = dc_parser_get_field(parser, DC_FIELD_DIVEMODE, 0, &divemode);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error obtaining dive mode"));
+		download_error(number, translate("gettextFromC", "Error obtaining dive mode"));
 		return rc;
 	}
 	if (rc == DC_STATUS_SUCCESS)
@@ -751,13 +773,133 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 
 	rc = parse_gasmixes(devdata, dive, parser, ngases);
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED) {
-		download_error(translate("gettextFromC", "Error parsing the gas mix"));
+		download_error(number, translate("gettextFromC", "Error parsing the gas mix"));
 		return rc;
 	}
 
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * The download is pipelined: dive_cb() is called from libdivecomputer's
+ * download loop and only parses the dive header, which is all that is needed
+ * to detect already downloaded dives. The samples are parsed on a separate
+ * thread, so that the transfer of the next dive doesn't have to wait for
+ * the parsing of the previous one.
+ */
+struct download_state {
+	device_data_t *devdata;
+	struct dive_index *known;
+	struct work_queue *parse_queue;
+	FILE *recording;		/* raw dives are recorded here, if not null */
+	bool recording_started;
+	int dive_number;		/* of the dive being downloaded, for messages */
+	bool first_temp_is_air;		/* read by the parse thread */
+};
+
+/*
+ * Together with the libdivecomputer log, the raw dive data is recorded,
+ * so that the parsing can be reproduced without the dive computer (see
+ * do_libdivecomputer_replay()). The file starts with a header describing
+ * the device, followed by the dives as they were passed to dive_cb().
+ * All numbers are stored as little-endian.
+ *
+ *	magic		"Subsurface dive recording 1\n"
+ *	vendor		zero-terminated string
+ *	product		zero-terminated string
+ *	model, firmware, serial, devtime	4 bytes each
+ *	systime		8 bytes
+ *	for each dive:	size (4 bytes), data, fingerprint size (4 bytes), fingerprint
+ */
+static const char recording_magic[] = "Subsurface dive recording 1\n";
+
+static void put_le32(FILE *f, uint32_t v)
+{
+	unsigned char buf[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24 };
+	fwrite(buf, 1, 4, f);
+}
+
+static void write_recording_header(FILE *f, const device_data_t *devdata)
+{
+	uint64_t systime = devdata->systime;
+
+	fwrite(recording_magic, 1, strlen(recording_magic), f);
+	fwrite(devdata->vendor, 1, strlen(devdata->vendor) + 1, f);
+	fwrite(devdata->product, 1, strlen(devdata->product) + 1, f);
+	put_le32(f, devdata->devinfo.model);
+	put_le32(f, devdata->devinfo.firmware);
+	put_le32(f, devdata->devinfo.serial);
+	put_le32(f, devdata->devtime);
+	put_le32(f, systime & 0xffffffff);
+	put_le32(f, systime >> 32);
+}
+
+static void record_dive(struct download_state *state, const unsigned char *data, unsigned int size,
+			const unsigned char *fingerprint, unsigned int fsize)
+{
+	// The device info and clock events arrive before the first dive
+	if (!state->recording_started) {
+		write_recording_header(state->recording, state->devdata);
+		state->recording_started = true;
+	}
+	put_le32(state->recording, size);
+	fwrite(data, 1, size, state->recording);
+	put_le32(state->recording, fsize);
+	if (fsize)
+		fwrite(fingerprint, 1, fsize, state->recording);
+}
+
+/* A dive whose header was parsed, waiting for the samples to be parsed */
+struct parse_job {
+	int number;			/* for error messages */
+	struct dive *dive;
+	dc_parser_t *parser;
+	unsigned char *data;		/* a copy of the raw dive data, used by the parser */
+};
+
+static void free_parse_job(struct parse_job *job)
+{
+	dc_parser_destroy(job->parser);
+	free(job->data);
+	free(job);
+}
+
+/* Called on the parse thread for each downloaded dive, in download order */
+static void parse_dive(void *item, void *userdata)
+{
+	struct parse_job *job = item;
+	struct download_state *state = userdata;
+	device_data_t *devdata = state->devdata;
+	struct dive *dive = job->dive;
+	int rc;
+
+	// Initialize the sample data.
+	rc = parse_samples(devdata, &dive->dc, job->parser);
+	if (rc != DC_STATUS_SUCCESS) {
+		report_error("Dive %d: %s", job->number, translate("gettextFromC", "Error parsing the samples"));
+		free_dive(dive);
+		free_parse_job(job);
+		return;
+	}
+	free_parse_job(job);
+
+	/* Various libdivecomputer interface fixups */
+	if (dive->dc.airtemp.mkelvin == 0 && state->first_temp_is_air && dive->dc.samples) {
+		dive->dc.airtemp = dive->dc.sample[0].temperature;
+		dive->dc.sample[0].temperature.mkelvin = 0;
+	}
+
+	/* special case for bug in Tecdiving DiveComputer.eu
+	 * often the first sample has a water temperature of 0C, followed by the correct
+	 * temperature in the next sample */
+	if (same_string(dive->dc.model, "Tecdiving DiveComputer.eu") &&
+	    dive->dc.sample[0].temperature.mkelvin == ZERO_C_IN_MKELVIN &&
+	    dive->dc.sample[1].temperature.mkelvin > dive->dc.sample[0].temperature.mkelvin)
+		dive->dc.sample[0].temperature.mkelvin = dive->dc.sample[1].temperature.mkelvin;
+
+	record_dive_to_table(dive, devdata->log->dives);
+}
+
 /* returns true if we want libdivecomputer's dc_device_foreach() to continue,
  *  false otherwise */
 static int dive_cb(const unsigned char *data, unsigned int size,
@@ -766,26 +908,33 @@ static int dive_cb(const unsigned char *data, unsigned int size,
 {
 	int rc;
 	dc_parser_t *parser = NULL;
-	device_data_t *devdata = userdata;
+	struct download_state *state = userdata;
+	device_data_t *devdata = state->devdata;
 	struct dive *dive = NULL;
+	struct parse_job *job;
+	unsigned char *copy = NULL;
+	char *date_string;
 
-	/* reset static data, that is only valid per dive */
-	stoptime = stopdepth = po2 = cns = heartbeat = 0;
-	ndl = bearing = -1;
-	in_deco = false;
-	current_gas_index = -1;
+	int number = ++state->dive_number;
 
-	import_dive_number++;
+	if (state->recording)
+		record_dive(state, data, size, fingerprint, fsize);
 
 	rc = create_parser(devdata, &parser);
 	if (rc != DC_STATUS_SUCCESS) {
-		download_error(translate("gettextFromC", "Unable to create parser for %s %s"), devdata->vendor, devdata->product);
+		download_error(number, translate("gettextFromC", "Unable to create parser for %s %s"), devdata->vendor, devdata->product);
 		return true;
 	}
 
-	rc = dc_parser_set_data(parser, data, size);
+	/* The data is only valid during the callback, but will be parsed later */
+	copy = malloc(size);
+	if (!copy)
+		goto error_exit;
+	memcpy(copy, data, size);
+
+	rc = dc_parser_set_data(parser, copy, size);
 	if (rc != DC_STATUS_SUCCESS) {
-		download_error(translate("gettextFromC", "Error registering the data"));
+		download_error(number, translate("gettextFromC", "Error registering the data"));
 		goto error_exit;
 	}
 
@@ -796,25 +945,19 @@ static int dive_cb(const unsigned char *data, unsigned int size,
 	dive->dc.diveid = calculate_diveid(fingerprint, fsize);
 
 	// Parse the dive's header data
-	rc = libdc_header_parser (parser, devdata, dive);
-	if (rc != DC_STATUS_SUCCESS) {
-		download_error(translate("getextFromC", "Error parsing the header"));
-		goto error_exit;
-	}
-
-	// Initialize the sample data.
-	rc = parse_samples(devdata, &dive->dc, parser);
+	rc = libdc_header_parser (parser, devdata, dive, number);
+	date_string = get_dive_date_c_string(dive->when);
+	dev_info(devdata, translate("gettextFromC", "Dive %d: %s"), number, date_string);
+	free(date_string);
 	if (rc != DC_STATUS_SUCCESS) {
-		download_error(translate("gettextFromC", "Error parsing the samples"));
+		download_error(number, translate("getextFromC", "Error parsing the header"));
 		goto error_exit;
 	}
 
-	dc_parser_destroy(parser);
-
 	/*
 	 * Save off fingerprint data.
 	 *
-	 * NOTE! We do this after parsing the dive fully, so that
+	 * NOTE! We do this after parsing the dive header, so that
 	 * we have the final deviceid here.
 	 */
 	if (fingerprint && fsize && !devdata->fingerprint) {
@@ -828,33 +971,29 @@ static int dive_cb(const unsigned char *data, unsigned int size,
 	}
 
 	/* If we already saw this dive, abort. */
-	if (!devdata->force_download && find_dive(&dive->dc)) {
-		char *date_string = get_dive_date_c_string(dive->when);
+	if (!devdata->force_download && find_dive(state->known, &dive->dc)) {
+		date_string = get_dive_date_c_string(dive->when);
 		dev_info(devdata, translate("gettextFromC", "Already downloaded dive at %s"), date_string);
 		free(date_string);
+		dc_parser_destroy(parser);
+		free(copy);
 		free_dive(dive);
 		return false;
 	}
 
-	/* Various libdivecomputer interface fixups */
-	if (dive->dc.airtemp.mkelvin == 0 && first_temp_is_air && dive->dc.samples) {
-		dive->dc.airtemp = dive->dc.sample[0].temperature;
-		dive->dc.sample[0].temperature.mkelvin = 0;
-	}
-
-	/* special case for bug in Tecdiving DiveComputer.eu
-	 * often the first sample has a water temperature of 0C, followed by the correct
-	 * temperature in the next sample */
-	if (same_string(dive->dc.model, "Tecdiving DiveComputer.eu") &&
-	    dive->dc.sample[0].temperature.mkelvin == ZERO_C_IN_MKELVIN &&
-	    dive->dc.sample[1].temperature.mkelvin > dive->dc.sample[0].temperature.mkelvin)
-		dive->dc.sample[0].temperature.mkelvin = dive->dc.sample[1].temperature.mkelvin;
-
-	record_dive_to_table(dive, devdata->log->dives);
+	job = malloc(sizeof(*job));
+	if (!job)
+		goto error_exit;
+	job->number = number;
+	job->dive = dive;
+	job->parser = parser;
+	job->data = copy;
+	queue_work(state->parse_queue, job);
 	return true;
 
 error_exit:
 	dc_parser_destroy(parser);
+	free(copy);
 	free_dive(dive);
 	return true;
 
@@ -1084,6 +1223,8 @@ static void event_cb(dc_device_t *device, dc_event_type_t event, const void *dat
 	case DC_EVENT_CLOCK:
 		dev_info(devdata, translate("gettextFromC", "Event: systime=%" PRId64 ", devtime=%u\n"),
 			 (uint64_t)clock->systime, clock->devtime);
+		devdata->devtime = clock->devtime;
+		devdata->systime = clock->systime;
 		if (devdata->libdc_logfile) {
 			fprintf(devdata->libdc_logfile, "Event: systime=%" PRId64 ", devtime=%u\n",
 				(uint64_t)clock->systime, clock->devtime);
@@ -1110,6 +1251,30 @@ static int cancel_cb(void *userdata)
 	return import_thread_cancelled;
 }
 
+static void start_download(struct download_state *state, device_data_t *data)
+{
+	memset(state, 0, sizeof(*state));
+	state->devdata = data;
+
+	/* The dive list doesn't change during the download */
+	state->known = dive_index_create(divelog.dives);
+	state->parse_queue = start_work_queue(parse_dive, state);
+
+	if (data->device && data->libdc_log && logfile_name) {
+		char *name = format_string("%s.dives", logfile_name);
+		state->recording = subsurface_fopen(name, "wb");
+		free(name);
+	}
+}
+
+static void finish_download(struct download_state *state)
+{
+	finish_work_queue(state->parse_queue);
+	dive_index_free(state->known);
+	if (state->recording)
+		fclose(state->recording);
+}
+
 static const char *do_device_import(device_data_t *data)
 {
 	dc_status_t rc;
@@ -1151,7 +1316,11 @@ static const char *do_device_import(device_data_t *data)
 			return translate("gettextFromC", "Dive data dumping error");
 		}
 	} else {
-		rc = dc_device_foreach(device, dive_cb, data);
+		struct download_state state;
+
+		start_download(&state, data);
+		rc = dc_device_foreach(device, dive_cb, &state);
+		finish_download(&state);
 
 		if (rc != DC_STATUS_SUCCESS) {
 			progress_bar_fraction = 0.0;
@@ -1440,13 +1609,13 @@ const char *do_libdivecomputer_import(device_data_t *data)
 	const char *err;
 	FILE *fp = NULL;
 
-	import_dive_number = 0;
-	first_temp_is_air = 0;
 	data->device = NULL;
 	data->context = NULL;
 	data->iostream = NULL;
 	data->fingerprint = NULL;
 	data->fsize = 0;
+	data->devtime = 0;
+	data->systime = 0;
 
 	if (data->libdc_log && logfile_name)
 		fp = subsurface_fopen(logfile_name, "w");
@@ -1543,6 +1712,131 @@ const char *do_libdivecomputer_import(device_data_t *data)
 	return err;
 }
 
+static bool get_le32(const unsigned char **p, const unsigned char *end, uint32_t *v)
+{
+	if (end - *p < 4)
+		return false;
+	*v = (*p)[0] | (*p)[1] << 8 | (*p)[2] << 16 | (uint32_t)(*p)[3] << 24;
+	*p += 4;
+	return true;
+}
+
+static const char *get_string(const unsigned char **p, const unsigned char *end)
+{
+	const char *res = (const char *)*p;
+	const unsigned char *nul = memchr(*p, 0, end - *p);
+	if (!nul)
+		return NULL;
+	*p = nul + 1;
+	return res;
+}
+
+static dc_descriptor_t *get_descriptor_by_name(const char *vendor, const char *product)
+{
+	dc_descriptor_t *descriptor = NULL;
+	dc_iterator_t *iterator = NULL;
+
+	if (dc_descriptor_iterator(&iterator) != DC_STATUS_SUCCESS)
+		return NULL;
+	while (dc_iterator_next(iterator, &descriptor) == DC_STATUS_SUCCESS) {
+		if (!strcmp(dc_descriptor_get_vendor(descriptor), vendor) &&
+		    !strcmp(dc_descriptor_get_product(descriptor), product))
+			break;
+		dc_descriptor_free(descriptor);
+		descriptor = NULL;
+	}
+	dc_iterator_free(iterator);
+	return descriptor;
+}
+
+/*
+ * Feed the dives of a recording made during a download (see record_dive())
+ * through the same parsing path as a download from the dive computer.
+ * The dives are added to data->log. Fingerprints are not saved.
+ */
+const char *do_libdivecomputer_replay(device_data_t *data, const char *filename)
+{
+	struct memblock mem;
+	struct download_state state;
+	const unsigned char *p, *end;
+	const char *vendor, *product;
+	uint32_t systime_lo, systime_hi;
+	const char *err = NULL;
+
+	if (readfile(filename, &mem) < 0)
+		return translate("gettextFromC", "Failed to read the dive recording");
+	p = mem.buffer;
+	end = p + mem.size;
+
+	if (mem.size < strlen(recording_magic) || memcmp(p, recording_magic, strlen(recording_magic))) {
+		free(mem.buffer);
+		return translate("gettextFromC", "Not a dive recording");
+	}
+	p += strlen(recording_magic);
+	vendor = get_string(&p, end);
+	product = vendor ? get_string(&p, end) : NULL;
+	if (!product ||
+	    !get_le32(&p, end, &data->devinfo.model) ||
+	    !get_le32(&p, end, &data->devinfo.firmware) ||
+	    !get_le32(&p, end, &data->devinfo.serial) ||
+	    !get_le32(&p, end, &data->devtime) ||
+	    !get_le32(&p, end, &systime_lo) ||
+	    !get_le32(&p, end, &systime_hi)) {
+		free(mem.buffer);
+		return translate("gettextFromC", "Not a dive recording");
+	}
+	data->systime = (dc_ticks_t)((uint64_t)systime_hi << 32 | systime_lo);
+
+	data->descriptor = get_descriptor_by_name(vendor, product);
+	if (!data->descriptor) {
+		free(mem.buffer);
+		return translate("gettextFromC", "Unknown dive computer in dive recording");
+	}
+	data->vendor = dc_descriptor_get_vendor(data->descriptor);
+	data->product = dc_descriptor_get_product(data->descriptor);
+	data->model = str_printf("%s %s", data->vendor, data->product);
+	data->device = NULL;
+	data->fingerprint = NULL;
+	data->fsize = 0;
+
+	if (dc_context_new(&data->context) != DC_STATUS_SUCCESS) {
+		err = translate("gettextFromC", "Unable to create libdivecomputer context");
+	} else {
+		start_download(&state, data);
+		while (p < end) {
+			uint32_t size, fsize;
+			const unsigned char *dive_data, *fingerprint;
+
+			if (!get_le32(&p, end, &size) || (uint32_t)(end - p) < size) {
+				err = translate("gettextFromC", "Truncated dive recording");
+				break;
+			}
+			dive_data = p;
+			p += size;
+			if (!get_le32(&p, end, &fsize) || (uint32_t)(end - p) < fsize) {
+				err = translate("gettextFromC", "Truncated dive recording");
+				break;
+			}
+			fingerprint = p;
+			p += fsize;
+			if (!dive_cb(dive_data, size, fingerprint, fsize, &state))
+				break;
+		}
+		finish_download(&state);
+		dc_context_free(data->context);
+		data->context = NULL;
+	}
+
+	free(data->fingerprint);
+	data->fingerprint = NULL;
+	/* vendor and product point into the descriptor, the model string is kept */
+	dc_descriptor_free(data->descriptor);
+	data->descriptor = NULL;
+	data->vendor = data->product = NULL;
+	free(mem.buffer);
+	return err;
+}
+
 /*
  * Parse data buffers instead of dc devices downloaded data.
  * Intended to be used to parse profile data from binary files during import tasks.
@@ -1585,12 +1879,12 @@ dc_status_t libdc_buffer_parser(struct dive *dive, device_data_t *data, unsigned
 	// Do not parse Aladin/Memomouse headers as they are fakes
 	// Do not return on error, we can still parse the samples
 	if (dc_descriptor_get_type(data->descriptor) != DC_FAMILY_UWATEC_ALADIN && dc_descriptor_get_type(data->descriptor) != DC_FAMILY_UWATEC_MEMOMOUSE) {
-		rc = libdc_header_parser (parser, data, dive);
+		rc = libdc_header_parser (parser, data, dive, dive->number);
 		if (rc != DC_STATUS_SUCCESS) {
 			report_error("Error parsing the dive header data. Dive # %d\nStatus = %s", dive->number, errmsg(rc));
 		}
 	}
-	rc = dc_parser_samples_foreach (parser, sample_cb, &dive->dc);
+	rc = parse_samples(data, &dive->dc, parser);
 	if (rc != DC_STATUS_SUCCESS) {
 		report_error("Error parsing the sample data. Dive # %d\nStatus = %s", dive->number, errmsg(rc));
 		dc_parser_destroy (parser);
@@ -38,6 +38,8 @@ typedef struct {
 	unsigned char *fingerprint;
 	unsigned int fsize, fdeviceid, fdiveid;
 	struct dc_event_devinfo_t devinfo;
+	unsigned int devtime;		// from the clock event
+	dc_ticks_t systime;
 	uint32_t diveid;
 	dc_device_t *device;
 	dc_context_t *context;
@@ -54,6 +56,7 @@ typedef struct {
 
 const char *errmsg (dc_status_t rc);
 const char *do_libdivecomputer_import(device_data_t *data);
+const char *do_libdivecomputer_replay(device_data_t *data, const char *filename);
 const char *do_uemis_import(device_data_t *data);
 dc_status_t libdc_buffer_parser(struct dive *dive, device_data_t *data, unsigned char *buffer, int size);
 void logfunc(dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *msg, void *userdata);
@@ -25,6 +25,7 @@
 #include "device.h"
 #include "membuffer.h"
 #include "git-access.h"
+#include "gitsnapshot.h"
 #include "picture.h"
 #include "qthelper.h"
 #include "tag.h"
@@ -35,7 +36,6 @@
 const char *saved_git_id = NULL;
 
 struct git_parser_state {
-	git_repository *repo;
 	struct divecomputer *active_dc;
 	struct dive *active_dive;
 	dive_trip_t *active_trip;
@@ -58,8 +58,6 @@ struct keyword_action {
 	void (*fn)(char *, struct membuffer *, struct git_parser_state *);
 };
 
-static git_blob *git_tree_entry_blob(git_repository *repo, const git_tree_entry *entry);
-
 static temperature_t get_temperature(const char *line)
 {
 	temperature_t t;
@@ -1400,10 +1398,10 @@ static unsigned parse_one_line(const char *buf, unsigned size, line_fn_t *fn, st
  * strings, but the callback function can "steal" it by
  * saving its value and just clear the original.
  */
-static void for_each_line(git_blob *blob, line_fn_t *fn, struct git_parser_state *state)
+static void for_each_line(const struct git_snapshot_entry *entry, line_fn_t *fn, struct git_parser_state *state)
 {
-	const char *content = git_blob_rawcontent(blob);
-	unsigned int size = git_blob_rawsize(blob);
+	const char *content = entry->content;
+	unsigned int size = entry->size;
 	struct membuffer str = { 0 };
 
 	while (size) {
@@ -1490,7 +1488,7 @@ static int dive_trip_directory(const char *root, const char *name, struct git_pa
  *
  * The root path will be of the form yyyy/mm[/tripdir],
  */
-static int dive_directory(const char *root, const git_tree_entry *entry, const char *name, int timeoff, struct git_parser_state *state)
+static int dive_directory(const char *root, const struct git_snapshot_entry *entry, const char *name, int timeoff, struct git_parser_state *state)
 {
 	int yyyy = -1, mm = -1, dd = -1;
 	int h, m, s;
@@ -1568,7 +1566,7 @@ static int dive_directory(const char *root, const git_tree_entry *entry, const c
 
 	finish_active_dive(state);
 	create_new_dive(utc_mktime(&tm), state);
-	memcpy(state->active_dive->git_id, git_tree_entry_id(entry)->id, 20);
+	memcpy(state->active_dive->git_id, entry->id, 20);
 	return GIT_WALK_OK;
 }
 
@@ -1632,9 +1630,9 @@ static int nonunique_length(const char *str)
  *    If it doesn't match the above patterns, we'll ignore them
  *    for dive loading purposes, and not even recurse into them.
  */
-static int walk_tree_directory(const char *root, const git_tree_entry *entry, struct git_parser_state *state)
+static int walk_tree_directory(const char *root, const struct git_snapshot_entry *entry, struct git_parser_state *state)
 {
-	const char *name = git_tree_entry_name(entry);
+	const char *name = entry->name;
 	int digits = 0, len;
 	char c;
 
@@ -1678,16 +1676,6 @@ static int walk_tree_directory(const char *root, const git_tree_entry *entry, st
 	return dive_trip_directory(root, name, state);
 }
 
-static git_blob *git_tree_entry_blob(git_repository *repo, const git_tree_entry *entry)
-{
-	const git_oid *id = git_tree_entry_id(entry);
-	git_blob *blob;
-
-	if (git_blob_lookup(&blob, repo, id))
-		return NULL;
-	return blob;
-}
-
 static struct divecomputer *create_new_dc(struct dive *dive)
 {
 	struct divecomputer *dc = &dive->dc;
@@ -1711,19 +1699,17 @@ static struct divecomputer *create_new_dc(struct dive *dive)
  * We should *really* try to delay the dive computer data parsing
  * until necessary, in order to reduce load-time. The parsing is
  * cheap, but the loading of the git blob into memory can be pretty
- * costly.
+ * costly (unless it comes from the snapshot).
  */
-static int parse_divecomputer_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
+static int parse_divecomputer_entry(struct git_parser_state *state, const struct git_snapshot_entry *entry, const char *suffix)
 {
 	UNUSED(suffix);
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
 
-	if (!blob)
+	if (!entry->content)
 		return report_error("Unable to read divecomputer file");
 
 	state->active_dc = create_new_dc(state->active_dive);
-	for_each_line(blob, divecomputer_parser, state);
-	git_blob_free(blob);
+	for_each_line(entry, divecomputer_parser, state);
 	state->active_dc = NULL;
 	return 0;
 }
@@ -1734,59 +1720,50 @@ static int parse_divecomputer_entry(struct git_parser_state *state, const git_tr
  * pictures too. So if any of the dive computers change, the dive cache
  * has to be invalidated too.
  */
-static int parse_dive_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
+static int parse_dive_entry(struct git_parser_state *state, const struct git_snapshot_entry *entry, const char *suffix)
 {
 	struct dive *dive = state->active_dive;
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
+	if (!entry->content)
 		return report_error("Unable to read dive file");
 	if (*suffix)
 		dive->number = atoi(suffix + 1);
 	clear_weightsystem_table(&state->active_dive->weightsystems);
 	state->o2pressure_sensor = 1;
-	for_each_line(blob, dive_parser, state);
-	git_blob_free(blob);
+	for_each_line(entry, dive_parser, state);
 	return 0;
 }
 
-static int parse_site_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
+static int parse_site_entry(struct git_parser_state *state, const struct git_snapshot_entry *entry, const char *suffix)
 {
 	if (*suffix == '\0')
 		return report_error("Dive site without uuid");
 	uint32_t uuid = strtoul(suffix, NULL, 16);
 	state->active_site = alloc_or_get_dive_site(uuid, state->log->sites);
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
+	if (!entry->content)
 		return report_error("Unable to read dive site file");
-	for_each_line(blob, site_parser, state);
+	for_each_line(entry, site_parser, state);
 	state->active_site = NULL;
-	git_blob_free(blob);
 	return 0;
 }
 
-static int parse_trip_entry(struct git_parser_state *state, const git_tree_entry *entry)
+static int parse_trip_entry(struct git_parser_state *state, const struct git_snapshot_entry *entry)
 {
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
+	if (!entry->content)
 		return report_error("Unable to read trip file");
-	for_each_line(blob, trip_parser, state);
-	git_blob_free(blob);
+	for_each_line(entry, trip_parser, state);
 	return 0;
 }
 
-static int parse_settings_entry(struct git_parser_state *state, const git_tree_entry *entry)
+static int parse_settings_entry(struct git_parser_state *state, const struct git_snapshot_entry *entry)
 {
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
+	if (!entry->content)
 		return report_error("Unable to read settings file");
-	for_each_line(blob, settings_parser, state);
-	git_blob_free(blob);
+	for_each_line(entry, settings_parser, state);
 	return 0;
 }
 
-static int parse_picture_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *name)
+static int parse_picture_entry(struct git_parser_state *state, const struct git_snapshot_entry *entry, const char *name)
 {
-	git_blob *blob;
 	int hh, mm, ss, offset;
 	char sign;
 
@@ -1803,15 +1780,13 @@ static int parse_picture_entry(struct git_parser_state *state, const git_tree_en
 	if (sign == '-')
 		offset = -offset;
 
-	blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
+	if (!entry->content)
 		return report_error("Unable to read picture file");
 
 	state->active_pic.offset.seconds = offset;
 
-	for_each_line(blob, picture_parser, state);
+	for_each_line(entry, picture_parser, state);
 	add_picture(&state->active_dive->pictures, state->active_pic);
-	git_blob_free(blob);
 
 	/* add_picture took ownership of the data -
 	 * clear out our copy just to be sure. */
@@ -1819,16 +1794,13 @@ static int parse_picture_entry(struct git_parser_state *state, const git_tree_en
 	return 0;
 }
 
-static int parse_filter_preset(struct git_parser_state *state, const git_tree_entry *entry)
+static int parse_filter_preset(struct git_parser_state *state, const struct git_snapshot_entry *entry)
 {
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
-	if (!blob)
+	if (!entry->content)
 		return report_error("Unable to read filter preset file");
 
 	state->active_filter = alloc_filter_preset();
-	for_each_line(blob, filter_preset_parser, state);
-
-	git_blob_free(blob);
+	for_each_line(entry, filter_preset_parser, state);
 
 	add_filter_preset_to_table(state->active_filter, state->log->filter_presets);
 	free_filter_preset(state->active_filter);
@@ -1837,11 +1809,11 @@ static int parse_filter_preset(struct git_parser_state *state, const git_tree_en
 	return 0;
 }
 
-static int walk_tree_file(const char *root, const git_tree_entry *entry, struct git_parser_state *state)
+static int walk_tree_file(const char *root, const struct git_snapshot_entry *entry, struct git_parser_state *state)
 {
 	struct dive *dive = state->active_dive;
 	dive_trip_t *trip = state->active_trip;
-	const char *name = git_tree_entry_name(entry);
+	const char *name = entry->name;
 	if (verbose > 1)
 		SSRF_INFO("git load handling file %s\n", name);
 	switch (*name) {
@@ -1874,22 +1846,27 @@ static int walk_tree_file(const char *root, const git_tree_entry *entry, struct
 	return GIT_WALK_SKIP;
 }
 
-static int walk_tree_cb(const char *root, const git_tree_entry *entry, void *payload)
+static int walk_tree_entry(const struct git_snapshot_entry *entry, struct git_parser_state *state)
 {
-	struct git_parser_state *state = payload;
-	git_filemode_t mode = git_tree_entry_filemode(entry);
-
-	if (mode == GIT_FILEMODE_TREE)
-		return walk_tree_directory(root, entry, state);
+	if (entry->is_tree)
+		return walk_tree_directory(entry->root, entry, state);
 
-	walk_tree_file(root, entry, state);
+	walk_tree_file(entry->root, entry, state);
 	/* Ignore failed blob loads */
 	return GIT_WALK_OK;
 }
 
-static int load_dives_from_tree(git_repository *repo, git_tree *tree, struct git_parser_state *state)
+/*
+ * The snapshot has the entries of the tree in the order of
+ * git_tree_walk(), so this works just like walking the tree.
+ */
+static int load_dives_from_snapshot(struct git_snapshot *snapshot, struct git_parser_state *state)
 {
-	git_tree_walk(tree, GIT_TREEWALK_PRE, walk_tree_cb, state);
+	struct git_snapshot_entry entry;
+	bool skip = false;
+
+	while (git_snapshot_next(snapshot, &entry, skip))
+		skip = walk_tree_entry(&entry, state) == GIT_WALK_SKIP;
 	return 0;
 }
 
@@ -1919,24 +1896,26 @@ static int find_commit(git_repository *repo, const char *branch, git_commit **co
 	return 0;
 }
 
-static int do_git_load(git_repository *repo, const char *branch, struct git_parser_state *state)
+static int do_git_load(struct git_info *info, struct git_parser_state *state)
 {
 	int ret;
 	git_commit *commit;
-	git_tree *tree;
+	struct git_snapshot *snapshot;
 
-	ret = find_commit(repo, branch, &commit);
+	ret = find_commit(info->repo, info->branch, &commit);
 	if (ret)
 		return ret;
-	if (git_commit_tree(&tree, commit))
-		return report_error("Could not look up tree of commit in branch '%s'", branch);
 	git_storage_update_progress(translate("gettextFromC", "Load dives from local cache"));
-	ret = load_dives_from_tree(repo, tree, state);
+	/* Only the cloud cache is ours to keep a snapshot in, see gitsnapshot.h */
+	snapshot = git_snapshot_get(info->repo, commit, info->is_subsurface_cloud);
+	if (!snapshot)
+		return report_error("Could not look up tree of commit in branch '%s'", info->branch);
+	ret = load_dives_from_snapshot(snapshot, state);
 	if (!ret) {
 		set_git_id(git_commit_id(commit));
 		git_storage_update_progress(translate("gettextFromC", "Successfully opened dive data"));
 	}
-	git_object_free((git_object *)tree);
+	git_snapshot_free(snapshot);
 
 	return ret;
 }
@@ -1963,12 +1942,11 @@ int git_load_dives(struct git_info *info, struct divelog *log)
 {
 	int ret;
 	struct git_parser_state state = { 0 };
-	state.repo = info->repo;
 	state.log = log;
 
 	if (!info->repo)
 		return report_error("Unable to open git repository '%s[%s]'", info->url, info->branch);
-	ret = do_git_load(info->repo, info->branch, &state);
+	ret = do_git_load(info, &state);
 	finish_active_dive(&state);
 	finish_active_trip(&state);
 	return ret;
@@ -40,6 +40,13 @@ static int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 1828
 					182880, 193040, 203200, 223520, 243840, 264160, 284480, 304800,
 					325120, 345440, 365760, 386080 };
 
+static enum stop_solver stop_solver = STOP_SOLVER_ESTIMATE;
+
+void set_stop_solver(enum stop_solver solver)
+{
+	stop_solver = solver;
+}
+
 #if DEBUG_PLAN
 void dump_plan(struct diveplan *diveplan)
 {
@@ -109,45 +116,128 @@ static void interpolate_transition(struct deco_state *ds, struct dive *dive, dur
 		calc_crushing_pressure(ds, depth_to_bar(d1.mm, dive));
 }
 
+/* A part of the profile between two samples, with constant gas and setpoint */
+struct plan_segment {
+	int t0, t1;
+	int d0, d1;
+	struct gasmix gas;
+	int setpoint;
+	enum divemode_t divemode;
+};
+
+static bool same_segment(const struct plan_segment *s1, const struct plan_segment *s2)
+{
+	return s1->t0 == s2->t0 && s1->t1 == s2->t1 && s1->d0 == s2->d0 && s1->d1 == s2->d1 &&
+	       same_gasmix(s1->gas, s2->gas) && s1->setpoint == s2->setpoint && s1->divemode == s2->divemode;
+}
+
+/* Can the cached tissue state be extended to the profile given by segments? This is the case
+ * if all segments but the last are the same and the last one stays longer at the same depth.
+ * If the ceiling was calculated during the bottom phase (VPM-B multilevel dives), this
+ * depends on the first ceiling, which must therefore be the same. */
+static bool tissue_cache_hit(const struct tissue_cache *cache, const struct deco_state *start, const struct deco_state *ds,
+			     const struct plan_segment *segments, int nr)
+{
+	int i;
+
+	if (!cache || !start || cache->start != start || cache->nr_segments != nr || nr == 0)
+		return false;
+	if (cache->ceiling_calculated && cache->first_ceiling_pressure.mbar != ds->first_ceiling_pressure.mbar)
+		return false;
+	for (i = 0; i < nr - 1; i++) {
+		if (!same_segment(&cache->segments[i], &segments[i]))
+			return false;
+	}
+	const struct plan_segment *old_last = &cache->segments[nr - 1], *new_last = &segments[nr - 1];
+	return old_last->t0 == new_last->t0 && old_last->t1 <= new_last->t1 &&
+	       old_last->d0 == new_last->d0 && old_last->d1 == new_last->d1 && new_last->d0 == new_last->d1 &&
+	       same_gasmix(old_last->gas, new_last->gas) && old_last->setpoint == new_last->setpoint &&
+	       old_last->divemode == new_last->divemode;
+}
+
+void free_tissue_cache(struct tissue_cache *cache)
+{
+	free(cache->segments);
+	memset(cache, 0, sizeof(*cache));
+}
+
 /* returns the tissue tolerance at the end of this (partial) dive */
-static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **cached_datap)
+static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **cached_datap, struct tissue_cache *tissue_cache)
 {
 	struct divecomputer *dc;
-	struct sample *sample, *psample;
-	int i;
+	struct sample *sample;
+	struct plan_segment *segments;
+	int i, nr;
 	depth_t lastdepth = {};
-	duration_t t0 = {}, t1 = {};
-	struct gasmix gas;
+	duration_t t0 = {};
 	int surface_interval = 0;
+	bool ceiling_calculated = false;
+	pressure_t bottom_ceiling_pressure = {};
 
 	if (!dive)
 		return 0;
+	dc = &dive->dc;
+
+	const struct event *evdm = NULL;
+	enum divemode_t divemode = UNDEF_COMP_TYPE;
+
+	nr = dc->samples;
+	segments = malloc(MAX(nr, 1) * sizeof(*segments));
+	for (i = 0, sample = dc->sample; i < nr; i++, sample++) {
+		struct plan_segment *segment = &segments[i];
+		segment->t0 = t0.seconds;
+		segment->t1 = sample->time.seconds;
+		segment->d0 = lastdepth.mm;
+		segment->d1 = sample->depth.mm;
+		segment->gas = get_gasmix_at_time(dive, dc, t0);
+		segment->setpoint = i ? sample[-1].setpoint.mbar : sample[0].setpoint.mbar;
+		segment->divemode = get_current_divemode(&dive->dc, t0.seconds + 1, &evdm, &divemode);
+		lastdepth = sample->depth;
+		t0 = sample->time;
+	}
+
+	/* If only the bottom time was extended, continue from the cached state */
+	if (*cached_datap && tissue_cache_hit(tissue_cache, *cached_datap, ds, segments, nr)) {
+		struct deco_state entry = *ds;
+		struct plan_segment *last = &tissue_cache->segments[nr - 1];
+		duration_t from = { .seconds = last->t1 }, to = { .seconds = segments[nr - 1].t1 };
+		depth_t depth = { .mm = last->d1 };
+		o2pressure_t setpoint = { .mbar = last->setpoint };
+
+		/* Like restore_deco_state(..., true), keep the VPM-B state of the caller */
+		*ds = tissue_cache->ds;
+		if (!tissue_cache->ceiling_calculated) {
+			memcpy(ds->bottom_n2_gradient, entry.bottom_n2_gradient, sizeof(ds->bottom_n2_gradient));
+			memcpy(ds->bottom_he_gradient, entry.bottom_he_gradient, sizeof(ds->bottom_he_gradient));
+			memcpy(ds->initial_n2_gradient, entry.initial_n2_gradient, sizeof(ds->initial_n2_gradient));
+			memcpy(ds->initial_he_gradient, entry.initial_he_gradient, sizeof(ds->initial_he_gradient));
+		}
+		ds->first_ceiling_pressure = entry.first_ceiling_pressure;
+		ds->max_bottom_ceiling_pressure.mbar = MAX(entry.max_bottom_ceiling_pressure.mbar, tissue_cache->bottom_ceiling_pressure.mbar);
+
+		interpolate_transition(ds, dive, from, to, depth, depth, last->gas, setpoint, last->divemode);
+		last->t1 = to.seconds;
+		tissue_cache->ds = *ds;
+		free(segments);
+		return 0;
+	}
+
 	if (*cached_datap) {
 		restore_deco_state(*cached_datap, ds, true);
 	} else {
 		surface_interval = init_decompression(ds, dive, true);
 		cache_deco_state(ds, cached_datap);
 	}
-	dc = &dive->dc;
-	if (!dc->samples)
+	if (!nr) {
+		free(segments);
 		return 0;
-	psample = sample = dc->sample;
-
-	const struct event *evdm = NULL;
-	enum divemode_t divemode = UNDEF_COMP_TYPE;
-
-	for (i = 0; i < dc->samples; i++, sample++) {
-		o2pressure_t setpoint;
-
-		if (i)
-			setpoint = sample[-1].setpoint;
-		else
-			setpoint = sample[0].setpoint;
+	}
 
-		t1 = sample->time;
-		gas = get_gasmix_at_time(dive, dc, t0);
-		if (i > 0)
-			lastdepth = psample->depth;
+	for (i = 0; i < nr; i++) {
+		const struct plan_segment *segment = &segments[i];
+		duration_t seg_t0 = { .seconds = segment->t0 }, seg_t1 = { .seconds = segment->t1 };
+		depth_t d0 = { .mm = segment->d0 }, d1 = { .mm = segment->d1 };
+		o2pressure_t setpoint = { .mbar = segment->setpoint };
 
 		/* The ceiling in the deeper portion of a multilevel dive is sometimes critical for the VPM-B
 		 * Boyle's law compensation.  We should check the ceiling prior to ascending during the bottom
@@ -158,24 +248,37 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 		 * portion of the dive.
 		 * Remember the value for later.
 		 */
-		if ((decoMode(true) == VPMB) && (lastdepth.mm > sample->depth.mm)) {
+		if ((decoMode(true) == VPMB) && (d0.mm > d1.mm)) {
 			pressure_t ceiling_pressure;
-			nuclear_regeneration(ds, t0.seconds);
+			nuclear_regeneration(ds, seg_t0.seconds);
 			vpmb_start_gradient(ds);
 			ceiling_pressure.mbar = depth_to_mbar(deco_allowed_depth(tissue_tolerance_calc(ds, dive,
-													depth_to_bar(lastdepth.mm, dive), true),
+													depth_to_bar(d0.mm, dive), true),
 										dive->surface_pressure.mbar / 1000.0,
 										dive,
 										1),
 								dive);
 			if (ceiling_pressure.mbar > ds->max_bottom_ceiling_pressure.mbar)
 				ds->max_bottom_ceiling_pressure.mbar = ceiling_pressure.mbar;
+			if (ceiling_pressure.mbar > bottom_ceiling_pressure.mbar)
+				bottom_ceiling_pressure.mbar = ceiling_pressure.mbar;
+			ceiling_calculated = true;
 		}
 
-		divemode = get_current_divemode(&dive->dc, t0.seconds + 1, &evdm, &divemode);
-		interpolate_transition(ds, dive, t0, t1, lastdepth, sample->depth, gas, setpoint, divemode);
-		psample = sample;
-		t0 = t1;
+		interpolate_transition(ds, dive, seg_t0, seg_t1, d0, d1, segment->gas, setpoint, segment->divemode);
+	}
+
+	if (tissue_cache && *cached_datap) {
+		free(tissue_cache->segments);
+		tissue_cache->start = *cached_datap;
+		tissue_cache->segments = segments;
+		tissue_cache->nr_segments = nr;
+		tissue_cache->ceiling_calculated = ceiling_calculated;
+		tissue_cache->first_ceiling_pressure = ds->first_ceiling_pressure;
+		tissue_cache->bottom_ceiling_pressure = bottom_ceiling_pressure;
+		tissue_cache->ds = *ds;
+	} else {
+		free(segments);
 	}
 	return surface_interval;
 }
@@ -544,12 +647,12 @@ static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth,
 {
 
 	bool clear_to_ascend = true;
-	struct deco_state *trial_cache = NULL;
+	struct deco_tissue_snapshot trial_cache;
 
 	// For consistency with other VPM-B implementations, we should not start the ascent while the ceiling is
 	// deeper than the next stop (thus the offgasing during the ascent is ignored).
 	// However, we still need to make sure we don't break the ceiling due to on-gassing during ascent.
-	cache_deco_state(ds, &trial_cache);
+	save_tissue_snapshot(ds, &trial_cache);
 	if (wait_time)
 		add_segment(ds, depth_to_bar(trial_depth, dive),
 			    gasmix,
@@ -558,8 +661,7 @@ static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth,
 		double tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(stoplevel, dive), true);
 		update_regression(ds, dive);
 		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > stoplevel) {
-			restore_deco_state(trial_cache, ds, false);
-			free(trial_cache);
+			restore_tissue_snapshot(&trial_cache, ds);
 			return false;
 		}
 	}
@@ -582,8 +684,7 @@ static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth,
 		}
 		trial_depth -= deltad;
 	}
-	restore_deco_state(trial_cache, ds, false);
-	free(trial_cache);
+	restore_tissue_snapshot(&trial_cache, ds);
 	return clear_to_ascend;
 }
 
@@ -628,6 +729,40 @@ static int wait_until(struct deco_state *ds, struct dive *dive, int clock, int m
 	return wait_until(ds, dive, clock, min, leap / 2, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
 }
 
+/* Like wait_until(), but start at the stop length estimated by buehlmann_stop_time(), which is
+ * usually off by at most a step. From there, walk to the first multiple of stepsize at which the
+ * ascent is clear. Under the same assumption as the binary search - that waiting longer never
+ * hurts - this gives the same result with fewer trial ascents. If the estimate is further off,
+ * continue with the binary search.
+ */
+static int wait_until_estimated(struct deco_state *ds, struct dive *dive, int clock, int leap, int stepsize, int depth, int target_depth, int avg_depth, int bottom_time, struct gasmix gasmix, int po2, double surface_pressure, enum divemode_t divemode)
+{
+	const int max_walk = 3;
+	double estimate = buehlmann_stop_time(ds, dive, depth_to_bar(depth, dive), depth_to_bar(target_depth, dive), gasmix, po2, divemode);
+	if (estimate < 0.0 || estimate >= 48 * 3600)
+		return wait_until(ds, dive, clock, clock, leap, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
+
+	// Round up to the next multiple of stepsize after clock, as wait_until() does
+	int t = clock + MAX((int)ceil(estimate), 1);
+	t += stepsize - 1 - (t - 1) % stepsize;
+
+	if (trial_ascent(ds, t - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive, divemode)) {
+		for (int i = 0; i < max_walk; i++) {
+			if (t - stepsize <= clock ||
+			    !trial_ascent(ds, t - stepsize - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive, divemode))
+				return t;
+			t -= stepsize;
+		}
+		return wait_until(ds, dive, clock, clock, t - clock, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
+	}
+	for (int i = 0; i < max_walk; i++) {
+		t += stepsize;
+		if (trial_ascent(ds, t - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive, divemode))
+			return t;
+	}
+	return wait_until(ds, dive, clock, t, MAX(leap, t - clock), stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
+}
+
 static void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_depth)
 {
 	int integral = 0;
@@ -655,6 +790,13 @@ static void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_de
 }
 
 bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
+{
+	set_gf(diveplan->gflow, diveplan->gfhigh);
+	set_vpmb_conservatism(diveplan->vpmb_conservatism);
+	return plan_with_tissue_cache(ds, diveplan, dive, timestep, decostoptable, cached_datap, NULL, is_planner, show_disclaimer);
+}
+
+bool plan_with_tissue_cache(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, struct tissue_cache *tissue_cache, bool is_planner, bool show_disclaimer)
 {
 
 	int bottom_depth;
@@ -663,7 +805,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	bool is_final_plan = true;
 	int bottom_time;
 	int previous_deco_time;
-	struct deco_state *bottom_cache = NULL;
+	struct deco_state bottom_cache;
 	struct sample *sample;
 	int po2;
 	int transitiontime, gi;
@@ -693,9 +835,6 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int decostopcounter = 0;
 	enum divemode_t divemode = dive->dc.divemode;
 
-	set_gf(diveplan->gflow, diveplan->gfhigh);
-	set_vpmb_conservatism(diveplan->vpmb_conservatism);
-
 	if (!diveplan->surface_pressure) {
 		// Lets use dive's surface pressure in planner, if have one...
 		if (dive->dc.surface_pressure.mbar) { // First from DC...
@@ -708,7 +847,18 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 			diveplan->surface_pressure = SURFACE_PRESSURE;
 		}
 	}
-	
+
+
+	/* The cached tissue state is only valid for the same settings */
+	if (tissue_cache && (tissue_cache->deco_mode != decoMode(true) || tissue_cache->vpmb_conservatism != diveplan->vpmb_conservatism ||
+			     tissue_cache->surface_pressure != diveplan->surface_pressure || tissue_cache->salinity != diveplan->salinity)) {
+		free_tissue_cache(tissue_cache);
+		tissue_cache->deco_mode = decoMode(true);
+		tissue_cache->vpmb_conservatism = diveplan->vpmb_conservatism;
+		tissue_cache->surface_pressure = diveplan->surface_pressure;
+		tissue_cache->salinity = diveplan->salinity;
+	}
+
 	clear_deco(ds, dive->surface_pressure.mbar / 1000.0, true);
 	ds->max_bottom_ceiling_pressure.mbar = ds->first_ceiling_pressure.mbar = 0;
 	create_dive_from_plan(diveplan, dive, is_planner);
@@ -782,7 +932,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	gi = gaschangenr - 1;
 
 	/* Set tissue tolerance and initial vpmb gradient at start of ascent phase */
-	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap);
+	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap, tissue_cache);
 	nuclear_regeneration(ds, clock);
 	vpmb_start_gradient(ds);
 	if (decoMode(true) == RECREATIONAL) {
@@ -850,7 +1000,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	}
 
 	// VPM-B or Buehlmann Deco
-	tissue_at_end(ds, dive, cached_datap);
+	tissue_at_end(ds, dive, cached_datap, tissue_cache);
 	if ((divemode == CCR || divemode == PSCR) && prefs.dobailout) {
 		divemode = OC;
 		po2 = 0;
@@ -864,7 +1014,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	}
 	previous_deco_time = 100000000;
 	ds->deco_time = 10000000;
-	cache_deco_state(ds, &bottom_cache);  // Lets us make several iterations
+	bottom_cache = *ds;  // Lets us make several iterations
 	bottom_depth = depth;
 	bottom_gi = gi;
 	bottom_gas = gas;
@@ -878,7 +1028,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 			vpmb_next_gradient(ds, ds->deco_time, diveplan->surface_pressure / 1000.0, true);
 
 		previous_deco_time = ds->deco_time;
-		restore_deco_state(bottom_cache, ds, true);
+		restore_deco_state(&bottom_cache, ds, true);
 
 		depth = bottom_depth;
 		gi = bottom_gi;
@@ -1028,8 +1178,13 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 					pendinggaschange = false;
 				}
 
-				int new_clock = wait_until(ds, dive, clock, clock, laststoptime * 2 + 1, timestep, depth, stoplevels[stopidx], avg_depth,
-					bottom_time, get_cylinder(dive, current_cylinder)->gasmix, po2, diveplan->surface_pressure / 1000.0, divemode);
+				int new_clock;
+				if (stop_solver == STOP_SOLVER_ESTIMATE && decoMode(true) != VPMB)
+					new_clock = wait_until_estimated(ds, dive, clock, laststoptime * 2 + 1, timestep, depth, stoplevels[stopidx], avg_depth,
+						bottom_time, get_cylinder(dive, current_cylinder)->gasmix, po2, diveplan->surface_pressure / 1000.0, divemode);
+				else
+					new_clock = wait_until(ds, dive, clock, clock, laststoptime * 2 + 1, timestep, depth, stoplevels[stopidx], avg_depth,
+						bottom_time, get_cylinder(dive, current_cylinder)->gasmix, po2, diveplan->surface_pressure / 1000.0, divemode);
 				laststoptime = new_clock - clock;
 				/* Finish infinite deco */
 				if (laststoptime >= 48 * 3600 && depth >= 6000) {
@@ -1124,7 +1279,6 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 
 	free(stoplevels);
 	free(gaschanges);
-	free(bottom_cache);
 	return decodive;
 }
 
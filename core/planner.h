@@ -6,6 +6,7 @@
 #define NOT_RECREATIONAL 2
 
 #include "units.h"
+#include "deco.h"
 #include "divemode.h"
 
 #define DECOTIMESTEP 60 /* seconds. Unit of deco stop times */
@@ -36,6 +37,30 @@ struct diveplan {
 	int surface_interval;
 };
 
+/* The tissue state at the end of the bottom phase of the last plan. If the next plan has the
+ * same profile, except that it stays longer at the last depth, only the extension is
+ * calculated. Used when planning many dives that only differ in bottom time.
+ * The cache must be used with the same start state (cached_datap) and settings. */
+struct plan_segment;
+struct tissue_cache {
+	const struct deco_state *start;
+	int deco_mode;
+	short vpmb_conservatism;
+	int surface_pressure, salinity;
+	int nr_segments;
+	struct plan_segment *segments;
+	bool ceiling_calculated;
+	pressure_t first_ceiling_pressure;
+	pressure_t bottom_ceiling_pressure;
+	struct deco_state ds;
+};
+
+/* How the lengths of deco stops are determined for the Bühlmann model. VPM-B always searches. */
+enum stop_solver {
+	STOP_SOLVER_SEARCH,	/* Binary search by trial ascents */
+	STOP_SOLVER_ESTIMATE	/* Estimate per compartment, then verify by trial ascents */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -49,6 +74,8 @@ extern const char *get_planner_disclaimer();
 extern char *get_planner_disclaimer_formatted();
 
 extern void free_dps(struct diveplan *diveplan);
+extern void set_stop_solver(enum stop_solver solver);
+extern void free_tissue_cache(struct tissue_cache *cache);
 
 struct divedatapoint *plan_add_segment(struct diveplan *diveplan, int duration, int depth, int cylinderid, int po2, bool entered, enum divemode_t divemode);
 #if DEBUG_PLAN
@@ -59,6 +86,9 @@ struct decostop {
 	int time;
 };
 extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer);
+/* Unlike plan(), doesn't set the gradient factors and the VPM-B conservatism of the diveplan,
+ * the caller has to do that beforehand. Thus, plans with the same settings can run in parallel. */
+extern bool plan_with_tissue_cache(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, struct tissue_cache *tissue_cache, bool is_planner, bool show_disclaimer);
 
 #ifdef __cplusplus
 }
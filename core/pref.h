@@ -86,6 +86,7 @@ struct preferences {
 	const char *cloud_storage_email_encoded;
 	const char *cloud_storage_password;
 	const char *cloud_storage_pin;
+	bool        cloud_shallow_clone;
 	int         cloud_timeout;
 	int         cloud_verification_status;
 	bool        save_password_local;
@@ -36,8 +36,13 @@
 #include <QFont>
 #include <QApplication>
 #include <QTextDocument>
+#include <QThread>
+#include <QWaitCondition>
 #include <cstdarg>
 #include <cstdint>
+#include <deque>
+#include <numeric>
+#include <vector>
 #ifdef Q_OS_UNIX
 #include <sys/utsname.h>
 #endif
@@ -1052,21 +1057,11 @@ static const QString hashfile_name()
 	return QString(system_default_directory()).append("/hashes");
 }
 
-static QString thumbnailDir()
+QString thumbnailDir()
 {
 	return QString(system_default_directory()) + "/thumbnails/";
 }
 
-// Calculate thumbnail filename by hashing name of file.
-QString thumbnailFileName(const QString &filename)
-{
-	if (filename.isEmpty())
-		return QString();
-	QCryptographicHash hash(QCryptographicHash::Sha1);
-	hash.addData(filename.toUtf8());
-	return thumbnailDir() + hash.result().toHex();
-}
-
 extern "C" char *hashfile_name_string()
 {
 	return copy_qstring(hashfile_name());
@@ -1623,6 +1618,103 @@ extern "C" void unlock_planner()
 	planLock.unlock();
 }
 
+// Serializes the updates of the branch of a local git cache, which are done
+// by saves and by the syncs with the remote in the background.
+QMutex gitStorageLock;
+
+extern "C" void lock_git_storage()
+{
+	gitStorageLock.lock();
+}
+
+extern "C" void unlock_git_storage()
+{
+	gitStorageLock.unlock();
+}
+
+// Call fn(idx, data) for idx = 0..count-1 on the global thread pool and wait
+// for all calls to finish. The order in which the indices are processed is
+// unspecified, so the callback must only touch data belonging to its index.
+extern "C" void parallel_for(int count, void (*fn)(int idx, void *data), void *data)
+{
+	if (count <= 0)
+		return;
+	if (count == 1) {
+		fn(0, data);
+		return;
+	}
+	std::vector<int> indices(count);
+	std::iota(indices.begin(), indices.end(), 0);
+	QtConcurrent::blockingMap(indices, [fn, data](int &idx) { fn(idx, data); });
+}
+
+// A thread that processes work items in the order in which they were added.
+struct work_queue : public QThread {
+	work_queue(void (*fn)(void *item, void *data), void *data) : fn(fn), data(data), done(false)
+	{
+	}
+	void add(void *item)
+	{
+		QMutexLocker l(&lock);
+		items.push_back(item);
+		cond.wakeOne();
+	}
+	void finish()
+	{
+		{
+			QMutexLocker l(&lock);
+			done = true;
+			cond.wakeOne();
+		}
+		wait();
+	}
+private:
+	void run() override
+	{
+		for (;;) {
+			void *item;
+			{
+				QMutexLocker l(&lock);
+				while (items.empty() && !done)
+					cond.wait(&lock);
+				if (items.empty())
+					return;
+				item = items.front();
+				items.pop_front();
+			}
+			fn(item, data);
+		}
+	}
+	void (*fn)(void *item, void *data);
+	void *data;
+	QMutex lock;
+	QWaitCondition cond;
+	std::deque<void *> items;
+	bool done;
+};
+
+// Start a thread that calls fn(item, data) for every item added with
+// queue_work(). The items are processed one after another in the order
+// in which they were added.
+extern "C" struct work_queue *start_work_queue(void (*fn)(void *item, void *data), void *data)
+{
+	work_queue *queue = new work_queue(fn, data);
+	queue->start();
+	return queue;
+}
+
+extern "C" void queue_work(struct work_queue *queue, void *item)
+{
+	queue->add(item);
+}
+
+// Wait until all items were processed, then stop the thread and free the queue.
+extern "C" void finish_work_queue(struct work_queue *queue)
+{
+	queue->finish();
+	delete queue;
+}
+
 char *copy_qstring(const QString &s)
 {
 	return strdup(qPrintable(s));
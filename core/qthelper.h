@@ -38,7 +38,7 @@ QString get_taglist_string(struct tag_entry *tag_list);
 QStringList stringToList(const QString &s);
 void read_hashes();
 void write_hashes();
-QString thumbnailFileName(const QString &filename);
+QString thumbnailDir();
 void learnPictureFilename(const QString &originalName, const QString &localName);
 QString localFilePath(const QString &originalFilename);
 int getCloudURL(QString &filename);
@@ -138,6 +138,12 @@ time_t get_dive_datetime_from_isostring(char *when);
 void print_qt_versions();
 void lock_planner();
 void unlock_planner();
+void lock_git_storage();
+void unlock_git_storage();
+void parallel_for(int count, void (*fn)(int idx, void *data), void *data);
+struct work_queue *start_work_queue(void (*fn)(void *item, void *data), void *data);
+void queue_work(struct work_queue *queue, void *item);
+void finish_work_queue(struct work_queue *queue);
 xsltStylesheetPtr get_stylesheet(const char *name);
 weight_t string_to_weight(const char *str);
 depth_t string_to_depth(const char *str);
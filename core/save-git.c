@@ -607,13 +607,11 @@ static int blob_insert(git_repository *repo, struct dir *tree, struct membuffer
 	return ret;
 }
 
-static int save_one_divecomputer(git_repository *repo, struct dir *tree, struct dive *dive, struct divecomputer *dc, int idx)
+static int save_one_divecomputer(git_repository *repo, struct dir *tree, struct membuffer *buf, int idx)
 {
 	int ret;
-	struct membuffer buf = { 0 };
 
-	save_dc(&buf, dive, dc);
-	ret = blob_insert(repo, tree, &buf, "Divecomputer%c%03u", idx ? '-' : 0, idx);
+	ret = blob_insert(repo, tree, buf, "Divecomputer%c%03u", idx ? '-' : 0, idx);
 	if (ret)
 		report_error("divecomputer tree insert failed");
 	return ret;
@@ -653,12 +651,78 @@ static int save_pictures(git_repository *repo, struct dir *dir, struct dive *div
 	return 0;
 }
 
-static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct tm *tm, bool cached_ok)
+/*
+ * Formatting the dive and dive computer files is by far the most
+ * expensive part of saving a dive that isn't cached, and it only
+ * depends on the dive itself. So we do that for all dives in parallel
+ * before building the tree. Creating the blobs and tree entries stays
+ * sequential, since the git repository must not be accessed from
+ * several threads.
+ *
+ * The texts are indexed by the position of the dive in the dive table.
+ */
+struct dive_text {
+	struct membuffer dive;
+	int nr_dcs;
+	struct membuffer *dcs;
+};
+
+struct dive_texts {
+	struct dive_text *texts;
+	bool select_only;
+	bool cached_ok;
+};
+
+static void format_one_dive(int idx, void *_data)
 {
+	struct dive_texts *data = _data;
+	struct dive_text *text = &data->texts[idx];
+	struct dive *dive = get_dive(idx);
 	struct divecomputer *dc;
-	struct membuffer buf = { 0 }, name = { 0 };
+	int i;
+
+	if (data->select_only && !dive->selected)
+		return;
+	if (data->cached_ok && dive_cache_is_valid(dive))
+		return;
+
+	create_dive_buffer(dive, &text->dive);
+	text->nr_dcs = number_of_computers(dive);
+	text->dcs = calloc(text->nr_dcs, sizeof(struct membuffer));
+	for (i = 0, dc = &dive->dc; dc; i++, dc = dc->next)
+		save_dc(&text->dcs[i], dive, dc);
+}
+
+static void format_dives(struct dive_texts *data, bool select_only, bool cached_ok)
+{
+	int nr = divelog.dives->nr;
+
+	data->texts = calloc(nr > 0 ? nr : 1, sizeof(struct dive_text));
+	data->select_only = select_only;
+	data->cached_ok = cached_ok;
+	parallel_for(nr, format_one_dive, data);
+}
+
+/* The buffers themselves have been consumed by blob_insert() */
+static void free_dive_texts(struct dive_texts *data)
+{
+	int i, j;
+
+	for (i = 0; i < divelog.dives->nr; i++) {
+		struct dive_text *text = &data->texts[i];
+		free_buffer(&text->dive);
+		for (j = 0; j < text->nr_dcs; j++)
+			free_buffer(&text->dcs[j]);
+		free(text->dcs);
+	}
+	free(data->texts);
+}
+
+static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct dive_text *text, struct tm *tm, bool cached_ok)
+{
+	struct membuffer name = { 0 };
 	struct dir *subdir;
-	int ret, nr;
+	int ret, nr, i;
 
 	/* Create dive directory */
 	create_dive_name(dive, &name, tm);
@@ -682,9 +746,8 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 	subdir->unique = 1;
 	free_buffer(&name);
 
-	create_dive_buffer(dive, &buf);
 	nr = dive->number;
-	ret = blob_insert(repo, subdir, &buf,
+	ret = blob_insert(repo, subdir, &text->dive,
 		"Dive%c%d", nr ? '-' : 0, nr);
 	if (ret)
 		return report_error("dive save-file tree insert failed");
@@ -694,12 +757,9 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 	 * computer, use index 0 for that (which disables the index
 	 * generation when naming it).
 	 */
-	dc = &dive->dc;
-	nr = dc->next ? 1 : 0;
-	do {
-		save_one_divecomputer(repo, subdir, dive, dc, nr++);
-		dc = dc->next;
-	} while (dc);
+	nr = text->nr_dcs > 1 ? 1 : 0;
+	for (i = 0; i < text->nr_dcs; i++)
+		save_one_divecomputer(repo, subdir, &text->dcs[i], nr++);
 
 	/* Save the picture data, if any */
 	save_pictures(repo, subdir, dive);
@@ -794,7 +854,7 @@ static void verify_shared_date(timestamp_t when, struct tm *tm)
 #define MIN_TIMESTAMP (0)
 #define MAX_TIMESTAMP (0x7fffffffffffffff)
 
-static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct tm *tm, bool cached_ok)
+static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct dive_texts *texts, struct tm *tm, bool cached_ok)
 {
 	int i;
 	struct dive *dive;
@@ -828,7 +888,7 @@ static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *tr
 	/* Save each dive in the directory */
 	for_each_dive(i, dive) {
 		if (dive->divetrip == trip)
-			save_one_dive(repo, subdir, dive, tm, cached_ok);
+			save_one_dive(repo, subdir, dive, &texts->texts[i], tm, cached_ok);
 	}
 
 	return 0;
@@ -1023,6 +1083,7 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 	int i;
 	struct dive *dive;
 	dive_trip_t *trip;
+	struct dive_texts texts;
 
 	git_storage_update_progress(translate("gettextFromC", "Start saving data"));
 	save_settings(repo, root);
@@ -1035,6 +1096,7 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 
 	/* save the dives */
 	git_storage_update_progress(translate("gettextFromC", "Start saving dives"));
+	format_dives(&texts, select_only, cached_ok);
 	for_each_dive(i, dive) {
 		struct tm tm;
 		struct dir *tree;
@@ -1061,12 +1123,13 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 			trip->saved = 1;
 
 			/* Pass that new subdirectory in for save-trip */
-			save_one_trip(repo, tree, trip, &tm, cached_ok);
+			save_one_trip(repo, tree, trip, &texts, &tm, cached_ok);
 			continue;
 		}
 
-		save_one_dive(repo, tree, dive, &tm, cached_ok);
+		save_one_dive(repo, tree, dive, &texts.texts[i], &tm, cached_ok);
 	}
+	free_dive_texts(&texts);
 	git_storage_update_progress(translate("gettextFromC", "Done creating local cache"));
 	return 0;
 }
@@ -1182,8 +1245,8 @@ static int create_new_commit(struct git_info *info, git_oid *tree_id, bool creat
 {
 	int ret;
 	git_reference *ref;
-	git_object *parent;
-	git_oid commit_id;
+	git_object *parent, *tip = NULL;
+	git_oid commit_id, merge_id;
 	git_signature *author;
 	git_commit *commit;
 	git_tree *tree;
@@ -1206,10 +1269,20 @@ static int create_new_commit(struct git_info *info, git_oid *tree_id, bool creat
 			if (existing_filename && verbose)
 				SSRF_INFO("existing filename %s\n", existing_filename);
 			const git_oid *id = git_commit_id((const git_commit *) parent);
-			/* if we are saving to the same git tree we got this from, let's make
-			 * sure there is no confusion */
-			if (same_string(existing_filename, info->url) && git_oid_strcmp(id, saved_git_id))
-				return report_error("The git branch does not match the git parent of the source");
+			git_object *loaded = git_oid_strcmp(id, saved_git_id) ? try_to_find_parent(saved_git_id, info->repo) : NULL;
+			/* The branch moved on from the loaded commit, e.g. by a merge of a sync with the
+			 * remote in the background. Commit on top of the loaded commit and merge that
+			 * into the branch, so that neither the changes in the branch nor ours are lost. */
+			if (loaded && git_graph_descendant_of(info->repo, id, git_commit_id((const git_commit *) loaded)) == 1) {
+				tip = parent;
+				parent = loaded;
+			} else {
+				git_object_free(loaded);
+				/* if we are saving to the same git tree we got this from, let's make
+				 * sure there is no confusion */
+				if (same_string(existing_filename, info->url) && git_oid_strcmp(id, saved_git_id))
+					return report_error("The git branch does not match the git parent of the source");
+			}
 		}
 
 		/* all good */
@@ -1226,6 +1299,7 @@ static int create_new_commit(struct git_info *info, git_oid *tree_id, bool creat
 	if (parent && git_oid_equal(tree_id, git_commit_tree_id((const git_commit *) parent))) {
 		/* If the parent already came from the ref, the commit is already there */
 		if (ref) {
+			git_object_free(tip);
 			git_signature_free(author);
 			return 0;
 		}
@@ -1253,29 +1327,37 @@ static int create_new_commit(struct git_info *info, git_oid *tree_id, bool creat
 		if (git_branch_create(&ref, info->repo, info->branch, commit, 0))
 			return report_error("Failed to create branch '%s'", info->branch);
 	}
-	/*
-	 * If it's a checked-out branch, try to also update the working
-	 * tree and index. If that fails (dirty working tree or whatever),
-	 * this is not technically a save error (we did save things in
-	 * the object database), but it can cause extreme confusion, so
-	 * warn about it.
-	 */
-	if (git_branch_is_head(ref) && !git_repository_is_bare(info->repo)) {
-		if (update_git_checkout(info->repo, parent, tree)) {
-			const git_error *err = giterr_last();
-			const char *errstr = err ? err->message : strerror(errno);
-			report_error("Git branch '%s' is checked out, but worktree is dirty (%s)",
-				info->branch, errstr);
+	if (tip) {
+		/* The merge updates the branch and the working tree */
+		git_object_free(tip);
+		if (git_merge_into_branch(info, &ref, git_commit_id((const git_commit *) parent), &commit_id, &merge_id))
+			return report_error("Failed to merge the changes into branch '%s'", info->branch);
+	} else {
+		/*
+		 * If it's a checked-out branch, try to also update the working
+		 * tree and index. If that fails (dirty working tree or whatever),
+		 * this is not technically a save error (we did save things in
+		 * the object database), but it can cause extreme confusion, so
+		 * warn about it.
+		 */
+		if (git_branch_is_head(ref) && !git_repository_is_bare(info->repo)) {
+			if (update_git_checkout(info->repo, parent, tree)) {
+				const git_error *err = giterr_last();
+				const char *errstr = err ? err->message : strerror(errno);
+				report_error("Git branch '%s' is checked out, but worktree is dirty (%s)",
+					info->branch, errstr);
+			}
 		}
-	}
 
-	if (git_reference_set_target(&ref, ref, &commit_id, "Subsurface save event"))
-		return report_error("Failed to update branch '%s'", info->branch);
+		if (git_reference_set_target(&ref, ref, &commit_id, "Subsurface save event"))
+			return report_error("Failed to update branch '%s'", info->branch);
+	}
 
 	/*
 	 * if this was the empty commit to initialize a new repo, don't remember the
 	 * commit_id, otherwise we'll think that the cache is valid and fail when building
-	 * the tree when we actually try to store the dive data
+	 * the tree when we actually try to store the dive data.
+	 * After a merge, the loaded data is still our commit, not the merge.
 	 */
 	if (! create_empty)
 		set_git_id(&commit_id);
@@ -1312,21 +1394,12 @@ static int write_git_tree(git_repository *repo, struct dir *tree, git_oid *resul
 	return ret;
 }
 
-int do_git_save(struct git_info *info, bool select_only, bool create_empty)
+static int write_new_commit(struct git_info *info, bool select_only, bool create_empty)
 {
 	struct dir tree;
 	git_oid id;
 	bool cached_ok;
 
-	if (!info->repo)
-		return report_error("Unable to open git repository '%s[%s]'", info->url, info->branch);
-
-	if (verbose)
-		SSRF_INFO("git storage: do git save\n");
-
-	if (!create_empty) // so we are actually saving the dives
-		git_storage_update_progress(translate("gettextFromC", "Preparing to save data"));
-
 	/*
 	 * Check if we can do the cached writes - we need to
 	 * have the original git commit we loaded in the repo
@@ -1353,6 +1426,28 @@ int do_git_save(struct git_info *info, bool select_only, bool create_empty)
 	/* And save the tree! */
 	if (create_new_commit(info, &id, create_empty))
 		return report_error("creating commit failed");
+	return 0;
+}
+
+int do_git_save(struct git_info *info, bool select_only, bool create_empty)
+{
+	int ret;
+
+	if (!info->repo)
+		return report_error("Unable to open git repository '%s[%s]'", info->url, info->branch);
+
+	if (verbose)
+		SSRF_INFO("git storage: do git save\n");
+
+	if (!create_empty) // so we are actually saving the dives
+		git_storage_update_progress(translate("gettextFromC", "Preparing to save data"));
+
+	/* A sync with the remote in the background may update the branch at the same time */
+	lock_git_storage();
+	ret = write_new_commit(info, select_only, create_empty);
+	unlock_git_storage();
+	if (ret)
+		return ret;
 
 	/* now sync the tree with the remote server */
 	if (info->url && !git_local_only)
@@ -556,29 +556,141 @@ int save_dive(FILE *f, struct dive *dive, bool anonymize)
 	return 0;
 }
 
-static void save_trip(struct membuffer *b, dive_trip_t *trip, bool anonymize)
+/*
+ * Formatting the dives is by far the most expensive part of saving
+ * a log, and each dive's text only depends on the dive itself. So we
+ * first determine the order in which the dives are written and then
+ * format them in batches in parallel, each dive into its own membuffer.
+ * Working in batches bounds the memory needed when streaming to a file.
+ */
+#define SAVE_BATCH_SIZE 256
+
+struct dive_buffers {
+	int *order;			/* dive table indices in output order */
+	int nr;
+	int start;			/* first entry of the current batch */
+	struct membuffer *buffers;	/* one buffer per dive of the batch */
+	bool anonymize;
+};
+
+/*
+ * Incredibly cheesy: we want to save the dives sorted, and they
+ * are sorted in the dive array.. So instead of using the dive
+ * list in the trip, we just traverse the global dive array and
+ * check the divetrip pointer..
+ */
+static int collect_dives_to_save(int *order, bool select_only)
 {
-	int i;
-	struct dive *dive;
+	int i, j, nr = 0;
+	struct dive *dive, *trip_dive;
+	dive_trip_t *trip;
+
+	for (i = 0; i < divelog.trips->nr; ++i)
+		divelog.trips->trips[i]->saved = 0;
+
+	for_each_dive(i, dive) {
+		if (select_only) {
+			if (dive->selected)
+				order[nr++] = i;
+			continue;
+		}
+
+		trip = dive->divetrip;
+
+		/* Bare dive without a trip? */
+		if (!trip) {
+			order[nr++] = i;
+			continue;
+		}
+
+		/* Have we already seen this trip (and thus saved this dive?) */
+		if (trip->saved)
+			continue;
+
+		/* We haven't seen this trip before - save all its dives */
+		trip->saved = 1;
+		for (j = i; (trip_dive = get_dive(j)) != NULL; j++) {
+			if (trip_dive->divetrip == trip)
+				order[nr++] = j;
+		}
+	}
+	return nr;
+}
+
+static void format_one_dive(int idx, void *_data)
+{
+	struct dive_buffers *data = _data;
+	struct dive *dive = get_dive(data->order[data->start + idx]);
+
+	save_one_dive_to_mb(&data->buffers[idx], dive, data->anonymize);
+}
 
+static void save_trip_header(struct membuffer *b, dive_trip_t *trip)
+{
 	put_format(b, "<trip");
 	show_date(b, trip_date(trip));
 	show_utf8(b, trip->location, " location=\'", "\'", 1);
 	put_format(b, ">\n");
 	show_utf8(b, trip->notes, "<notes>", "</notes>\n", 0);
+}
 
-	/*
-	 * Incredibly cheesy: we want to save the dives sorted, and they
-	 * are sorted in the dive array.. So instead of using the dive
-	 * list in the trip, we just traverse the global dive array and
-	 * check the divetrip pointer..
-	 */
-	for_each_dive(i, dive) {
-		if (dive->divetrip == trip)
-			save_one_dive_to_mb(b, dive, anonymize);
+/*
+ * When streaming, the buffer is handed to the output whenever it
+ * grows beyond this size, so that the whole document never has to
+ * be kept in memory.
+ */
+#define SAVE_FLUSH_THRESHOLD (1024 * 1024)
+
+struct xml_output {
+	/* Consumes the contents of the buffer */
+	void (*write)(struct membuffer *b, void *data);
+	void *data;
+};
+
+static void flush_if_needed(struct membuffer *b, struct xml_output *out)
+{
+	if (out && b->len >= SAVE_FLUSH_THRESHOLD)
+		out->write(b, out->data);
+}
+
+static void save_dive_list(struct membuffer *b, bool select_only, bool anonymize, struct xml_output *out)
+{
+	int i, batch;
+	struct dive *dive;
+	dive_trip_t *trip = NULL, *dive_trip;
+	struct dive_buffers data;
+
+	data.order = malloc((divelog.dives->nr + 1) * sizeof(int));
+	data.nr = collect_dives_to_save(data.order, select_only);
+	data.buffers = calloc(SAVE_BATCH_SIZE, sizeof(struct membuffer));
+	data.anonymize = anonymize;
+
+	for (data.start = 0; data.start < data.nr; data.start += batch) {
+		batch = MIN(data.nr - data.start, SAVE_BATCH_SIZE);
+		parallel_for(batch, format_one_dive, &data);
+
+		for (i = 0; i < batch; i++) {
+			dive = get_dive(data.order[data.start + i]);
+
+			/* We don't save trips when doing selected dive saves */
+			dive_trip = select_only ? NULL : dive->divetrip;
+			if (dive_trip != trip) {
+				if (trip)
+					put_format(b, "</trip>\n");
+				if (dive_trip)
+					save_trip_header(b, dive_trip);
+				trip = dive_trip;
+			}
+			put_bytes(b, data.buffers[i].buffer, data.buffers[i].len);
+			free_buffer(&data.buffers[i]);
+			flush_if_needed(b, out);
+		}
 	}
+	if (trip)
+		put_format(b, "</trip>\n");
 
-	put_format(b, "</trip>\n");
+	free(data.buffers);
+	free(data.order);
 }
 
 static void save_one_device(struct membuffer *b, const struct device *d)
@@ -619,11 +731,20 @@ static void save_one_fingerprint(struct membuffer *b, int i)
 	free((void *)data);
 }
 
+static int do_save_dives(const char *filename, bool select_only, bool anonymize, bool local_only);
+
 int save_dives(const char *filename)
 {
 	return save_dives_logic(filename, false, false);
 }
 
+/* Like save_dives(), but remote git repositories are only saved to their local
+ * cache, independent of git_local_only. The caller syncs them with the remote. */
+int save_dives_local(const char *filename)
+{
+	return do_save_dives(filename, false, false, true);
+}
+
 static void save_filter_presets(struct membuffer *b)
 {
 	int i;
@@ -674,11 +795,14 @@ static void save_filter_presets(struct membuffer *b)
 	put_format(b, "</filterpresets>\n");
 }
 
-static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonymize)
+/*
+ * If 'out' is non-NULL, parts of the document are passed on to it while
+ * saving. The caller is responsible for handing over the final remainder
+ * of the buffer.
+ */
+static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonymize, struct xml_output *out)
 {
 	int i;
-	struct dive *dive;
-	dive_trip_t *trip;
 
 	put_format(b, "<divelog program='subsurface' version='%d'>\n<settings>\n", DATAFORMAT_VERSION);
 
@@ -727,38 +851,12 @@ static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonym
 		put_format(b, "</site>\n");
 	}
 	put_format(b, "</divesites>\n<dives>\n");
-	for (i = 0; i < divelog.trips->nr; ++i)
-		divelog.trips->trips[i]->saved = 0;
 
 	/* save the filter presets */
 	save_filter_presets(b);
 
 	/* save the dives */
-	for_each_dive(i, dive) {
-		if (select_only) {
-
-			if (!dive->selected)
-				continue;
-			save_one_dive_to_mb(b, dive, anonymize);
-
-		} else {
-			trip = dive->divetrip;
-
-			/* Bare dive without a trip? */
-			if (!trip) {
-				save_one_dive_to_mb(b, dive, anonymize);
-				continue;
-			}
-
-			/* Have we already seen this trip (and thus saved this dive?) */
-			if (trip->saved)
-				continue;
-
-			/* We haven't seen this trip before - save it and all dives */
-			trip->saved = 1;
-			save_trip(b, trip, anonymize);
-		}
-	}
+	save_dive_list(b, select_only, anonymize, out);
 	put_format(b, "</dives>\n</divelog>\n");
 }
 
@@ -819,21 +917,31 @@ static void try_to_backup(const char *filename)
 	}
 }
 
+static void write_to_file(struct membuffer *b, void *f)
+{
+	flush_buffer(b, f);
+}
+
 int save_dives_logic(const char *filename, const bool select_only, bool anonymize)
+{
+	return do_save_dives(filename, select_only, anonymize, false);
+}
+
+static int do_save_dives(const char *filename, bool select_only, bool anonymize, bool local_only)
 {
 	struct membuffer buf = { 0 };
+	struct xml_output out = { write_to_file, NULL };
 	struct git_info info;
 	FILE *f;
 	int error = 0;
 
 	if (is_git_repository(filename, &info)) {
+		info.local_only = local_only;
 		error = git_save_dives(&info, select_only);
 		cleanup_git_info(&info);
 		return error;
 	}
 
-	save_dives_buffer(&buf, select_only, anonymize);
-
 	if (same_string(filename, "-")) {
 		f = stdout;
 	} else {
@@ -842,8 +950,13 @@ int save_dives_logic(const char *filename, const bool select_only, bool anonymiz
 		f = subsurface_fopen(filename, "w");
 	}
 	if (f) {
+		/* Stream the log to the file instead of building it in memory */
+		out.data = f;
+		save_dives_buffer(&buf, select_only, anonymize, &out);
 		flush_buffer(&buf, f);
-		error = fclose(f);
+		error = ferror(f) ? -1 : 0;
+		if (fclose(f))
+			error = -1;
 	}
 	if (error)
 		report_error(translate("gettextFromC", "Failed to save dives to %s (%s)"), filename, strerror(errno));
@@ -862,10 +975,18 @@ int export_dives_xslt(const char *filename, const bool selected, const int units
 	return ret;
 }
 
+static void write_to_parser(struct membuffer *b, void *ctxt)
+{
+	xmlParseChunk(ctxt, b->buffer, b->len, 0);
+	free_buffer(b);
+}
+
 static int export_dives_xslt_doit(const char *filename, struct xml_params *params, bool selected, int units, const char *export_xslt, bool anonymize)
 {
 	FILE *f;
 	struct membuffer buf = { 0 };
+	struct xml_output out = { write_to_parser, NULL };
+	xmlParserCtxtPtr ctxt;
 	xmlDoc *doc;
 	xsltStylesheetPtr xslt = NULL;
 	xmlDoc *transformed;
@@ -877,16 +998,22 @@ static int export_dives_xslt_doit(const char *filename, struct xml_params *param
 	if (!filename)
 		return report_error("No filename for export");
 
-	/* Save XML to file and convert it into a memory buffer */
-	save_dives_buffer(&buf, selected, anonymize);
-
 	/*
-	 * Parse the memory buffer into XML document and
-	 * transform it to selected export format, finally dumping
-	 * the XML into a character buffer.
+	 * Feed the XML into a push parser piece by piece while saving,
+	 * so that we never have to keep the whole text in memory. Then
+	 * transform the resulting XML document to the selected export
+	 * format and dump it into the output file.
 	 */
-	doc = xmlReadMemory(buf.buffer, buf.len, "divelog", NULL, XML_PARSE_HUGE | XML_PARSE_RECOVER);
-	free_buffer(&buf);
+	ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, "divelog");
+	if (!ctxt)
+		return report_error("Failed to create XML parser");
+	xmlCtxtUseOptions(ctxt, XML_PARSE_HUGE | XML_PARSE_RECOVER);
+	out.data = ctxt;
+	save_dives_buffer(&buf, selected, anonymize, &out);
+	write_to_parser(&buf, ctxt);
+	xmlParseChunk(ctxt, NULL, 0, 1);
+	doc = ctxt->myDoc;
+	xmlFreeParserCtxt(ctxt);
 	if (!doc)
 		return report_error("Failed to read XML memory");
 
@@ -18,6 +18,7 @@ void qPrefCloudStorage::loadSync(bool doSync)
 	disk_cloud_storage_email_encoded(doSync);
 	disk_cloud_storage_password(doSync);
 	disk_cloud_storage_pin(doSync);
+	disk_cloud_shallow_clone(doSync);
 	disk_cloud_timeout(doSync);
 	disk_cloud_verification_status(doSync);
 	disk_save_password_local(doSync);
@@ -76,6 +77,8 @@ void qPrefCloudStorage::disk_cloud_storage_password(bool doSync)
 
 HANDLE_PREFERENCE_TXT(CloudStorage, "pin", cloud_storage_pin);
 
+HANDLE_PREFERENCE_BOOL(CloudStorage, "shallow_clone", cloud_shallow_clone);
+
 HANDLE_PREFERENCE_INT(CloudStorage, "timeout", cloud_timeout);
 
 HANDLE_PREFERENCE_INT(CloudStorage, "cloud_verification_status", cloud_verification_status);
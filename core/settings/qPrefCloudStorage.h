@@ -13,6 +13,7 @@ class qPrefCloudStorage : public QObject {
 	Q_PROPERTY(QString cloud_storage_email_encoded READ cloud_storage_email_encoded WRITE set_cloud_storage_email_encoded NOTIFY cloud_storage_email_encodedChanged)
 	Q_PROPERTY(QString cloud_storage_password READ cloud_storage_password WRITE set_cloud_storage_password NOTIFY cloud_storage_passwordChanged)
 	Q_PROPERTY(QString cloud_storage_pin READ cloud_storage_pin WRITE set_cloud_storage_pin NOTIFY cloud_storage_pinChanged)
+	Q_PROPERTY(bool cloud_shallow_clone READ cloud_shallow_clone WRITE set_cloud_shallow_clone NOTIFY cloud_shallow_cloneChanged)
 	Q_PROPERTY(int cloud_verification_status READ cloud_verification_status WRITE set_cloud_verification_status NOTIFY cloud_verification_statusChanged)
 	Q_PROPERTY(int cloud_timeout READ cloud_timeout WRITE set_cloud_timeout NOTIFY cloud_timeoutChanged)
 	Q_PROPERTY(bool save_password_local READ save_password_local WRITE set_save_password_local NOTIFY save_password_localChanged)
@@ -46,6 +47,7 @@ public:
 	static QString cloud_storage_email_encoded() { return prefs.cloud_storage_email_encoded; }
 	static QString cloud_storage_password() { return prefs.cloud_storage_password; }
 	static QString cloud_storage_pin() { return prefs.cloud_storage_pin; }
+	static bool cloud_shallow_clone() { return prefs.cloud_shallow_clone; }
 	static int cloud_timeout() { return prefs.cloud_timeout; }
 	static int cloud_verification_status() { return prefs.cloud_verification_status; }
 	static bool save_password_local() { return prefs.save_password_local; }
@@ -62,6 +64,7 @@ public slots:
 	static void set_cloud_storage_email_encoded(const QString &value);
 	static void set_cloud_storage_password(const QString &value);
 	static void set_cloud_storage_pin(const QString &value);
+	static void set_cloud_shallow_clone(bool value);
 	static void set_cloud_timeout(int value);
 	static void set_cloud_verification_status(int value);
 	static void set_save_password_local(bool value);
@@ -77,6 +80,7 @@ signals:
 	void cloud_storage_email_encodedChanged(const QString &value);
 	void cloud_storage_passwordChanged(const QString &value);
 	void cloud_storage_pinChanged(const QString &value);
+	void cloud_shallow_cloneChanged(bool value);
 	void cloud_timeoutChanged(int value);
 	void cloud_verification_statusChanged(int value);
 	void save_password_localChanged(bool value);
@@ -95,6 +99,7 @@ private:
 	static void disk_cloud_storage_email_encoded(bool doSync);
 	static void disk_cloud_storage_password(bool doSync);
 	static void disk_cloud_storage_pin(bool doSync);
+	static void disk_cloud_shallow_clone(bool doSync);
 	static void disk_cloud_timeout(bool doSync);
 	static void disk_cloud_verification_status(bool doSync);
 	static void disk_save_password_local(bool doSync);
@@ -20,45 +20,36 @@
 #include <string.h>
 #include <ctype.h>
 
-static void process_temperatures(struct dive *dp, stats_t *stats)
+static void process_temperatures(const struct dive *dp, stats_t *stats)
 {
-	temperature_t min_temp, mean_temp, max_temp = {.mkelvin = 0};
+	temperature_t mean_temp;
 
-	max_temp.mkelvin = dp->maxtemp.mkelvin;
-	if (max_temp.mkelvin && (!stats->max_temp.mkelvin || max_temp.mkelvin > stats->max_temp.mkelvin))
-		stats->max_temp.mkelvin = max_temp.mkelvin;
+	stats->max_temp.mkelvin = dp->maxtemp.mkelvin;
+	stats->min_temp.mkelvin = dp->mintemp.mkelvin;
 
-	min_temp.mkelvin = dp->mintemp.mkelvin;
-	if (min_temp.mkelvin && (!stats->min_temp.mkelvin || min_temp.mkelvin < stats->min_temp.mkelvin))
-		stats->min_temp.mkelvin = min_temp.mkelvin;
-
-	if (min_temp.mkelvin || max_temp.mkelvin) {
-		mean_temp.mkelvin = min_temp.mkelvin;
+	if (dp->mintemp.mkelvin || dp->maxtemp.mkelvin) {
+		mean_temp.mkelvin = dp->mintemp.mkelvin;
 		if (mean_temp.mkelvin)
-			mean_temp.mkelvin = (mean_temp.mkelvin + max_temp.mkelvin) / 2;
+			mean_temp.mkelvin = (mean_temp.mkelvin + dp->maxtemp.mkelvin) / 2;
 		else
-			mean_temp.mkelvin = max_temp.mkelvin;
+			mean_temp.mkelvin = dp->maxtemp.mkelvin;
 		stats->combined_temp.mkelvin += mean_temp.mkelvin;
 		stats->combined_count++;
 	}
 }
 
-static void process_dive(struct dive *dive, stats_t *stats)
+/* The statistics of a single dive, which can then be added to or removed from a group of dives */
+void calculate_dive_stats(const struct dive *dive, stats_t *stats)
 {
-	int old_tadt, sac_time = 0;
 	int32_t duration = dive->duration.seconds;
 
-	old_tadt = stats->total_average_depth_time.seconds;
-	stats->total_time.seconds += duration;
-	if (duration > stats->longest_time.seconds)
-		stats->longest_time.seconds = duration;
-	if (stats->shortest_time.seconds == 0 || duration < stats->shortest_time.seconds)
-		stats->shortest_time.seconds = duration;
-	if (dive->maxdepth.mm > stats->max_depth.mm)
-		stats->max_depth.mm = dive->maxdepth.mm;
-	if (stats->min_depth.mm == 0 || dive->maxdepth.mm < stats->min_depth.mm)
-		stats->min_depth.mm = dive->maxdepth.mm;
-	stats->combined_max_depth.mm += dive->maxdepth.mm;
+	memset(stats, 0, sizeof(*stats));
+	stats->total_time.seconds = duration;
+	stats->longest_time.seconds = duration;
+	stats->shortest_time.seconds = duration;
+	stats->max_depth.mm = dive->maxdepth.mm;
+	stats->min_depth.mm = dive->maxdepth.mm;
+	stats->combined_max_depth.mm = dive->maxdepth.mm;
 
 	process_temperatures(dive, stats);
 
@@ -66,76 +57,139 @@ static void process_dive(struct dive *dive, stats_t *stats)
 	if (!duration)
 		return;
 	if (dive->meandepth.mm) {
-		stats->total_average_depth_time.seconds += duration;
-		stats->avg_depth.mm = lrint((1.0 * old_tadt * stats->avg_depth.mm +
-					duration * dive->meandepth.mm) /
-					stats->total_average_depth_time.seconds);
+		stats->total_average_depth_time.seconds = duration;
+		stats->depth_time_sum = (uint64_t)duration * dive->meandepth.mm;
 	}
 	if (dive->sac > 100) { /* less than .1 l/min is bogus, even with a pSCR */
-		sac_time = stats->total_sac_time.seconds + duration;
-		stats->avg_sac.mliter = lrint((1.0 * stats->total_sac_time.seconds * stats->avg_sac.mliter +
-					 duration * dive->sac) /
-					 sac_time);
-		if (dive->sac > stats->max_sac.mliter)
-			stats->max_sac.mliter = dive->sac;
-		if (stats->min_sac.mliter == 0 || dive->sac < stats->min_sac.mliter)
-			stats->min_sac.mliter = dive->sac;
-		stats->total_sac_time.seconds = sac_time;
+		stats->total_sac_time.seconds = duration;
+		stats->sac_time_sum = (uint64_t)duration * dive->sac;
+		stats->max_sac.mliter = dive->sac;
+		stats->min_sac.mliter = dive->sac;
 	}
 }
 
+static void set_averages(stats_t *stats)
+{
+	stats->avg_depth.mm = stats->total_average_depth_time.seconds ?
+		lrint((double)stats->depth_time_sum / stats->total_average_depth_time.seconds) : 0;
+	stats->avg_sac.mliter = stats->total_sac_time.seconds ?
+		lrint((double)stats->sac_time_sum / stats->total_sac_time.seconds) : 0;
+}
+
+/* Zero means "no value" for the minima, so that the result doesn't depend on the order of the dives */
+#define MAX_FIELD(field) if (other->field > stats->field) stats->field = other->field
+#define MIN_FIELD(field) if (other->field && (!stats->field || other->field < stats->field)) stats->field = other->field
+#define IS_MAX(field) (other->field && other->field >= stats->field)
+#define IS_MIN(field) (other->field && other->field <= stats->field)
+
 /*
- * Calculate a summary of the statistics and put in the stats_summary
- * structure provided in the first parameter.
- * Before first use, it should be initialized with init_stats_summary().
- * After use, memory must be released with free_stats_summary().
+ * Add the statistics of a dive or a group of dives to those of another group.
+ * All fields are sums, minima or maxima, so the order doesn't matter.
  */
-void calculate_stats_summary(struct stats_summary *out, bool selected_only)
+void add_stats(stats_t *stats, const stats_t *other)
 {
-	int idx;
-	int t_idx, d_idx, r;
-	struct dive *dp;
-	struct tm tm;
-	int current_year = 0;
-	int current_month = 0;
-	int year_iter = 0;
-	int month_iter = 0;
-	int prev_month = 0, prev_year = 0;
-	int trip_iter = 0;
-	dive_trip_t *trip_ptr = 0;
-	size_t size, tsize, dsize, tmsize;
-	stats_t stats = { 0 };
+	stats->total_time.seconds += other->total_time.seconds;
+	MAX_FIELD(longest_time.seconds);
+	MIN_FIELD(shortest_time.seconds);
+	MAX_FIELD(max_depth.mm);
+	MIN_FIELD(min_depth.mm);
+	stats->combined_max_depth.mm += other->combined_max_depth.mm;
+	MAX_FIELD(max_temp.mkelvin);
+	MIN_FIELD(min_temp.mkelvin);
+	stats->combined_temp.mkelvin += other->combined_temp.mkelvin;
+	stats->combined_count += other->combined_count;
+	stats->total_average_depth_time.seconds += other->total_average_depth_time.seconds;
+	stats->depth_time_sum += other->depth_time_sum;
+	stats->total_sac_time.seconds += other->total_sac_time.seconds;
+	stats->sac_time_sum += other->sac_time_sum;
+	MAX_FIELD(max_sac.mliter);
+	MIN_FIELD(min_sac.mliter);
+	set_averages(stats);
+}
 
-	if (divelog.dives->nr > 0) {
-		stats.shortest_time.seconds = divelog.dives->dives[0]->duration.seconds;
-		stats.min_depth.mm = divelog.dives->dives[0]->maxdepth.mm;
-		stats.selection_size = divelog.dives->nr;
-	}
+/*
+ * Remove the statistics previously added with add_stats(). The minima and
+ * maxima can't be undone: returns false if other had one of the extreme
+ * values, in which case the statistics have to be recalculated.
+ */
+bool remove_stats(stats_t *stats, const stats_t *other)
+{
+	stats->total_time.seconds -= other->total_time.seconds;
+	stats->combined_max_depth.mm -= other->combined_max_depth.mm;
+	stats->combined_temp.mkelvin -= other->combined_temp.mkelvin;
+	stats->combined_count -= other->combined_count;
+	stats->total_average_depth_time.seconds -= other->total_average_depth_time.seconds;
+	stats->depth_time_sum -= other->depth_time_sum;
+	stats->total_sac_time.seconds -= other->total_sac_time.seconds;
+	stats->sac_time_sum -= other->sac_time_sum;
+	set_averages(stats);
+
+	return !IS_MAX(longest_time.seconds) && !IS_MIN(shortest_time.seconds) &&
+	       !IS_MAX(max_depth.mm) && !IS_MIN(min_depth.mm) &&
+	       !IS_MAX(max_temp.mkelvin) && !IS_MIN(min_temp.mkelvin) &&
+	       !IS_MAX(max_sac.mliter) && !IS_MIN(min_sac.mliter);
+}
 
-	/* allocate sufficient space to hold the worst
-	 * case (one dive per year or all dives during
-	 * one month) for yearly and monthly statistics*/
+#undef MAX_FIELD
+#undef MIN_FIELD
+#undef IS_MAX
+#undef IS_MIN
+
+void add_dive_to_stats(const struct dive *dive, stats_t *stats)
+{
+	stats_t single;
+
+	calculate_dive_stats(dive, &single);
+	add_stats(stats, &single);
+}
+
+/* The index of the depth range of a dive, not counting the "All" entry */
+int stats_depth_bucket(const struct dive *dive)
+{
+	int d_idx = dive->maxdepth.mm / (STATS_DEPTH_BUCKET * 1000);
+	if (d_idx < 0)
+		d_idx = 0;
+	if (d_idx >= STATS_MAX_DEPTH / STATS_DEPTH_BUCKET)
+		d_idx = STATS_MAX_DEPTH / STATS_DEPTH_BUCKET - 1;
+	return d_idx;
+}
+
+/* The index of the minimum temperature range of a dive, not counting the "All" entry */
+int stats_temp_bucket(const struct dive *dive)
+{
+	int t_idx = ((int)mkelvin_to_C(dive->mintemp.mkelvin)) / STATS_TEMP_BUCKET;
+	if (t_idx < 0)
+		t_idx = 0;
+	if (t_idx >= STATS_MAX_TEMP / STATS_TEMP_BUCKET)
+		t_idx = STATS_MAX_TEMP / STATS_TEMP_BUCKET - 1;
+	return t_idx;
+}
+
+/*
+ * Allocate the tables of a stats_summary for up to nr periods (years,
+ * months or trips) and set the labels of the fixed tables.
+ */
+void alloc_stats_summary(struct stats_summary *out, int nr)
+{
+	/* one more entry than needed to mark the end of the tables */
+	size_t size = nr + 1;
+	size_t tsize = NUM_DIVEMODE + 1;
+	size_t dsize = (STATS_MAX_DEPTH / STATS_DEPTH_BUCKET) + 1;
+	size_t tmsize = (STATS_MAX_TEMP / STATS_TEMP_BUCKET) + 1;
 
-	size = sizeof(stats_t) * (divelog.dives->nr + 1);
-	tsize = sizeof(stats_t) * (NUM_DIVEMODE + 1);
-	dsize = sizeof(stats_t) * ((STATS_MAX_DEPTH / STATS_DEPTH_BUCKET) + 1);
-	tmsize = sizeof(stats_t) * ((STATS_MAX_TEMP / STATS_TEMP_BUCKET) + 1);
 	free_stats_summary(out);
-	out->stats_yearly = malloc(size);
-	out->stats_monthly = malloc(size);
-	out->stats_by_trip = malloc(size);
-	out->stats_by_type = malloc(tsize);
-	out->stats_by_depth = malloc(dsize);
-	out->stats_by_temp = malloc(tmsize);
+	out->stats_yearly = calloc(size, sizeof(stats_t));
+	out->stats_monthly = calloc(size, sizeof(stats_t));
+	out->stats_by_trip = calloc(size, sizeof(stats_t));
+	out->stats_by_type = calloc(tsize, sizeof(stats_t));
+	out->stats_by_depth = calloc(dsize, sizeof(stats_t));
+	out->stats_by_temp = calloc(tmsize, sizeof(stats_t));
 	if (!out->stats_yearly || !out->stats_monthly || !out->stats_by_trip ||
-		  !out->stats_by_type || !out->stats_by_depth || !out->stats_by_temp)
+		  !out->stats_by_type || !out->stats_by_depth || !out->stats_by_temp) {
+		free_stats_summary(out);
+		init_stats_summary(out);
 		return;
-	memset(out->stats_yearly, 0, size);
-	memset(out->stats_monthly, 0, size);
-	memset(out->stats_by_trip, 0, size);
-	memset(out->stats_by_type, 0, tsize);
-	memset(out->stats_by_depth, 0, dsize);
-	memset(out->stats_by_temp, 0, tmsize);
+	}
 	out->stats_yearly[0].is_year = true;
 
 	/* Setting the is_trip to true to show the location as first
@@ -156,6 +210,60 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 
 	out->stats_by_temp[0].location = strdup(translate("gettextFromC", "All (by min. temp stats)"));
 	out->stats_by_temp[0].is_trip = true;
+}
+
+/* Show the depth and temperature ranges up to the maximum seen */
+void set_stats_summary_ranges(struct stats_summary *out)
+{
+	int t_idx, d_idx, r;
+
+	/* add labels for depth ranges up to maximum depth seen */
+	if (out->stats_by_depth[0].selection_size) {
+		d_idx = out->stats_by_depth[0].max_depth.mm;
+		if (d_idx > STATS_MAX_DEPTH * 1000)
+			d_idx = STATS_MAX_DEPTH * 1000;
+		for (r = 0; r * (STATS_DEPTH_BUCKET * 1000) < d_idx; ++r)
+			out->stats_by_depth[r+1].is_trip = true;
+	}
+
+	/* add labels for depth ranges up to maximum temperature seen */
+	if (out->stats_by_temp[0].selection_size) {
+		t_idx = (int)mkelvin_to_C(out->stats_by_temp[0].max_temp.mkelvin);
+		if (t_idx > STATS_MAX_TEMP)
+			t_idx = STATS_MAX_TEMP;
+		for (r = 0; r * STATS_TEMP_BUCKET < t_idx; ++r)
+			out->stats_by_temp[r+1].is_trip = true;
+	}
+}
+
+/*
+ * Calculate a summary of the statistics and put in the stats_summary
+ * structure provided in the first parameter.
+ * Before first use, it should be initialized with init_stats_summary().
+ * After use, memory must be released with free_stats_summary().
+ * For all dives, StatisticsCache::summary() gives the same result
+ * without going through the whole dive list.
+ */
+void calculate_stats_summary(struct stats_summary *out, bool selected_only)
+{
+	int idx;
+	int t_idx, d_idx;
+	struct dive *dp;
+	struct tm tm;
+	int current_year = 0;
+	int current_month = 0;
+	int year_iter = 0;
+	int month_iter = 0;
+	int prev_month = 0, prev_year = 0;
+	int trip_iter = 0;
+	dive_trip_t *trip_ptr = 0;
+
+	/* allocate sufficient space to hold the worst
+	 * case (one dive per year or all dives during
+	 * one month) for yearly and monthly statistics*/
+	alloc_stats_summary(out, divelog.dives->nr);
+	if (!out->stats_yearly)
+		return;
 
 	/* this relies on the fact that the dives in the dive_table
 	 * are in chronological order */
@@ -164,7 +272,6 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 			continue;
 		if (dp->invalid)
 			continue;
-		process_dive(dp, &stats);
 
 		/* yearly statistics */
 		utc_mkdate(dp->when, &tm);
@@ -173,43 +280,35 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 
 		if (current_year != tm.tm_year) {
 			current_year = tm.tm_year;
-			process_dive(dp, &(out->stats_yearly[++year_iter]));
+			add_dive_to_stats(dp, &(out->stats_yearly[++year_iter]));
 			out->stats_yearly[year_iter].is_year = true;
 		} else {
-			process_dive(dp, &(out->stats_yearly[year_iter]));
+			add_dive_to_stats(dp, &(out->stats_yearly[year_iter]));
 		}
 		out->stats_yearly[year_iter].selection_size++;
 		out->stats_yearly[year_iter].period = current_year;
 
 		/* stats_by_type[0] is all the dives combined */
 		out->stats_by_type[0].selection_size++;
-		process_dive(dp, &(out->stats_by_type[0]));
+		add_dive_to_stats(dp, &(out->stats_by_type[0]));
 
-		process_dive(dp, &(out->stats_by_type[dp->dc.divemode + 1]));
+		add_dive_to_stats(dp, &(out->stats_by_type[dp->dc.divemode + 1]));
 		out->stats_by_type[dp->dc.divemode + 1].selection_size++;
 
 		/* stats_by_depth[0] is all the dives combined */
 		out->stats_by_depth[0].selection_size++;
-		process_dive(dp, &(out->stats_by_depth[0]));
-
-		d_idx = dp->maxdepth.mm / (STATS_DEPTH_BUCKET * 1000);
-		if (d_idx < 0)
-			d_idx = 0;
-		if (d_idx >= STATS_MAX_DEPTH / STATS_DEPTH_BUCKET)
-			d_idx = STATS_MAX_DEPTH / STATS_DEPTH_BUCKET - 1;
-		process_dive(dp, &(out->stats_by_depth[d_idx + 1]));
+		add_dive_to_stats(dp, &(out->stats_by_depth[0]));
+
+		d_idx = stats_depth_bucket(dp);
+		add_dive_to_stats(dp, &(out->stats_by_depth[d_idx + 1]));
 		out->stats_by_depth[d_idx + 1].selection_size++;
 
 		/* stats_by_temp[0] is all the dives combined */
 		out->stats_by_temp[0].selection_size++;
-		process_dive(dp, &(out->stats_by_temp[0]));
-
-		t_idx = ((int)mkelvin_to_C(dp->mintemp.mkelvin)) / STATS_TEMP_BUCKET;
-		if (t_idx < 0)
-			t_idx = 0;
-		if (t_idx >= STATS_MAX_TEMP / STATS_TEMP_BUCKET)
-			t_idx = STATS_MAX_TEMP / STATS_TEMP_BUCKET - 1;
-		process_dive(dp, &(out->stats_by_temp[t_idx + 1]));
+		add_dive_to_stats(dp, &(out->stats_by_temp[0]));
+
+		t_idx = stats_temp_bucket(dp);
+		add_dive_to_stats(dp, &(out->stats_by_temp[t_idx + 1]));
 		out->stats_by_temp[t_idx + 1].selection_size++;
 
 		if (dp->divetrip != NULL) {
@@ -220,11 +319,11 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 
 			/* stats_by_trip[0] is all the dives combined */
 			out->stats_by_trip[0].selection_size++;
-			process_dive(dp, &(out->stats_by_trip[0]));
+			add_dive_to_stats(dp, &(out->stats_by_trip[0]));
 			out->stats_by_trip[0].is_trip = true;
 			out->stats_by_trip[0].location = strdup(translate("gettextFromC", "All (by trip stats)"));
 
-			process_dive(dp, &(out->stats_by_trip[trip_iter]));
+			add_dive_to_stats(dp, &(out->stats_by_trip[trip_iter]));
 			out->stats_by_trip[trip_iter].selection_size++;
 			out->stats_by_trip[trip_iter].is_trip = true;
 			out->stats_by_trip[trip_iter].location = dp->divetrip->location;
@@ -239,30 +338,14 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 			if (prev_month != current_month || prev_year != current_year)
 				month_iter++;
 		}
-		process_dive(dp, &(out->stats_monthly[month_iter]));
+		add_dive_to_stats(dp, &(out->stats_monthly[month_iter]));
 		out->stats_monthly[month_iter].selection_size++;
 		out->stats_monthly[month_iter].period = current_month;
 		prev_month = current_month;
 		prev_year = current_year;
 	}
 
-	/* add labels for depth ranges up to maximum depth seen */
-	if (out->stats_by_depth[0].selection_size) {
-		d_idx = out->stats_by_depth[0].max_depth.mm;
-		if (d_idx > STATS_MAX_DEPTH * 1000)
-			d_idx = STATS_MAX_DEPTH * 1000;
-		for (r = 0; r * (STATS_DEPTH_BUCKET * 1000) < d_idx; ++r)
-			out->stats_by_depth[r+1].is_trip = true;
-	}
-
-	/* add labels for depth ranges up to maximum temperature seen */
-	if (out->stats_by_temp[0].selection_size) {
-		t_idx = (int)mkelvin_to_C(out->stats_by_temp[0].max_temp.mkelvin);
-		if (t_idx > STATS_MAX_TEMP)
-			t_idx = STATS_MAX_TEMP;
-		for (r = 0; r * STATS_TEMP_BUCKET < t_idx; ++r)
-			out->stats_by_temp[r+1].is_trip = true;
-	}
+	set_stats_summary_ranges(out);
 }
 
 void free_stats_summary(struct stats_summary *stats)
@@ -296,7 +379,7 @@ void calculate_stats_selected(stats_t *stats_selection)
 	nr = 0;
 	for_each_dive(i, dive) {
 		if (dive->selected && !dive->invalid) {
-			process_dive(dive, stats_selection);
+			add_dive_to_stats(dive, stats_selection);
 			nr++;
 		}
 	}
@@ -40,6 +40,9 @@ typedef struct
 	unsigned int combined_count;
 	unsigned int selection_size;
 	duration_t total_sac_time;
+	/* sums of duration * mean depth and duration * SAC, the averages are derived from these */
+	uint64_t depth_time_sum;
+	uint64_t sac_time_sum;
 	bool is_year;
 	bool is_trip;
 	char *location;
@@ -61,6 +64,14 @@ extern "C" {
 extern void init_stats_summary(struct stats_summary *stats);
 extern void free_stats_summary(struct stats_summary *stats);
 extern void calculate_stats_summary(struct stats_summary *stats, bool selected_only);
+extern void alloc_stats_summary(struct stats_summary *stats, int nr);
+extern void set_stats_summary_ranges(struct stats_summary *stats);
+extern void add_dive_to_stats(const struct dive *dive, stats_t *stats);
+extern void calculate_dive_stats(const struct dive *dive, stats_t *stats);
+extern void add_stats(stats_t *stats, const stats_t *other);
+extern bool remove_stats(stats_t *stats, const stats_t *other);
+extern int stats_depth_bucket(const struct dive *dive);
+extern int stats_temp_bucket(const struct dive *dive);
 extern void calculate_stats_selected(stats_t *stats_selection);
 extern volume_t *get_gas_used(struct dive *dive);
 extern void selected_dives_gas_parts(volume_t *o2_tot, volume_t *he_tot);
@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "statisticscache.h"
+#include "dive.h"
+#include "divelog.h"
+#include "gettextfromc.h"
+#include "subsurface-time.h"
+#include "trip.h"
+#include "subsurface-qt/divelistnotifier.h"
+
+#include <algorithm>
+#include <string.h>
+
+StatisticsCache *StatisticsCache::instance()
+{
+	static StatisticsCache self;
+	return &self;
+}
+
+StatisticsCache::StatisticsCache() : valid(false)
+{
+	// Signals move the dives between buckets. The statistics of a bucket are only recalculated
+	// when asked for and only if a dive with an extreme value was removed from it.
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &StatisticsCache::reset);
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this,
+		[this](dive_trip *, bool, const QVector<dive *> &dives) { for (dive *d: dives) addDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this,
+		[this](dive_trip *, bool, const QVector<dive *> &dives) { for (dive *d: dives) removeDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::divesMovedBetweenTrips, this,
+		[this](dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives) { updateDives(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this,
+		[this](const QVector<dive *> &dives, DiveField) { updateDives(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this,
+		[this](timestamp_t, const QVector<dive *> &dives) { updateDives(dives); });
+
+	// Cylinder and event edits change the SAC
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &StatisticsCache::updateDives);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, [this](dive *d, int) { updateDive(d); });
+	connect(&diveListNotifier, &DiveListNotifier::eventsChanged, this, &StatisticsCache::updateDive);
+}
+
+void StatisticsCache::Bucket::add(dive *d, const stats_t &s)
+{
+	dives.insert(d);
+	if (!dirty)
+		add_stats(&stats, &s);
+	if (first && dive_less_than(d, first))
+		first = d;
+}
+
+void StatisticsCache::Bucket::remove(dive *d, const stats_t &s)
+{
+	if (!dives.erase(d))
+		return;
+	if (!dirty && !remove_stats(&stats, &s))
+		dirty = true;
+	if (d == first)
+		first = nullptr;
+}
+
+// The statistics of a dive are sums, minima and maxima, so the order of the dives doesn't matter
+const stats_t &StatisticsCache::Bucket::get(const KeyMap &keys)
+{
+	if (dirty) {
+		memset(&stats, 0, sizeof(stats));
+		for (const dive *d: dives)
+			add_stats(&stats, &keys.at(d).stats);
+		dirty = false;
+	}
+	stats.selection_size = (unsigned int)dives.size();
+	return stats;
+}
+
+dive *StatisticsCache::Bucket::firstDive()
+{
+	if (!first && !dives.empty())
+		first = *std::min_element(dives.begin(), dives.end(), dive_less_than);
+	return first;
+}
+
+// Drop all buckets. They are rebuilt on the next query.
+void StatisticsCache::reset()
+{
+	valid = false;
+	keys.clear();
+	all = allTrips = Bucket();
+	years.clear();
+	months.clear();
+	trips.clear();
+	for (Bucket &b: modes)
+		b = Bucket();
+	for (Bucket &b: depths)
+		b = Bucket();
+	for (Bucket &b: temps)
+		b = Bucket();
+}
+
+void StatisticsCache::addDive(dive *d)
+{
+	if (!valid)
+		return;
+
+	Keys &k = keys[d];
+	k = { !d->invalid, 0, 0, d->divetrip, d->dc.divemode, stats_depth_bucket(d), stats_temp_bucket(d), {} };
+	struct tm tm;
+	utc_mkdate(d->when, &tm);
+	k.year = tm.tm_year;
+	k.month = tm.tm_mon + 1;
+	if (!k.counted)
+		return;
+	calculate_dive_stats(d, &k.stats);
+
+	all.add(d, k.stats);
+	years[k.year].add(d, k.stats);
+	months[k.year * 12 + k.month - 1].add(d, k.stats);
+	if (k.trip) {
+		allTrips.add(d, k.stats);
+		trips[k.trip].add(d, k.stats);
+	}
+	modes[k.mode].add(d, k.stats);
+	depths[k.depth].add(d, k.stats);
+	temps[k.temp].add(d, k.stats);
+}
+
+// Remove the dive from a bucket of a map. Empty buckets are removed,
+// so that no stale periods or trips are shown.
+template <typename Map, typename Key>
+static void removeFromBucket(Map &map, const Key &key, dive *d, const stats_t &s)
+{
+	auto it = map.find(key);
+	if (it == map.end())
+		return;
+	it->second.remove(d, s);
+	if (it->second.dives.empty())
+		map.erase(it);
+}
+
+void StatisticsCache::removeDive(const dive *d)
+{
+	if (!valid)
+		return;
+
+	auto it = keys.find(d);
+	if (it == keys.end())
+		return;
+	Keys k = it->second;
+	keys.erase(it);
+	if (!k.counted)
+		return;
+
+	// The dive may have been edited already: remove what it added, not its current statistics
+	dive *dp = const_cast<dive *>(d);
+	all.remove(dp, k.stats);
+	removeFromBucket(years, k.year, dp, k.stats);
+	removeFromBucket(months, k.year * 12 + k.month - 1, dp, k.stats);
+	if (k.trip) {
+		allTrips.remove(dp, k.stats);
+		removeFromBucket(trips, k.trip, dp, k.stats);
+	}
+	modes[k.mode].remove(dp, k.stats);
+	depths[k.depth].remove(dp, k.stats);
+	temps[k.temp].remove(dp, k.stats);
+}
+
+void StatisticsCache::updateDive(dive *d)
+{
+	// Ignore dives that are not in the dive list, such as the planned dive
+	if (keys.find(d) == keys.end())
+		return;
+	removeDive(d);
+	addDive(d);
+}
+
+void StatisticsCache::updateDives(const QVector<dive *> &dives)
+{
+	for (dive *d: dives)
+		updateDive(d);
+}
+
+void StatisticsCache::summary(struct stats_summary *out)
+{
+	int i;
+	struct dive *d;
+
+	// Changes of the dive list that were not signalled (e.g. when loading
+	// a log in the tests) are caught by comparing the number of dives.
+	if (valid && keys.size() != (size_t)divelog.dives->nr)
+		reset();
+	if (!valid) {
+		valid = true;
+		for_each_dive (i, d)
+			addDive(d);
+	}
+
+	alloc_stats_summary(out, (int)std::max(months.size(), trips.size() + 1));
+	if (!out->stats_yearly)
+		return;
+
+	i = 0;
+	for (auto &it: years) {
+		out->stats_yearly[i] = it.second.get(keys);
+		out->stats_yearly[i].is_year = true;
+		out->stats_yearly[i].period = it.first;
+		++i;
+	}
+
+	i = 0;
+	for (auto &it: months) {
+		out->stats_monthly[i] = it.second.get(keys);
+		out->stats_monthly[i].period = it.first % 12 + 1;
+		++i;
+	}
+
+	if (!allTrips.dives.empty()) {
+		out->stats_by_trip[0] = allTrips.get(keys);
+		out->stats_by_trip[0].is_trip = true;
+		out->stats_by_trip[0].location = strdup(trGettext("All (by trip stats)"));
+
+		// The trips are listed in the order of their first dive
+		std::vector<std::pair<dive_trip *, Bucket *>> sorted;
+		sorted.reserve(trips.size());
+		for (auto &it: trips) {
+			it.second.firstDive();
+			sorted.push_back({ it.first, &it.second });
+		}
+		std::sort(sorted.begin(), sorted.end(),
+			  [](const std::pair<dive_trip *, Bucket *> &t1, const std::pair<dive_trip *, Bucket *> &t2)
+			  { return dive_less_than(t1.second->first, t2.second->first); });
+		i = 1;
+		for (auto &it: sorted) {
+			out->stats_by_trip[i] = it.second->get(keys);
+			out->stats_by_trip[i].is_trip = true;
+			out->stats_by_trip[i].location = it.first->location;
+			++i;
+		}
+	}
+
+	// The labels of the dive mode, depth and temperature tables were set by alloc_stats_summary()
+	auto copyStats = [this](stats_t &to, Bucket &from) {
+		char *location = to.location;
+		bool is_trip = to.is_trip;
+		to = from.get(keys);
+		to.location = location;
+		to.is_trip = is_trip;
+	};
+	copyStats(out->stats_by_type[0], all);
+	copyStats(out->stats_by_depth[0], all);
+	copyStats(out->stats_by_temp[0], all);
+	for (i = 0; i < NUM_DIVEMODE; ++i)
+		copyStats(out->stats_by_type[i + 1], modes[i]);
+	for (i = 0; i < STATS_MAX_DEPTH / STATS_DEPTH_BUCKET; ++i)
+		copyStats(out->stats_by_depth[i + 1], depths[i]);
+	for (i = 0; i < STATS_MAX_TEMP / STATS_TEMP_BUCKET; ++i)
+		copyStats(out->stats_by_temp[i + 1], temps[i]);
+
+	set_stats_summary_ranges(out);
+}
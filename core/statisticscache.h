@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0
+// Keeps the statistics summary of the whole dive log up to date. The dives are
+// sorted into buckets (years, months, trips, dive modes, depth and temperature
+// ranges). When dives are added, removed or edited, their statistics are added
+// to or subtracted from the statistics of their buckets. Only if a dive with an
+// extreme value (e.g. the deepest dive) is removed, the statistics of that
+// bucket are recalculated from its dives.
+#ifndef STATISTICSCACHE_H
+#define STATISTICSCACHE_H
+
+#include "statistics.h"
+#include "divemode.h"
+
+#include <QObject>
+#include <QVector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct dive;
+struct dive_trip;
+
+class StatisticsCache : public QObject {
+	Q_OBJECT
+public:
+	static StatisticsCache *instance();
+
+	// Same result as calculate_stats_summary(out, false)
+	void summary(struct stats_summary *out);
+private:
+	// The buckets a dive was sorted into. Invalid dives are not in any bucket.
+	struct Keys {
+		bool counted;
+		int year, month;
+		dive_trip *trip;
+		int mode, depth, temp;
+		stats_t stats;		// What the dive added to its buckets
+	};
+	using KeyMap = std::unordered_map<const dive *, Keys>;
+	struct Bucket {
+		std::unordered_set<dive *> dives;
+		stats_t stats = {};
+		bool dirty = false;		// An extreme value was removed, recalculate from the dives
+		dive *first = nullptr;		// Null if it has to be searched
+		void add(dive *d, const stats_t &s);
+		void remove(dive *d, const stats_t &s);
+		const stats_t &get(const KeyMap &keys);
+		dive *firstDive();
+	};
+
+	StatisticsCache();
+	void reset();
+	void addDive(dive *d);
+	void removeDive(const dive *d);
+	void updateDives(const QVector<dive *> &dives);
+	void updateDive(dive *d);
+
+	bool valid;
+	KeyMap keys;
+	Bucket all, allTrips;
+	std::map<int, Bucket> years;
+	std::map<int, Bucket> months;	// Indexed by year * 12 + month
+	std::unordered_map<dive_trip *, Bucket> trips;
+	Bucket modes[NUM_DIVEMODE];
+	Bucket depths[STATS_MAX_DEPTH / STATS_DEPTH_BUCKET];
+	Bucket temps[STATS_MAX_TEMP / STATS_TEMP_BUCKET];
+};
+
+#endif
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "thumbnailscheduler.h"
+
+#include <QRunnable>
+#include <QMutexLocker>
+#include <algorithm>
+
+// Picture decoding and video frame extraction used to run on separate pools with
+// one thread each. Stefan Fuchs reported problems when decoding multiple pictures
+// at once, so keep picture decoding at one job. The second worker is shared, so
+// that video frames can be extracted while a picture is decoded.
+static const int maxThumbnailJobs = 2;
+static const int maxThumbnailPictureJobs = 1;
+
+ThumbnailScheduler *ThumbnailScheduler::instance()
+{
+	static ThumbnailScheduler self(maxThumbnailJobs, maxThumbnailPictureJobs);
+	return &self;
+}
+
+class ThumbnailScheduler::Runner : public QRunnable {
+public:
+	Runner(ThumbnailScheduler *scheduler, Kind kind, std::function<void()> job) :
+		scheduler(scheduler), kind(kind), job(std::move(job))
+	{
+	}
+	void run() override
+	{
+		job();
+		scheduler->finished(kind);
+	}
+private:
+	ThumbnailScheduler *scheduler;
+	Kind kind;
+	std::function<void()> job;
+};
+
+ThumbnailScheduler::ThumbnailScheduler(int maxJobsIn, int maxPictureJobsIn) :
+	maxJobs(maxJobsIn), maxPictureJobs(maxPictureJobsIn), running(0), serial(0)
+{
+	for (int &r: runningKind)
+		r = 0;
+	pool.setMaxThreadCount(maxJobs);
+}
+
+ThumbnailScheduler::~ThumbnailScheduler()
+{
+	{
+		QMutexLocker l(&lock);
+		for (std::vector<Job> &p: pending)
+			p.clear();
+	}
+	pool.waitForDone();
+}
+
+bool ThumbnailScheduler::JobOrder::operator()(const Job &j1, const Job &j2) const
+{
+	return j1.effectivePriority != j2.effectivePriority ? j1.effectivePriority < j2.effectivePriority
+							    : j1.serial > j2.serial;
+}
+
+int ThumbnailScheduler::effectivePriority(const Job &job) const
+{
+	return visible.contains(job.filename) ? PRIORITY_NORMAL + 1 : job.priority;
+}
+
+int ThumbnailScheduler::maxRunning(Kind kind) const
+{
+	return kind == JOB_PICTURE ? maxPictureJobs : maxJobs;
+}
+
+// Start the most important pending jobs, if there are free workers. Must be called with the lock held.
+void ThumbnailScheduler::dispatch()
+{
+	while (running < maxJobs) {
+		// Choose among the front jobs of the kinds that haven't reached their limit
+		std::vector<Job> *best = nullptr;
+		Kind bestKind = JOB_PICTURE;
+		for (int kind = 0; kind < JOB_KIND_COUNT; ++kind) {
+			std::vector<Job> &p = pending[kind];
+			if (p.empty() || runningKind[kind] >= maxRunning((Kind)kind))
+				continue;
+			if (!best || JobOrder()(best->front(), p.front())) {
+				best = &p;
+				bestKind = (Kind)kind;
+			}
+		}
+		if (!best)
+			break;
+		std::pop_heap(best->begin(), best->end(), JobOrder());
+		std::function<void()> job = std::move(best->back().job);
+		best->pop_back();
+		++running;
+		++runningKind[bestKind];
+		pool.start(new Runner(this, bestKind, std::move(job)));
+	}
+}
+
+void ThumbnailScheduler::finished(Kind kind)
+{
+	QMutexLocker l(&lock);
+	--running;
+	--runningKind[kind];
+	dispatch();
+}
+
+void ThumbnailScheduler::add(const void *owner, const QString &filename, Kind kind, Priority priority, std::function<void()> job)
+{
+	QMutexLocker l(&lock);
+	Job j { owner, filename, priority, 0, serial++, std::move(job) };
+	j.effectivePriority = effectivePriority(j);
+	pending[kind].push_back(std::move(j));
+	std::push_heap(pending[kind].begin(), pending[kind].end(), JobOrder());
+	dispatch();
+}
+
+// Remove the pending jobs for which pred returns true. Must be called with the lock held.
+void ThumbnailScheduler::remove(std::function<bool(const Job &)> pred)
+{
+	for (std::vector<Job> &p: pending) {
+		auto it = std::remove_if(p.begin(), p.end(), pred);
+		if (it == p.end())
+			continue;
+		p.erase(it, p.end());
+		std::make_heap(p.begin(), p.end(), JobOrder());
+	}
+}
+
+void ThumbnailScheduler::cancel(const void *owner, const QString &filename)
+{
+	QMutexLocker l(&lock);
+	remove([owner, &filename](const Job &j) { return j.owner == owner && j.filename == filename; });
+}
+
+void ThumbnailScheduler::cancelAll(const void *owner)
+{
+	QMutexLocker l(&lock);
+	remove([owner](const Job &j) { return j.owner == owner; });
+}
+
+void ThumbnailScheduler::setVisible(const QVector<QString> &filenames)
+{
+	QMutexLocker l(&lock);
+	visible.clear();
+	for (const QString &filename: filenames)
+		visible.insert(filename);
+	// The priorities changed, so the heaps have to be rebuilt
+	for (std::vector<Job> &p: pending) {
+		for (Job &j: p)
+			j.effectivePriority = effectivePriority(j);
+		std::make_heap(p.begin(), p.end(), JobOrder());
+	}
+}
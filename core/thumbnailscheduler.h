@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef THUMBNAILSCHEDULER_H
+#define THUMBNAILSCHEDULER_H
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <functional>
+#include <vector>
+
+// Runs the thumbnail jobs (picture decoding and video frame extraction) with a
+// common, bounded number of worker threads. The number of concurrent picture
+// decodes has a separate, lower bound. Instead of running the jobs in the order
+// they were added, jobs for pictures that are currently visible are run first.
+// Pending jobs can be cancelled.
+//
+// Jobs are identified by their owner and the filename of the picture.
+class ThumbnailScheduler {
+public:
+	// Base priorities of jobs. Jobs for visible pictures are run before any other job.
+	enum Priority {
+		PRIORITY_BACKGROUND = 0,	// E.g. forced recalculation
+		PRIORITY_NORMAL = 1
+	};
+
+	enum Kind {
+		JOB_PICTURE,
+		JOB_VIDEO,
+		JOB_KIND_COUNT
+	};
+
+	static ThumbnailScheduler *instance();
+	ThumbnailScheduler(int maxJobs, int maxPictureJobs);
+	~ThumbnailScheduler();
+
+	void add(const void *owner, const QString &filename, Kind kind, Priority priority, std::function<void()> job);
+	void cancel(const void *owner, const QString &filename);
+	void cancelAll(const void *owner);
+
+	// Set the filenames of the pictures that are currently shown.
+	void setVisible(const QVector<QString> &filenames);
+private:
+	struct Job {
+		const void *owner;
+		QString filename;
+		Priority priority;
+		int effectivePriority;		// Raised while the picture is visible
+		unsigned int serial;		// To keep the order of jobs with the same priority
+		std::function<void()> job;
+	};
+	// Orders the heaps of pending jobs, so that the most important job is at the front
+	struct JobOrder {
+		bool operator()(const Job &j1, const Job &j2) const;
+	};
+	class Runner;
+	int effectivePriority(const Job &job) const;
+	int maxRunning(Kind kind) const;
+	void dispatch();
+	void finished(Kind kind);
+	void remove(std::function<bool(const Job &)> pred);
+
+	QMutex lock;
+	QThreadPool pool;
+	int maxJobs;
+	int maxPictureJobs;
+	int running;
+	int runningKind[JOB_KIND_COUNT];
+	unsigned int serial;
+	std::vector<Job> pending[JOB_KIND_COUNT];	// Heaps ordered by JobOrder
+	QSet<QString> visible;
+};
+
+#endif
@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "thumbnailstore.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <cstring>
+#include <vector>
+
+// The index file consists of a header followed by a power-of-two number of slots.
+// Collisions are resolved by linear probing. Since entries are never removed, no
+// tombstones are needed. The table is grown when it becomes half full.
+//
+// The data file is a sequence of records, each consisting of a record header
+// followed by the thumbnail data. The record header repeats the key, so that a
+// stale index (e.g. after a crash during compaction) is detected on lookup.
+// All numbers are in native byte order - this is a local cache, not an exchange format.
+static const char indexMagic[8] = { 'S', 'S', 'R', 'F', 'T', 'H', 'M', 'B' };
+static const quint32 indexVersion = 1;
+static const quint32 initialCapacity = 1024;
+static const qint64 minCompactGarbage = 1024 * 1024;
+
+struct ThumbnailStore::IndexHeader {
+	char magic[8];
+	quint32 version;
+	quint32 capacity;	// Number of slots
+	quint32 count;		// Number of used slots
+	quint32 reserved;
+	qint64 garbage;		// Bytes in the data file not referenced by the index
+};
+
+struct RecordHeader {
+	ThumbnailStore::Key key;
+	quint32 length;
+	quint32 reserved;
+};
+
+bool ThumbnailStore::Key::operator==(const Key &k) const
+{
+	return hash[0] == k.hash[0] && hash[1] == k.hash[1];
+}
+
+static ThumbnailStore::Key keyFromHash(const QByteArray &hash)
+{
+	ThumbnailStore::Key key;
+	memcpy(key.hash, hash.constData(), sizeof(key.hash));
+	return key;
+}
+
+// This is the same hash that was used for the names of the thumbnail files.
+static ThumbnailStore::Key keyOf(const QString &filename)
+{
+	return keyFromHash(QCryptographicHash::hash(filename.toUtf8(), QCryptographicHash::Sha1));
+}
+
+static qint64 indexSize(quint32 capacity)
+{
+	return sizeof(ThumbnailStore::IndexHeader) + (qint64)capacity * sizeof(ThumbnailStore::Slot);
+}
+
+ThumbnailStore::ThumbnailStore(const QString &dirIn) : dir(dirIn),
+	opened(false),
+	indexFile(dirIn + "/thumbnails.idx"),
+	dataFile(dirIn + "/thumbnails.dat"),
+	index(nullptr)
+{
+}
+
+ThumbnailStore::~ThumbnailStore()
+{
+	unmapIndex();
+}
+
+ThumbnailStore::IndexHeader *ThumbnailStore::header()
+{
+	return reinterpret_cast<IndexHeader *>(index);
+}
+
+ThumbnailStore::Slot *ThumbnailStore::slotArray()
+{
+	return reinterpret_cast<Slot *>(index + sizeof(IndexHeader));
+}
+
+bool ThumbnailStore::mapIndex()
+{
+	index = indexFile.map(0, indexFile.size());
+	return index != nullptr;
+}
+
+void ThumbnailStore::unmapIndex()
+{
+	if (index)
+		indexFile.unmap(index);
+	index = nullptr;
+}
+
+// Create an empty index with the given number of slots.
+bool ThumbnailStore::initIndex(quint32 capacity)
+{
+	unmapIndex();
+	if (!indexFile.resize(0) || !indexFile.resize(indexSize(capacity)) || !mapIndex())
+		return false;
+	IndexHeader *h = header();
+	memcpy(h->magic, indexMagic, sizeof(indexMagic));
+	h->version = indexVersion;
+	h->capacity = capacity;
+	h->count = 0;
+	h->reserved = 0;
+	h->garbage = 0;
+	return true;
+}
+
+// Open the store on first access. Returns false if the store is not usable.
+bool ThumbnailStore::open()
+{
+	if (opened)
+		return index != nullptr;
+	opened = true;
+
+	QDir().mkpath(dir);
+	if (!dataFile.open(QIODevice::ReadWrite) || !indexFile.open(QIODevice::ReadWrite)) {
+		qWarning() << "Cannot open thumbnail store in" << dir;
+		return false;
+	}
+
+	if (indexFile.size() >= (qint64)sizeof(IndexHeader) && mapIndex()) {
+		const IndexHeader *h = header();
+		if (memcmp(h->magic, indexMagic, sizeof(indexMagic)) == 0 && h->version == indexVersion &&
+		    h->capacity > 0 && (h->capacity & (h->capacity - 1)) == 0 &&
+		    indexFile.size() == indexSize(h->capacity))
+			return true;
+	}
+
+	// No index or incompatible index: start from scratch
+	if (!dataFile.resize(0) || !initIndex(initialCapacity)) {
+		qWarning() << "Cannot create thumbnail store in" << dir;
+		unmapIndex();
+		return false;
+	}
+	importLegacyThumbnails();
+	return true;
+}
+
+// Returns either the slot with the given key or the empty slot where it should be inserted.
+ThumbnailStore::Slot *ThumbnailStore::findSlot(const Key &key)
+{
+	quint32 mask = header()->capacity - 1;
+	Slot *table = slotArray();
+	for (quint32 i = key.hash[0] & mask; ; i = (i + 1) & mask) {
+		if (!table[i].used || table[i].key == key)
+			return &table[i];
+	}
+}
+
+bool ThumbnailStore::grow()
+{
+	quint32 capacity = header()->capacity;
+	qint64 garbage = header()->garbage;
+	std::vector<Slot> old(slotArray(), slotArray() + capacity);
+
+	if (!initIndex(capacity * 2))
+		return false;
+	header()->garbage = garbage;
+	for (const Slot &slot: old) {
+		if (!slot.used)
+			continue;
+		*findSlot(slot.key) = slot;
+		++header()->count;
+	}
+	return true;
+}
+
+ThumbnailStore::Entry ThumbnailStore::get(const QString &filename)
+{
+	QMutexLocker l(&lock);
+	if (filename.isEmpty() || !open())
+		return { QByteArray(), 0 };
+
+	Key key = keyOf(filename);
+	const Slot *slot = findSlot(key);
+	if (!slot->used || slot->offset + (qint64)sizeof(RecordHeader) + slot->length > dataFile.size())
+		return { QByteArray(), 0 };
+
+	RecordHeader record;
+	if (!dataFile.seek(slot->offset) ||
+	    dataFile.read(reinterpret_cast<char *>(&record), sizeof(record)) != sizeof(record) ||
+	    !(record.key == key) || record.length != slot->length)
+		return { QByteArray(), 0 };
+	QByteArray data = dataFile.read(slot->length);
+	if (data.size() != (int)slot->length)
+		return { QByteArray(), 0 };
+	return { data, slot->time };
+}
+
+bool ThumbnailStore::putLocked(const Key &key, qint64 time, const QByteArray &data)
+{
+	if ((header()->count + 1) * 2 > header()->capacity && !grow())
+		return false;
+
+	// Append the record to the data file
+	RecordHeader record;
+	record.key = key;
+	record.length = data.size();
+	record.reserved = 0;
+	qint64 offset = dataFile.size();
+	if (!dataFile.seek(offset) ||
+	    dataFile.write(reinterpret_cast<const char *>(&record), sizeof(record)) != sizeof(record) ||
+	    dataFile.write(data) != data.size() ||
+	    !dataFile.flush())
+		return false;
+
+	// And only then point the index to it
+	Slot *slot = findSlot(key);
+	if (slot->used) {
+		header()->garbage += sizeof(RecordHeader) + slot->length;
+	} else {
+		slot->key = key;
+		++header()->count;
+	}
+	slot->time = time;
+	slot->offset = offset;
+	slot->length = data.size();
+	slot->used = 1;
+	return true;
+}
+
+void ThumbnailStore::put(const QString &filename, qint64 time, const QByteArray &data)
+{
+	QMutexLocker l(&lock);
+	if (filename.isEmpty() || !open())
+		return;
+	if (!putLocked(keyOf(filename), time, data))
+		return;
+	if (header()->garbage >= minCompactGarbage && header()->garbage * 2 > dataFile.size())
+		doCompact();
+}
+
+void ThumbnailStore::compact()
+{
+	QMutexLocker l(&lock);
+	if (open() && header()->garbage > 0)
+		doCompact();
+}
+
+// Rewrite the data file with only the referenced records. The new data file
+// replaces the old one atomically, then the offsets in the index are updated.
+// Should we crash in between, the keys in the record headers won't match and the
+// affected thumbnails will simply be recalculated.
+void ThumbnailStore::doCompact()
+{
+	QSaveFile newData(dataFile.fileName());
+	if (!newData.open(QIODevice::WriteOnly))
+		return;
+
+	Slot *table = slotArray();
+	quint32 capacity = header()->capacity;
+	std::vector<qint64> newOffsets(capacity, -1);
+	qint64 offset = 0;
+	for (quint32 i = 0; i < capacity; ++i) {
+		if (!table[i].used)
+			continue;
+		qint64 size = sizeof(RecordHeader) + table[i].length;
+		if (!dataFile.seek(table[i].offset))
+			return;
+		QByteArray record = dataFile.read(size);
+		if (record.size() != size || newData.write(record) != size)
+			return;
+		newOffsets[i] = offset;
+		offset += size;
+	}
+
+	dataFile.close();
+	bool ok = newData.commit();
+	if (!dataFile.open(QIODevice::ReadWrite)) {
+		qWarning() << "Cannot reopen thumbnail store data file" << dataFile.fileName();
+		unmapIndex();
+		return;
+	}
+	if (!ok)
+		return;
+	for (quint32 i = 0; i < capacity; ++i) {
+		if (table[i].used)
+			table[i].offset = newOffsets[i];
+	}
+	header()->garbage = 0;
+}
+
+// Thumbnails used to be stored in one file per picture, named after the hex
+// representation of the SHA1 of the picture filename. Move them into the store.
+void ThumbnailStore::importLegacyThumbnails()
+{
+	QDir thumbnailDir(dir);
+	const QStringList files = thumbnailDir.entryList(QDir::Files);
+	for (const QString &name: files) {
+		if (name.size() != 40)
+			continue;
+		QByteArray hash = QByteArray::fromHex(name.toLatin1());
+		if (hash.size() != 20)
+			continue;
+		QFile file(thumbnailDir.filePath(name));
+		if (!file.open(QIODevice::ReadOnly))
+			continue;
+		QByteArray data = file.readAll();
+		qint64 time = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+		file.close();
+		if (!data.isEmpty() && !putLocked(keyFromHash(hash), time, data))
+			break;
+		file.remove();
+	}
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+
+// A packed store for thumbnails. Instead of one file per picture, the thumbnails
+// are appended to a single data file. They are found via a hash table, which is
+// kept in a memory-mapped index file and keyed by the hash of the picture filename.
+// Thus, looking up a thumbnail costs one seek and one read instead of opening,
+// stat()ing and reading a file.
+//
+// Each entry also stores the time the thumbnail was created, so that outdated
+// thumbnails can be detected without touching the data file.
+//
+// Replaced thumbnails leave unreferenced data in the data file. Once that makes
+// up more than half of the file, the data file is compacted.
+//
+// The thumbnails are stored as opaque blobs. All functions are thread safe.
+class ThumbnailStore {
+public:
+	ThumbnailStore(const QString &dir);
+	~ThumbnailStore();
+
+	struct Entry {
+		QByteArray data;	// Empty if no thumbnail was found
+		qint64 time;		// Creation time of the thumbnail in ms since epoch
+	};
+	Entry get(const QString &filename);
+	void put(const QString &filename, qint64 time, const QByteArray &data);
+	void compact();
+
+	// The on-disk format. Public so that they can be used in helper functions.
+	struct Key {
+		quint64 hash[2];	// First 16 bytes of the SHA1 of the filename
+		bool operator==(const Key &k) const;
+	};
+	struct Slot {
+		Key key;
+		qint64 time;
+		qint64 offset;		// Offset of the record in the data file
+		quint32 length;		// Length of the thumbnail data
+		quint32 used;
+	};
+	struct IndexHeader;
+private:
+	bool open();
+	bool initIndex(quint32 capacity);
+	bool mapIndex();
+	void unmapIndex();
+	bool grow();
+	void doCompact();
+	Slot *findSlot(const Key &key);
+	bool putLocked(const Key &key, qint64 time, const QByteArray &data);
+	void importLegacyThumbnails();
+	IndexHeader *header();
+	Slot *slotArray();
+
+	QMutex lock;
+	QString dir;
+	bool opened;
+	QFile indexFile;
+	QFile dataFile;
+	uchar *index;
+};
+
+#endif
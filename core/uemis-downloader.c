@@ -24,6 +24,7 @@
 #include "gettext.h"
 #include "libdivecomputer.h"
 #include "uemis.h"
+#include "diveindex.h"
 #include "divelist.h"
 #include "divelog.h"
 #include "divesite.h"
@@ -82,6 +83,7 @@ static int mbuf_size = 0;
 static int max_mem_used = -1;
 static int next_table_index = 0;
 static int dive_to_read = 0;
+static struct dive_index *downloaded_dives = NULL;	/* the dives in the download table */
 static uint32_t mindiveid;
 
 /* Linked list to remember already executed divespot download requests */
@@ -210,13 +212,15 @@ static struct dive *uemis_start_dive(uint32_t deviceid)
 	return dive;
 }
 
-static struct dive *get_dive_by_uemis_diveid(device_data_t *devdata, uint32_t object_id)
+static struct dive *get_dive_by_uemis_diveid(uint32_t deviceid, uint32_t object_id)
 {
-	for (int i = 0; i < devdata->log->dives->nr; i++) {
-		if (object_id == devdata->log->dives->dives[i]->dc.diveid)
-			return devdata->log->dives->dives[i];
-	}
-	return NULL;
+	return dive_index_find_id(downloaded_dives, deviceid, object_id);
+}
+
+static void record_uemis_dive(device_data_t *devdata, struct dive *dive)
+{
+	record_dive_to_table(dive, devdata->log->dives);
+	dive_index_add(downloaded_dives, dive);
 }
 
 /* send text to the importer progress bar */
@@ -989,9 +993,14 @@ static bool process_raw_buffer(device_data_t *devdata, uint32_t deviceid, char *
 #endif
 		} else if (is_dive && strcmp(tag, "logfilenr") == 0) {
 			/* this one tells us which dive we are adding data to */
-			dive = get_dive_by_uemis_diveid(devdata, atoi(val));
-			if (strcmp(dive_no, "0"))
+			dive = get_dive_by_uemis_diveid(deviceid, atoi(val));
+			/* the details of a dive whose log wasn't downloaded are ignored */
+			if (dive && strcmp(dive_no, "0"))
 				dive->number = atoi(dive_no);
+#if UEMIS_DEBUG & 2
+			if (!dive)
+				fprintf(debugfile, "No dive log for dive details with logfilenr %d\n", atoi(val));
+#endif
 			if (for_dive)
 				*for_dive = atoi(val);
 		} else if (!is_log && dive && !strcmp(tag, "divespot_id")) {
@@ -1016,13 +1025,13 @@ static bool process_raw_buffer(device_data_t *devdata, uint32_t deviceid, char *
 		 * be a short read because of some error */
 		if (done && ++bp < endptr && *bp != '{' && strstr(bp, "{{")) {
 			done = false;
-			record_dive_to_table(dive, devdata->log->dives);
+			record_uemis_dive(devdata, dive);
 			dive = uemis_start_dive(deviceid);
 		}
 	}
 	if (is_log) {
 		if (dive->dc.diveid) {
-			record_dive_to_table(dive, devdata->log->dives);
+			record_uemis_dive(devdata, dive);
 		} else { /* partial dive */
 			free_dive(dive);
 			free(buf);
@@ -1214,7 +1223,7 @@ static void get_uemis_divespot(device_data_t *devdata, const char *mountpath, in
 	}
 }
 
-static bool get_matching_dive(int idx, char *newmax, int *uemis_mem_status, device_data_t *data, const char *mountpath, const char deviceidnr)
+static bool get_matching_dive(int idx, char *newmax, int *uemis_mem_status, device_data_t *data, const char *mountpath, uint32_t deviceidnr)
 {
 	struct dive *dive = data->log->dives->dives[idx];
 	char log_file_no_to_find[20];
@@ -1344,6 +1353,7 @@ const char *do_uemis_import(device_data_t *data)
 		free(reqtxt_path);
 		return translate("gettextFromC", "Uemis init failed");
 	}
+	downloaded_dives = dive_index_create(data->log->dives);
 
 	if (!uemis_get_answer(mountpath, "getDeviceId", 0, 1, &result))
 		goto bail;
@@ -1531,6 +1541,8 @@ bail:
 	}
 	free(deviceid);
 	free(reqtxt_path);
+	dive_index_free(downloaded_dives);
+	downloaded_dives = NULL;
 	if (!data->log->dives->nr)
 		result = translate("gettextFromC", ERR_NO_FILES);
 	return result;
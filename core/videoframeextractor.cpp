@@ -3,8 +3,8 @@
 #include "imagedownloader.h"
 #include "core/pref.h"
 #include "core/errorhelper.h"
+#include "core/thumbnailscheduler.h"
 
-#include <QtConcurrent>
 #include <QProcess>
 
 // Note: this is a global instead of a function-local variable on purpose.
@@ -18,9 +18,6 @@ VideoFrameExtractor *VideoFrameExtractor::instance()
 
 VideoFrameExtractor::VideoFrameExtractor()
 {
-	// Currently, we only process one video at a time.
-	// Eventually, we might want to increase this value.
-	pool.setMaxThreadCount(1);
 }
 
 void VideoFrameExtractor::extract(QString originalFilename, QString filename, duration_t duration)
@@ -28,8 +25,10 @@ void VideoFrameExtractor::extract(QString originalFilename, QString filename, du
 	QMutexLocker l(&lock);
 	if (!workingOn.contains(originalFilename)) {
 		// We are not currently extracting this video - add it to the list.
-		workingOn.insert(originalFilename, QtConcurrent::run(&pool, [this, originalFilename, filename, duration]()
-				 { processItem(originalFilename, filename, duration); }));
+		workingOn.insert(originalFilename);
+		ThumbnailScheduler::instance()->add(this, originalFilename, ThumbnailScheduler::JOB_VIDEO, ThumbnailScheduler::PRIORITY_NORMAL,
+						    [this, originalFilename, filename, duration]()
+						    { processItem(originalFilename, filename, duration); });
 	}
 }
 
@@ -46,8 +45,7 @@ void VideoFrameExtractor::fail(const QString &originalFilename, duration_t durat
 void VideoFrameExtractor::clearWorkQueue()
 {
 	QMutexLocker l(&lock);
-	for (auto it = workingOn.begin(); it != workingOn.end(); ++it)
-		it->cancel();
+	ThumbnailScheduler::instance()->cancelAll(this);
 	workingOn.clear();
 }
 
@@ -5,9 +5,9 @@
 #include "core/units.h"
 
 #include <QMutex>
-#include <QFuture>
-#include <QThreadPool>
+#include <QObject>
 #include <QQueue>
+#include <QSet>
 #include <QString>
 #include <QPair>
 
@@ -30,8 +30,7 @@ private:
 	void processItem(QString originalFilename, QString filename, duration_t duration);
 	void fail(const QString &originalFilename, duration_t duration, bool isInvalid);
 	mutable QMutex lock;
-	QThreadPool pool;
-	QMap<QString, QFuture<void>> workingOn;
+	QSet<QString> workingOn;
 };
 
 #endif
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Print tables of dive plans for grids of depths, bottom times, gases and gradient factors */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QStringList>
+
+#include "core/decotable.h"
+#include "core/membuffer.h"
+#include "core/planner.h"
+#include "core/pref.h"
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+#define SKIP_EMPTY Qt::SkipEmptyParts
+#else
+#define SKIP_EMPTY QString::SkipEmptyParts
+#endif
+
+static std::vector<int> parseList(const QStringList &values, double factor, bool &ok)
+{
+	std::vector<int> res;
+	for (const QString &value: values) {
+		for (const QString &item: value.split(',', SKIP_EMPTY)) {
+			double v = item.toDouble(&ok);
+			if (!ok || v <= 0.0)
+				return {};
+			res.push_back(lrint(v * factor));
+		}
+	}
+	ok = !res.empty();
+	return res;
+}
+
+// A gas set is given as bottom gas followed by the deco gases, separated by '+', e.g. "21/35+ean50+oxygen"
+static bool parseGases(const QString &value, deco_table_gases &gases)
+{
+	QStringList mixes = value.split('+', SKIP_EMPTY);
+	if (mixes.isEmpty() || mixes.size() > MAX_DECO_TABLE_GASES + 1)
+		return false;
+	gases.nr_deco = 0;
+	for (int i = 0; i < mixes.size(); i++) {
+		gasmix *mix = i == 0 ? &gases.bottom : &gases.deco[gases.nr_deco++];
+		if (!validate_gas(qPrintable(mixes[i]), mix))
+			return false;
+	}
+	return true;
+}
+
+// Gradient factors are given as low/high, e.g. "30/70"
+static bool parseGF(const QString &value, deco_table_setting &setting)
+{
+	QStringList gf = value.split('/');
+	bool ok1, ok2;
+	if (gf.size() != 2)
+		return false;
+	setting.gflow = gf[0].toInt(&ok1);
+	setting.gfhigh = gf[1].toInt(&ok2);
+	setting.vpmb_conservatism = 0;
+	return ok1 && ok2 && setting.gflow > 0 && setting.gflow <= setting.gfhigh && setting.gfhigh <= 150;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication application(argc, argv);
+	copy_prefs(&default_prefs, &prefs);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	QCommandLineOption depthOption(QStringList() << "d" << "depth",
+				       "Bottom depths in m, comma separated", "depths");
+	parser.addOption(depthOption);
+	QCommandLineOption timeOption(QStringList() << "t" << "time",
+				      "Bottom times in min including the descent, comma separated", "times");
+	parser.addOption(timeOption);
+	QCommandLineOption gasOption(QStringList() << "g" << "gas",
+				     "Bottom gas and deco gases, e.g. 21/35+ean50+oxygen. Can be given more than once", "gases");
+	parser.addOption(gasOption);
+	QCommandLineOption gfOption(QStringList() << "gf",
+				    "Gradient factors, e.g. 30/70. Can be given more than once", "gflow/gfhigh");
+	parser.addOption(gfOption);
+	QCommandLineOption vpmbOption(QStringList() << "vpmb",
+				      "Use VPM-B with the given conservatism (0-4). Can be given more than once", "conservatism");
+	parser.addOption(vpmbOption);
+	QCommandLineOption formatOption(QStringList() << "f" << "format",
+					"Output format: csv (default) or json", "format", "csv");
+	parser.addOption(formatOption);
+	QCommandLineOption outputOption(QStringList() << "o" << "output",
+					"Write the table to <file> instead of standard output", "file");
+	parser.addOption(outputOption);
+
+	parser.process(application);
+
+	bool ok;
+	std::vector<int> depths = parseList(parser.values(depthOption), 1000.0, ok);
+	if (!ok) {
+		fprintf(stderr, "need --depth\n");
+		exit(1);
+	}
+	std::vector<int> times = parseList(parser.values(timeOption), 60.0, ok);
+	if (!ok) {
+		fprintf(stderr, "need --time\n");
+		exit(1);
+	}
+
+	std::vector<deco_table_gases> gases;
+	for (const QString &value: parser.values(gasOption)) {
+		deco_table_gases g;
+		if (!parseGases(value, g)) {
+			fprintf(stderr, "invalid gases %s\n", qPrintable(value));
+			exit(1);
+		}
+		gases.push_back(g);
+	}
+	if (gases.empty()) {
+		fprintf(stderr, "need --gas\n");
+		exit(1);
+	}
+
+	std::vector<deco_table_setting> settings;
+	if (parser.isSet(vpmbOption)) {
+		if (parser.isSet(gfOption)) {
+			fprintf(stderr, "--gf and --vpmb are mutually exclusive\n");
+			exit(1);
+		}
+		prefs.planner_deco_mode = VPMB;
+		for (const QString &value: parser.values(vpmbOption)) {
+			deco_table_setting setting = { 0, 0, (short)value.toInt(&ok) };
+			if (!ok || setting.vpmb_conservatism < 0 || setting.vpmb_conservatism > 4) {
+				fprintf(stderr, "invalid conservatism %s\n", qPrintable(value));
+				exit(1);
+			}
+			settings.push_back(setting);
+		}
+	} else {
+		prefs.planner_deco_mode = BUEHLMANN;
+		for (const QString &value: parser.values(gfOption)) {
+			deco_table_setting setting;
+			if (!parseGF(value, setting)) {
+				fprintf(stderr, "invalid gradient factors %s\n", qPrintable(value));
+				exit(1);
+			}
+			settings.push_back(setting);
+		}
+		if (settings.empty())
+			settings.push_back({ prefs.gflow, prefs.gfhigh, 0 });
+	}
+
+	QString format = parser.value(formatOption);
+	if (format != "csv" && format != "json") {
+		fprintf(stderr, "unknown format %s\n", qPrintable(format));
+		exit(1);
+	}
+
+	deco_table_request request = {
+		(int)depths.size(), depths.data(),
+		(int)times.size(), times.data(),
+		(int)gases.size(), gases.data(),
+		(int)settings.size(), settings.data()
+	};
+	deco_table table;
+	calculate_deco_table(&request, &table);
+
+	membufferpp b;
+	if (format == "json")
+		save_deco_table_json(&b, &table);
+	else
+		save_deco_table_csv(&b, &table);
+	free_deco_table(&table);
+
+	FILE *f = stdout;
+	QString output = parser.value(outputOption);
+	if (!output.isEmpty() && !(f = fopen(qPrintable(output), "w"))) {
+		fprintf(stderr, "can't write %s\n", qPrintable(output));
+		exit(1);
+	}
+	flush_buffer(&b, f);
+	if (f != stdout)
+		fclose(f);
+	exit(0);
+}
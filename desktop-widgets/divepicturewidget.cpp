@@ -6,9 +6,62 @@
 #include <QMimeData>
 #include <QMouseEvent>
 #include <QPixmap>
+#include <QScrollBar>
 
 DivePictureWidget::DivePictureWidget(QWidget *parent) : QListView(parent)
 {
+	// Don't recalculate the visible items on every scroll step
+	visibleRowsTimer.setSingleShot(true);
+	visibleRowsTimer.setInterval(50);
+	connect(&visibleRowsTimer, &QTimer::timeout, this, &DivePictureWidget::updateVisibleRows);
+	connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &DivePictureWidget::scheduleVisibleRowsUpdate);
+	connect(horizontalScrollBar(), &QScrollBar::valueChanged, this, &DivePictureWidget::scheduleVisibleRowsUpdate);
+}
+
+void DivePictureWidget::setModel(QAbstractItemModel *newModel)
+{
+	QListView::setModel(newModel);
+	if (!newModel)
+		return;
+	connect(newModel, &QAbstractItemModel::modelReset, this, &DivePictureWidget::scheduleVisibleRowsUpdate);
+	connect(newModel, &QAbstractItemModel::layoutChanged, this, &DivePictureWidget::scheduleVisibleRowsUpdate);
+	connect(newModel, &QAbstractItemModel::rowsInserted, this, &DivePictureWidget::scheduleVisibleRowsUpdate);
+	connect(newModel, &QAbstractItemModel::rowsRemoved, this, &DivePictureWidget::scheduleVisibleRowsUpdate);
+	scheduleVisibleRowsUpdate();
+}
+
+void DivePictureWidget::scheduleVisibleRowsUpdate()
+{
+	visibleRowsTimer.start();
+}
+
+void DivePictureWidget::updateVisibleRows()
+{
+	int first = 0, last = -1;
+	if (model() && isVisible()) {
+		QRect viewportRect = viewport()->rect();
+		int rows = model()->rowCount();
+		for (int i = 0; i < rows; ++i) {
+			if (!visualRect(model()->index(i, 0)).intersects(viewportRect))
+				continue;
+			if (last < first)
+				first = i;
+			last = i;
+		}
+	}
+	emit visibleRowsChanged(first, last);
+}
+
+void DivePictureWidget::resizeEvent(QResizeEvent *event)
+{
+	QListView::resizeEvent(event);
+	scheduleVisibleRowsUpdate();
+}
+
+void DivePictureWidget::showEvent(QShowEvent *event)
+{
+	QListView::showEvent(event);
+	scheduleVisibleRowsUpdate();
 }
 
 void DivePictureWidget::mouseDoubleClickEvent(QMouseEvent *event)
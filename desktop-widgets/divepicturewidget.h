@@ -3,19 +3,30 @@
 #define DIVEPICTUREWIDGET_H
 
 #include <QListView>
+#include <QTimer>
 
 class DivePictureWidget : public QListView {
 	Q_OBJECT
 public:
 	DivePictureWidget(QWidget *parent);
+	void setModel(QAbstractItemModel *model) override;
 protected:
 	void mouseDoubleClickEvent(QMouseEvent *event) override;
 	void mousePressEvent(QMouseEvent *event) override;
 	void wheelEvent(QWheelEvent *event) override;
+	void resizeEvent(QResizeEvent *event) override;
+	void showEvent(QShowEvent *event) override;
 
 signals:
 	void photoDoubleClicked(const QString filePath);
 	void zoomLevelChanged(int delta);
+	// Range of rows that are currently shown. first > last if no row is shown.
+	void visibleRowsChanged(int first, int last);
+private slots:
+	void updateVisibleRows();
+private:
+	void scheduleVisibleRowsUpdate();
+	QTimer visibleRowsTimer;
 };
 
 #endif
@@ -25,6 +25,7 @@
 #include "core/file.h"
 #include "core/gettextfromc.h"
 #include "core/git-access.h"
+#include "core/gitsync.h"
 #include "core/import-csv.h"
 #include "core/planner.h"
 #include "core/qthelper.h"
@@ -186,6 +187,8 @@ MainWindow::MainWindow() :
 	connect(DivePlannerPointsModel::instance(), SIGNAL(planCreated()), this, SLOT(planCreated()));
 	connect(DivePlannerPointsModel::instance(), SIGNAL(planCanceled()), this, SLOT(planCanceled()));
 	connect(this, &MainWindow::showError, ui.mainErrorMessage, &NotificationWidget::showError, Qt::AutoConnection);
+	connect(GitSync::instance(), &GitSync::progress, this, &MainWindow::cloudSyncProgress);
+	connect(GitSync::instance(), &GitSync::finished, this, &MainWindow::cloudSyncFinished);
 
 	connect(&windowTitleUpdate, &WindowTitleUpdate::updateTitle, this, &MainWindow::setAutomaticTitle);
 	connect(&diveListNotifier, &DiveListNotifier::numShownChanged, this, &MainWindow::setAutomaticTitle);
@@ -446,7 +449,7 @@ void MainWindow::on_actionCloudstoragesave_triggered()
 	mainTab->stealFocus(); // Make sure that any currently edited field is updated before saving.
 
 	showProgressBar();
-	int error = save_dives(qPrintable(filename));
+	int error = saveAndSync(qPrintable(filename));
 	hideProgressBar();
 	if (error)
 		return;
@@ -507,6 +510,9 @@ bool MainWindow::okToClose(QString message)
 
 void MainWindow::closeCurrentFile()
 {
+	/* the results of a sync of the file in the background are not needed anymore */
+	syncedFilename.clear();
+
 	/* free the dives and trips */
 	clear_git_id();
 	clear_dive_file_data(); // this clears all the core data structures and resets the models
@@ -602,6 +608,7 @@ void MainWindow::on_actionQuit_triggered()
 		return;
 
 	writeSettings();
+	finishCloudSync();
 	QApplication::quit();
 }
 
@@ -1056,6 +1063,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 	}
 	event->accept();
 	writeSettings();
+	finishCloudSync();
 	QApplication::closeAllWindows();
 }
 
@@ -1222,7 +1230,7 @@ int MainWindow::file_save(void)
 	}
 	if (is_cloud)
 		showProgressBar();
-	if (save_dives(existing_filename)) {
+	if (saveAndSync(existing_filename)) {
 		if (is_cloud)
 			hideProgressBar();
 		return -1;
@@ -1234,6 +1242,68 @@ int MainWindow::file_save(void)
 	return 0;
 }
 
+// Remote git repositories are only committed to the local cache here, so that
+// the save returns right away. The sync with the remote runs in the background.
+int MainWindow::saveAndSync(const char *filename)
+{
+	int error = save_dives_local(filename);
+	if (error || git_local_only)
+		return error;
+	syncedFilename = filename;
+	GitSync::instance()->sync(syncedFilename);
+	return 0;
+}
+
+// Don't quit before the last save is in the cloud. Since that may take a while on a slow
+// connection, the user can cancel the upload. The save was committed to the local cache,
+// so that the changes are pushed when the cloud storage is loaded the next time.
+void MainWindow::finishCloudSync()
+{
+	GitSync *sync = GitSync::instance();
+	QProgressDialog dialog(tr("Uploading the last changes to cloud storage..."), tr("Cancel"), 0, 0, this);
+	dialog.setWindowModality(Qt::WindowModal);
+	connect(sync, &GitSync::allFinished, &dialog, &QProgressDialog::reset);
+	if (!sync->busy())
+		return;
+	dialog.exec();
+	if (dialog.wasCanceled()) {
+		sync->cancel();
+		qDebug() << "Upload to cloud storage canceled, keeping the changes in the local cache";
+	}
+}
+
+void MainWindow::cloudSyncProgress(int stage, unsigned int objects, unsigned int totalObjects, qulonglong)
+{
+	QString text = stage == GIT_SYNC_FETCH ? tr("Fetching from remote storage") :
+		       stage == GIT_SYNC_MERGE ? tr("Merging with remote storage") :
+						 tr("Pushing to remote storage");
+	if (totalObjects)
+		text += QStringLiteral(" (%1/%2)").arg(objects).arg(totalObjects);
+	statusBar()->showMessage(text);
+}
+
+void MainWindow::cloudSyncFinished(int error, bool canceled, const QString &sha)
+{
+	statusBar()->clearMessage();
+	if (error || canceled || GitSync::instance()->pending() || syncedFilename.isEmpty() ||
+	    !same_string(qPrintable(syncedFilename), existing_filename))
+		return;
+
+	// The sync merged in newer data from the remote. Show it, unless that would throw away changes.
+	if (sha.isEmpty() || same_string(qPrintable(sha), saved_git_id) || !Command::isClean())
+		return;
+	QByteArray filename = QFile::encodeName(syncedFilename);
+	bool glo = git_local_only;
+	git_local_only = true;
+	closeCurrentFile();
+	if (!parse_file(filename.constData(), &divelog))
+		setCurrentFile(filename.constData());
+	git_local_only = glo;
+	process_loaded_dives();
+	refreshDisplay();
+	updateAutogroup();
+}
+
 NotificationWidget *MainWindow::getNotificationWidget()
 {
 	return ui.mainErrorMessage;
@@ -143,6 +143,8 @@ slots:
 	void setDefaultState();
 	void setAutomaticTitle();
 	void cancelCloudStorageOperation();
+	void cloudSyncProgress(int stage, unsigned int objects, unsigned int totalObjects, qulonglong bytes);
+	void cloudSyncFinished(int error, bool canceled, const QString &sha);
 
 protected:
 	void closeEvent(QCloseEvent *);
@@ -191,10 +193,13 @@ private:
 	void showProfile();
 	int file_save();
 	int file_save_as();
+	int saveAndSync(const char *filename);
+	void finishCloudSync();
 	void saveSplitterSizes();
 	void restoreSplitterSizes();
 	void updateLastUsedDir(const QString &s);
 	bool filesAsArguments;
+	QString syncedFilename;
 	UpdateManager *updateManager;
 	std::unique_ptr<LocationInformationWidget> diveSiteEdit;
 
@@ -27,6 +27,7 @@ void PreferencesCloud::refreshSettings()
 	ui->cloud_storage_email->setText(prefs.cloud_storage_email);
 	ui->cloud_storage_password->setText(prefs.cloud_storage_password);
 	ui->save_password_local->setChecked(prefs.save_password_local);
+	ui->cloud_shallow_clone->setChecked(prefs.cloud_shallow_clone);
 	updateCloudAuthenticationState();
 }
 
@@ -96,6 +97,7 @@ void PreferencesCloud::syncSettings()
 	}
 	cloud->set_cloud_storage_email(email);
 	cloud->set_save_password_local(ui->save_password_local->isChecked());
+	cloud->set_cloud_shallow_clone(ui->cloud_shallow_clone->isChecked());
 	cloud->set_cloud_storage_password(password);
 	cloud->set_cloud_verification_status(prefs.cloud_verification_status);
 	cloud->set_cloud_base_url(prefs.cloud_base_url);
@@ -38,6 +38,8 @@ TabDivePhotos::TabDivePhotos(MainTab *parent)
 	);
 	connect(ui->photosView, &DivePictureWidget::zoomLevelChanged,
 		this, &TabDivePhotos::changeZoomLevel);
+	connect(ui->photosView, &DivePictureWidget::visibleRowsChanged,
+		DivePictureModel::instance(), &DivePictureModel::setVisibleRows);
 	connect(ui->zoomSlider, &QAbstractSlider::valueChanged,
 		DivePictureModel::instance(), &DivePictureModel::setZoomLevel);
 }
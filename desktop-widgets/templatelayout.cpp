@@ -10,6 +10,7 @@
 #include "printoptions.h"
 #include "core/divelist.h"
 #include "core/selection.h"
+#include "core/statisticscache.h"
 #include "core/qthelper.h"
 #include "core/string-format.h"
 
@@ -123,7 +124,7 @@ QString TemplateLayout::generateStatistics()
 
 	int i = 0;
 	stats_summary_auto_free stats;
-	calculate_stats_summary(&stats, false);
+	StatisticsCache::instance()->summary(&stats);
 	while (stats.stats_yearly != NULL && stats.stats_yearly[i].period) {
 		state.years.append(&stats.stats_yearly[i]);
 		i++;
@@ -42,10 +42,25 @@ Item {
 		property var clickCoord: QtPositioning.coordinate(0, 0)
 		property bool isReady: false
 
-		Component.onCompleted: isReady = true
+		Component.onCompleted: {
+			isReady = true
+			viewportTimer.restart()
+		}
 		onZoomLevelChanged: {
-			if (isReady)
+			if (isReady) {
 				mapHelper.calculateSmallCircleRadius(map.center)
+				viewportTimer.restart()
+			}
+		}
+		onCenterChanged: if (isReady) viewportTimer.restart()
+		onWidthChanged: if (isReady) viewportTimer.restart()
+		onHeightChanged: if (isReady) viewportTimer.restart()
+
+		// The markers are updated once the map stopped moving
+		Timer {
+			id: viewportTimer
+			interval: 100
+			onTriggered: mapHelper.updateViewport()
 		}
 
 		MapItemView {
@@ -53,13 +68,36 @@ Item {
 			model: mapHelper.model
 			delegate: MapQuickItem {
 				id: mapItem
-				anchorPoint.x: 0
-				anchorPoint.y: mapItemImage.height
+				// Clusters of dive sites are drawn as circles centered on the mean position
+				readonly property bool isCluster: model.count > 1
+				anchorPoint.x: isCluster ? mapItemCluster.width * 0.5 : 0
+				anchorPoint.y: isCluster ? mapItemCluster.height * 0.5 : mapItemImage.height
 				coordinate:  model.coordinate
 				z: model.z
 				sourceItem: Image {
 					id: mapItemImage
-					source: model.pixmap
+					source: mapItem.isCluster ? "" : model.pixmap
+					Rectangle {
+						id: mapItemCluster
+						visible: mapItem.isCluster
+						width: Math.max(mapItemClusterText.width + 12, 30)
+						height: width
+						radius: width * 0.5
+						color: "#b08000"
+						border.color: "white"
+						border.width: 2
+						Text {
+							id: mapItemClusterText
+							anchors.centerIn: parent
+							text: model.count
+							font.pointSize: 10.0
+							color: "white"
+						}
+						MouseArea {
+							anchors.fill: parent
+							onClicked: map.doubleClickHandler(mapItem.coordinate)
+						}
+					}
 					SequentialAnimation {
 						id: mapItemImageAnimation
 						PropertyAnimation { target: mapItemImage; property: "scale"; from: 1.0; to: 0.7; duration: 120 }
@@ -82,7 +120,7 @@ Item {
 					Item {
 						// Text with a duplicate for shadow. DropShadow as layer effect is kind of slow here.
 						y: mapItemImage.y + mapItemImage.height
-						visible: map.zoomLevel >= map.textVisibleZoom
+						visible: !mapItem.isCluster && map.zoomLevel >= map.textVisibleZoom
 						Text {
 							id: mapItemTextShadow
 							x: mapItemText.x + 2; y: mapItemText.y + 2
@@ -2,9 +2,12 @@
 #include <QApplication>
 #include <QClipboard>
 #include <QDebug>
+#include <QSet>
 #include <QVector>
+#include <cmath>
 
 #include "qmlmapwidgethelper.h"
+#include "core/divelog.h"
 #include "core/divesite.h"
 #include "core/qthelper.h"
 #include "core/divefilter.h"
@@ -22,7 +25,10 @@ MapWidgetHelper::MapWidgetHelper(QObject *parent) : QObject(parent)
 	m_smallCircleRadius = SMALL_CIRCLE_RADIUS_PX;
 	m_map = nullptr;
 	m_editMode = false;
+	m_siteIndexValid = false;
 	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &MapWidgetHelper::diveSiteChanged);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteAdded, this, &MapWidgetHelper::invalidateSiteIndex);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteDeleted, this, &MapWidgetHelper::invalidateSiteIndex);
 }
 
 QGeoCoordinate MapWidgetHelper::getCoordinates(struct dive_site *ds)
@@ -117,7 +123,64 @@ void MapWidgetHelper::updateEditMode()
 void MapWidgetHelper::reloadMapLocations()
 {
 	updateEditMode();
-	m_mapLocationModel->reload(m_map);
+	invalidateSiteIndex();
+	m_mapLocationModel->update(m_map);
+	updateViewport();
+}
+
+// Pass the shown part of the map to the model, which only provides the markers in that part.
+void MapWidgetHelper::updateViewport()
+{
+	if (!m_map)
+		return;
+	double width = m_map->property("width").toDouble();
+	double height = m_map->property("height").toDouble();
+	double zoomLevel = m_map->property("zoomLevel").toDouble();
+	if (width <= 0.0 || height <= 0.0)
+		return;
+
+	QGeoCoordinate top, bottom, left;
+	QMetaObject::invokeMethod(m_map, "toCoordinate", Q_RETURN_ARG(QGeoCoordinate, top),
+				  Q_ARG(QPointF, QPointF(width / 2.0, 0.0)));
+	QMetaObject::invokeMethod(m_map, "toCoordinate", Q_RETURN_ARG(QGeoCoordinate, bottom),
+				  Q_ARG(QPointF, QPointF(width / 2.0, height)));
+	QMetaObject::invokeMethod(m_map, "toCoordinate", Q_RETURN_ARG(QGeoCoordinate, left),
+				  Q_ARG(QPointF, QPointF(0.0, height / 2.0)));
+
+	// When zoomed out, the map may show more than the world. Then the coordinates
+	// of the borders are not valid. At zoom level 0, the world is 256 pixels wide.
+	GeoIndex::Area area = GeoIndex::Area::world();
+	if (top.isValid())
+		area.north = top.latitude();
+	if (bottom.isValid())
+		area.south = bottom.latitude();
+	double lonWidth = 360.0 * width / (256.0 * pow(2.0, zoomLevel));
+	if (left.isValid() && lonWidth < 360.0) {
+		area.west = left.longitude();
+		area.width = lonWidth;
+	}
+	m_mapLocationModel->setViewport(area, zoomLevel);
+}
+
+void MapWidgetHelper::invalidateSiteIndex()
+{
+	m_siteIndexValid = false;
+}
+
+// An index of all dive sites with GPS location, the ids are the indexes in the dive site table
+const GeoIndex &MapWidgetHelper::siteIndex()
+{
+	if (m_siteIndexValid)
+		return m_siteIndex;
+	std::vector<GeoIndex::Point> points;
+	for (int i = 0; i < divelog.sites->nr; ++i) {
+		const struct dive_site *ds = divelog.sites->dive_sites[i];
+		if (dive_site_has_gps_location(ds))
+			points.push_back({ ds->location.lat.udeg * 0.000001, ds->location.lon.udeg * 0.000001, i });
+	}
+	m_siteIndex.build(std::move(points));
+	m_siteIndexValid = true;
+	return m_siteIndex;
 }
 
 void MapWidgetHelper::selectedLocationChanged(struct dive_site *ds_in)
@@ -133,18 +196,20 @@ void MapWidgetHelper::selectedLocationChanged(struct dive_site *ds_in)
 		return;
 	QGeoCoordinate locationCoord = location->coordinate;
 
-	for_each_dive (idx, dive) {
-		struct dive_site *ds = get_dive_site_for_dive(dive);
-		if (!dive_site_has_gps_location(ds))
-			continue;
 #ifndef SUBSURFACE_MOBILE
-		const qreal latitude = ds->location.lat.udeg * 0.000001;
-		const qreal longitude = ds->location.lon.udeg * 0.000001;
-		QGeoCoordinate dsCoord(latitude, longitude);
-		if (locationCoord.distanceTo(dsCoord) < m_smallCircleRadius)
+	// Select the dives of all dive sites in a small circle around the location
+	QSet<struct dive_site *> sites;
+	for (int siteIdx: siteIndex().withinRadius(locationCoord.latitude(), locationCoord.longitude(), m_smallCircleRadius))
+		sites.insert(divelog.sites->dive_sites[siteIdx]);
+	for_each_dive (idx, dive) {
+		if (sites.contains(get_dive_site_for_dive(dive)))
 			selectedDiveIds.append(idx);
 	}
 #else // the mobile version doesn't support multi-dive selection
+	for_each_dive (idx, dive) {
+		struct dive_site *ds = get_dive_site_for_dive(dive);
+		if (!dive_site_has_gps_location(ds))
+			continue;
 		if (ds == location->divesite)
 			selectedDiveIds.append(dive->id); // use id here instead of index
 	}
@@ -231,6 +296,7 @@ void MapWidgetHelper::copyToClipboardCoordinates(QGeoCoordinate coord, bool form
 
 void MapWidgetHelper::updateCurrentDiveSiteCoordinatesFromMap(struct dive_site *ds, QGeoCoordinate coord)
 {
+	invalidateSiteIndex();
 	MapLocation *loc = m_mapLocationModel->getMapLocation(ds);
 	if (loc)
 		loc->coordinate = coord;
@@ -240,6 +306,8 @@ void MapWidgetHelper::updateCurrentDiveSiteCoordinatesFromMap(struct dive_site *
 
 void MapWidgetHelper::diveSiteChanged(struct dive_site *ds, int field)
 {
+	if (field == LocationInformationModel::LOCATION)
+		invalidateSiteIndex();
 	centerOnDiveSite(ds);
 }
 
@@ -31,6 +31,7 @@ public:
 	Q_INVOKABLE QGeoCoordinate getCoordinates(struct dive_site *ds);
 	Q_INVOKABLE void centerOnDiveSite(struct dive_site *ds);
 	Q_INVOKABLE void reloadMapLocations();
+	Q_INVOKABLE void updateViewport();
 	Q_INVOKABLE void copyToClipboardCoordinates(QGeoCoordinate coord, bool formatTraditional);
 	Q_INVOKABLE void calculateSmallCircleRadius(QGeoCoordinate coord);
 	Q_INVOKABLE void updateCurrentDiveSiteCoordinatesFromMap(struct dive_site *ds, QGeoCoordinate coord);
@@ -42,13 +43,17 @@ public:
 
 private:
 	void updateEditMode();
+	const GeoIndex &siteIndex();
 	QObject *m_map;
 	MapLocationModel *m_mapLocationModel;
 	qreal m_smallCircleRadius;
 	bool m_editMode;
+	GeoIndex m_siteIndex;
+	bool m_siteIndexValid;
 
 private slots:
 	void diveSiteChanged(struct dive_site *ds, int field);
+	void invalidateSiteIndex();
 
 signals:
 	void modelChanged();
@@ -33,6 +33,7 @@
 #include "core/qthelper.h"
 #include "core/qt-gui.h"
 #include "core/git-access.h"
+#include "core/gitsync.h"
 #include "core/cloudstorage.h"
 #include "core/downloadfromdcthread.h"
 #include "core/subsurfacestartup.h" // for ignore_bt flag
@@ -324,6 +325,9 @@ QMLManager::QMLManager() :
 	connect(Command::getUndoStack(), &QUndoStack::undoTextChanged, this, &QMLManager::undoTextChanged);
 	connect(Command::getUndoStack(), &QUndoStack::redoTextChanged, this, &QMLManager::redoTextChanged);
 
+	// the cloud storage is synced in the background after saving locally
+	connect(GitSync::instance(), &GitSync::finished, this, &QMLManager::cloudSyncFinished);
+
 	// now that everything is setup, connect the application changed signal
 	connect(qobject_cast<QApplication *>(QApplication::instance()), &QApplication::applicationStateChanged, this, &QMLManager::applicationStateChanged);
 
@@ -1495,10 +1499,7 @@ void QMLManager::saveChangesLocal(bool fromUndo)
 			appendTextToLog("Don't save dives without loading from the cloud, first.");
 			return;
 		}
-		bool glo = git_local_only;
-		git_local_only = true;
-		int error = save_dives(existing_filename);
-		git_local_only = glo;
+		int error = save_dives_local(existing_filename);
 		if (error) {
 			setNotificationText(consumeError());
 			set_filename(NULL);
@@ -1540,8 +1541,38 @@ void QMLManager::saveChangesCloud(bool forceRemoteSync, bool fromUndo)
 		return;
 	}
 
+	// the local save is done, push it to the cloud without blocking the UI
+	appendTextToLog("Sync local cache with cloud storage in the background");
+	GitSync::instance()->sync(existing_filename);
+}
+
+void QMLManager::cloudSyncFinished(int error, bool canceled, const QString &sha)
+{
+	if (canceled) {
+		appendTextToLog("Background sync with cloud storage canceled");
+		return;
+	}
+	if (error) {
+		appendTextToLog(QStringLiteral("Background sync with cloud storage failed (%1)").arg(error));
+		setNotificationText(consumeError());
+		return;
+	}
+	// with another sync queued, the local changes aren't in the cloud yet
+	if (GitSync::instance()->pending())
+		return;
+	updateHaveLocalChanges(false);
+
+	// the sync merged in newer data from the cloud, load it from the local cache -
+	// unless there were changes in the meantime, which can't be saved on top of the
+	// new data. These are rare, since the changes are saved right away.
+	if (sha.isEmpty() || same_string(qPrintable(sha), saved_git_id))
+		return;
+	if (unsavedChanges()) {
+		appendTextToLog("Cloud sync brought newer data, but there are unsaved changes");
+		return;
+	}
 	bool glo = git_local_only;
-	git_local_only = false;
+	git_local_only = true;
 	loadDivesWithValidCredentials();
 	git_local_only = glo;
 }
@@ -304,6 +304,7 @@ signals:
 
 private slots:
 	void uploadFinishSlot(bool success, const QString &text, const QByteArray &html);
+	void cloudSyncFinished(int error, bool canceled, const QString &sha);
 };
 
 #endif
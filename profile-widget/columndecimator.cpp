@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "profile-widget/columndecimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ColumnDecimator::add(int idx, double pos, double value)
+{
+	int newColumn = static_cast<int>(floor(pos));
+	if (first < 0 || newColumn != column) {
+		flush();
+		column = newColumn;
+		first = last = low = high = idx;
+		lowValue = highValue = value;
+		return;
+	}
+	last = idx;
+	if (value < lowValue) {
+		low = idx;
+		lowValue = value;
+	}
+	if (value > highValue) {
+		high = idx;
+		highValue = value;
+	}
+}
+
+void ColumnDecimator::flush()
+{
+	if (first < 0)
+		return;
+	// The indexes are increasing, keep them in that order and skip duplicates.
+	for (int idx: { first, std::min(low, high), std::max(low, high), last }) {
+		if (res.empty() || res.back() < idx)
+			res.push_back(idx);
+	}
+	first = -1;
+}
+
+std::vector<int> ColumnDecimator::finish()
+{
+	flush();
+	return std::move(res);
+}
@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: GPL-2.0
+// For long dives, there are many more plot entries than pixels. The decimator collects
+// the points of a polyline and keeps only the first, the last, the lowest and the highest
+// point of every pixel column. The polyline through these points covers the same pixels
+// as the polyline through all points.
+#ifndef COLUMNDECIMATOR_H
+#define COLUMNDECIMATOR_H
+
+#include <vector>
+
+class ColumnDecimator {
+public:
+	void add(int idx, double pos, double value); // Indexes must be increasing, pos in pixels
+	std::vector<int> finish(); // The indexes of the kept points in increasing order
+private:
+	void flush();
+	std::vector<int> res;
+	int column = 0;
+	int first = -1, last = -1, low = -1, high = -1;
+	double lowValue = 0.0, highValue = 0.0;
+};
+
+#endif
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "profile-widget/diveprofileitem.h"
+#include "profile-widget/columndecimator.h"
 #include "profile-widget/divecartesianaxis.h"
 #include "profile-widget/divetextitem.h"
 #include "profile-widget/animationfunctions.h"
@@ -11,10 +12,15 @@
 #include "libdivecomputer/parser.h"
 #include "profile-widget/profilewidget2.h"
 
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
 AbstractProfilePolygonItem::AbstractProfilePolygonItem(const plot_info &pInfo, const DiveCartesianAxis &horizontal,
 						       const DiveCartesianAxis &vertical, DataAccessor accessor,
 						       double dpr) :
-	hAxis(horizontal), vAxis(vertical), pInfo(pInfo), accessor(accessor), dpr(dpr), from(0), to(0)
+	hAxis(horizontal), vAxis(vertical), pInfo(pInfo), accessor(accessor), dpr(dpr), from(0), to(0),
+	lodKeyValid(false)
 {
 	setCacheMode(DeviceCoordinateCache);
 }
@@ -26,7 +32,50 @@ AbstractProfilePolygonItem::~AbstractProfilePolygonItem()
 void AbstractProfilePolygonItem::clear()
 {
 	setPolygon(QPolygonF());
+	polygonEntries.clear();
 	texts.clear();
+	invalidateLOD();
+}
+
+void AbstractProfilePolygonItem::invalidateLOD()
+{
+	lodKeyValid = false;
+}
+
+bool AbstractProfilePolygonItem::LODKey::operator==(const LODKey &k) const
+{
+	return std::tie(from, to, minimum, maximum, minimumPos, maximumPos) ==
+	       std::tie(k.from, k.to, k.minimum, k.maximum, k.minimumPos, k.maximumPos);
+}
+
+// Returns true if the plotted entries of the last call can be reused.
+bool AbstractProfilePolygonItem::lodCached()
+{
+	LODKey key { from, to, hAxis.minimum(), hAxis.maximum(),
+		     hAxis.posAtValue(hAxis.minimum()), hAxis.posAtValue(hAxis.maximum()) };
+	if (lodKeyValid && key == lodKey)
+		return true;
+	lodKey = key;
+	lodKeyValid = true;
+	return false;
+}
+
+// The indexes of the entries in the range (from, to) that are plotted. Entries
+// for which isEmpty() returns true are not plotted at all.
+const std::vector<int> &AbstractProfilePolygonItem::lodIndexes(bool (*isEmpty)(double value))
+{
+	if (lodCached())
+		return lodIndexCache;
+
+	ColumnDecimator decimator;
+	for (int i = from; i < to; i++) {
+		auto [sec, value] = getPoint(i);
+		if (isEmpty && isEmpty(value))
+			continue;
+		decimator.add(i, hAxis.posAtValue(sec), value);
+	}
+	lodIndexCache = decimator.finish();
+	return lodIndexCache;
 }
 
 static std::pair<double,double> clip(double x1, double y1, double x2, double y2, double x)
@@ -78,8 +127,11 @@ void AbstractProfilePolygonItem::makePolygon(int fromIn, int toIn)
 	// regarting our cartesian plane ( made by the hAxis and vAxis ), the QPolygonF
 	// is an array of QPointF's, so we basically get the point from the model, convert
 	// to our coordinates, store. no painting is done here.
+	// The plotted entries are kept with the polygon, so that paint() colors the
+	// segments of this polygon, even if the axes changed in the meantime.
+	polygonEntries = lodIndexes();
 	QPolygonF poly;
-	for (int i = from; i < to; i++) {
+	for (int i: polygonEntries) {
 		auto [horizontalValue, verticalValue] = getPoint(i);
 
 		if (i == from) {
@@ -122,13 +174,15 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 	pen.setWidth(2);
 	QPolygonF poly = polygon();
 	const struct plot_data *data = pInfo.entry;
-	// This paints the colors of the velocities.
-	for (int i = from + 1; i < to; i++) {
-		QColor color = getColor((color_index_t)(VELOCITY_COLORS_START_IDX + data[i].velocity));
+	// This paints the colors of the velocities. The first point of the polygon is on the surface,
+	// the following points are the plotted entries.
+	const std::vector<int> &indexes = polygonEntries;
+	for (size_t i = 1; i < indexes.size(); i++) {
+		QColor color = getColor((color_index_t)(VELOCITY_COLORS_START_IDX + data[indexes[i]].velocity));
 		pen.setBrush(QBrush(color));
 		painter->setPen(pen);
-		if (i - from < poly.count() - 1)
-			painter->drawLine(poly[i - from], poly[i - from + 1]);
+		if ((int)i < poly.count() - 1)
+			painter->drawLine(poly[i], poly[i + 1]);
 	}
 	painter->restore();
 }
@@ -147,11 +201,13 @@ void DiveProfileItem::replot(const dive *d, int from, int to, bool in_planner)
 	profileColor = pInfo.waypoint_above_ceiling ? QColor(Qt::red)
 						    : getColor(DEPTH_BOTTOM);
 
-	/* Show any ceiling we may have encountered */
+	/* Show any ceiling we may have encountered. The ceiling changes slowly,
+	 * therefore it is plotted only at the entries of the depth profile. */
 	if (prefs.dcceiling && !prefs.redceiling) {
 		QPolygonF p = polygon();
-		plot_data *entry = pInfo.entry + to - 1;
-		for (int i = to - 1; i >= from; i--, entry--) {
+		const std::vector<int> &indexes = polygonEntries;
+		for (auto it = indexes.rbegin(); it != indexes.rend(); ++it) {
+			const plot_data *entry = pInfo.entry + *it;
 			if (!entry->in_deco) {
 				/* not in deco implies this is a safety stop, no ceiling */
 				p.append(QPointF(hAxis.posAtValue(entry->sec), vAxis.posAtValue(0)));
@@ -284,16 +340,21 @@ void DiveHeartrateItem::replot(const dive *, int fromIn, int toIn, bool)
 
 	texts.clear();
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
+	auto isEmpty = [](double hr) { return lrint(hr) == 0; };
 	QPolygonF poly;
+	for (int i: lodIndexes(isEmpty)) {
+		auto [sec, hr] = getPoint(i);
+		poly.append(QPointF(hAxis.posAtValue(sec), vAxis.posAtValue(hr)));
+	}
+	setPolygon(poly);
+
 	int interval = vAxis.getMinLabelDistance(hAxis);
 	for (int i = from; i < to; i++) {
 		auto [sec_double, hr_double] = getPoint(i);
-		int hr = lrint(hr_double);
-		if (!hr)
+		if (isEmpty(hr_double))
 			continue;
+		int hr = lrint(hr_double);
 		int sec = lrint(sec_double);
-		QPointF point(hAxis.posAtValue(sec_double), vAxis.posAtValue(hr_double));
-		poly.append(point);
 		if (hr == hist[2].hr)
 			// same as last one, no point in looking at printing
 			continue;
@@ -320,7 +381,6 @@ void DiveHeartrateItem::replot(const dive *, int fromIn, int toIn, bool)
 		textItems.push_back({ sec, hr });
 		last_printed_hr = hr;
 	}
-	setPolygon(poly);
 
 	for (size_t i = 0; i < textItems.size(); ++i) {
 		auto [sec, hr] = textItems[i];
@@ -369,14 +429,19 @@ void DiveTemperatureItem::replot(const dive *, int fromIn, int toIn, bool)
 
 	texts.clear();
 	// Ignore empty values. things do not look good with '0' as temperature in kelvin...
+	auto isEmpty = [](double mkelvin) { return mkelvin < 1.0; };
 	QPolygonF poly;
+	for (int i: lodIndexes(isEmpty)) {
+		auto [sec, mkelvin] = getPoint(i);
+		poly.append(QPointF(hAxis.posAtValue(sec), vAxis.posAtValue(mkelvin)));
+	}
+	setPolygon(poly);
+
 	int interval = vAxis.getMinLabelDistance(hAxis);
 	for (int i = from; i < to; i++) {
 		auto [sec, mkelvin] = getPoint(i);
-		if (mkelvin < 1.0)
+		if (isEmpty(mkelvin))
 			continue;
-		QPointF point(hAxis.posAtValue(sec), vAxis.posAtValue(mkelvin));
-		poly.append(point);
 		last_valid_temp = sec;
 
 		/* don't print a temperature
@@ -392,7 +457,6 @@ void DiveTemperatureItem::replot(const dive *, int fromIn, int toIn, bool)
 			textItems.push_back({ static_cast<int>(sec), static_cast<int>(mkelvin) });
 		last_printed_temp = mkelvin;
 	}
-	setPolygon(poly);
 
 	/* print the end temperature, if it's different or if the
 	 * last temperature print has been more than a quarter of the
@@ -521,42 +585,86 @@ void DiveMeanDepthItem::createTextItem(double lastSec, double lastMeanDepth)
 	texts.push_back(std::move(text));
 }
 
-void DiveGasPressureItem::replot(const dive *d, int fromIn, int toIn, bool in_planner)
+// Get the pressure of a cylinder at an entry. Returns false if there is no pressure.
+// The first and the last entry are clipped to the plotted range.
+bool DiveGasPressureItem::getPressure(int i, int cyl, double &time, double &mbar) const
 {
-	from = fromIn;
-	to = toIn;
+	const struct plot_data *entry = pInfo.entry + i;
+	mbar = static_cast<double>(get_plot_pressure(&pInfo, i, cyl));
+	time = static_cast<double>(entry->sec);
 
-	std::vector<int> plotted_cyl(pInfo.nr_cylinders, false);
-	std::vector<double> last_plotted(pInfo.nr_cylinders, 0.0);
-	std::vector<Segment> act_segments(pInfo.nr_cylinders);
-	QPolygonF boundingPoly;
-	segments.clear();
+	if (mbar < 1.0)
+		return false;
 
-	for (int i = from; i < to; i++) {
-		const struct plot_data *entry = pInfo.entry + i;
+	if (i == from && i < to - 1) {
+		double mbar2 = static_cast<double>(get_plot_pressure(&pInfo, i+1, cyl));
+		double time2 = static_cast<double>(entry[1].sec);
+		if (mbar2 < 1.0)
+			return false;
+		clipStart(time, mbar, time2, mbar2);
+	}
 
-		for (int cyl = 0; cyl < pInfo.nr_cylinders; cyl++) {
-			double mbar = static_cast<double>(get_plot_pressure(&pInfo, i, cyl));
-			double time = static_cast<double>(entry->sec);
+	if (i == to - 1 && i > from) {
+		double mbar2 = static_cast<double>(get_plot_pressure(&pInfo, i-1, cyl));
+		double time2 = static_cast<double>(entry[-1].sec);
+		if (mbar2 < 1.0)
+			return false;
+		clipStop(time, mbar, time2, mbar2);
+	}
+	return true;
+}
 
-			if (mbar < 1.0)
-				continue;
+void DiveGasPressureItem::replot(const dive *d, int fromIn, int toIn, bool in_planner)
+{
+	from = fromIn;
+	to = toIn;
 
-			if (i == from && i < to - 1) {
-				double mbar2 = static_cast<double>(get_plot_pressure(&pInfo, i+1, cyl));
-				double time2 = static_cast<double>(entry[1].sec);
-				if (mbar2 < 1.0)
+	// The segments are split when a cylinder was not used for more than two minutes.
+	// Within each segment, only the entries that are visible at the current zoom level are kept.
+	if (!lodCached()) {
+		std::vector<LODSegment> act_segments(pInfo.nr_cylinders);
+		std::vector<double> last_time(pInfo.nr_cylinders, 0.0);
+		lodSegments.clear();
+		for (int i = from; i < to; i++) {
+			for (int cyl = 0; cyl < pInfo.nr_cylinders; cyl++) {
+				double time, mbar;
+				if (!getPressure(i, cyl, time, mbar))
 					continue;
-				clipStart(time, mbar, time2, mbar2);
+				/* Have we used this cylinder in the last two minutes? Otherwise start a new segment */
+				if (!act_segments[cyl].indexes.empty() && time - last_time[cyl] > 2*60) {
+					lodSegments.push_back(std::move(act_segments[cyl]));
+					act_segments[cyl] = LODSegment();
+				}
+				act_segments[cyl].cyl = cyl;
+				act_segments[cyl].indexes.push_back(i);
+				last_time[cyl] = time;
 			}
+		}
+		for (int cyl = 0; cyl < pInfo.nr_cylinders; cyl++) {
+			if (!act_segments[cyl].indexes.empty())
+				lodSegments.push_back(std::move(act_segments[cyl]));
+		}
 
-			if (i == to - 1 && i > from) {
-				double mbar2 = static_cast<double>(get_plot_pressure(&pInfo, i-1, cyl));
-				double time2 = static_cast<double>(entry[-1].sec);
-				if (mbar2 < 1.0)
-					continue;
-				clipStop(time, mbar, time2, mbar2);
+		for (LODSegment &segment: lodSegments) {
+			ColumnDecimator decimator;
+			for (int i: segment.indexes) {
+				double time, mbar;
+				getPressure(i, segment.cyl, time, mbar);
+				decimator.add(i, hAxis.posAtValue(time), mbar);
 			}
+			segment.indexes = decimator.finish();
+		}
+	}
+
+	QPolygonF boundingPoly;
+	segments.clear();
+	for (const LODSegment &lodSegment: lodSegments) {
+		Segment segment;
+		segment.cyl = lodSegment.cyl;
+		for (int i: lodSegment.indexes) {
+			const struct plot_data *entry = pInfo.entry + i;
+			double time, mbar;
+			getPressure(i, lodSegment.cyl, time, mbar);
 
 			QPointF point(hAxis.posAtValue(time), vAxis.posAtValue(mbar));
 			boundingPoly.push_back(point);
@@ -574,37 +682,15 @@ void DiveGasPressureItem::replot(const dive *d, int fromIn, int toIn, bool in_pl
 					color = getPressureColor(entry->density);
 			}
 
-			if (!act_segments[cyl].polygon.empty()) {
-				/* Have we used this cylinder in the last two minutes? Continue */
-				if (time - act_segments[cyl].last.time <= 2*60) {
-					act_segments[cyl].polygon.push_back({ point, color });
-					act_segments[cyl].last.time = time;
-					act_segments[cyl].last.pressure = mbar;
-					continue;
-				}
-
-				/* Finish the previous one, start a new one */
-				act_segments[cyl].cyl = cyl;
-				segments.push_back(std::move(act_segments[cyl]));
-				act_segments[cyl] = Segment();
-			}
-
-			plotted_cyl[cyl] = true;
-			act_segments[cyl].polygon.push_back({ point, color });
-			act_segments[cyl].last.time = time;
-			act_segments[cyl].last.pressure = mbar;
-			if (act_segments[cyl].first.pressure == 0.0) {
-				act_segments[cyl].first.time = time;
-				act_segments[cyl].first.pressure = mbar;
+			segment.polygon.push_back({ point, color });
+			segment.last.time = time;
+			segment.last.pressure = mbar;
+			if (segment.first.pressure == 0.0) {
+				segment.first.time = time;
+				segment.first.pressure = mbar;
 			}
 		}
-	}
-
-	for (int cyl = 0; cyl < pInfo.nr_cylinders; cyl++) {
-		if (act_segments[cyl].polygon.empty())
-			continue;
-		act_segments[cyl].cyl = cyl;
-		segments.push_back(std::move(act_segments[cyl]));
+		segments.push_back(std::move(segment));
 	}
 
 	setPolygon(boundingPoly);
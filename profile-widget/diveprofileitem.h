@@ -4,6 +4,7 @@
 
 #include <QGraphicsPolygonItem>
 #include <memory>
+#include <vector>
 
 #include "divelineitem.h"
 
@@ -30,6 +31,7 @@ public:
 	~AbstractProfilePolygonItem();
 	virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0) = 0;
 	void clear();
+	void invalidateLOD(); // Call when the plot info was recalculated.
 
 	// Plot the range (from, to), given as indexes. The caller guarantees that
 	// only the first and the last segment will have to be clipped.
@@ -40,13 +42,32 @@ protected:
 	void clipStart(double &x, double &y, double next_x, double next_y) const;
 	void clipStop(double &x, double &y, double prev_x, double prev_y) const;
 	std::pair<double, double> getPoint(int i) const;
+
+	// For long dives, there are many more entries than pixels. Therefore, in every pixel
+	// column only the entries with the first, the last, the lowest and the highest value
+	// are plotted (see columndecimator.h). Which entries are plotted depends only on the
+	// plot info, the range and the pixel columns of the time axis. Thus, they are kept
+	// until one of these changes.
+	bool lodCached();
+	const std::vector<int> &lodIndexes(bool (*isEmpty)(double value) = nullptr);
 	const DiveCartesianAxis &hAxis;
 	const DiveCartesianAxis &vAxis;
 	const plot_info &pInfo;
 	DataAccessor accessor;
 	double dpr;
 	int from, to;
+	std::vector<int> polygonEntries; // The entries plotted by the last call to makePolygon()
 	std::vector<std::unique_ptr<DiveTextItem>> texts;
+private:
+	struct LODKey {
+		int from, to;
+		double minimum, maximum;
+		double minimumPos, maximumPos;
+		bool operator==(const LODKey &k) const;
+	};
+	bool lodKeyValid;
+	LODKey lodKey;
+	std::vector<int> lodIndexCache;
 };
 
 class DiveProfileItem : public AbstractProfilePolygonItem {
@@ -120,7 +141,13 @@ private:
 		std::vector<Entry> polygon;
 		PressureEntry first, last;
 	};
+	struct LODSegment {
+		int cyl;
+		std::vector<int> indexes;
+	};
+	bool getPressure(int i, int cyl, double &time, double &mbar) const;
 	std::vector<Segment> segments;
+	std::vector<LODSegment> lodSegments;
 };
 
 class DiveCalculatedCeiling : public AbstractProfilePolygonItem {
@@ -449,8 +449,11 @@ void ProfileScene::plotDive(const struct dive *dIn, int dcIn, DivePlannerPointsM
 	 * shown.
 	 * create_plot_info_new() automatically frees old plot data.
 	 */
-	if (!keepPlotInfo)
+	if (!keepPlotInfo) {
 		create_plot_info_new(d, currentdc, &plotInfo, planner_ds);
+		for (AbstractProfilePolygonItem *item: profileItems)
+			item->invalidateLOD();
+	}
 
 	bool hasHeartBeat = plotInfo.maxhr;
 	// For mobile we might want to turn of some features that are normally shown.
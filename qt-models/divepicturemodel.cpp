@@ -81,6 +81,15 @@ void DivePictureModel::updateThumbnails()
 		entry.image = Thumbnailer::instance()->fetchThumbnail(QString::fromStdString(entry.filename), false);
 }
 
+// The thumbnails of the shown pictures are calculated first
+void DivePictureModel::setVisibleRows(int first, int last)
+{
+	QVector<QString> filenames;
+	for (int i = std::max(first, 0); i <= last && i < (int)pictures.size(); ++i)
+		filenames.push_back(QString::fromStdString(pictures[i].filename));
+	Thumbnailer::instance()->setVisibleThumbnails(filenames);
+}
+
 void DivePictureModel::updateDivePictures()
 {
 	beginResetModel();
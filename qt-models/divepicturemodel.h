@@ -37,6 +37,7 @@ public slots:
 	void pictureOffsetChanged(dive *d, const QString filename, offset_t offset);
 	void picturesRemoved(dive *d, QVector<QString> filenames);
 	void picturesAdded(dive *d, QVector<PictureObj> pics);
+	void setVisibleRows(int first, int last);
 private:
 	DivePictureModel();
 	std::vector<PictureEntry> pictures;
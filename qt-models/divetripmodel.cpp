@@ -23,6 +23,7 @@
 #include <QDateTime>
 #include <memory>
 #include <algorithm>
+#include <unordered_map>
 
 // 1) Base functions
 
@@ -316,51 +317,16 @@ QVariant DiveTripModelBase::diveData(const struct dive *d, int column, int role)
 		return d->invalid ? invalidForeground : QVariant();
 	case Qt::TextAlignmentRole:
 		return dive_table_alignment(column);
-	case Qt::DisplayRole:
-		switch (column) {
-		case NR:
-			return d->number;
-		case DATE:
-			return get_dive_date_string(d->when);
-		case DEPTH:
-			return get_depth_string(d->maxdepth, prefs.units.show_units_table);
-		case DURATION:
-			return displayDuration(d);
-		case TEMPERATURE:
-			return displayTemperature(d, prefs.units.show_units_table);
-		case TOTALWEIGHT:
-			return displayWeight(d, prefs.units.show_units_table);
-		case SUIT:
-			return QString(d->suit);
-		case CYLINDER:
-			return d->cylinders.nr > 0 ? QString(get_cylinder(d, 0)->type.description) : QString();
-		case SAC:
-			return displaySac(d, prefs.units.show_units_table);
-		case OTU:
-			return d->otu;
-		case MAXCNS:
-			if (prefs.units.show_units_table)
-				return QString("%1%").arg(d->maxcns);
-			else
-				return d->maxcns;
-		case TAGS:
-			return get_taglist_string(d->tag_list);
-		case PHOTOS:
+	case Qt::DisplayRole: {
+		if (column < 0 || column >= COLUMNS)
 			break;
-		case COUNTRY:
-			return QString(get_dive_country(d));
-		case BUDDIES:
-			return QString(d->buddy);
-		case DIVEGUIDE:
-			return QString(d->diveguide);
-		case LOCATION:
-			return QString(get_dive_location(d));
-		case GAS:
-			return formatDiveGasString(d);
-		case NOTES:
-			return QString(d->notes);
+		DisplayCache &cache = displayCache[d];
+		if (!(cache.valid & (1u << column))) {
+			cache.display[column] = diveDisplayData(d, column);
+			cache.valid |= 1u << column;
 		}
-		break;
+		return cache.display[column];
+	}
 	case Qt::DecorationRole:
 		switch (column) {
 		//TODO: ADD A FLAG
@@ -394,6 +360,161 @@ QVariant DiveTripModelBase::diveData(const struct dive *d, int column, int role)
 	return QVariant();
 }
 
+// The text shown in a column. Called only if the data is not cached.
+QVariant DiveTripModelBase::diveDisplayData(const struct dive *d, int column)
+{
+	switch (column) {
+	case NR:
+		return d->number;
+	case DATE:
+		return get_dive_date_string(d->when);
+	case DEPTH:
+		return get_depth_string(d->maxdepth, prefs.units.show_units_table);
+	case DURATION:
+		return displayDuration(d);
+	case TEMPERATURE:
+		return displayTemperature(d, prefs.units.show_units_table);
+	case TOTALWEIGHT:
+		return displayWeight(d, prefs.units.show_units_table);
+	case SUIT:
+		return QString(d->suit);
+	case CYLINDER:
+		return d->cylinders.nr > 0 ? QString(get_cylinder(d, 0)->type.description) : QString();
+	case SAC:
+		return displaySac(d, prefs.units.show_units_table);
+	case OTU:
+		return d->otu;
+	case MAXCNS:
+		if (prefs.units.show_units_table)
+			return QString("%1%").arg(d->maxcns);
+		else
+			return d->maxcns;
+	case TAGS:
+		return get_taglist_string(d->tag_list);
+	case PHOTOS:
+		break;
+	case COUNTRY:
+		return QString(get_dive_country(d));
+	case BUDDIES:
+		return QString(d->buddy);
+	case DIVEGUIDE:
+		return QString(d->diveguide);
+	case LOCATION:
+		return QString(get_dive_location(d));
+	case GAS:
+		return formatDiveGasString(d);
+	case NOTES:
+		return QString(d->notes);
+	}
+	return QVariant();
+}
+
+// The string that a column is sorted by. Null if the C-string is null.
+QString DiveTripModelBase::sortString(const struct dive *d, int column)
+{
+	switch (column) {
+	case SUIT:
+		return QString(d->suit);
+	case CYLINDER:
+		return d->cylinders.nr > 0 ? QString(get_cylinder(d, 0)->type.description) : QString();
+	case TAGS: {
+		// The tag string is never null, even for dives without tags, so
+		// that these are sorted as empty strings, not before them.
+		QString tags = get_taglist_string(d->tag_list);
+		return tags.isNull() ? QString("") : tags;
+	}
+	case COUNTRY:
+		return QString(get_dive_country(d));
+	case BUDDIES:
+		return QString(d->buddy);
+	case DIVEGUIDE:
+		return QString(d->diveguide);
+	case LOCATION:
+		return QString(get_dive_location(d));
+	case NOTES:
+		return QString(d->notes);
+	default:
+		return QString();
+	}
+}
+
+int DiveTripModelBase::sortKeyIndex(int column)
+{
+	switch (column) {
+	case SUIT: return 0;
+	case CYLINDER: return 1;
+	case TAGS: return 2;
+	case COUNTRY: return 3;
+	case BUDDIES: return 4;
+	case DIVEGUIDE: return 5;
+	case LOCATION: return 6;
+	case NOTES: return 7;
+	default: return -1;
+	}
+}
+
+const std::optional<QCollatorSortKey> &DiveTripModelBase::sortKey(const struct dive *d, int column) const
+{
+	static const std::optional<QCollatorSortKey> none;
+	int idx = sortKeyIndex(column);
+	if (idx < 0)
+		return none;
+	DisplayCache &cache = displayCache[d];
+	if (!(cache.validSortKeys & (1u << idx))) {
+		QString s = sortString(d, column);
+		if (s.isNull())
+			cache.sortKeys[idx].reset();
+		else
+			cache.sortKeys[idx] = collator.sortKey(s);
+		cache.validSortKeys |= 1u << idx;
+	}
+	return cache.sortKeys[idx];
+}
+
+int DiveTripModelBase::compareStrings(const dive *d1, const dive *d2, int column) const
+{
+	// Note: references to elements of an unordered_map stay valid when inserting
+	const std::optional<QCollatorSortKey> &key1 = sortKey(d1, column);
+	const std::optional<QCollatorSortKey> &key2 = sortKey(d2, column);
+	if (!key1)
+		return !key2 ? 0 : -1;
+	if (!key2)
+		return 1;
+	return key1->compare(*key2);
+}
+
+void DiveTripModelBase::invalidateDisplayCache(const QVector<dive *> &dives)
+{
+	for (const dive *d: dives)
+		displayCache.erase(d);
+}
+
+void DiveTripModelBase::divesChangedInvalidateCache(const QVector<dive *> &dives, DiveField field)
+{
+	// Rating, visibility, etc. are not shown as text - no need to recalculate the strings.
+	// Note that pressure, salinity and dive mode enter the SAC calculation.
+	if (!field.nr && !field.datetime && !field.depth && !field.duration && !field.water_temp &&
+	    !field.atm_press && !field.divesite && !field.diveguide && !field.buddy && !field.suit &&
+	    !field.tags && !field.mode && !field.notes && !field.salinity)
+		return;
+	invalidateDisplayCache(dives);
+}
+
+void DiveTripModelBase::divesDeletedInvalidateCache(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	invalidateDisplayCache(dives);
+}
+
+void DiveTripModelBase::divesTimeChangedInvalidateCache(timestamp_t, const QVector<dive *> &dives)
+{
+	invalidateDisplayCache(dives);
+}
+
+void DiveTripModelBase::clearDisplayCache()
+{
+	displayCache.clear();
+}
+
 QVariant DiveTripModelBase::headerData(int section, Qt::Orientation orientation, int role) const
 {
 	if (orientation == Qt::Vertical)
@@ -489,6 +610,17 @@ DiveTripModelBase::DiveTripModelBase(QObject *parent) : QAbstractItemModel(paren
 	invalidForeground(Qt::gray)
 {
 	invalidFont.setStrikeOut(true);
+
+	// Keep the display cache up to date. These connections are made before the
+	// connections of the derived classes, so the cache is invalidated before
+	// the views are informed of changed data.
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &DiveTripModelBase::divesChangedInvalidateCache);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &DiveTripModelBase::divesDeletedInvalidateCache);
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this, &DiveTripModelBase::divesTimeChangedInvalidateCache);
+	connect(&diveListNotifier, &DiveListNotifier::settingsChanged, this, &DiveTripModelBase::clearDisplayCache);
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &DiveTripModelBase::clearDisplayCache);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &DiveTripModelBase::invalidateDisplayCache);
+	connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, this, &DiveTripModelBase::invalidateDisplayCache);
 }
 
 int DiveTripModelBase::columnCount(const QModelIndex&) const
@@ -689,6 +821,11 @@ DiveTripModelTree::DiveTripModelTree(QObject *parent) : DiveTripModelBase(parent
 	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, &DiveTripModelTree::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, &DiveTripModelTree::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, &DiveTripModelTree::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &DiveTripModelTree::divesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightAdded, this, &DiveTripModelTree::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightEdited, this, &DiveTripModelTree::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightRemoved, this, &DiveTripModelTree::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, this, &DiveTripModelTree::divesChanged);
 	connect(&diveListNotifier, &DiveListNotifier::pictureOffsetChanged, this, &DiveTripModelTree::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::picturesRemoved, this, &DiveTripModelTree::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::picturesAdded, this, &DiveTripModelTree::diveChanged);
@@ -704,11 +841,13 @@ void DiveTripModelTree::populate()
 	// we want this to be two calls as the second text is overwritten below by the lines starting with "\r"
 	uiNotification(QObject::tr("populate data model"));
 	uiNotification(QObject::tr("start processing"));
+
+	// Index of the top-level item of each trip we encountered so far
+	std::unordered_map<const dive_trip *, size_t> tripItems;
 	for (int i = 0; i < divelog.dives->nr; ++i) {
 		dive *d = get_dive(i);
 		if (!d) // should never happen
 			continue;
-		update_cylinder_related_info(d);
 		if (d->hidden_by_filter)
 			continue;
 		dive_trip_t *trip = d->divetrip;
@@ -719,16 +858,15 @@ void DiveTripModelTree::populate()
 			continue;
 		}
 
-		// Check if that trip is already known to us: search for the first item
-		// that corresponds to that trip
-		auto it = std::find_if(items.begin(), items.end(), [trip](const Item &item)
-				       { return item.d_or_t.trip == trip; });
-		if (it == items.end()) {
+		// Check if that trip is already known to us
+		auto it = tripItems.find(trip);
+		if (it == tripItems.end()) {
 			// We didn't find an entry for this trip -> add one
+			tripItems.emplace(trip, items.size());
 			items.emplace_back(trip, d);
 		} else {
 			// We found the trip -> simply add the dive
-			it->dives.push_back(d);
+			items[it->second].dives.push_back(d);
 		}
 	}
 
@@ -1217,7 +1355,9 @@ void DiveTripModelTree::diveSiteChanged(dive_site *ds, int field)
 {
 	if (!isInterestingDiveSiteField(field))
 		return;
-	divesChanged(getDivesForSite(ds));
+	QVector<dive *> dives = getDivesForSite(ds);
+	invalidateDisplayCache(dives);
+	divesChanged(dives);
 }
 
 void DiveTripModelTree::divesChanged(const QVector<dive *> &dives)
@@ -1228,7 +1368,9 @@ void DiveTripModelTree::divesChanged(const QVector<dive *> &dives)
 
 void DiveTripModelTree::diveChanged(dive *d)
 {
-	divesChanged(QVector<dive *> { d });
+	QVector<dive *> dives { d };
+	invalidateDisplayCache(dives);
+	divesChanged(dives);
 }
 
 void DiveTripModelTree::divesChangedTrip(dive_trip *trip, const QVector<dive *> &divesIn)
@@ -1469,6 +1611,11 @@ DiveTripModelList::DiveTripModelList(QObject *parent) : DiveTripModelBase(parent
 	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, &DiveTripModelList::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, &DiveTripModelList::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, &DiveTripModelList::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &DiveTripModelList::divesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightAdded, this, &DiveTripModelList::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightEdited, this, &DiveTripModelList::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightRemoved, this, &DiveTripModelList::diveChanged);
+	connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, this, &DiveTripModelList::divesChanged);
 	connect(&diveListNotifier, &DiveListNotifier::pictureOffsetChanged, this, &DiveTripModelList::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::picturesRemoved, this, &DiveTripModelList::diveChanged);
 	connect(&diveListNotifier, &DiveListNotifier::picturesAdded, this, &DiveTripModelList::diveChanged);
@@ -1598,7 +1745,9 @@ void DiveTripModelList::diveSiteChanged(dive_site *ds, int field)
 {
 	if (!isInterestingDiveSiteField(field))
 		return;
-	divesChanged(getDivesForSite(ds));
+	QVector<dive *> dives = getDivesForSite(ds);
+	invalidateDisplayCache(dives);
+	divesChanged(dives);
 }
 
 void DiveTripModelList::divesChanged(const QVector<dive *> &divesIn)
@@ -1630,7 +1779,9 @@ void DiveTripModelList::divesChanged(const QVector<dive *> &divesIn)
 
 void DiveTripModelList::diveChanged(dive *d)
 {
-	divesChanged(QVector<dive *> { d });
+	QVector<dive *> dives { d };
+	invalidateDisplayCache(dives);
+	divesChanged(dives);
 }
 
 void DiveTripModelList::divesTimeChanged(timestamp_t delta, const QVector<dive *> &divesIn)
@@ -1709,15 +1860,6 @@ static bool lessThanHelper(int diff1, int diff2)
 	return diff1 < 0 || (diff1 == 0 && diff2 < 0);
 }
 
-static int strCmp(const char *s1, const char *s2)
-{
-	if (!s1)
-		return !s2 ? 0 : -1;
-	if (!s2)
-		return 1;
-	return QString::localeAwareCompare(QString(s1), QString(s2)); // TODO: avoid copy
-}
-
 bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) const
 {
 	// We assume that i1.column() == i2.column().
@@ -1745,10 +1887,10 @@ bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) c
 	case TOTALWEIGHT:
 		return lessThanHelper(total_weight(d1) - total_weight(d2), row_diff);
 	case SUIT:
-		return lessThanHelper(strCmp(d1->suit, d2->suit), row_diff);
+		return lessThanHelper(compareStrings(d1, d2, SUIT), row_diff);
 	case CYLINDER:
 		if (d1->cylinders.nr > 0 && d2->cylinders.nr > 0)
-			return lessThanHelper(strCmp(get_cylinder(d1, 0)->type.description, get_cylinder(d2, 0)->type.description), row_diff);
+			return lessThanHelper(compareStrings(d1, d2, CYLINDER), row_diff);
 		return d1->cylinders.nr - d2->cylinders.nr < 0;
 	case GAS:
 		return lessThanHelper(nitrox_sort_value(d1) - nitrox_sort_value(d2), row_diff);
@@ -1758,25 +1900,19 @@ bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) c
 		return lessThanHelper(d1->otu - d2->otu, row_diff);
 	case MAXCNS:
 		return lessThanHelper(d1->maxcns - d2->maxcns, row_diff);
-	case TAGS: {
-		char *s1 = taglist_get_tagstring(d1->tag_list);
-		char *s2 = taglist_get_tagstring(d2->tag_list);
-		int diff = strCmp(s1, s2);
-		free(s1);
-		free(s2);
-		return lessThanHelper(diff, row_diff);
-	}
+	case TAGS:
+		return lessThanHelper(compareStrings(d1, d2, TAGS), row_diff);
 	case PHOTOS:
 		return lessThanHelper(countPhotos(d1) - countPhotos(d2), row_diff);
 	case COUNTRY:
-		return lessThanHelper(strCmp(get_dive_country(d1), get_dive_country(d2)), row_diff);
+		return lessThanHelper(compareStrings(d1, d2, COUNTRY), row_diff);
 	case BUDDIES:
-		return lessThanHelper(strCmp(d1->buddy, d2->buddy), row_diff);
+		return lessThanHelper(compareStrings(d1, d2, BUDDIES), row_diff);
 	case DIVEGUIDE:
-		return lessThanHelper(strCmp(d1->diveguide, d2->diveguide), row_diff);
+		return lessThanHelper(compareStrings(d1, d2, DIVEGUIDE), row_diff);
 	case LOCATION:
-		return lessThanHelper(strCmp(get_dive_location(d1), get_dive_location(d2)), row_diff);
+		return lessThanHelper(compareStrings(d1, d2, LOCATION), row_diff);
 	case NOTES:
-		return lessThanHelper(strCmp(d1->notes, d2->notes), row_diff);
+		return lessThanHelper(compareStrings(d1, d2, NOTES), row_diff);
 	}
 }
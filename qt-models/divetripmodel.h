@@ -6,7 +6,11 @@
 #include "core/subsurface-qt/divelistnotifier.h"
 #include <QAbstractItemModel>
 #include <QBrush>
+#include <QCollator>
 #include <QFont>
+#include <array>
+#include <optional>
+#include <unordered_map>
 
 class DiveFilter;
 
@@ -105,6 +109,33 @@ protected:
 	virtual void clearData() = 0;
 	virtual void populate() = 0;
 	virtual QModelIndex diveToIdx(const dive *d) const = 0;
+
+	// Compare the strings of a column using the locale. Null strings are sorted first.
+	int compareStrings(const dive *d1, const dive *d2, int column) const;
+	void invalidateDisplayCache(const QVector<dive *> &dives);
+private slots:
+	void divesChangedInvalidateCache(const QVector<dive *> &dives, DiveField field);
+	void divesDeletedInvalidateCache(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives);
+	void divesTimeChangedInvalidateCache(timestamp_t delta, const QVector<dive *> &dives);
+	void clearDisplayCache();
+private:
+	// Formatting the column strings is expensive and sorting by locale-aware
+	// comparison of strings even more so. Therefore, the display data and the
+	// collation keys of the string columns are calculated once per dive and cached
+	// until the dive changes.
+	static const int numSortKeys = 8;
+	struct DisplayCache {
+		unsigned int valid = 0;		// Bit field: columns with valid display data
+		unsigned int validSortKeys = 0;	// Bit field: sort keys that have been calculated
+		std::array<QVariant, COLUMNS> display;
+		std::array<std::optional<QCollatorSortKey>, numSortKeys> sortKeys;	// Empty for null strings
+	};
+	static QVariant diveDisplayData(const struct dive *d, int column);
+	static QString sortString(const struct dive *d, int column);
+	static int sortKeyIndex(int column);
+	const std::optional<QCollatorSortKey> &sortKey(const struct dive *d, int column) const;
+	QCollator collator;
+	mutable std::unordered_map<const dive *, DisplayCache> displayCache;
 };
 
 class DiveTripModelTree final : public DiveTripModelBase
@@ -10,7 +10,17 @@
 #include "desktop-widgets/mapwidget.h"
 #endif
 
+#include <cmath>
+
 #define MIN_DISTANCE_BETWEEN_DIVE_SITES_M 50.0
+// Dive sites closer than this are merged into clusters, up to a zoom level at which
+// dive sites are separated by a few meters.
+#define CLUSTER_SIZE_PX 50.0
+#define MAX_CLUSTER_ZOOM 17.0
+// When the map is moved, the markers are only recalculated if the shown area
+// leaves the area for which they were calculated. That area extends the shown
+// area by this factor times its size in each direction.
+#define MARKER_AREA_MARGIN 0.5
 
 // MKW If "Map Short Names" preference is set, only return the last component
 // of the full dive site name.
@@ -35,7 +45,7 @@ static QString siteMapDisplayName(const char *sitename)
 
 
 MapLocation::MapLocation(struct dive_site *dsIn, QGeoCoordinate coordIn, QString nameIn, bool selectedIn) :
-    divesite(dsIn), coordinate(coordIn), name(nameIn), selected(selectedIn)
+    divesite(dsIn), coordinate(coordIn), name(nameIn), selected(selectedIn), count(1)
 {
 }
 
@@ -68,27 +78,41 @@ QVariant MapLocation::getRole(int role) const
 		return selected ? 1 : 0;
 	case RoleIsSelected:
 		return QVariant::fromValue(selected);
+	case RoleCount:
+		return QVariant::fromValue(count);
 	default:
 		return QVariant();
 	}
 }
 
-MapLocationModel::MapLocationModel(QObject *parent) : QAbstractListModel(parent)
+MapLocationModel::MapLocationModel(QObject *parent) : QAbstractListModel(parent),
+	m_viewport(GeoIndex::Area::world()),
+	m_zoomLevel(-1.0),
+	m_markerArea(GeoIndex::Area::world()),
+	m_clusterLevel(-1),
+	m_map(nullptr),
+	m_populated(false),
+	m_diveSiteMode(false)
 {
 	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &MapLocationModel::diveSiteChanged);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteAdded, this, &MapLocationModel::diveSitesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteDeleted, this, &MapLocationModel::diveSitesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteDivesChanged, this, &MapLocationModel::diveSitesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::numShownChanged, this, &MapLocationModel::diveSitesChanged);
 }
 
 MapLocationModel::~MapLocationModel()
 {
 	qDeleteAll(m_mapLocations);
+	qDeleteAll(m_clusters);
 }
 
 QVariant MapLocationModel::data(const QModelIndex & index, int role) const
 {
-	if (index.row() < 0 || index.row() >= m_mapLocations.size())
+	if (index.row() < 0 || index.row() >= m_markers.size())
 		return QVariant();
 
-	return m_mapLocations.at(index.row())->getRole(role);
+	return m_markers.at(index.row())->getRole(role);
 }
 
 QHash<int, QByteArray> MapLocationModel::roleNames() const
@@ -100,19 +124,13 @@ QHash<int, QByteArray> MapLocationModel::roleNames() const
 	roles[MapLocation::RolePixmap] = "pixmap";
 	roles[MapLocation::RoleZ] = "z";
 	roles[MapLocation::RoleIsSelected] = "isSelected";
+	roles[MapLocation::RoleCount] = "count";
 	return roles;
 }
 
 int MapLocationModel::rowCount(const QModelIndex&) const
 {
-	return m_mapLocations.size();
-}
-
-void MapLocationModel::add(MapLocation *location)
-{
-	beginInsertRows(QModelIndex(), m_mapLocations.size(), m_mapLocations.size());
-	m_mapLocations.append(location);
-	endInsertRows();
+	return m_markers.size();
 }
 
 const QVector<dive_site *> &MapLocationModel::selectedDs() const
@@ -136,20 +154,139 @@ void MapLocationModel::selectionChanged()
 {
 	if (m_mapLocations.isEmpty())
 		return;
-	for(MapLocation *m: m_mapLocations)
-		m->selected = m_selectedDs.contains(m->divesite);
-	emit dataChanged(createIndex(0, 0), createIndex(m_mapLocations.size() - 1, 0));
+	// Selected locations are not clustered, therefore the markers may change.
+	QSet<MapLocation *> changed;
+	for (MapLocation *m: m_mapLocations) {
+		bool selected = m_selectedDs.contains(m->divesite);
+		if (selected != m->selected) {
+			m->selected = selected;
+			changed.insert(m);
+		}
+	}
+	if (changed.isEmpty())
+		return;
+	buildIndex();
+	updateMarkers(changed);
 }
 
-void MapLocationModel::reload(QObject *map)
+static double clusterSize(double zoomLevel)
 {
-	beginResetModel();
+	if (zoomLevel < 0.0 || zoomLevel >= MAX_CLUSTER_ZOOM)
+		return 0.0;
+	// At zoom level 0, the whole world is 256 pixels wide.
+	return CLUSTER_SIZE_PX / (256.0 * pow(2.0, zoomLevel));
+}
 
-	qDeleteAll(m_mapLocations);
-	m_mapLocations.clear();
+void MapLocationModel::buildIndex()
+{
+	std::vector<GeoIndex::Point> points;
+	for (int i = 0; i < m_mapLocations.size(); ++i) {
+		const MapLocation *location = m_mapLocations[i];
+		if (!location->selected)
+			points.push_back({ location->coordinate.latitude(), location->coordinate.longitude(), i });
+	}
+	m_index.build(std::move(points));
+}
+
+// Recalculate the markers and update the rows of the model: rows of markers that disappeared
+// are removed, new markers are appended and the rows of the markers in "changed" are updated.
+// Clusters are identified by their first dive site, so that they are kept when possible.
+void MapLocationModel::updateMarkers(const QSet<MapLocation *> &changedIn)
+{
+	QSet<MapLocation *> changed = changedIn;
+	double size = clusterSize(m_zoomLevel);
+	m_markerArea = m_viewport.expanded(MARKER_AREA_MARGIN);
+	m_clusterLevel = GeoIndex::clusterLevel(size);
+
+	QHash<dive_site *, MapLocation *> oldClusters;
+	for (MapLocation *cluster: m_clusters)
+		oldClusters.insert(cluster->divesite, cluster);
+	QVector<MapLocation *> clusters;
+	QVector<MapLocation *> markers;
+
+	// Selected locations are always shown, so that they can be dragged in dive site edit mode.
+	for (MapLocation *location: m_mapLocations) {
+		if (location->selected)
+			markers.append(location);
+	}
+	for (const GeoIndex::Cluster &c: m_index.clusters(m_markerArea, size)) {
+		MapLocation *location = m_mapLocations[c.id];
+		if (c.count == 1) {
+			markers.append(location);
+			continue;
+		}
+		QGeoCoordinate coord(c.latitude, c.longitude);
+		MapLocation *cluster = oldClusters.take(location->divesite);
+		if (!cluster) {
+			cluster = new MapLocation(location->divesite, coord, QString(), false);
+		} else if (cluster->count != c.count || cluster->coordinate != coord) {
+			cluster->coordinate = coord;
+			changed.insert(cluster);
+		}
+		cluster->count = c.count;
+		clusters.append(cluster);
+		markers.append(cluster);
+	}
+
+	// Remove the rows of the markers that are not shown anymore, in ranges from the back.
+	QSet<MapLocation *> newMarkers;
+	for (MapLocation *marker: markers)
+		newMarkers.insert(marker);
+	int row = m_markers.size();
+	while (row > 0) {
+		if (newMarkers.contains(m_markers[row - 1])) {
+			--row;
+			continue;
+		}
+		int end = row;
+		while (row > 0 && !newMarkers.contains(m_markers[row - 1]))
+			--row;
+		beginRemoveRows(QModelIndex(), row, end - 1);
+		m_markers.remove(row, end - row);
+		endRemoveRows();
+	}
+	// The clusters that were not reused are not referenced anymore
+	qDeleteAll(oldClusters);
+	m_clusters = clusters;
+
+	QSet<MapLocation *> oldMarkers;
+	for (row = 0; row < m_markers.size(); ++row) {
+		oldMarkers.insert(m_markers[row]);
+		if (changed.contains(m_markers[row]))
+			emit dataChanged(createIndex(row, 0), createIndex(row, 0));
+	}
+
+	QVector<MapLocation *> added;
+	for (MapLocation *marker: markers) {
+		if (!oldMarkers.contains(marker))
+			added.append(marker);
+	}
+	if (added.isEmpty())
+		return;
+	beginInsertRows(QModelIndex(), m_markers.size(), m_markers.size() + added.size() - 1);
+	m_markers.append(added);
+	endInsertRows();
+}
+
+void MapLocationModel::setViewport(const GeoIndex::Area &area, double zoomLevel)
+{
+	m_viewport = area;
+	m_zoomLevel = zoomLevel;
+	if (GeoIndex::clusterLevel(clusterSize(zoomLevel)) == m_clusterLevel && m_markerArea.contains(area))
+		return;
+	updateMarkers(QSet<MapLocation *>());
+}
+
+// Compare the shown dive sites to the dive site table and only add, remove or update the
+// locations that changed. The old locations are only identified by their dive site pointer,
+// which is never dereferenced, because the dive site may have been freed in the meantime.
+void MapLocationModel::update(QObject *map)
+{
+	m_map = map;
+	m_populated = true;
 	m_selectedDs.clear();
 
-	QMap<QString, MapLocation *> locationNameMap;
+	QHash<QString, QGeoCoordinate> locationNameMap;
 
 #if defined(SUBSURFACE_MOBILE) || defined(SUBSURFACE_DOWNLOADER)
 	bool diveSiteMode = false;
@@ -162,8 +299,13 @@ void MapLocationModel::reload(QObject *map)
 	if (diveSiteMode)
 		m_selectedDs = DiveFilter::instance()->filteredDiveSites();
 #endif
+	QHash<const dive_site *, MapLocation *> oldLocations;
+	oldLocations.swap(m_siteLocations);
+	QVector<MapLocation *> locations;
+	QSet<MapLocation *> changed;
 	for (int i = 0; i < divelog.sites->nr; ++i) {
 		struct dive_site *ds = divelog.sites->dive_sites[i];
+		MapLocation *location = oldLocations.value(ds);
 		QGeoCoordinate dsCoord;
 
 		// Don't show dive sites of hidden dives, unless we're in dive site edit mode.
@@ -173,9 +315,10 @@ void MapLocationModel::reload(QObject *map)
 			// Dive sites that do not have a gps location are not shown in normal mode.
 			// In dive-edit mode, selected sites are placed at the center of the map,
 			// so that the user can drag them somewhere without having to enter coordinates.
-			if (!diveSiteMode || !m_selectedDs.contains(ds) || !map)
+			// Sites that are already shown stay where they are.
+			if (!diveSiteMode || !m_selectedDs.contains(ds) || (!map && !location))
 				continue;
-			dsCoord = map->property("center").value<QGeoCoordinate>();
+			dsCoord = location ? location->coordinate : map->property("center").value<QGeoCoordinate>();
 		} else {
 			qreal latitude = ds->location.lat.udeg * 0.000001;
 			qreal longitude = ds->location.lon.udeg * 0.000001;
@@ -187,21 +330,49 @@ void MapLocationModel::reload(QObject *map)
 		if (!diveSiteMode) {
 			// don't add dive locations with the same name, unless they are
 			// at least MIN_DISTANCE_BETWEEN_DIVE_SITES_M apart
-			if (locationNameMap.contains(name)) {
-				MapLocation *existingLocation = locationNameMap[name];
-				QGeoCoordinate coord = existingLocation->coordinate;
-				if (dsCoord.distanceTo(coord) < MIN_DISTANCE_BETWEEN_DIVE_SITES_M)
-					continue;
-			}
+			auto it = locationNameMap.find(name);
+			if (it != locationNameMap.end() && dsCoord.distanceTo(*it) < MIN_DISTANCE_BETWEEN_DIVE_SITES_M)
+				continue;
 		}
 		bool selected = m_selectedDs.contains(ds);
-		MapLocation *location = new MapLocation(ds, dsCoord, name, selected);
-		m_mapLocations.append(location);
+		if (!location) {
+			location = new MapLocation(ds, dsCoord, name, selected);
+		} else {
+			oldLocations.remove(ds);
+			if (location->coordinate != dsCoord || location->name != name || location->selected != selected) {
+				location->coordinate = dsCoord;
+				location->name = name;
+				location->selected = selected;
+				changed.insert(location);
+			}
+		}
+		locations.append(location);
+		m_siteLocations.insert(ds, location);
 		if (!diveSiteMode)
-			locationNameMap[name] = location;
+			locationNameMap[name] = dsCoord;
+	}
+
+	// The pixmaps depend on whether we are in dive site edit mode
+	if (diveSiteMode != m_diveSiteMode) {
+		for (MapLocation *location: locations)
+			changed.insert(location);
+		m_diveSiteMode = diveSiteMode;
 	}
 
-	endResetModel();
+	m_mapLocations = locations;
+	buildIndex();
+	updateMarkers(changed);
+	// Delete the locations that are not shown anymore only after their rows were removed
+	qDeleteAll(oldLocations);
+}
+
+// Update the map after changes of dive sites or of the filter, but only if it was shown before
+// and still exists.
+void MapLocationModel::diveSitesChanged()
+{
+	if (!m_populated || !m_map)
+		return;
+	update(m_map);
 }
 
 void MapLocationModel::setSelected(struct dive_site *ds)
@@ -218,40 +389,27 @@ void MapLocationModel::setSelected(const QVector<dive_site *> &divesites)
 
 MapLocation *MapLocationModel::getMapLocation(const struct dive_site *ds)
 {
-	MapLocation *location;
-	foreach(location, m_mapLocations) {
-		if (ds == location->divesite)
-			return location;
-	}
-	return nullptr;
+	return m_siteLocations.value(ds);
 }
 
 void MapLocationModel::diveSiteChanged(struct dive_site *ds, int field)
 {
-	// Find dive site
-	int row;
-	for (row = 0; row < m_mapLocations.size(); ++row) {
-		if (m_mapLocations[row]->divesite == ds)
-			break;
-	}
-	if (row == m_mapLocations.size())
-		return;
-
 	switch (field) {
 	case LocationInformationModel::LOCATION:
-		if (has_location(&ds->location)) {
-			const qreal latitude_r = ds->location.lat.udeg * 0.000001;
-			const qreal longitude_r = ds->location.lon.udeg * 0.000001;
-			QGeoCoordinate coord(latitude_r, longitude_r);
-			m_mapLocations[row]->coordinate = coord;
-		}
-		break;
+		// The dive site may have gotten or lost its location, which may change the clusters
+		diveSitesChanged();
+		return;
 	case LocationInformationModel::NAME:
-		m_mapLocations[row]->name = siteMapDisplayName(ds->name);
 		break;
 	default:
-		break;
+		return;
 	}
 
-	emit dataChanged(createIndex(row, 0), createIndex(row, 0));
+	MapLocation *location = getMapLocation(ds);
+	if (!location)
+		return;
+	location->name = siteMapDisplayName(ds->name);
+	int row = m_markers.indexOf(location);
+	if (row >= 0)
+		emit dataChanged(createIndex(row, 0), createIndex(row, 0));
 }
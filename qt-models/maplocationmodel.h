@@ -3,9 +3,12 @@
 #define MAPLOCATIONMODEL_H
 
 #include "core/subsurface-qt/divelistnotifier.h"
+#include "core/geoindex.h"
 #include <QObject>
+#include <QPointer>
 #include <QVector>
 #include <QHash>
+#include <QSet>
 #include <QByteArray>
 #include <QAbstractListModel>
 #include <QGeoCoordinate>
@@ -23,13 +26,15 @@ public:
 		RoleName,
 		RolePixmap,
 		RoleZ,
-		RoleIsSelected
+		RoleIsSelected,
+		RoleCount
 	};
 
 	struct dive_site *divesite;
 	QGeoCoordinate coordinate;
 	QString name;
 	bool selected;
+	int count; // Number of dive sites if this is a cluster
 };
 
 class MapLocationModel : public QAbstractListModel
@@ -42,9 +47,12 @@ public:
 
 	QVariant data(const QModelIndex &index, int role) const override;
 	int rowCount(const QModelIndex &parent) const override;
-	void add(MapLocation *);
+	// Synchronize the locations with the dive site table. Only the rows that changed are updated.
 	// If map is not null, it will be used to place new dive sites without GPS location at the center of the map
-	void reload(QObject *map);
+	void update(QObject *map);
+	// The shown part of the map. Only the markers in that area are provided by the model.
+	// Dive sites that are close at the given zoom level are merged into clusters.
+	void setViewport(const GeoIndex::Area &area, double zoomLevel);
 	void selectionChanged();
 	void setSelected(const QVector<dive_site *> &divesites);
 	MapLocation *getMapLocation(const struct dive_site *ds);
@@ -56,10 +64,24 @@ protected:
 
 private slots:
 	void diveSiteChanged(struct dive_site *ds, int field);
+	void diveSitesChanged();
 
 private:
-	QVector<MapLocation *> m_mapLocations;
+	void buildIndex();
+	void updateMarkers(const QSet<MapLocation *> &changed);
+	QVector<MapLocation *> m_mapLocations;	// All locations
+	QHash<const dive_site *, MapLocation *> m_siteLocations;
+	QVector<MapLocation *> m_markers;	// The rows of the model: locations and clusters
+	QVector<MapLocation *> m_clusters;
 	QVector<dive_site *> m_selectedDs;
+	GeoIndex m_index;			// Locations that are not selected, ids are indexes into m_mapLocations
+	GeoIndex::Area m_viewport;
+	double m_zoomLevel;
+	GeoIndex::Area m_markerArea;		// The area for which the markers were calculated
+	int m_clusterLevel;
+	QPointer<QObject> m_map;		// Reset by Qt if the QML map is destroyed
+	bool m_populated;			// Only update the locations if the map was shown
+	bool m_diveSiteMode;
 };
 
 #endif
@@ -3,6 +3,7 @@
 #include "core/qthelper.h"
 #include "core/metrics.h"
 #include "core/statistics.h"
+#include "core/statisticscache.h"
 #include "core/string-format.h"
 #include "core/dive.h" // For NUM_DIVEMODE
 
@@ -189,7 +190,7 @@ void YearlyStatisticsModel::update_yearly_stats()
 	stats_summary_auto_free stats;
 	QString label;
 	temperature_t t_range_min,t_range_max;
-	calculate_stats_summary(&stats, false);
+	StatisticsCache::instance()->summary(&stats);
 
 	for (i = 0; stats.stats_yearly != NULL && stats.stats_yearly[i].period; ++i) {
 		YearStatisticsItem *item = new YearStatisticsItem(stats.stats_yearly[i]);
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "statsdives.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/equipment.h"
+#include "core/subsurface-string.h"
+#include "core/tag.h"
+#include "core/trip.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// The tags themselves are in the global tag list, which is never freed
+static tag_entry *copy_tag_list(const tag_entry *tl)
+{
+	tag_entry *res = nullptr;
+	tag_entry **last = &res;
+	for (; tl; tl = tl->next) {
+		*last = (tag_entry *)calloc(1, sizeof(tag_entry));
+		(*last)->tag = tl->tag;
+		last = &(*last)->next;
+	}
+	return res;
+}
+
+// Like copy_dive(), but without the dive computers, except for the dive mode,
+// the notes and the pictures. The copy is freed with free_dive().
+static dive *copy_stats_dive(const dive *d, dive_site *ds, dive_trip *trip)
+{
+	dive *res = alloc_dive();
+	*res = *d;
+	res->divetrip = trip;
+	res->dive_site = ds;
+	res->notes = nullptr;
+	res->buddy = copy_string(d->buddy);
+	res->diveguide = copy_string(d->diveguide);
+	res->suit = copy_string(d->suit);
+	memset(&res->cylinders, 0, sizeof(res->cylinders));
+	memset(&res->weightsystems, 0, sizeof(res->weightsystems));
+	memset(&res->pictures, 0, sizeof(res->pictures));
+	copy_cylinders(&d->cylinders, &res->cylinders);
+	copy_weights(&d->weightsystems, &res->weightsystems);
+	res->tag_list = copy_tag_list(d->tag_list);
+	memset(&res->dc, 0, sizeof(res->dc));
+	res->dc.divemode = d->dc.divemode;
+	res->full_text = nullptr;
+	return res;
+}
+
+StatsDives::StatsDives(const std::vector<dive *> &dives)
+{
+	std::unordered_map<const dive_site *, dive_site *> siteCopies;
+	std::unordered_map<const dive_trip *, dive_trip *> tripCopies;
+
+	copiedDives.reserve(dives.size());
+	originals.reserve(dives.size());
+	for (dive *d: dives) {
+		dive_site *ds = nullptr;
+		if (d->dive_site) {
+			dive_site *&copy = siteCopies[d->dive_site];
+			if (!copy) {
+				copy = alloc_dive_site_with_name(d->dive_site->name);
+				copy->uuid = d->dive_site->uuid;
+				sites.push_back(copy);
+			}
+			ds = copy;
+		}
+
+		dive_trip *trip = nullptr;
+		if (d->divetrip) {
+			dive_trip *&copy = tripCopies[d->divetrip];
+			if (!copy) {
+				// The title of a trip is made from its location and the dates of its first and last dive
+				const dive_table &table = d->divetrip->dives;
+				copy = alloc_trip();
+				copy->location = copy_string(d->divetrip->location);
+				copy->dives.nr = std::min(table.nr, 2);
+				copy->dives.allocated = 2;
+				copy->dives.dives = (dive **)calloc(2, sizeof(dive *));
+				for (int i = 0; i < copy->dives.nr; ++i) {
+					dive *date = alloc_dive();
+					date->when = table.dives[i == 0 ? 0 : table.nr - 1]->when;
+					copy->dives.dives[i] = date;
+					tripDives.push_back(date);
+				}
+				trips.push_back(copy);
+			}
+			trip = copy;
+		}
+
+		dive *copy = copy_stats_dive(d, ds, trip);
+		copiedDives.push_back(copy);
+		originals.emplace(copy, d);
+	}
+}
+
+StatsDives::~StatsDives()
+{
+	for (dive *d: copiedDives)
+		free_dive(d);
+	for (dive *d: tripDives)
+		free_dive(d);
+	for (dive_site *ds: sites)
+		free_dive_site(ds);
+	for (dive_trip *trip: trips)
+		free_trip(trip);
+}
+
+const std::vector<dive *> &StatsDives::copies() const
+{
+	return copiedDives;
+}
+
+dive *StatsDives::original(const dive *copy) const
+{
+	auto it = originals.find(copy);
+	return it != originals.end() ? it->second : nullptr;
+}
+
+void StatsDives::toOriginals(std::vector<dive *> &dives) const
+{
+	for (dive *&d: dives)
+		d = original(d);
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copies of the dives of a chart. Charts are calculated on the thread pool,
+// while the dives may be edited or deleted on the GUI thread. Therefore, the
+// data that is read by the statistics variables is copied on the GUI thread:
+// the dives without their dive computers, notes and pictures, the names of
+// their dive sites and the locations and dates of their trips.
+#ifndef STATS_DIVES_H
+#define STATS_DIVES_H
+
+#include <unordered_map>
+#include <vector>
+
+struct dive;
+struct dive_site;
+struct dive_trip;
+
+class StatsDives {
+public:
+	StatsDives(const std::vector<dive *> &dives); // Must be called on the GUI thread
+	~StatsDives();
+	StatsDives(const StatsDives &) = delete;
+	StatsDives &operator=(const StatsDives &) = delete;
+
+	const std::vector<dive *> &copies() const; // In the order of the dives passed to the constructor
+	dive *original(const dive *copy) const;
+	void toOriginals(std::vector<dive *> &dives) const; // Replaces the copies by the dives in place
+private:
+	std::vector<dive *> copiedDives;
+	std::unordered_map<const dive *, dive *> originals;
+	std::vector<dive_site *> sites;
+	std::vector<dive_trip *> trips;
+	std::vector<dive *> tripDives; // The first and last dives of the trips, only with their dates
+};
+
+#endif
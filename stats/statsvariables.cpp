@@ -2,6 +2,7 @@
 #include "statsvariables.h"
 #include "statstranslations.h"
 #include "core/dive.h"
+#include "core/divefeatures.h"
 #include "core/divelog.h"
 #include "core/divemode.h"
 #include "core/divesite.h"
@@ -12,12 +13,25 @@
 #include "core/tag.h"
 #include "core/trip.h"
 #include "core/subsurface-time.h"
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <QLocale>
+#include <QThreadPool>
 
 static constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
 
+// Binning and the per-bin calculations are distributed over the global thread
+// pool. Below this number of dives per thread it is not worth the overhead.
+int stats_min_dives_per_thread = 1000;
+
+// Adapter to pass a lambda to parallel_for()
+template<typename Func>
+static void call_func(int idx, void *func)
+{
+	(*static_cast<Func *>(func))(idx);
+}
+
 // Typedefs for year / quarter or month binners
 using year_quarter = std::pair<unsigned short, unsigned short>;
 using year_month = std::pair<unsigned short, unsigned short>;
@@ -540,18 +554,29 @@ std::vector<StatsScatterItem> StatsVariable::scatter(const StatsVariable &t2, co
 	return res;
 }
 
+// The values of the bins (e.g. the sorting for the quartiles) are calculated
+// in parallel if there are enough dives.
 template <typename T, typename DivesToValueFunc>
 std::vector<StatsBinValue<T>> bin_convert(const StatsVariable &variable, const StatsBinner &binner, const std::vector<dive *> &dives,
 					  bool fill_empty, DivesToValueFunc func)
 {
 	std::vector<StatsBinDives> bin_dives = binner.bin_dives(dives, fill_empty);
+	std::vector<T> values(bin_dives.size());
+	auto calculate = [&bin_dives, &values, &func](int idx) { values[idx] = func(bin_dives[idx].value); };
+	if ((int)dives.size() < stats_min_dives_per_thread) {
+		for (int i = 0; i < (int)bin_dives.size(); ++i)
+			calculate(i);
+	} else {
+		parallel_for((int)bin_dives.size(), &call_func<decltype(calculate)>, &calculate);
+	}
+
 	std::vector<StatsBinValue<T>> res;
 	res.reserve(bin_dives.size());
-	for (auto &[bin, dives]: bin_dives) {
-		T v = func(dives);
+	for (size_t i = 0; i < bin_dives.size(); ++i) {
+		T &v = values[i];
 		if (is_invalid_value(v) && (res.empty() || !fill_empty))
 			continue;
-		res.push_back({ std::move(bin), v });
+		res.push_back({ std::move(bin_dives[i].bin), std::move(v) });
 	}
 	if (res.empty())
 		return res;
@@ -662,6 +687,59 @@ void register_bin_value(std::vector<std::pair<BinValueType, ValueType>> &v,
 	add_dive_func(it->second);				// Register dive
 }
 
+// Merge two (bin-value, dives)-pair vectors that are sorted by bin-value.
+// The dives of the second vector are appended to the dives of the same bin
+// in the first vector, so that the order of the dives in the bins is kept.
+template<typename BinValueType>
+std::vector<std::pair<BinValueType, std::vector<dive *>>>
+merge_bin_values(std::vector<std::pair<BinValueType, std::vector<dive *>>> &v1,
+		 std::vector<std::pair<BinValueType, std::vector<dive *>>> &v2)
+{
+	std::vector<std::pair<BinValueType, std::vector<dive *>>> res;
+	res.reserve(v1.size() + v2.size());
+	auto it1 = v1.begin(), it2 = v2.begin();
+	while (it1 != v1.end() || it2 != v2.end()) {
+		if (it2 == v2.end() || (it1 != v1.end() && it1->first < it2->first)) {
+			res.push_back(std::move(*it1++));
+		} else if (it1 == v1.end() || it2->first < it1->first) {
+			res.push_back(std::move(*it2++));
+		} else {
+			res.push_back(std::move(*it1++));
+			std::vector<dive *> &dives = res.back().second;
+			dives.insert(dives.end(), it2->second.begin(), it2->second.end());
+			++it2;
+		}
+	}
+	return res;
+}
+
+// Collect a sorted (bin-value, dives)-pair vector. The add_dive_func(v, d)
+// function registers the dive d in the vector v, typically using
+// register_bin_value(). For large numbers of dives, the dives are split
+// into one consecutive range per thread. The ranges are binned on the
+// global thread pool into partial vectors, which are merged at the end.
+template<typename BinValueType, typename AddDiveFunc>
+std::vector<std::pair<BinValueType, std::vector<dive *>>>
+collect_bin_values(const std::vector<dive *> &dives, AddDiveFunc add_dive_func)
+{
+	using Pair = std::pair<BinValueType, std::vector<dive *>>;
+	int num_dives = (int)dives.size();
+	int num_parts = std::clamp(num_dives / stats_min_dives_per_thread, 1, std::max(QThreadPool::globalInstance()->maxThreadCount(), 1));
+	std::vector<std::vector<Pair>> parts(num_parts);
+	auto bin_part = [&dives, &parts, &add_dive_func, num_dives, num_parts](int idx) {
+		int from = (int)((long long)num_dives * idx / num_parts);
+		int to = (int)((long long)num_dives * (idx + 1) / num_parts);
+		for (int i = from; i < to; ++i)
+			add_dive_func(parts[idx], dives[i]);
+	};
+	parallel_for(num_parts, &call_func<decltype(bin_part)>, &bin_part);
+
+	std::vector<Pair> res = std::move(parts[0]);
+	for (int i = 1; i < num_parts; ++i)
+		res = merge_bin_values(res, parts[i]);
+	return res;
+}
+
 // Turn a (bin-value, value)-pair vector into a (bin, value)-pair vector.
 // The values are moved out of the first vectors.
 // If fill_empty is true, missing bins will be completed with a default constructed
@@ -691,14 +769,14 @@ std::vector<StatsBinDives> SimpleBinner<Binner, Bin>::bin_dives(const std::vecto
 	// First, collect a value / dives vector and then produce the final vector
 	// out of that. I wonder if that is premature optimization?
 	using Pair = std::pair<Type, std::vector<dive *>>;
-	std::vector<Pair> value_bins;
-	for (dive *d: dives) {
-		Type value = derived().to_bin_value(d);
-		if (is_invalid_value(value))
-			continue;
-		register_bin_value(value_bins, value,
-				   [d](std::vector<dive *> &v) { v.push_back(d); });
-	}
+	std::vector<Pair> value_bins = collect_bin_values<Type>(dives,
+		[this](std::vector<Pair> &bins, dive *d) {
+			Type value = derived().to_bin_value(d);
+			if (is_invalid_value(value))
+				return;
+			register_bin_value(bins, value,
+					   [d](std::vector<dive *> &v) { v.push_back(d); });
+		});
 
 	// Now, turn that into our result array with allocated bin objects.
 	return value_vector_to_bin_vector<Bin>(*this, value_bins, fill_empty);
@@ -814,15 +892,15 @@ std::vector<StatsBinDives> MultiBinner<Binner, Bin>::bin_dives(const std::vector
 	// First, collect a value / dives vector and then produce the final vector
 	// out of that. I wonder if that is premature optimization?
 	using Pair = std::pair<Type, std::vector<dive *>>;
-	std::vector<Pair> value_bins;
-	for (dive *d: dives) {
-		for (const Type &val: derived().to_bin_values(d)) {
-			if (is_invalid_value(val))
-				continue;
-			register_bin_value(value_bins, val,
-					   [d](std::vector<dive *> &v) { v.push_back(d); });
-		}
-	}
+	std::vector<Pair> value_bins = collect_bin_values<Type>(dives,
+		[this](std::vector<Pair> &bins, dive *d) {
+			for (const Type &val: derived().to_bin_values(d)) {
+				if (is_invalid_value(val))
+					continue;
+				register_bin_value(bins, val,
+						   [d](std::vector<dive *> &v) { v.push_back(d); });
+			}
+		});
 
 	// Now, turn that into our result array with allocated bin objects.
 	return value_vector_to_bin_vector<Bin>(*this, value_bins, false);
@@ -1297,8 +1375,9 @@ struct WeightBinner : public IntRangeBinner<WeightBinner, IntBin> {
 		return get_weight_unit(metric);
 	}
 	int to_bin_value(const dive *d) const {
-		return metric ? total_weight(d) / 1000 / bin_size
-			      : lrint(grams_to_lbs(total_weight(d))) / bin_size;
+		int weight = DiveFeatures::calculate(d, DiveFeature::TotalWeight);
+		return metric ? weight / 1000 / bin_size
+			      : lrint(grams_to_lbs(weight)) / bin_size;
 	}
 };
 
@@ -1328,8 +1407,9 @@ struct WeightVariable : public StatsVariableTemplate<StatsVariable::Type::Numeri
 			return { &weight_binner_2lbs, &weight_binner_5lbs, &weight_binner_10lbs, &weight_binner_20lbs };
 	}
 	double toFloat(const dive *d) const override {
-		return prefs.units.weight == units::KG ? total_weight(d) / 1000.0
-						       : grams_to_lbs(total_weight(d));
+		int weight = DiveFeatures::calculate(d, DiveFeature::TotalWeight);
+		return prefs.units.weight == units::KG ? weight / 1000.0
+						       : grams_to_lbs(weight);
 	}
 	std::vector<StatsOperation> supportedOperations() const override {
 		return { StatsOperation::Median, StatsOperation::Mean, StatsOperation::Sum, StatsOperation::Min, StatsOperation::Max };
@@ -1648,17 +1728,10 @@ struct GasTypeVariable : public StatsVariableTemplate<StatsVariable::Type::Discr
 //  - max_he: get cylinder with maximum he content, otherwise with maximum o2 content
 static int get_gas_content(const struct dive *d, bool he, bool max_he)
 {
-	if (d->cylinders.nr <= 0)
-		return invalid_value<int>();
-	// If sorting be He, the second sort criterion is O2 descending, because
-	// we are interested in the "bottom gas": highest He and lowest O2.
-	auto comp = max_he ? [] (const cylinder_t &c1, const cylinder_t &c2)
-				{ return std::make_tuple(get_he(c1.gasmix), -get_o2(c1.gasmix)) <
-					 std::make_tuple(get_he(c2.gasmix), -get_o2(c2.gasmix)); }
-			   : [] (const cylinder_t &c1, const cylinder_t &c2)
-				{ return get_o2(c1.gasmix) < get_o2(c2.gasmix); };
-	auto it = std::max_element(d->cylinders.cylinders, d->cylinders.cylinders + d->cylinders.nr, comp);
-	return he ? get_he(it->gasmix) : get_o2(it->gasmix);
+	DiveFeature feature = he ? DiveFeature::MaxHe :
+			      max_he ? DiveFeature::BottomGasO2 : DiveFeature::MaxO2;
+	int res = DiveFeatures::calculate(d, feature);
+	return res == DiveFeatures::NoValue ? invalid_value<int>() : res;
 }
 
 // We use the same binner for all gas contents
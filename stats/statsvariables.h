@@ -146,6 +146,10 @@ private:
 
 extern const std::vector<const StatsVariable *> stats_variables;
 
+// Binning is only distributed over the thread pool if there are at least
+// this many dives per thread. Can be changed by the tests.
+extern int stats_min_dives_per_thread;
+
 // Helper function for date-based variables
 extern double date_to_double(int year, int month, int day);
 
@@ -10,6 +10,7 @@
 #include "scatterseries.h"
 #include "statsaxis.h"
 #include "statscolors.h"
+#include "statsdives.h"
 #include "statsgrid.h"
 #include "statshelper.h"
 #include "statsstate.h"
@@ -23,6 +24,7 @@
 
 #include <array> // for std::array
 #include <cmath>
+#include <QtConcurrent>
 #include <QQuickItem>
 #include <QQuickWindow>
 #include <QSGImageNode>
@@ -34,6 +36,8 @@ static const double sceneBorder = 5.0;			// Border between scene edges and stati
 static const double titleBorder = 2.0;			// Border between title and chart
 static const double selectionLassoWidth = 2.0;		// Border between title and chart
 
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
 StatsView::StatsView(QQuickItem *parent) : QQuickItem(parent),
 	backgroundDirty(true),
 	currentTheme(&getStatsTheme(false)),
@@ -42,17 +46,33 @@ StatsView::StatsView(QQuickItem *parent) : QQuickItem(parent),
 	yAxis(nullptr),
 	draggedItem(nullptr),
 	restrictDives(false),
-	rootNode(nullptr)
+	rootNode(nullptr),
+	plotGeneration(0)
 {
 	setFlag(ItemHasContents, true);
 
 	connect(&diveListNotifier, &DiveListNotifier::numShownChanged, this, &StatsView::replotIfVisible);
 	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &StatsView::replotIfVisible);
-	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &StatsView::replotIfVisible);
-	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &StatsView::replotIfVisible);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &StatsView::divesRemoved);
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &StatsView::divesRemoved);
 	connect(&diveListNotifier, &DiveListNotifier::settingsChanged, this, &StatsView::replotIfVisible);
 	connect(&diveListNotifier, &DiveListNotifier::divesSelected, this, &StatsView::divesSelected);
 
+	// A calculation that is running while the dives are edited works on copies of the old dives, so it is restarted
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::divesMovedBetweenTrips, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::weightAdded, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::weightRemoved, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::weightEdited, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::tripChanged, this, &StatsView::divesEdited);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &StatsView::divesEdited);
+
 	setAcceptHoverEvents(true);
 	setAcceptedMouseButtons(Qt::LeftButton);
 }
@@ -63,6 +83,7 @@ StatsView::StatsView() : StatsView(nullptr)
 
 StatsView::~StatsView()
 {
+	abortPlot();
 }
 
 void StatsView::mousePressEvent(QMouseEvent *event)
@@ -393,6 +414,21 @@ void StatsView::replotIfVisible()
 		plot(state);
 }
 
+void StatsView::divesEdited()
+{
+	if (plotFuture.isRunning())
+		plotChart();
+}
+
+// The results of a running calculation would refer to removed dives, which may be freed
+void StatsView::divesRemoved()
+{
+	abortPlot();
+	reset();
+	update();
+	replotIfVisible();
+}
+
 void StatsView::divesSelected(const QVector<dive *> &dives)
 {
 	if (isVisible()) {
@@ -538,9 +574,6 @@ void StatsView::plot(const StatsState &stateIn)
 {
 	state = stateIn;
 	plotChart();
-	updateFeatures(); // Show / hide chart features, such as legend, etc.
-	plotAreaChanged(plotRect.size());
-	update();
 }
 
 void StatsView::updateFeatures(const StatsState &stateIn)
@@ -550,11 +583,59 @@ void StatsView::updateFeatures(const StatsState &stateIn)
 	update();
 }
 
+// The bins of a chart. Which fields are used depends on the chart type.
+struct StatsView::ChartData {
+	int generation;
+	std::shared_ptr<StatsDives> dives;			// The copies of the dives that were binned
+	std::vector<StatsBinDives> binDives;			// Count, bar, pie and histogram charts
+	std::vector<std::vector<StatsBinDives>> valueBins;	// Bar charts: the value bins of each category bin
+	std::vector<StatsBinOp> binOps;				// Value charts
+	std::vector<StatsBinQuartiles> binQuartiles;		// Box charts
+	std::vector<StatsBinValues> binValues;			// Discrete scatter charts
+	std::vector<StatsQuartiles> quartiles;			// Discrete scatter charts: the quartiles of each bin
+	double mean = NaN, median = NaN;			// Histogram count charts of numeric variables
+	std::vector<StatsScatterItem> points;			// Scatter plots
+	regression_data regression;				// Scatter plots
+	void toOriginals();
+};
+
+// The bins contain the copies of the dives, but the chart shows and selects the dives of the dive list
+void StatsView::ChartData::toOriginals()
+{
+	for (StatsBinDives &bin: binDives)
+		dives->toOriginals(bin.value);
+	for (std::vector<StatsBinDives> &bins: valueBins) {
+		for (StatsBinDives &bin: bins)
+			dives->toOriginals(bin.value);
+	}
+	for (StatsBinOp &bin: binOps)
+		dives->toOriginals(bin.value.dives);
+	for (StatsBinQuartiles &bin: binQuartiles)
+		dives->toOriginals(bin.value.dives);
+	for (StatsBinValues &bin: binValues) {
+		for (StatsValue &v: bin.value)
+			v.d = dives->original(v.d);
+	}
+	for (StatsQuartiles &q: quartiles)
+		dives->toOriginals(q.dives);
+	for (StatsScatterItem &p: points)
+		p.d = dives->original(p.d);
+}
+
+void StatsView::abortPlot()
+{
+	if (plotCancelled)
+		*plotCancelled = true;
+	plotFuture.waitForFinished();
+	++plotGeneration;
+}
+
+// Copy the dives on the GUI thread and calculate the bins of the copies on the thread pool
 void StatsView::plotChart()
 {
+	abortPlot();
 	if (!state.var1)
 		return;
-	reset();
 
 	std::vector<dive *> dives;
 	if (restrictDives) {
@@ -569,33 +650,65 @@ void StatsView::plotChart()
 	} else {
 		dives = DiveFilter::instance()->visibleDives();
 	}
+
+	std::shared_ptr<StatsDives> copies = std::make_shared<StatsDives>(dives);
+	std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+	plotCancelled = cancelled;
+	int generation = plotGeneration;
+	plotFuture = QtConcurrent::run([this, s = state, copies, cancelled, generation]() {
+		std::shared_ptr<ChartData> data = calculateChartData(s, copies->copies(), *cancelled);
+		if (!data || *cancelled)
+			return;
+		data->generation = generation;
+		data->dives = copies;
+		// Delivered on the GUI thread. The view waits for this function in its destructor.
+		QMetaObject::invokeMethod(this, [this, data]() { chartDataCalculated(data); }, Qt::QueuedConnection);
+	});
+}
+
+void StatsView::chartDataCalculated(std::shared_ptr<ChartData> data)
+{
+	// The result of a cancelled or superseded calculation
+	if (data->generation != plotGeneration)
+		return;
+	data->toOriginals();
+	reset();
+	chartDives = data->dives;
+	plotChartData(*data);
+	updateFeatures(); // Show / hide chart features, such as legend, etc.
+	plotAreaChanged(plotRect.size());
+	update();
+}
+
+void StatsView::plotChartData(ChartData &data)
+{
 	switch (state.type) {
 	case ChartType::DiscreteBar:
-		return plotBarChart(dives, state.subtype, state.sortMode1, state.var1, state.var1Binner,
+		return plotBarChart(data, state.subtype, state.var1, state.var1Binner,
 				    state.var2, state.var2Binner);
 	case ChartType::DiscreteValue:
-		return plotValueChart(dives, state.subtype, state.sortMode1,
+		return plotValueChart(data, state.subtype,
 				      state.var1, state.var1Binner, state.var2, state.var2Operation);
 	case ChartType::DiscreteCount:
-		return plotDiscreteCountChart(dives, state.subtype, state.sortMode1, state.var1, state.var1Binner);
+		return plotDiscreteCountChart(data, state.subtype, state.var1, state.var1Binner);
 	case ChartType::Pie:
-		return plotPieChart(dives, state.sortMode1, state.var1, state.var1Binner);
+		return plotPieChart(data, state.sortMode1, state.var1, state.var1Binner);
 	case ChartType::DiscreteBox:
-		return plotDiscreteBoxChart(dives, state.var1, state.var1Binner, state.var2);
+		return plotDiscreteBoxChart(data, state.var1, state.var1Binner, state.var2);
 	case ChartType::DiscreteScatter:
-		return plotDiscreteScatter(dives, state.var1, state.var1Binner, state.var2);
+		return plotDiscreteScatter(data, state.var1, state.var1Binner, state.var2);
 	case ChartType::HistogramCount:
-		return plotHistogramCountChart(dives, state.subtype, state.var1, state.var1Binner);
+		return plotHistogramCountChart(data, state.subtype, state.var1, state.var1Binner);
 	case ChartType::HistogramValue:
-		return plotHistogramValueChart(dives, state.subtype, state.var1, state.var1Binner, state.var2,
+		return plotHistogramValueChart(data, state.subtype, state.var1, state.var1Binner, state.var2,
 					       state.var2Operation);
 	case ChartType::HistogramStacked:
-		return plotHistogramStackedChart(dives, state.subtype, state.var1, state.var1Binner,
+		return plotHistogramStackedChart(data, state.subtype, state.var1, state.var1Binner,
 						 state.var2, state.var2Binner);
 	case ChartType::HistogramBox:
-		return plotHistogramBoxChart(dives, state.var1, state.var1Binner, state.var2);
+		return plotHistogramBoxChart(data, state.var1, state.var1Binner, state.var2);
 	case ChartType::ScatterPlot:
-		return plotScatter(dives, state.var1, state.var2);
+		return plotScatter(data, state.var1, state.var2);
 	case ChartType::Invalid:
 		return;
 	default:
@@ -663,17 +776,20 @@ struct BarPlotData {
 	std::vector<QString> vbinNames;
 	int maxCount;				// Highest count of any bin-combination
 	int maxCategoryCount;			// Highest count of any category bin
-	// Attention: categoryBin argument will be consumed!
-	BarPlotData(std::vector<StatsBinDives> &categoryBins, const StatsBinner &valuebinner);
+	// Attention: the categoryBins and valueBins arguments will be consumed!
+	// valueBins are the value bins of the dives of each category bin.
+	BarPlotData(std::vector<StatsBinDives> &categoryBins, std::vector<std::vector<StatsBinDives>> &valueBins,
+		    const StatsBinner &valuebinner);
 };
 
-BarPlotData::BarPlotData(std::vector<StatsBinDives> &categoryBins, const StatsBinner &valueBinner) :
+BarPlotData::BarPlotData(std::vector<StatsBinDives> &categoryBins, std::vector<std::vector<StatsBinDives>> &valueBins,
+			 const StatsBinner &valueBinner) :
 	maxCount(0), maxCategoryCount(0)
 {
-	for (auto &[bin, dives]: categoryBins) {
+	for (size_t i = 0; i < categoryBins.size(); ++i) {
 		// This moves the bin - the original pointer is invalidated
-		hbins.push_back({ std::move(bin), std::vector<std::vector<dive *>>(vbins.size()), 0 });
-		for (auto &[vbin, dives]: valueBinner.bin_dives(dives, false)) {
+		hbins.push_back({ std::move(categoryBins[i].bin), std::vector<std::vector<dive *>>(vbins.size()), 0 });
+		for (auto &[vbin, dives]: valueBins[i]) {
 			// Note: we assume that the bins are sorted!
 			auto it = std::lower_bound(vbins.begin(), vbins.end(), vbin,
 						   [] (const StatsBinPtr &p, const StatsBinPtr &bin)
@@ -726,8 +842,7 @@ static std::vector<BarSeries::MultiItem::Item> makeMultiItems(std::vector<std::v
 	return res;
 }
 
-void StatsView::plotBarChart(const std::vector<dive *> &dives,
-			     ChartSubType subType, ChartSortMode sortMode,
+void StatsView::plotBarChart(ChartData &chartData, ChartSubType subType,
 			     const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 			     const StatsVariable *valueVariable, const StatsBinner *valueBinner)
 {
@@ -736,14 +851,7 @@ void StatsView::plotBarChart(const std::vector<dive *> &dives,
 
 	setTitle(valueVariable->nameWithBinnerUnit(*valueBinner));
 
-	std::vector<StatsBinDives> categoryBins = categoryBinner->bin_dives(dives, false);
-
-	if (sortMode == ChartSortMode::Count) {
-		// Note: we sort by count in reverse order, as this is probably what the user desires(?).
-		std::sort(categoryBins.begin(), categoryBins.end(),
-			  [](const StatsBinDives &b1, const StatsBinDives &b2)
-			  { return b1.value.size() > b2.value.size(); });
-	}
+	std::vector<StatsBinDives> &categoryBins = chartData.binDives;
 
 	bool isStacked = subType == ChartSubType::VerticalStacked || subType == ChartSubType::HorizontalStacked;
 	bool isHorizontal = subType == ChartSubType::HorizontalGrouped || subType == ChartSubType::HorizontalStacked;
@@ -753,7 +861,7 @@ void StatsView::plotBarChart(const std::vector<dive *> &dives,
 	CategoryAxis *catAxis = createCategoryAxis(categoryVariable->nameWithBinnerUnit(*categoryBinner),
 						   *categoryBinner, categoryBins, !isHorizontal);
 
-	BarPlotData data(categoryBins, *valueBinner);
+	BarPlotData data(categoryBins, chartData.valueBins, *valueBinner);
 
 	int maxVal = isStacked ? data.maxCategoryCount : data.maxCount;
 	CountAxis *valAxis = createCountAxis(maxVal, isHorizontal);
@@ -778,8 +886,6 @@ void StatsView::plotBarChart(const std::vector<dive *> &dives,
 	createSeries<BarSeries>(isHorizontal, isStacked, categoryVariable->name(), valueVariable, std::move(data.vbinNames), std::move(items));
 }
 
-const double NaN = std::numeric_limits<double>::quiet_NaN();
-
 // These templates are used to extract min and max y-values of various lists.
 // A bit too convoluted for my tastes - can we make that simpler?
 static std::pair<double, double> getMinMaxValueBase(const std::vector<StatsValue> &values)
@@ -844,8 +950,7 @@ static std::pair<double, double> getMinMaxValue(const std::vector<StatsBinOp> &b
 	return found ? std::make_pair(min, max) : std::make_pair(0.0, 0.0);
 }
 
-void StatsView::plotValueChart(const std::vector<dive *> &dives,
-			       ChartSubType subType, ChartSortMode sortMode,
+void StatsView::plotValueChart(ChartData &data, ChartSubType subType,
 			       const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 			       const StatsVariable *valueVariable, StatsOperation valueAxisOperation)
 {
@@ -854,23 +959,12 @@ void StatsView::plotValueChart(const std::vector<dive *> &dives,
 
 	setTitle(QStringLiteral("%1 (%2)").arg(valueVariable->name(), StatsVariable::operationName(valueAxisOperation)));
 
-	std::vector<StatsBinOp> categoryBins = valueVariable->bin_operations(*categoryBinner, dives, false);
+	std::vector<StatsBinOp> &categoryBins = data.binOps;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
 		return;
 
-	if (sortMode == ChartSortMode::Count) {
-		// Note: we sort by count in reverse order, as this is probably what the user desires(?).
-		std::sort(categoryBins.begin(), categoryBins.end(),
-			  [](const StatsBinOp &b1, const StatsBinOp &b2)
-			  { return b1.value.dives.size() > b2.value.dives.size(); });
-	} else if (sortMode == ChartSortMode::Value) {
-		std::sort(categoryBins.begin(), categoryBins.end(),
-			  [valueAxisOperation](const StatsBinOp &b1, const StatsBinOp &b2)
-			  { return b1.value.get(valueAxisOperation) < b2.value.get(valueAxisOperation); });
-	}
-
 	bool isHorizontal = subType == ChartSubType::Horizontal;
 	const auto [minValue, maxValue] = getMinMaxValue(categoryBins, valueAxisOperation);
 	int decimals = valueVariable->decimals();
@@ -919,8 +1013,7 @@ static int getMaxCount(const std::vector<T> &bins)
 	return res;
 }
 
-void StatsView::plotDiscreteCountChart(const std::vector<dive *> &dives,
-				      ChartSubType subType, ChartSortMode sortMode,
+void StatsView::plotDiscreteCountChart(ChartData &data, ChartSubType subType,
 				      const StatsVariable *categoryVariable, const StatsBinner *categoryBinner)
 {
 	if (!categoryBinner)
@@ -928,19 +1021,12 @@ void StatsView::plotDiscreteCountChart(const std::vector<dive *> &dives,
 
 	setTitle(categoryVariable->nameWithBinnerUnit(*categoryBinner));
 
-	std::vector<StatsBinDives> categoryBins = categoryBinner->bin_dives(dives, false);
+	std::vector<StatsBinDives> &categoryBins = data.binDives;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
 		return;
 
-	if (sortMode == ChartSortMode::Count) {
-		// Note: we sort by count in reverse order, as this is probably what the user desires(?).
-		std::sort(categoryBins.begin(), categoryBins.end(),
-			  [](const StatsBinDives &b1, const StatsBinDives &b2)
-			  { return b1.value.size() > b2.value.size(); });
-	}
-
 	int total = getTotalCount(categoryBins);
 	bool isHorizontal = subType != ChartSubType::Vertical;
 
@@ -968,7 +1054,7 @@ void StatsView::plotDiscreteCountChart(const std::vector<dive *> &dives,
 	createSeries<BarSeries>(isHorizontal, categoryVariable->name(), std::move(items));
 }
 
-void StatsView::plotPieChart(const std::vector<dive *> &dives, ChartSortMode sortMode,
+void StatsView::plotPieChart(ChartData &chartData, ChartSortMode sortMode,
 			     const StatsVariable *categoryVariable, const StatsBinner *categoryBinner)
 {
 	if (!categoryBinner)
@@ -976,7 +1062,7 @@ void StatsView::plotPieChart(const std::vector<dive *> &dives, ChartSortMode sor
 
 	setTitle(categoryVariable->nameWithBinnerUnit(*categoryBinner));
 
-	std::vector<StatsBinDives> categoryBins = categoryBinner->bin_dives(dives, false);
+	std::vector<StatsBinDives> &categoryBins = chartData.binDives;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
@@ -992,7 +1078,7 @@ void StatsView::plotPieChart(const std::vector<dive *> &dives, ChartSortMode sor
 	legend = createChartItem<Legend>(series->binNames());
 }
 
-void StatsView::plotDiscreteBoxChart(const std::vector<dive *> &dives,
+void StatsView::plotDiscreteBoxChart(ChartData &data,
 				     const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 				     const StatsVariable *valueVariable)
 {
@@ -1001,7 +1087,7 @@ void StatsView::plotDiscreteBoxChart(const std::vector<dive *> &dives,
 
 	setTitle(valueVariable->name());
 
-	std::vector<StatsBinQuartiles> categoryBins = valueVariable->bin_quartiles(*categoryBinner, dives, false);
+	std::vector<StatsBinQuartiles> &categoryBins = data.binQuartiles;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
@@ -1026,7 +1112,7 @@ void StatsView::plotDiscreteBoxChart(const std::vector<dive *> &dives,
 	}
 }
 
-void StatsView::plotDiscreteScatter(const std::vector<dive *> &dives,
+void StatsView::plotDiscreteScatter(ChartData &data,
 				    const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 				    const StatsVariable *valueVariable)
 {
@@ -1035,7 +1121,7 @@ void StatsView::plotDiscreteScatter(const std::vector<dive *> &dives,
 
 	setTitle(valueVariable->name());
 
-	std::vector<StatsBinValues> categoryBins = valueVariable->bin_values(*categoryBinner, dives, false);
+	std::vector<StatsBinValues> &categoryBins = data.binValues;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
@@ -1053,10 +1139,10 @@ void StatsView::plotDiscreteScatter(const std::vector<dive *> &dives,
 	ScatterSeries *series = createSeries<ScatterSeries>(*categoryVariable, *valueVariable);
 
 	double x = 0.0;
-	for (const auto &[bin, array]: categoryBins) {
-		for (auto [v, d]: array)
+	for (size_t i = 0; i < categoryBins.size(); ++i) {
+		for (auto [v, d]: categoryBins[i].value)
 			series->append(d, x, v);
-		StatsQuartiles quartiles = StatsVariable::quartiles(array);
+		const StatsQuartiles &quartiles = data.quartiles[i];
 		if (quartiles.isValid()) {
 			quartileMarkers.push_back(createChartItem<QuartileMarker>(
 					x, quartiles.q1, catAxis, valAxis));
@@ -1091,7 +1177,7 @@ HistogramAxis *StatsView::createHistogramAxis(const QString &name, const StatsBi
 	return createAxis<HistogramAxis>(name, std::move(labels), isHorizontal);
 }
 
-void StatsView::plotHistogramCountChart(const std::vector<dive *> &dives,
+void StatsView::plotHistogramCountChart(ChartData &data,
 					ChartSubType subType,
 					const StatsVariable *categoryVariable, const StatsBinner *categoryBinner)
 {
@@ -1100,7 +1186,7 @@ void StatsView::plotHistogramCountChart(const std::vector<dive *> &dives,
 
 	setTitle(categoryVariable->name());
 
-	std::vector<StatsBinDives> categoryBins = categoryBinner->bin_dives(dives, true);
+	std::vector<StatsBinDives> &categoryBins = data.binDives;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
@@ -1135,17 +1221,13 @@ void StatsView::plotHistogramCountChart(const std::vector<dive *> &dives,
 
 	createSeries<BarSeries>(isHorizontal, categoryVariable->name(), std::move(items));
 
-	if (categoryVariable->type() == StatsVariable::Type::Numeric) {
-		double mean = categoryVariable->mean(dives);
-		if (!std::isnan(mean))
-			meanMarker = createChartItem<HistogramMarker>(mean, isHorizontal, currentTheme->meanMarkerColor, xAxis, yAxis);
-		double median = categoryVariable->quartiles(dives).q2;
-		if (!std::isnan(median))
-			medianMarker = createChartItem<HistogramMarker>(median, isHorizontal, currentTheme->medianMarkerColor, xAxis, yAxis);
-	}
+	if (!std::isnan(data.mean))
+		meanMarker = createChartItem<HistogramMarker>(data.mean, isHorizontal, currentTheme->meanMarkerColor, xAxis, yAxis);
+	if (!std::isnan(data.median))
+		medianMarker = createChartItem<HistogramMarker>(data.median, isHorizontal, currentTheme->medianMarkerColor, xAxis, yAxis);
 }
 
-void StatsView::plotHistogramValueChart(const std::vector<dive *> &dives,
+void StatsView::plotHistogramValueChart(ChartData &data,
 					ChartSubType subType,
 					const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 					const StatsVariable *valueVariable, StatsOperation valueAxisOperation)
@@ -1155,7 +1237,7 @@ void StatsView::plotHistogramValueChart(const std::vector<dive *> &dives,
 
 	setTitle(QStringLiteral("%1 (%2)").arg(valueVariable->name(), StatsVariable::operationName(valueAxisOperation)));
 
-	std::vector<StatsBinOp> categoryBins = valueVariable->bin_operations(*categoryBinner, dives, true);
+	std::vector<StatsBinOp> &categoryBins = data.binOps;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
@@ -1195,7 +1277,7 @@ void StatsView::plotHistogramValueChart(const std::vector<dive *> &dives,
 	createSeries<BarSeries>(isHorizontal, categoryVariable->name(), valueVariable, std::move(items));
 }
 
-void StatsView::plotHistogramStackedChart(const std::vector<dive *> &dives,
+void StatsView::plotHistogramStackedChart(ChartData &chartData,
 					  ChartSubType subType,
 					  const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 					  const StatsVariable *valueVariable, const StatsBinner *valueBinner)
@@ -1205,7 +1287,7 @@ void StatsView::plotHistogramStackedChart(const std::vector<dive *> &dives,
 
 	setTitle(valueVariable->nameWithBinnerUnit(*valueBinner));
 
-	std::vector<StatsBinDives> categoryBins = categoryBinner->bin_dives(dives, true);
+	std::vector<StatsBinDives> &categoryBins = chartData.binDives;
 
 	// Construct the histogram axis now, because the pointers to the bins
 	// will be moved away when constructing BarPlotData below.
@@ -1213,7 +1295,7 @@ void StatsView::plotHistogramStackedChart(const std::vector<dive *> &dives,
 	HistogramAxis *catAxis = createHistogramAxis(categoryVariable->nameWithBinnerUnit(*categoryBinner),
 						     *categoryBinner, categoryBins, !isHorizontal);
 
-	BarPlotData data(categoryBins, *valueBinner);
+	BarPlotData data(categoryBins, chartData.valueBins, *valueBinner);
 	legend = createChartItem<Legend>(data.vbinNames);
 
 	CountAxis *valAxis = createCountAxis(data.maxCategoryCount, isHorizontal);
@@ -1236,7 +1318,7 @@ void StatsView::plotHistogramStackedChart(const std::vector<dive *> &dives,
 	createSeries<BarSeries>(isHorizontal, true, categoryVariable->name(), valueVariable, std::move(data.vbinNames), std::move(items));
 }
 
-void StatsView::plotHistogramBoxChart(const std::vector<dive *> &dives,
+void StatsView::plotHistogramBoxChart(ChartData &data,
 				      const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 				      const StatsVariable *valueVariable)
 {
@@ -1245,7 +1327,7 @@ void StatsView::plotHistogramBoxChart(const std::vector<dive *> &dives,
 
 	setTitle(valueVariable->name());
 
-	std::vector<StatsBinQuartiles> categoryBins = valueVariable->bin_quartiles(*categoryBinner, dives, true);
+	std::vector<StatsBinQuartiles> &categoryBins = data.binQuartiles;
 
 	// If there is nothing to display, quit
 	if (categoryBins.empty())
@@ -1336,11 +1418,11 @@ static struct regression_data linear_regression(const std::vector<StatsScatterIt
 	return ret;
 }
 
-void StatsView::plotScatter(const std::vector<dive *> &dives, const StatsVariable *categoryVariable, const StatsVariable *valueVariable)
+void StatsView::plotScatter(ChartData &data, const StatsVariable *categoryVariable, const StatsVariable *valueVariable)
 {
 	setTitle(StatsTranslations::tr("%1 vs. %2").arg(valueVariable->name(), categoryVariable->name()));
 
-	std::vector<StatsScatterItem> points = categoryVariable->scatter(*valueVariable, dives);
+	const std::vector<StatsScatterItem> &points = data.points;
 	if (points.empty())
 		return;
 
@@ -1363,7 +1445,96 @@ void StatsView::plotScatter(const std::vector<dive *> &dives, const StatsVariabl
 		series->append(dive, x, y);
 
 	// y = ax + b
-	struct regression_data reg = linear_regression(points);
-	if (!std::isnan(reg.a))
-		regressionItem = createChartItem<RegressionItem>(reg, xAxis, yAxis);
+	if (!std::isnan(data.regression.a))
+		regressionItem = createChartItem<RegressionItem>(data.regression, xAxis, yAxis);
+}
+
+// Note: this runs on the thread pool and therefore must not access the view
+// or the dive list, only the copied dives. It checks for cancellation between
+// the binning steps.
+std::shared_ptr<StatsView::ChartData> StatsView::calculateChartData(const StatsState &state, const std::vector<dive *> &dives,
+								     const std::atomic<bool> &cancelled)
+{
+	std::shared_ptr<ChartData> data = std::make_shared<ChartData>();
+	const StatsBinner *binner = state.var1Binner;
+	bool histogram = state.type == ChartType::HistogramCount || state.type == ChartType::HistogramValue ||
+			 state.type == ChartType::HistogramStacked || state.type == ChartType::HistogramBox;
+	switch (state.type) {
+	case ChartType::DiscreteBar:
+	case ChartType::HistogramStacked:
+		if (!binner || !state.var2Binner)
+			break;
+		data->binDives = binner->bin_dives(dives, histogram);
+		// Note: we sort by count in reverse order, as this is probably what the user desires(?).
+		if (!histogram && state.sortMode1 == ChartSortMode::Count) {
+			std::sort(data->binDives.begin(), data->binDives.end(),
+				  [](const StatsBinDives &b1, const StatsBinDives &b2)
+				  { return b1.value.size() > b2.value.size(); });
+		}
+		for (const auto &[bin, binDives]: data->binDives) {
+			if (cancelled)
+				return nullptr;
+			data->valueBins.push_back(state.var2Binner->bin_dives(binDives, false));
+		}
+		break;
+	case ChartType::DiscreteCount:
+	case ChartType::Pie:
+	case ChartType::HistogramCount:
+		if (!binner)
+			break;
+		data->binDives = binner->bin_dives(dives, histogram);
+		if (state.type == ChartType::DiscreteCount && state.sortMode1 == ChartSortMode::Count) {
+			std::sort(data->binDives.begin(), data->binDives.end(),
+				  [](const StatsBinDives &b1, const StatsBinDives &b2)
+				  { return b1.value.size() > b2.value.size(); });
+		}
+		if (state.type == ChartType::HistogramCount && state.var1->type() == StatsVariable::Type::Numeric) {
+			if (cancelled)
+				return nullptr;
+			data->mean = state.var1->mean(dives);
+			data->median = state.var1->quartiles(dives).q2;
+		}
+		break;
+	case ChartType::DiscreteValue:
+	case ChartType::HistogramValue:
+		if (!binner)
+			break;
+		data->binOps = state.var2->bin_operations(*binner, dives, histogram);
+		if (histogram)
+			break;
+		if (state.sortMode1 == ChartSortMode::Count) {
+			std::sort(data->binOps.begin(), data->binOps.end(),
+				  [](const StatsBinOp &b1, const StatsBinOp &b2)
+				  { return b1.value.dives.size() > b2.value.dives.size(); });
+		} else if (state.sortMode1 == ChartSortMode::Value) {
+			StatsOperation op = state.var2Operation;
+			std::sort(data->binOps.begin(), data->binOps.end(),
+				  [op](const StatsBinOp &b1, const StatsBinOp &b2)
+				  { return b1.value.get(op) < b2.value.get(op); });
+		}
+		break;
+	case ChartType::DiscreteBox:
+	case ChartType::HistogramBox:
+		if (binner)
+			data->binQuartiles = state.var2->bin_quartiles(*binner, dives, histogram);
+		break;
+	case ChartType::DiscreteScatter:
+		if (!binner)
+			break;
+		data->binValues = state.var2->bin_values(*binner, dives, false);
+		if (cancelled)
+			return nullptr;
+		for (const auto &[bin, values]: data->binValues)
+			data->quartiles.push_back(StatsVariable::quartiles(values));
+		break;
+	case ChartType::ScatterPlot:
+		data->points = state.var1->scatter(*state.var2, dives);
+		if (cancelled)
+			return nullptr;
+		data->regression = linear_regression(data->points);
+		break;
+	default:
+		break;
+	}
+	return data;
 }
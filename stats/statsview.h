@@ -5,7 +5,9 @@
 #include "statsstate.h"
 #include "statshelper.h"
 #include "statsselection.h"
+#include <atomic>
 #include <memory>
+#include <QFuture>
 #include <QImage>
 #include <QPainter>
 #include <QQuickItem>
@@ -16,6 +18,7 @@ struct StatsBin;
 struct StatsState;
 struct StatsVariable;
 
+class StatsDives;
 class StatsSeries;
 class CategoryAxis;
 class ChartItem;
@@ -73,6 +76,8 @@ public:
 private slots:
 	void replotIfVisible();
 	void divesSelected(const QVector<dive *> &dives);
+	void divesEdited();
+	void divesRemoved();
 private:
 	// QtQuick related things
 	bool backgroundDirty;
@@ -86,39 +91,50 @@ private:
 #endif
 	void plotAreaChanged(const QSizeF &size);
 	void reset(); // clears all series and axes
+
+	// The bins of a chart are calculated from copies of the dives on the thread pool
+	// and the chart is then created on the GUI thread. The results of older plots are dropped.
+	struct ChartData;
+	static std::shared_ptr<ChartData> calculateChartData(const StatsState &state, const std::vector<dive *> &dives,
+							     const std::atomic<bool> &cancelled);
+	void chartDataCalculated(std::shared_ptr<ChartData> data);
+	void plotChartData(ChartData &data);
+	void abortPlot();	// Cancels the calculation, waits for it and drops its result
+	int plotGeneration;
+	QFuture<void> plotFuture;
+	std::shared_ptr<std::atomic<bool>> plotCancelled;
+	std::shared_ptr<StatsDives> chartDives;	// The bins of the chart refer to the copied dive sites and trips
+
 	void setAxes(StatsAxis *x, StatsAxis *y);
-	void plotBarChart(const std::vector<dive *> &dives,
-			  ChartSubType subType, ChartSortMode sortMode,
+	void plotBarChart(ChartData &data, ChartSubType subType,
 			  const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 			  const StatsVariable *valueVariable, const StatsBinner *valueBinner);
-	void plotValueChart(const std::vector<dive *> &dives,
-			    ChartSubType subType, ChartSortMode sortMode,
+	void plotValueChart(ChartData &data, ChartSubType subType,
 			    const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 			    const StatsVariable *valueVariable, StatsOperation valueAxisOperation);
-	void plotDiscreteCountChart(const std::vector<dive *> &dives,
-				    ChartSubType subType, ChartSortMode sortMode,
+	void plotDiscreteCountChart(ChartData &data, ChartSubType subType,
 				    const StatsVariable *categoryVariable, const StatsBinner *categoryBinner);
-	void plotPieChart(const std::vector<dive *> &dives, ChartSortMode sortMode,
+	void plotPieChart(ChartData &data, ChartSortMode sortMode,
 			  const StatsVariable *categoryVariable, const StatsBinner *categoryBinner);
-	void plotDiscreteBoxChart(const std::vector<dive *> &dives,
+	void plotDiscreteBoxChart(ChartData &data,
 				  const StatsVariable *categoryVariable, const StatsBinner *categoryBinner, const StatsVariable *valueVariable);
-	void plotDiscreteScatter(const std::vector<dive *> &dives,
+	void plotDiscreteScatter(ChartData &data,
 				 const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 				 const StatsVariable *valueVariable);
-	void plotHistogramCountChart(const std::vector<dive *> &dives,
+	void plotHistogramCountChart(ChartData &data,
 				     ChartSubType subType,
 				     const StatsVariable *categoryVariable, const StatsBinner *categoryBinner);
-	void plotHistogramValueChart(const std::vector<dive *> &dives,
+	void plotHistogramValueChart(ChartData &data,
 				     ChartSubType subType,
 				     const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 				     const StatsVariable *valueVariable, StatsOperation valueAxisOperation);
-	void plotHistogramStackedChart(const std::vector<dive *> &dives,
+	void plotHistogramStackedChart(ChartData &data,
 				       ChartSubType subType,
 				       const StatsVariable *categoryVariable, const StatsBinner *categoryBinner,
 				       const StatsVariable *valueVariable, const StatsBinner *valueBinner);
-	void plotHistogramBoxChart(const std::vector<dive *> &dives,
+	void plotHistogramBoxChart(ChartData &data,
 				   const StatsVariable *categoryVariable, const StatsBinner *categoryBinner, const StatsVariable *valueVariable);
-	void plotScatter(const std::vector<dive *> &dives, const StatsVariable *categoryVariable, const StatsVariable *valueVariable);
+	void plotScatter(ChartData &data, const StatsVariable *categoryVariable, const StatsVariable *valueVariable);
 	void setTitle(const QString &);
 	void updateTitlePos(); // After resizing, set title to correct position
 	void plotChart();
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testcolumndecimator.h"
+#include "profile-widget/columndecimator.h"
+
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+// A noisy depth profile, sampled every two seconds
+static std::vector<double> randomProfile(int count)
+{
+	QRandomGenerator random(42);
+	std::vector<double> res;
+	for (int i = 0; i < count; ++i)
+		res.push_back(30000.0 * sin(i * M_PI / count) + random.bounded(1000.0));
+	return res;
+}
+
+static std::vector<int> decimate(const std::vector<double> &values, double pixelsPerEntry)
+{
+	ColumnDecimator decimator;
+	for (int i = 0; i < (int)values.size(); ++i)
+		decimator.add(i, i * pixelsPerEntry, values[i]);
+	return decimator.finish();
+}
+
+struct Column {
+	int first = -1, last = -1;
+	double min = 0.0, max = 0.0;
+};
+
+static std::map<int, Column> columns(const std::vector<double> &values, const std::vector<int> &indexes, double pixelsPerEntry)
+{
+	std::map<int, Column> res;
+	for (int i: indexes) {
+		Column &column = res[static_cast<int>(floor(i * pixelsPerEntry))];
+		if (column.first < 0) {
+			column.first = i;
+			column.min = column.max = values[i];
+		}
+		column.last = i;
+		column.min = std::min(column.min, values[i]);
+		column.max = std::max(column.max, values[i]);
+	}
+	return res;
+}
+
+void TestColumnDecimator::testExtremaKept()
+{
+	// A long dive: about 50 entries per pixel column
+	std::vector<double> values = randomProfile(20000);
+	std::vector<int> all(values.size());
+	for (int i = 0; i < (int)all.size(); ++i)
+		all[i] = i;
+
+	const double pixelsPerEntry = 0.02;
+	std::vector<int> indexes = decimate(values, pixelsPerEntry);
+	QVERIFY(std::is_sorted(indexes.begin(), indexes.end()));
+	QVERIFY(std::adjacent_find(indexes.begin(), indexes.end()) == indexes.end());
+	QVERIFY(indexes.size() <= 4 * 400);
+	QCOMPARE(indexes.front(), 0);
+	QCOMPARE(indexes.back(), (int)values.size() - 1);
+
+	// Every column keeps its first and last entry as well as its minimum and maximum
+	std::map<int, Column> full = columns(values, all, pixelsPerEntry);
+	std::map<int, Column> decimated = columns(values, indexes, pixelsPerEntry);
+	QCOMPARE(decimated.size(), full.size());
+	for (auto &[pos, column]: full) {
+		const Column &res = decimated[pos];
+		QCOMPARE(res.first, column.first);
+		QCOMPARE(res.last, column.last);
+		QCOMPARE(res.min, column.min);
+		QCOMPARE(res.max, column.max);
+	}
+}
+
+void TestColumnDecimator::testZoomedIn()
+{
+	// When every entry has its own pixel column, the full polygon is plotted
+	std::vector<double> values = randomProfile(1000);
+	for (double pixelsPerEntry: { 1.0, 2.5, 10.0 }) {
+		std::vector<int> indexes = decimate(values, pixelsPerEntry);
+		QCOMPARE(indexes.size(), values.size());
+		for (int i = 0; i < (int)indexes.size(); ++i)
+			QCOMPARE(indexes[i], i);
+	}
+
+	// With two entries per column, nothing is dropped either
+	std::vector<int> indexes = decimate(values, 0.5);
+	QCOMPARE(indexes.size(), values.size());
+}
+
+void TestColumnDecimator::testSkippedEntries()
+{
+	// Entries that are not plotted, such as missing temperatures, are not passed to the decimator
+	std::vector<double> values = randomProfile(10000);
+	ColumnDecimator decimator;
+	for (int i = 0; i < (int)values.size(); ++i) {
+		if (i % 3 == 0)
+			decimator.add(i, i * 0.01, values[i]);
+	}
+	std::vector<int> indexes = decimator.finish();
+	QVERIFY(!indexes.empty());
+	for (int i: indexes)
+		QCOMPARE(i % 3, 0);
+	QCOMPARE(indexes.front(), 0);
+	QCOMPARE(indexes.back(), 9999);
+}
+
+QTEST_GUILESS_MAIN(TestColumnDecimator)
@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTCOLUMNDECIMATOR_H
+#define TESTCOLUMNDECIMATOR_H
+
+#include <QtTest>
+
+class TestColumnDecimator : public QObject {
+	Q_OBJECT
+private slots:
+	void testExtremaKept();
+	void testZoomedIn();
+	void testSkippedEntries();
+};
+
+#endif
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdcreplay.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/event.h"
+#include "core/file.h"
+#include "core/libdivecomputer.h"
+#include "core/pref.h"
+#include "core/sample.h"
+#include <QDir>
+
+// The recordings of downloads from dive computers, written next to the libdivecomputer
+// logfile. Add new recordings for dive computer families that aren't covered yet.
+static QStringList recordings()
+{
+	return QDir(SUBSURFACE_TEST_DATA "/dives").entryList({ "*.dives" }, QDir::Files, QDir::Name);
+}
+
+static QString recordingPath(const QString &name)
+{
+	return QString(SUBSURFACE_TEST_DATA "/dives/") + name;
+}
+
+static const char *replay(const QString &file, struct divelog *log)
+{
+	device_data_t data = {};
+	data.log = log;
+	data.force_download = true;
+	const char *err = do_libdivecomputer_replay(&data, qPrintable(file));
+	free((void *)data.model);
+	return err;
+}
+
+void TestDcReplay::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestDcReplay::replay_data()
+{
+	QTest::addColumn<QString>("file");
+	for (const QString &name: recordings())
+		QTest::newRow(qPrintable(name)) << recordingPath(name);
+}
+
+void TestDcReplay::replay()
+{
+	QFETCH(QString, file);
+	struct divelog log;
+
+	QCOMPARE(::replay(file, &log), nullptr);
+	QVERIFY(log.dives->nr > 0);
+	for (int i = 0; i < log.dives->nr; ++i) {
+		const struct dive *d = log.dives->dives[i];
+		QVERIFY(d->when > 0);
+		QVERIFY(d->dc.samples > 0);
+	}
+}
+
+static bool sameProfile(const struct divecomputer *dc1, const struct divecomputer *dc2)
+{
+	if (dc1->samples != dc2->samples || memcmp(dc1->sample, dc2->sample, dc1->samples * sizeof(struct sample)))
+		return false;
+	const struct event *ev1 = dc1->events, *ev2 = dc2->events;
+	for ( ; ev1 && ev2; ev1 = ev1->next, ev2 = ev2->next) {
+		if (ev1->time.seconds != ev2->time.seconds || ev1->type != ev2->type ||
+		    ev1->value != ev2->value || strcmp(ev1->name, ev2->name))
+			return false;
+	}
+	return !ev1 && !ev2;
+}
+
+// The OSTC recording contains the dives of the OSTCTools files, which
+// are parsed by libdc_buffer_parser(). Both paths must give the same profiles.
+void TestDcReplay::replayMatchesBufferParser()
+{
+	struct divelog replayed, imported;
+
+	QCOMPARE(::replay(recordingPath("ostc2n-recording.dives"), &replayed), nullptr);
+	ostctools_import(SUBSURFACE_TEST_DATA "/dives/ostc_00087_04-05-2014_043m_032min.dive", &imported);
+	ostctools_import(SUBSURFACE_TEST_DATA "/dives/ostc_00173_17-08-2013_027m_043min.dive", &imported);
+	sort_dive_table(replayed.dives);
+	sort_dive_table(imported.dives);
+
+	QCOMPARE(replayed.dives->nr, 2);
+	QCOMPARE(imported.dives->nr, 2);
+	for (int i = 0; i < 2; ++i) {
+		const struct dive *d1 = replayed.dives->dives[i];
+		const struct dive *d2 = imported.dives->dives[i];
+		QCOMPARE(d1->when, d2->when);
+		QCOMPARE(d1->dc.maxdepth.mm, d2->dc.maxdepth.mm);
+		QVERIFY(sameProfile(&d1->dc, &d2->dc));
+	}
+}
+
+void TestDcReplay::benchmark_data()
+{
+	replay_data();
+}
+
+// One row per dive computer family, so that QBENCHMARK reports the time per family
+void TestDcReplay::benchmark()
+{
+	QFETCH(QString, file);
+	int dives = 0;
+
+	QBENCHMARK {
+		struct divelog log;
+		::replay(file, &log);
+		dives = log.dives->nr;
+	}
+	QVERIFY(dives > 0);
+}
+
+QTEST_GUILESS_MAIN(TestDcReplay)
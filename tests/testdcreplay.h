@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDCREPLAY_H
+#define TESTDCREPLAY_H
+
+#include <QtTest>
+
+class TestDcReplay : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+
+	void replay_data();
+	void replay();
+	void replayMatchesBufferParser();
+	void benchmark_data();
+	void benchmark();
+};
+
+#endif
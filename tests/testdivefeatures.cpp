@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivefeatures.h"
+#include "core/dive.h"
+#include "core/divefeatures.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/pref.h"
+#include "core/subsurface-qt/divelistnotifier.h"
+
+// The cached values must be the same as the values calculated from scratch
+static void compareWithCalculation()
+{
+	DiveFeatures *features = DiveFeatures::instance();
+	for (int i = 0; i < divelog.dives->nr; ++i) {
+		const struct dive *d = get_dive(i);
+		for (int f = 0; f < (int)DiveFeature::Count; ++f)
+			QCOMPARE(features->get(d, (DiveFeature)f), DiveFeatures::calculate(d, (DiveFeature)f));
+	}
+}
+
+// Returns a dive with at least one weight system or cylinder
+static struct dive *findDive(bool weight)
+{
+	for (int i = 0; i < divelog.dives->nr; ++i) {
+		struct dive *d = get_dive(i);
+		if ((weight ? d->weightsystems.nr : d->cylinders.nr) > 0)
+			return d;
+	}
+	return nullptr;
+}
+
+void TestDiveFeatures::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestDiveFeatures::init()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	process_loaded_dives();
+	QVERIFY(divelog.dives->nr > 2);
+}
+
+void TestDiveFeatures::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestDiveFeatures::testLoad()
+{
+	compareWithCalculation();
+}
+
+void TestDiveFeatures::testEditWeight()
+{
+	compareWithCalculation();
+	struct dive *d = findDive(true);
+	QVERIFY(d);
+	d->weightsystems.weightsystems[0].weight.grams += 2000;
+	emit diveListNotifier.weightEdited(d, 0);
+	QCOMPARE(DiveFeatures::instance()->get(d, DiveFeature::TotalWeight), total_weight(d));
+	compareWithCalculation();
+}
+
+void TestDiveFeatures::testEditCylinder()
+{
+	compareWithCalculation();
+	struct dive *d = findDive(false);
+	QVERIFY(d);
+	d->cylinders.cylinders[0].gasmix.o2.permille = 320;
+	d->cylinders.cylinders[0].gasmix.he.permille = 0;
+	emit diveListNotifier.cylinderEdited(d, 0);
+	compareWithCalculation();
+	d->cylinders.cylinders[0].gasmix.o2.permille = 180;
+	d->cylinders.cylinders[0].gasmix.he.permille = 450;
+	emit diveListNotifier.cylinderEdited(d, 0);
+	compareWithCalculation();
+}
+
+// Changes that are not signalled are caught by the dive count
+void TestDiveFeatures::testReset()
+{
+	compareWithCalculation();
+	delete_single_dive(0);
+	compareWithCalculation();
+}
+
+QTEST_GUILESS_MAIN(TestDiveFeatures)
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVEFEATURES_H
+#define TESTDIVEFEATURES_H
+
+#include <QtTest>
+
+class TestDiveFeatures : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void init();
+	void cleanup();
+
+	void testLoad();
+	void testEditWeight();
+	void testEditCylinder();
+	void testReset();
+};
+
+#endif
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivelistperformance.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/qthelper.h"
+#include "core/trip.h"
+#include "qt-models/divetripmodel.h"
+#include <algorithm>
+
+// A log with many trips, as found in the logs of long-time divers
+static const int numTrips = 1000;
+static const int divesPerTrip = 20;
+
+static const char *suits[] = { "Drysuit", "Wetsuit 3mm", "Wetsuit 7mm", "Shorty", "Semi-dry" };
+static const char *buddies[] = { "Jürgen", "Ånne", "Olivier", "Ørjan", "Émile", "Zoë", "Dirk", "anna" };
+
+void TestDiveListPerformance::initTestCase()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+
+	timestamp_t when = 946684800;	// 2000-01-01
+	for (int i = 0; i < numTrips; ++i) {
+		dive_trip_t *trip = nullptr;
+		for (int j = 0; j < divesPerTrip; ++j) {
+			struct dive *d = alloc_dive();
+			d->when = when;
+			d->dc.when = when;
+			d->dc.duration.seconds = 45 * 60;
+			d->dc.maxdepth.mm = 30000;
+			d->dc.meandepth.mm = 15000;
+			d->duration = d->dc.duration;
+			d->maxdepth = d->dc.maxdepth;
+			d->suit = strdup(suits[(i + j) % 5]);
+			d->buddy = strdup(buddies[(i * 7 + j) % 8]);
+			add_to_dive_table(divelog.dives, divelog.dives->nr, d);
+			if (!trip)
+				trip = create_and_hookup_trip_from_dive(d, divelog.trips);
+			else
+				add_dive_to_trip(d, trip);
+			when += 4 * 3600;
+		}
+		when += 30 * 24 * 3600;
+	}
+	process_loaded_dives();
+}
+
+void TestDiveListPerformance::cleanupTestCase()
+{
+	clear_dive_file_data();
+}
+
+void TestDiveListPerformance::treeModelReset()
+{
+	DiveTripModelTree tree;
+	QAbstractItemModel &model = tree;
+	QCOMPARE(model.rowCount(), numTrips);
+	QBENCHMARK {
+		emit_reset_signal();
+	}
+	QCOMPARE(model.rowCount(), numTrips);
+	QCOMPARE(model.rowCount(model.index(0, 0)), divesPerTrip);
+}
+
+void TestDiveListPerformance::listModelReset()
+{
+	DiveTripModelList list;
+	QAbstractItemModel &model = list;
+	QCOMPARE(model.rowCount(), numTrips * divesPerTrip);
+	QBENCHMARK {
+		emit_reset_signal();
+	}
+}
+
+static void sortList(DiveTripModelBase::Column column)
+{
+	DiveTripModelList list;
+	const DiveTripModelBase &base = list;
+	QAbstractItemModel &model = list;
+	std::vector<QModelIndex> indices;
+	for (int i = 0; i < model.rowCount(); ++i)
+		indices.push_back(model.index(i, column));
+	QBENCHMARK {
+		std::vector<QModelIndex> sorted = indices;
+		std::sort(sorted.begin(), sorted.end(), [&base](const QModelIndex &i1, const QModelIndex &i2)
+			  { return base.lessThan(i1, i2); });
+	}
+}
+
+void TestDiveListPerformance::listSortBySuit()
+{
+	sortList(DiveTripModelBase::SUIT);
+}
+
+void TestDiveListPerformance::listSortByBuddy()
+{
+	sortList(DiveTripModelBase::BUDDIES);
+}
+
+QTEST_GUILESS_MAIN(TestDiveListPerformance)
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVELISTPERFORMANCE_H
+#define TESTDIVELISTPERFORMANCE_H
+
+#include <QtTest>
+
+class TestDiveListPerformance : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void treeModelReset();
+	void listModelReset();
+	void listSortBySuit();
+	void listSortByBuddy();
+};
+
+#endif
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivetripmodel.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/equipment.h"
+#include "core/pref.h"
+#include "core/tag.h"
+#include "core/subsurface-qt/divelistnotifier.h"
+#include "qt-models/divetripmodel.h"
+
+static struct dive *addDive(timestamp_t when, int weight)
+{
+	struct dive *d = alloc_dive();
+	d->when = d->dc.when = when;
+	d->dc.duration.seconds = d->duration.seconds = 45 * 60;
+	d->dc.maxdepth.mm = d->maxdepth.mm = 20000;
+	weightsystem_t ws = { { weight }, "belt", false };
+	add_cloned_weightsystem(&d->weightsystems, ws);
+	add_to_dive_table(divelog.dives, divelog.dives->nr, d);
+	return d;
+}
+
+// The text of a cell as shown by a freshly created model, i.e. without cached data
+static QVariant uncachedData(int row, int column)
+{
+	DiveTripModelList list;
+	QAbstractItemModel &model = list;
+	return model.data(model.index(row, column), Qt::DisplayRole);
+}
+
+void TestDiveTripModel::initTestCase()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestDiveTripModel::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestDiveTripModel::editWeight()
+{
+	struct dive *d = addDive(946684800, 4000);
+	process_loaded_dives();
+	DiveTripModelList list;
+	QAbstractItemModel &model = list;
+	QModelIndex idx = model.index(0, DiveTripModelBase::TOTALWEIGHT);
+	QVariant before = model.data(idx, Qt::DisplayRole);
+	QCOMPARE(before, uncachedData(0, DiveTripModelBase::TOTALWEIGHT));
+
+	// This is what the weight editing commands do
+	QSignalSpy spy(&model, &QAbstractItemModel::dataChanged);
+	d->weightsystems.weightsystems[0].weight.grams = 6000;
+	emit diveListNotifier.weightEdited(d, 0);
+	QVERIFY(spy.count() > 0);
+	QVariant after = model.data(idx, Qt::DisplayRole);
+	QVERIFY(after != before);
+	QCOMPARE(after, uncachedData(0, DiveTripModelBase::TOTALWEIGHT));
+
+	weightsystem_t ws = { { 2000 }, "ankle", false };
+	add_cloned_weightsystem(&d->weightsystems, ws);
+	emit diveListNotifier.weightAdded(d, 1);
+	QCOMPARE(model.data(idx, Qt::DisplayRole), uncachedData(0, DiveTripModelBase::TOTALWEIGHT));
+
+	remove_weightsystem(d, 0);
+	emit diveListNotifier.weightRemoved(d, 0);
+	QCOMPARE(model.data(idx, Qt::DisplayRole), uncachedData(0, DiveTripModelBase::TOTALWEIGHT));
+}
+
+void TestDiveTripModel::resetWeights()
+{
+	// Pasting weights to multiple dives resets the weight systems of these dives
+	struct dive *d1 = addDive(946684800, 4000);
+	struct dive *d2 = addDive(946684800 + 3600, 4000);
+	process_loaded_dives();
+	DiveTripModelList list;
+	QAbstractItemModel &model = list;
+	for (int row = 0; row < 2; ++row)
+		model.data(model.index(row, DiveTripModelBase::TOTALWEIGHT), Qt::DisplayRole);
+
+	d1->weightsystems.weightsystems[0].weight.grams = 8000;
+	d2->weightsystems.weightsystems[0].weight.grams = 8000;
+	emit diveListNotifier.weightsystemsReset(QVector<dive *> { d1, d2 });
+	for (int row = 0; row < 2; ++row) {
+		QCOMPARE(model.data(model.index(row, DiveTripModelBase::TOTALWEIGHT), Qt::DisplayRole),
+			 uncachedData(row, DiveTripModelBase::TOTALWEIGHT));
+	}
+}
+
+void TestDiveTripModel::sortEmptyTags()
+{
+	// Dives without tags compare equal to each other and sort before dives with tags
+	struct dive *d1 = addDive(946684800, 4000);
+	addDive(946684800 + 3600, 4000);
+	taglist_add_tag(&d1->tag_list, "wreck");
+	process_loaded_dives();
+	DiveTripModelList list;
+	const DiveTripModelBase &base = list;
+	QAbstractItemModel &model = list;
+	int tagged = model.data(model.index(0, DiveTripModelBase::TAGS), Qt::DisplayRole).toString().isEmpty() ? 1 : 0;
+	QModelIndex withTags = model.index(tagged, DiveTripModelBase::TAGS);
+	QModelIndex withoutTags = model.index(1 - tagged, DiveTripModelBase::TAGS);
+	QVERIFY(base.lessThan(withoutTags, withTags));
+	QVERIFY(!base.lessThan(withTags, withoutTags));
+}
+
+QTEST_GUILESS_MAIN(TestDiveTripModel)
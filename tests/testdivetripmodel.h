@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVETRIPMODEL_H
+#define TESTDIVETRIPMODEL_H
+
+#include <QtTest>
+
+class TestDiveTripModel : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+
+	void editWeight();
+	void resetWeights();
+	void sortEmptyTags();
+};
+
+#endif
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testgaspressures.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/gaspressures.h"
+#include "core/pref.h"
+#include "core/profile.h"
+
+#include <vector>
+
+// The previous implementation, see gaspressuresreference.c
+extern "C" void populate_pressure_information_reference(const struct dive *, const struct divecomputer *, struct plot_info *, int);
+
+// A copy of the entries and the pressures of a plot info, which can be modified independently
+struct PlotInfoCopy {
+	plot_info pi;
+	std::vector<plot_data> entries;
+	std::vector<plot_pressure_data> pressures;
+	PlotInfoCopy(const plot_info &src) : pi(src),
+		entries(src.entry, src.entry + src.nr),
+		pressures(src.pressures, src.pressures + src.nr * src.nr_cylinders)
+	{
+		pi.entry = entries.data();
+		pi.pressures = pressures.data();
+	}
+};
+
+void TestGasPressures::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestGasPressures::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestGasPressures::compareWithReference_data()
+{
+	QTest::addColumn<QString>("file");
+	QTest::addColumn<int>("step");
+
+	// Keeping only every step-th sensor pressure gives longer segments to interpolate
+	for (const char *file: { "abitofeverything.ssrf", "SampleDivesV2.ssrf", "tank_pressure.xml", "sac-test.xml" }) {
+		for (int step: { 1, 3, 20 })
+			QTest::addRow("%s/%d", file, step) << QString(file) << step;
+	}
+}
+
+// The pressures are interpolated on the plot info of the profile of every dive computer of
+// every dive, once with the current and once with the previous implementation.
+void TestGasPressures::compareWithReference()
+{
+	QFETCH(QString, file);
+	QFETCH(int, step);
+
+	QCOMPARE(parse_file(qPrintable(SUBSURFACE_TEST_DATA "/dives/" + file), &divelog), 0);
+	QVERIFY(divelog.dives->nr > 0);
+
+	int interpolated = 0;
+	int i;
+	struct dive *d;
+	for_each_dive (i, d) {
+		struct divecomputer *dc;
+		for_each_dc (d, dc) {
+			struct plot_info pi;
+			init_plot_info(&pi);
+			create_plot_info_new(d, dc, &pi, NULL);
+
+			// Start from the sensor pressures only
+			PlotInfoCopy input(pi);
+			for (int idx = 0; idx < pi.nr; ++idx) {
+				for (int cyl = 0; cyl < pi.nr_cylinders; ++cyl) {
+					set_plot_pressure_data(&input.pi, idx, INTERPOLATED_PR, cyl, 0);
+					if (idx % step)
+						set_plot_pressure_data(&input.pi, idx, SENSOR_PR, cyl, 0);
+				}
+			}
+			PlotInfoCopy current(input.pi), reference(input.pi);
+			for (int cyl = 0; cyl < pi.nr_cylinders; ++cyl) {
+				populate_pressure_information(d, dc, &current.pi, cyl);
+				populate_pressure_information_reference(d, dc, &reference.pi, cyl);
+			}
+
+			for (int idx = 0; idx < pi.nr; ++idx) {
+				QCOMPARE(current.entries[idx].pressure_time, reference.entries[idx].pressure_time);
+				for (int cyl = 0; cyl < pi.nr_cylinders; ++cyl) {
+					QCOMPARE(get_plot_sensor_pressure(&current.pi, idx, cyl), get_plot_sensor_pressure(&reference.pi, idx, cyl));
+					QCOMPARE(get_plot_interpolated_pressure(&current.pi, idx, cyl), get_plot_interpolated_pressure(&reference.pi, idx, cyl));
+					if (get_plot_interpolated_pressure(&current.pi, idx, cyl))
+						++interpolated;
+				}
+			}
+			free_plot_info_data(&pi);
+		}
+	}
+	// Make sure that the comparison covers the interpolation at all
+	QVERIFY(interpolated > 0);
+}
+
+QTEST_GUILESS_MAIN(TestGasPressures)
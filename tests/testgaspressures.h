@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTGASPRESSURES_H
+#define TESTGASPRESSURES_H
+
+#include <QtTest>
+
+class TestGasPressures : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+
+	void compareWithReference_data();
+	void compareWithReference();
+};
+
+#endif
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testgeoindex.h"
+#include "core/geoindex.h"
+
+#include <QGeoCoordinate>
+#include <QRandomGenerator>
+#include <algorithm>
+
+// Random points, a third of them crowded around a few dive spots
+static std::vector<GeoIndex::Point> randomPoints(int count)
+{
+	QRandomGenerator random(42);
+	std::vector<GeoIndex::Point> res;
+	for (int i = 0; i < count; ++i) {
+		if (i % 3) {
+			res.push_back({ random.bounded(170.0) - 85.0, random.bounded(360.0) - 180.0, i });
+		} else {
+			int spot = random.bounded(5);
+			res.push_back({ spot * 10.0 + random.bounded(0.01), spot * 30.0 + random.bounded(0.01), i });
+		}
+	}
+	return res;
+}
+
+static int totalCount(const std::vector<GeoIndex::Cluster> &clusters)
+{
+	int res = 0;
+	for (const GeoIndex::Cluster &cluster: clusters)
+		res += cluster.count;
+	return res;
+}
+
+void TestGeoIndex::testWithinRadius()
+{
+	std::vector<GeoIndex::Point> points = randomPoints(5000);
+	GeoIndex index;
+	index.build(points);
+
+	for (int i = 0; i < 100; ++i) {
+		const GeoIndex::Point &center = points[i * 37];
+		QGeoCoordinate centerCoord(center.latitude, center.longitude);
+		double radius = i % 2 ? 500.0 : 500000.0;
+		std::vector<int> expected;
+		for (const GeoIndex::Point &p: points) {
+			if (centerCoord.distanceTo(QGeoCoordinate(p.latitude, p.longitude)) < radius)
+				expected.push_back(p.id);
+		}
+		std::vector<int> found = index.withinRadius(center.latitude, center.longitude, radius);
+		std::sort(found.begin(), found.end());
+		QCOMPARE(found, expected);
+	}
+}
+
+void TestGeoIndex::testClusters()
+{
+	std::vector<GeoIndex::Point> points = randomPoints(5000);
+	GeoIndex index;
+	index.build(points);
+
+	// Every point is in exactly one cluster
+	for (double clusterSize: { 0.2, 0.01, 0.0001 })
+		QCOMPARE(totalCount(index.clusters(GeoIndex::Area::world(), clusterSize)), (int)points.size());
+
+	// When zoomed out, the dive spots become single clusters
+	std::vector<GeoIndex::Cluster> clusters = index.clusters(GeoIndex::Area::world(), 0.01);
+	QVERIFY(clusters.size() < points.size());
+	QVERIFY(std::any_of(clusters.begin(), clusters.end(), [](const GeoIndex::Cluster &c) { return c.count > 100; }));
+
+	// Without clustering, there is one cluster per point
+	clusters = index.clusters(GeoIndex::Area::world(), 0.0);
+	QCOMPARE(clusters.size(), points.size());
+}
+
+void TestGeoIndex::testAntimeridian()
+{
+	std::vector<GeoIndex::Point> points = {
+		{ 10.0, 179.5, 0 },
+		{ 10.0, -179.5, 1 },
+		{ 10.0, 0.0, 2 },
+		{ 30.0, 179.5, 3 }
+	};
+	GeoIndex index;
+	index.build(points);
+
+	GeoIndex::Area area { 20.0, 0.0, 179.0, 2.0 };
+	std::vector<GeoIndex::Cluster> clusters = index.clusters(area, 0.0);
+	std::vector<int> ids;
+	for (const GeoIndex::Cluster &cluster: clusters)
+		ids.push_back(cluster.id);
+	std::sort(ids.begin(), ids.end());
+	QCOMPARE(ids, std::vector<int>({ 0, 1 }));
+
+	std::vector<int> found = index.withinRadius(10.0, 180.0, 100000.0);
+	std::sort(found.begin(), found.end());
+	QCOMPARE(found, std::vector<int>({ 0, 1 }));
+}
+
+void TestGeoIndex::testArea()
+{
+	GeoIndex::Area area { 20.0, 0.0, 170.0, 20.0 };
+	GeoIndex::Area expanded = area.expanded(0.5);
+	QVERIFY(expanded.contains(area));
+	QVERIFY(!area.contains(expanded));
+	QCOMPARE(expanded.west, 160.0);
+	QCOMPARE(expanded.width, 40.0);
+	QVERIFY(GeoIndex::Area::world().contains(expanded));
+	QCOMPARE(area.expanded(10.0).width, 360.0);
+}
+
+QTEST_GUILESS_MAIN(TestGeoIndex)
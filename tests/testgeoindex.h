@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTGEOINDEX_H
+#define TESTGEOINDEX_H
+
+#include <QtTest>
+
+class TestGeoIndex : public QObject {
+	Q_OBJECT
+private slots:
+	void testWithinRadius();
+	void testClusters();
+	void testAntimeridian();
+	void testArea();
+};
+
+#endif
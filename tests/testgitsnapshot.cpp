@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testgitsnapshot.h"
+#include "git2.h"
+
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/git-access.h"
+#include "core/gitsnapshot.h"
+#include "core/pref.h"
+#include "core/subsurfacestartup.h"
+
+#include <QDir>
+#include <QFile>
+
+static const QString repoDir = "./gitsnapshot";
+static const QString repoName = repoDir + "[test]";
+static const QString snapshotFile = repoDir + "/.git/subsurface-snapshot";
+static const QString otherRepoDir = "./gitnosnapshot";
+static const QString otherRepoName = otherRepoDir + "[test]";
+
+static QByteArray readFile(const QString &name)
+{
+	QFile f(name);
+	return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+}
+
+// Load the repository and return the dive log as XML
+static QByteArray loadAsXml()
+{
+	clear_dive_file_data();
+	if (parse_file(qPrintable(repoName), &divelog) || save_dives("./gitsnapshot.ssrf"))
+		return QByteArray();
+	return readFile("./gitsnapshot.ssrf");
+}
+
+static int countEntries(const char *, const git_tree_entry *, void *payload)
+{
+	++*(int *)payload;
+	return 0;
+}
+
+void TestGitSnapshot::initTestCase()
+{
+	git_repository *repo;
+
+	copy_prefs(&default_prefs, &prefs);
+	// snapshots are only kept for the cloud storage, let the test repository count as such
+	prefs.cloud_base_url = strdup(qPrintable(repoDir));
+	git_libgit2_init();
+	for (const QString &dir: { repoDir, otherRepoDir }) {
+		QCOMPARE(QDir(dir).removeRecursively(), true);
+		QCOMPARE(git_repository_init(&repo, qPrintable(dir), false), 0);
+		git_repository_free(repo);
+	}
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	QCOMPARE(save_dives(qPrintable(repoName)), 0);
+}
+
+void TestGitSnapshot::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestGitSnapshot::testEntries()
+{
+	git_repository *repo;
+	git_object *object;
+	git_commit *commit;
+	git_tree *tree;
+
+	// the save doesn't make the snapshot, the first load does
+	QVERIFY(!QFile::exists(snapshotFile));
+
+	QCOMPARE(git_repository_open(&repo, qPrintable(repoDir)), 0);
+	QCOMPARE(git_revparse_single(&object, repo, "test"), 0);
+	QCOMPARE(git_object_peel((git_object **)&commit, object, GIT_OBJ_COMMIT), 0);
+	QCOMPARE(git_commit_tree(&tree, commit), 0);
+	int expected = 0;
+	QCOMPARE(git_tree_walk(tree, GIT_TREEWALK_PRE, &countEntries, &expected), 0);
+	QVERIFY(expected > 0);
+
+	// every entry of the tree is there and the files have the contents of their blobs
+	struct git_snapshot *snapshot = git_snapshot_get(repo, commit, true);
+	QVERIFY(snapshot);
+	QVERIFY(QFile::exists(snapshotFile));
+	struct git_snapshot_entry entry;
+	int count = 0;
+	while (git_snapshot_next(snapshot, &entry, false)) {
+		++count;
+		if (entry.is_tree)
+			continue;
+		git_oid id;
+		git_blob *blob;
+		git_oid_fromraw(&id, entry.id);
+		QCOMPARE(git_blob_lookup(&blob, repo, &id), 0);
+		QVERIFY(entry.content);
+		QCOMPARE(QByteArray(entry.content, entry.size),
+			 QByteArray((const char *)git_blob_rawcontent(blob), (int)git_blob_rawsize(blob)));
+		git_blob_free(blob);
+	}
+	QCOMPARE(count, expected);
+
+	git_snapshot_free(snapshot);
+	git_tree_free(tree);
+	git_commit_free(commit);
+	git_object_free(object);
+	git_repository_free(repo);
+}
+
+void TestGitSnapshot::testLoad()
+{
+	// loading from the snapshot gives the same dive log as loading from the repository
+	QByteArray fromSnapshot = loadAsXml();
+	QVERIFY(!fromSnapshot.isEmpty());
+	QVERIFY(QFile::remove(snapshotFile));
+	QCOMPARE(loadAsXml(), fromSnapshot);
+	// and that load made the snapshot again
+	QVERIFY(QFile::exists(snapshotFile));
+}
+
+void TestGitSnapshot::testUpdate()
+{
+	// the snapshot is left alone by a save and updated by the next load, which sees the new dive
+	QCOMPARE(parse_file(qPrintable(repoName), &divelog), 0);
+	int count = divelog.dives->nr;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/test10.xml", &divelog), 0);
+	process_loaded_dives();
+	QByteArray old = readFile(snapshotFile);
+	QCOMPARE(save_dives(qPrintable(repoName)), 0);
+	QCOMPARE(readFile(snapshotFile), old);
+	QByteArray xml = loadAsXml();
+	QCOMPARE(divelog.dives->nr, count + 1);
+	QByteArray snapshot = readFile(snapshotFile);
+	QVERIFY(snapshot != old);
+
+	// the updated snapshot is the same as a new one
+	QVERIFY(QFile::remove(snapshotFile));
+	QCOMPARE(loadAsXml(), xml);
+	QCOMPARE(readFile(snapshotFile), snapshot);
+}
+
+void TestGitSnapshot::testDamaged()
+{
+	// a truncated snapshot is not used, but replaced
+	QByteArray xml = loadAsXml();
+	QByteArray snapshot = readFile(snapshotFile);
+	QFile f(snapshotFile);
+	QVERIFY(f.open(QIODevice::WriteOnly));
+	QCOMPARE(f.write(snapshot.left(snapshot.size() / 2)), (qint64)snapshot.size() / 2);
+	f.close();
+	QCOMPARE(loadAsXml(), xml);
+	QCOMPARE(readFile(snapshotFile), snapshot);
+}
+
+void TestGitSnapshot::testBoundary()
+{
+	// a tree whose entries don't end on a record boundary is detected as well
+	QByteArray xml = loadAsXml();
+	QByteArray snapshot = readFile(snapshotFile);
+	QByteArray damaged = snapshot;
+	// snapshot header: magic[8], version, commit[20]
+	// record header: id[20], type, rootLength, nameLength, size, subtreeLength
+	int pos = 32;
+	while (pos + 40 <= damaged.size()) {
+		quint32 h[5];
+		memcpy(h, damaged.constData() + pos + 20, sizeof(h));
+		if (h[0] == 1 && h[4] > 0) {
+			--h[4];
+			memcpy(damaged.data() + pos + 36, &h[4], sizeof(h[4]));
+			break;
+		}
+		pos += 40 + h[1] + 1 + h[2] + 1 + h[3];
+	}
+	QVERIFY(damaged != snapshot);
+	QFile f(snapshotFile);
+	QVERIFY(f.open(QIODevice::WriteOnly));
+	QCOMPARE(f.write(damaged), (qint64)damaged.size());
+	f.close();
+	QCOMPARE(loadAsXml(), xml);
+	QCOMPARE(readFile(snapshotFile), snapshot);
+}
+
+void TestGitSnapshot::testUnreadable()
+{
+	// a file that can't be read is not stored in the snapshot, so the load doesn't make one
+	git_repository *repo;
+	git_object *blob;
+	char id[GIT_OID_HEXSZ + 1];
+
+	QCOMPARE(git_repository_open(&repo, qPrintable(repoDir)), 0);
+	QCOMPARE(git_revparse_single(&blob, repo, "test:00-Subsurface"), 0);
+	git_oid_tostr(id, sizeof(id), git_object_id(blob));
+	git_object_free(blob);
+	git_repository_free(repo);
+	QString object = repoDir + "/.git/objects/" + QString(id).left(2) + "/" + QString(id).mid(2);
+	QVERIFY(QFile::setPermissions(object, QFile::ReadOwner | QFile::WriteOwner));
+	QVERIFY(QFile::remove(object));
+	QVERIFY(QFile::remove(snapshotFile));
+
+	clear_dive_file_data();
+	QCOMPARE(parse_file(qPrintable(repoName), &divelog), 0);
+	QVERIFY(divelog.dives->nr > 0);
+	QVERIFY(!QFile::exists(snapshotFile));
+}
+
+void TestGitSnapshot::testNotCloud()
+{
+	// other repositories belong to the user, they are loaded without making a snapshot
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	int count = divelog.dives->nr;
+	QCOMPARE(save_dives(qPrintable(otherRepoName)), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file(qPrintable(otherRepoName), &divelog), 0);
+	QCOMPARE(divelog.dives->nr, count);
+	QVERIFY(!QFile::exists(otherRepoDir + "/.git/subsurface-snapshot"));
+}
+
+QTEST_GUILESS_MAIN(TestGitSnapshot)
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTGITSNAPSHOT_H
+#define TESTGITSNAPSHOT_H
+
+#include <QtTest>
+
+class TestGitSnapshot : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+
+	void testEntries();
+	void testLoad();
+	void testUpdate();
+	void testDamaged();
+	void testBoundary();
+	void testUnreadable();
+	void testNotCloud();
+};
+
+#endif
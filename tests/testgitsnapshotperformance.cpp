@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testgitsnapshotperformance.h"
+#include "git2.h"
+
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/pref.h"
+#include "core/sample.h"
+#include "core/subsurfacestartup.h"
+
+#include <QDir>
+#include <QFile>
+#include <cmath>
+
+// A log of many dives with the profiles of a dive computer, as kept in the cloud storage of long-time divers
+static const int numDives = 3000;
+static const int samplesPerDive = 600;	// 50 minutes, every five seconds
+
+static const QString repoDir = "./gitsnapshotperformance";
+static const QString repoName = repoDir + "[test]";
+static const QString snapshotFile = repoDir + "/.git/subsurface-snapshot";
+static const QByteArray repoPath = QFile::encodeName(repoDir);
+
+// Snapshots are only kept for the cloud storage, which is recognized by its base url
+static void setCloudStorage(bool cloud)
+{
+	prefs.cloud_base_url = cloud ? repoPath.constData() : default_prefs.cloud_base_url;
+}
+
+// Clearing the dive log is part of every measured load, so that the loads can be compared
+static void load()
+{
+	clear_dive_file_data();
+	QCOMPARE(parse_file(qPrintable(repoName), &divelog), 0);
+}
+
+void TestGitSnapshotPerformance::initTestCase()
+{
+	git_repository *repo;
+
+	copy_prefs(&default_prefs, &prefs);
+	git_libgit2_init();
+	QCOMPARE(QDir(repoDir).removeRecursively(), true);
+	QCOMPARE(git_repository_init(&repo, qPrintable(repoDir), false), 0);
+	git_repository_free(repo);
+
+	timestamp_t when = 946684800;	// 2000-01-01
+	for (int i = 0; i < numDives; ++i) {
+		struct dive *d = alloc_dive();
+		d->when = d->dc.when = when;
+		for (int j = 0; j < samplesPerDive; ++j) {
+			struct sample sample = { };
+			sample.depth.mm = lrint(20000.0 * sin(M_PI * j / samplesPerDive)) + (i * 37 + j * 11) % 500;
+			sample.temperature.mkelvin = 290000 - sample.depth.mm / 10;
+			add_sample(&sample, j * 5, &d->dc);
+		}
+		add_to_dive_table(divelog.dives, divelog.dives->nr, d);
+		when += 6 * 3600;
+	}
+	process_loaded_dives();
+	setCloudStorage(false);
+	QCOMPARE(save_dives(qPrintable(repoName)), 0);
+}
+
+void TestGitSnapshotPerformance::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestGitSnapshotPerformance::loadFromRepository()
+{
+	// every object is looked up and decompressed
+	setCloudStorage(false);
+	QBENCHMARK {
+		load();
+	}
+	QCOMPARE(divelog.dives->nr, numDives);
+	QVERIFY(!QFile::exists(snapshotFile));
+}
+
+void TestGitSnapshotPerformance::loadWritingSnapshot()
+{
+	// the first load after a save reads the repository and writes the snapshot
+	setCloudStorage(true);
+	QBENCHMARK {
+		QFile::remove(snapshotFile);
+		load();
+	}
+	QCOMPARE(divelog.dives->nr, numDives);
+	QVERIFY(QFile::exists(snapshotFile));
+}
+
+void TestGitSnapshotPerformance::loadFromSnapshot()
+{
+	// the following loads only map the snapshot
+	setCloudStorage(true);
+	load();
+	QVERIFY(QFile::exists(snapshotFile));
+	QBENCHMARK {
+		load();
+	}
+	QCOMPARE(divelog.dives->nr, numDives);
+}
+
+QTEST_GUILESS_MAIN(TestGitSnapshotPerformance)
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTGITSNAPSHOTPERFORMANCE_H
+#define TESTGITSNAPSHOTPERFORMANCE_H
+
+#include <QtTest>
+
+class TestGitSnapshotPerformance : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+
+	void loadFromRepository();
+	void loadWritingSnapshot();
+	void loadFromSnapshot();
+};
+
+#endif
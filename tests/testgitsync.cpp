@@ -0,0 +1,350 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testgitsync.h"
+#include "git2.h"
+
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/git-access.h"
+#include "core/gitsync.h"
+#include "core/pref.h"
+#include "core/subsurfacestartup.h"
+
+#include <QDir>
+#include <QSignalSpy>
+#include <algorithm>
+#include <string.h>
+
+// The remote is a bare repository in the file system. The caches are set up
+// like the local cache of the cloud storage, but are synced explicitly.
+static const QString remoteDir = "./gitsync_remote";
+static const QString cacheDir = "./gitsync_cache";
+static const QString otherCacheDir = "./gitsync_cache2";
+static const QString shallowCacheDir = "./gitsync_shallow";
+
+static QString repoName(const QString &dir)
+{
+	return dir + "[test]";
+}
+
+static QString branchHead(const QString &dir)
+{
+	git_repository *repo;
+	git_reference *ref;
+	QString res;
+
+	if (git_repository_open(&repo, qPrintable(dir)))
+		return res;
+	if (!git_branch_lookup(&ref, repo, "test", GIT_BRANCH_LOCAL)) {
+		char id[GIT_OID_HEXSZ + 1];
+		git_oid_tostr(id, sizeof(id), git_reference_target(ref));
+		res = id;
+		git_reference_free(ref);
+	}
+	git_repository_free(repo);
+	return res;
+}
+
+// Whether the parent of the branch head is in the repository, i.e. not cut off by a shallow clone
+static bool haveParent(const QString &dir)
+{
+	git_repository *repo;
+	git_reference *ref;
+	git_commit *commit, *parent;
+	bool res = false;
+
+	if (git_repository_open(&repo, qPrintable(dir)))
+		return false;
+	if (!git_branch_lookup(&ref, repo, "test", GIT_BRANCH_LOCAL)) {
+		if (!git_commit_lookup(&commit, repo, git_reference_target(ref))) {
+			if (!git_commit_parent(&parent, commit, 0)) {
+				res = true;
+				git_commit_free(parent);
+			}
+			git_commit_free(commit);
+		}
+		git_reference_free(ref);
+	}
+	git_repository_free(repo);
+	return res;
+}
+
+// Add a history of commits that don't change anything to the branch of a cache
+static void addHistory(const QString &dir, int count)
+{
+	git_repository *repo;
+	git_reference *ref, *updated;
+	git_signature *author;
+
+	QCOMPARE(git_repository_open(&repo, qPrintable(dir)), 0);
+	QCOMPARE(git_branch_lookup(&ref, repo, "test", GIT_BRANCH_LOCAL), 0);
+	QCOMPARE(git_signature_now(&author, "Subsurface", "subsurface@subsurface-divelog.org"), 0);
+	git_oid id = *git_reference_target(ref);
+	for (int i = 0; i < count; ++i) {
+		git_commit *parent;
+		git_tree *tree;
+		QCOMPARE(git_commit_lookup(&parent, repo, &id), 0);
+		QCOMPARE(git_commit_tree(&tree, parent), 0);
+		const git_commit *parents[] = { parent };
+		QByteArray msg = QString("Commit %1").arg(i).toUtf8();
+		QCOMPARE(git_commit_create(&id, repo, NULL, author, author, NULL, msg.constData(), tree, 1, parents), 0);
+		git_tree_free(tree);
+		git_commit_free(parent);
+	}
+	QCOMPARE(git_reference_set_target(&updated, ref, &id, "history"), 0);
+	git_reference_free(updated);
+	git_signature_free(author);
+	git_reference_free(ref);
+	git_repository_free(repo);
+}
+
+// Sync the cache in the background, wait for it and return the arguments of the finished signal
+static QList<QVariant> syncCache(const QString &dir, bool cancel)
+{
+	GitSync *sync = GitSync::instance();
+	QSignalSpy spy(sync, &GitSync::finished);
+	sync->sync(remoteDir, "test", dir);
+	if (cancel)
+		sync->cancel();
+	sync->waitForFinished();
+	return spy.count() == 1 ? spy.takeFirst() : QList<QVariant>();
+}
+
+// Load the cache, add the dives of a file and commit that to the cache only
+static void addDives(const QString &dir, const char *file)
+{
+	QCOMPARE(parse_file(qPrintable(repoName(dir)), &divelog), 0);
+	QCOMPARE(parse_file(file, &divelog), 0);
+	process_loaded_dives();
+	QCOMPARE(save_dives(qPrintable(repoName(dir))), 0);
+}
+
+void TestGitSync::initTestCase()
+{
+	git_repository *repo;
+	git_config *conf;
+
+	copy_prefs(&default_prefs, &prefs);
+	git_libgit2_init();
+	// the saves only commit to the cache, like the saves of the apps before a background sync
+	git_local_only = true;
+
+	for (const QString &dir: { remoteDir, cacheDir, otherCacheDir, shallowCacheDir })
+		QCOMPARE(QDir(dir).removeRecursively(), true);
+	QCOMPARE(git_repository_init(&repo, qPrintable(remoteDir), true), 0);
+	git_repository_free(repo);
+
+	// a cache with the branch set up to track the remote, that wasn't pushed yet
+	QByteArray url = QFile::encodeName(remoteDir);
+	git_repository_init_options opts = GIT_REPOSITORY_INIT_OPTIONS_INIT;
+	opts.flags = GIT_REPOSITORY_INIT_MKPATH;
+	opts.initial_head = "test";
+	opts.origin_url = url.constData();
+	QCOMPARE(git_repository_init_ext(&repo, qPrintable(cacheDir), &opts), 0);
+	QCOMPARE(git_repository_config(&conf, repo), 0);
+	QCOMPARE(git_config_set_string(conf, "branch.test.remote", "origin"), 0);
+	QCOMPARE(git_config_set_string(conf, "branch.test.merge", "refs/heads/test"), 0);
+	git_config_free(conf);
+	git_repository_free(repo);
+}
+
+void TestGitSync::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestGitSync::testPush()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	QCOMPARE(save_dives(qPrintable(repoName(cacheDir))), 0);
+	QString local = branchHead(cacheDir);
+	QVERIFY(!local.isEmpty());
+	QVERIFY(branchHead(remoteDir).isEmpty());
+
+	QSignalSpy progress(GitSync::instance(), &GitSync::progress);
+	QSignalSpy allFinished(GitSync::instance(), &GitSync::allFinished);
+	QList<QVariant> res = syncCache(cacheDir, false);
+	QVERIFY(!GitSync::instance()->busy());
+	// the signal is sent by the worker right after waking up the waiting thread
+	QVERIFY(allFinished.count() == 1 || allFinished.wait());
+	QCOMPARE(res.size(), 3);
+	QCOMPARE(res[0].toInt(), 0);
+	QCOMPARE(res[1].toBool(), false);
+	QCOMPARE(res[2].toString(), local);
+	QCOMPARE(branchHead(remoteDir), local);
+	QVERIFY(std::any_of(progress.begin(), progress.end(),
+			    [](const QList<QVariant> &args) { return args[0].toInt() == GIT_SYNC_PUSH; }));
+}
+
+void TestGitSync::testCancel()
+{
+	QString remote = branchHead(remoteDir);
+	addDives(cacheDir, SUBSURFACE_TEST_DATA "/dives/test10.xml");
+	QString local = branchHead(cacheDir);
+	QVERIFY(local != remote);
+
+	// canceled before the worker got to it: the remote stays as it was
+	QList<QVariant> res = syncCache(cacheDir, true);
+	QCOMPARE(res.size(), 3);
+	QCOMPARE(res[1].toBool(), true);
+	QCOMPARE(branchHead(remoteDir), remote);
+	QCOMPARE(branchHead(cacheDir), local);
+
+	// the next sync pushes the commit
+	res = syncCache(cacheDir, false);
+	QCOMPARE(res.size(), 3);
+	QCOMPARE(res[0].toInt(), 0);
+	QCOMPARE(res[1].toBool(), false);
+	QCOMPARE(branchHead(remoteDir), local);
+}
+
+void TestGitSync::testMerge()
+{
+	// a second client adds a dive and pushes it
+	git_repository *repo;
+	git_clone_options opts = GIT_CLONE_OPTIONS_INIT;
+	opts.checkout_branch = "test";
+	QCOMPARE(git_clone(&repo, qPrintable(remoteDir), qPrintable(otherCacheDir), &opts), 0);
+	git_repository_free(repo);
+	QCOMPARE(parse_file(qPrintable(repoName(otherCacheDir)), &divelog), 0);
+	int base = divelog.dives->nr;
+	clear_dive_file_data();
+	addDives(otherCacheDir, SUBSURFACE_TEST_DATA "/dives/test11.xml");
+	int added = divelog.dives->nr - base;
+	QVERIFY(added > 0);
+	clear_dive_file_data();
+	QCOMPARE(syncCache(otherCacheDir, false).value(0).toInt(), 0);
+	QString other = branchHead(remoteDir);
+	QCOMPARE(other, branchHead(otherCacheDir));
+
+	// meanwhile, the first client adds a different dive
+	addDives(cacheDir, SUBSURFACE_TEST_DATA "/dives/test12.xml");
+	int expected = divelog.dives->nr + added;
+	QString local = branchHead(cacheDir);
+	QCOMPARE(QString(saved_git_id), local);
+
+	// the sync merges both and pushes the merge, the loaded data is left alone
+	QList<QVariant> res = syncCache(cacheDir, false);
+	QCOMPARE(res.size(), 3);
+	QCOMPARE(res[0].toInt(), 0);
+	QString merged = res[2].toString();
+	QVERIFY(merged != local && merged != other);
+	QCOMPARE(QString(saved_git_id), local);
+	QCOMPARE(branchHead(cacheDir), merged);
+	QCOMPARE(branchHead(remoteDir), merged);
+
+	clear_dive_file_data();
+	QCOMPARE(parse_file(qPrintable(repoName(cacheDir)), &divelog), 0);
+	QCOMPARE(divelog.dives->nr, expected);
+}
+
+void TestGitSync::testSaveAfterMerge()
+{
+	// the second client adds a dive, but doesn't push it yet
+	QCOMPARE(syncCache(otherCacheDir, false).value(0).toInt(), 0);
+	QCOMPARE(branchHead(otherCacheDir), branchHead(remoteDir));
+	QCOMPARE(parse_file(qPrintable(repoName(otherCacheDir)), &divelog), 0);
+	int base = divelog.dives->nr;
+	clear_dive_file_data();
+	addDives(otherCacheDir, SUBSURFACE_TEST_DATA "/dives/test15.xml");
+	int added = divelog.dives->nr - base;
+	QVERIFY(added > 0);
+	clear_dive_file_data();
+
+	// the first client saves a dive and keeps the data loaded
+	addDives(cacheDir, SUBSURFACE_TEST_DATA "/dives/test16.xml");
+	QString local = branchHead(cacheDir);
+
+	// meanwhile, the second client pushes and the background sync of the first one merges that
+	QCOMPARE(syncCache(otherCacheDir, false).value(0).toInt(), 0);
+	QList<QVariant> res = syncCache(cacheDir, false);
+	QCOMPARE(res.size(), 3);
+	QCOMPARE(res[0].toInt(), 0);
+	QString merged = res[2].toString();
+	QVERIFY(merged != local);
+	QCOMPARE(QString(saved_git_id), local);
+
+	// the next save of the loaded data is committed on top of the loaded commit and merged
+	// into the branch, instead of failing or dropping the dive of the second client
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/test17.xml", &divelog), 0);
+	process_loaded_dives();
+	int expected = divelog.dives->nr + added;
+	QCOMPARE(save_dives(qPrintable(repoName(cacheDir))), 0);
+	QString saved(saved_git_id);
+	QString head = branchHead(cacheDir);
+	QVERIFY(saved != local && saved != merged);
+	QVERIFY(head != saved && head != merged);
+
+	// the merge goes to the remote with the next sync and has the dives of both clients
+	QCOMPARE(syncCache(cacheDir, false).value(0).toInt(), 0);
+	QCOMPARE(branchHead(remoteDir), head);
+	clear_dive_file_data();
+	QCOMPARE(parse_file(qPrintable(repoName(cacheDir)), &divelog), 0);
+	QCOMPARE(divelog.dives->nr, expected);
+}
+
+void TestGitSync::testShallowClone()
+{
+#if LIBGIT2_VER_MAJOR < 1 || (LIBGIT2_VER_MAJOR == 1 && LIBGIT2_VER_MINOR < 7)
+	QSKIP("libgit2 supports shallow repositories since version 1.7");
+#endif
+	// a long history on the remote
+	addHistory(cacheDir, 100);
+	QCOMPARE(syncCache(cacheDir, false).value(0).toInt(), 0);
+	QString remote = branchHead(remoteDir);
+	QCOMPARE(remote, branchHead(cacheDir));
+
+	// set up the cache on a new computer, like for the cloud storage
+	struct git_info info;
+	QByteArray url = QFile::encodeName(remoteDir);
+	QByteArray localdir = QFile::encodeName(shallowCacheDir);
+	memset(&info, 0, sizeof(info));
+	info.url = url.constData();
+	info.branch = "test";
+	info.localdir = localdir.constData();
+	info.transport = RT_OTHER;
+	QVERIFY(open_git_repository(&info));
+
+	// the local transport can't fetch a limited history, so cut off the history
+	// of the clone at the branch head, like a shallow clone does
+	QFile shallowFile(QString::fromUtf8(git_repository_path(info.repo)) + "shallow");
+	git_repository_free(info.repo);
+	QVERIFY(shallowFile.open(QIODevice::WriteOnly));
+	QVERIFY(shallowFile.write(remote.toLatin1() + "\n") > 0);
+	shallowFile.close();
+	git_repository *repo;
+	QCOMPARE(git_repository_open(&repo, qPrintable(shallowCacheDir)), 0);
+	QCOMPARE(git_repository_is_shallow(repo), 1);
+	git_repository_free(repo);
+	QCOMPARE(branchHead(shallowCacheDir), remote);
+	QVERIFY(!haveParent(shallowCacheDir));
+	QCOMPARE(parse_file(qPrintable(repoName(shallowCacheDir)), &divelog), 0);
+	int base = divelog.dives->nr;
+	QVERIFY(base > 0);
+	clear_dive_file_data();
+
+	// the old cache adds a dive and pushes it, the new one adds another dive
+	addDives(cacheDir, SUBSURFACE_TEST_DATA "/dives/test13.xml");
+	clear_dive_file_data();
+	QCOMPARE(syncCache(cacheDir, false).value(0).toInt(), 0);
+	addDives(shallowCacheDir, SUBSURFACE_TEST_DATA "/dives/test14.xml");
+	clear_dive_file_data();
+
+	// the new cache fetches the dive of the old one on top of the cut off history and merges it
+	QList<QVariant> res = syncCache(shallowCacheDir, false);
+	QCOMPARE(res.size(), 3);
+	QCOMPARE(res[0].toInt(), 0);
+	QString merged = res[2].toString();
+	QCOMPARE(branchHead(shallowCacheDir), merged);
+	QCOMPARE(branchHead(remoteDir), merged);
+	QCOMPARE(parse_file(qPrintable(repoName(shallowCacheDir)), &divelog), 0);
+	QCOMPARE(divelog.dives->nr, base + 2);
+	clear_dive_file_data();
+
+	// and the old cache gets the merge
+	QCOMPARE(syncCache(cacheDir, false).value(0).toInt(), 0);
+	QCOMPARE(branchHead(cacheDir), merged);
+}
+
+QTEST_GUILESS_MAIN(TestGitSync)
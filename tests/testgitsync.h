@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTGITSYNC_H
+#define TESTGITSYNC_H
+
+#include <QtTest>
+
+class TestGitSync : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+
+	void testPush();
+	void testCancel();
+	void testMerge();
+	void testSaveAfterMerge();
+	void testShallowClone();
+};
+
+#endif
@@ -4,15 +4,18 @@
 #include "core/dive.h"
 #include "core/divelog.h"
 #include "core/divesite.h"
+#include "core/event.h"
 #include "core/errorhelper.h"
 #include "core/trip.h"
 #include "core/file.h"
 #include "core/import-csv.h"
 #include "core/parse.h"
+#include "core/sample.h"
 #include "core/qthelper.h"
 #include "core/subsurface-string.h"
 #include "core/xmlparams.h"
 #include <QTextStream>
+#include <vector>
 
 /* We have to use a macro since QCOMPARE
  * can only be called from a test method
@@ -470,4 +473,53 @@ void TestParse::parseDL7()
 }
 
 
+static const char *ostcToolsFiles[] = {
+	SUBSURFACE_TEST_DATA "/dives/ostc_00087_04-05-2014_043m_032min.dive",
+	SUBSURFACE_TEST_DATA "/dives/ostc_00173_17-08-2013_027m_043min.dive"
+};
+static const int nrOstcToolsFiles = sizeof(ostcToolsFiles) / sizeof(ostcToolsFiles[0]);
+
+static void importOSTCToolsFile(int idx, void *data)
+{
+	struct divelog *logs = (struct divelog *)data;
+	ostctools_import(ostcToolsFiles[idx % nrOstcToolsFiles], &logs[idx]);
+}
+
+static bool sameProfile(const struct divecomputer *dc1, const struct divecomputer *dc2)
+{
+	if (dc1->samples != dc2->samples || dc1->no_o2sensors != dc2->no_o2sensors ||
+	    memcmp(dc1->sample, dc2->sample, dc1->samples * sizeof(struct sample)))
+		return false;
+	const struct event *ev1 = dc1->events, *ev2 = dc2->events;
+	for ( ; ev1 && ev2; ev1 = ev1->next, ev2 = ev2->next) {
+		if (ev1->time.seconds != ev2->time.seconds || ev1->type != ev2->type ||
+		    ev1->flags != ev2->flags || ev1->value != ev2->value || strcmp(ev1->name, ev2->name))
+			return false;
+	}
+	return !ev1 && !ev2;
+}
+
+void TestParse::parseOSTCToolsParallel()
+{
+	// Parsing the profiles must give the same result when
+	// multiple dives are parsed at the same time.
+	const int count = 4 * nrOstcToolsFiles;
+	std::vector<struct divelog> serial(count), parallel(count);
+
+	for (int i = 0; i < count; ++i)
+		importOSTCToolsFile(i, &serial[0]);
+	parallel_for(count, &importOSTCToolsFile, &parallel[0]);
+
+	for (int i = 0; i < count; ++i) {
+		QCOMPARE(serial[i].dives->nr, 1);
+		QCOMPARE(parallel[i].dives->nr, 1);
+		const struct dive *d1 = serial[i].dives->dives[0];
+		const struct dive *d2 = parallel[i].dives->dives[0];
+		QVERIFY(d1->dc.samples > 0);
+		QCOMPARE(d1->when, d2->when);
+		QCOMPARE(d1->cylinders.nr, d2->cylinders.nr);
+		QVERIFY(sameProfile(&d1->dc, &d2->dc));
+	}
+}
+
 QTEST_GUILESS_MAIN(TestParse)
@@ -34,6 +34,7 @@ private slots:
 	void testExport();
 
 	void parseDL7();
+	void parseOSTCToolsParallel();
 
 private:
 	sqlite3 *_sqlite3_handle = NULL;
@@ -4,9 +4,13 @@
 #include "core/dive.h"
 #include "core/divelog.h"
 #include "core/errorhelper.h"
+#include "core/exif.h"
+#include "core/imagedownloader.h"
 #include "core/picture.h"
 #include "core/file.h"
 #include "core/pref.h"
+#include <QFile>
+#include <QImage>
 #include <QString>
 #include <core/qthelper.h>
 
@@ -65,4 +69,27 @@ void TestPicture::addPicture()
 	QCOMPARE(localFilePath(pic2->filename), QString(PIC2_NAME));
 }
 
+void TestPicture::exifThumbnail()
+{
+	// This picture has a 160x90 JPEG thumbnail in the IFD1 of its EXIF data
+	QString filename = SUBSURFACE_TEST_DATA PIC2_NAME;
+	QFile f(filename);
+	QVERIFY(f.open(QIODevice::ReadOnly));
+	QByteArray data = f.readAll();
+	const unsigned char *buf = reinterpret_cast<const unsigned char *>(data.constData());
+	easyexif::EXIFInfo exif;
+	QCOMPARE(exif.parseFrom(buf, data.size()), PARSE_EXIF_SUCCESS);
+	QVERIFY(exif.ThumbnailLength > 0);
+	QImage thumbnail = QImage::fromData(buf + exif.ThumbnailOffset, exif.ThumbnailLength, "JPG");
+	QCOMPARE(thumbnail.size(), QSize(160, 90));
+
+	// If it is large enough, the embedded thumbnail is used as it is
+	QCOMPARE(loadThumbnailImage(filename, 160), thumbnail);
+	QCOMPARE(loadThumbnailImage(filename, 100), thumbnail.scaled(100, 100, Qt::KeepAspectRatio));
+
+	// Otherwise, the picture itself is decoded
+	QImage img = loadThumbnailImage(filename, 320);
+	QCOMPARE(img.size(), QSize(320, 180));
+}
+
 QTEST_GUILESS_MAIN(TestPicture)
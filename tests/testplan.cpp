@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testplan.h"
 #include "core/deco.h"
+#include "core/decotable.h"
 #include "core/dive.h"
 #include "core/event.h"
 #include "core/planner.h"
@@ -8,6 +9,7 @@
 #include "core/subsurfacestartup.h"
 #include "core/units.h"
 #include <QDebug>
+#include <vector>
 
 #define DEBUG 1
 
@@ -965,4 +967,174 @@ void TestPlan::testCcrBailoutGasSelection()
 
 }
 
+// The estimated stop lengths are verified by trial ascents, so the plans
+// must be exactly the same as the ones found by searching.
+static void planWithSolver(void (*setupPlan)(struct diveplan *), const short gf[2], enum stop_solver solver,
+			   std::vector<decostop> &stops, std::vector<std::pair<int, int>> &samples)
+{
+	struct deco_state *cache = NULL;
+	struct diveplan testPlan = {};
+
+	set_stop_solver(solver);
+	setupPlan(&testPlan);
+	testPlan.gflow = gf[0];
+	testPlan.gfhigh = gf[1];
+	plan(&test_deco_state, &testPlan, &dive, 60, stoptable, &cache, 1, 0);
+	set_stop_solver(STOP_SOLVER_ESTIMATE);
+
+	stops.clear();
+	for (const decostop *stop = stoptable; stop->depth; ++stop)
+		stops.push_back(*stop);
+	samples.clear();
+	for (int i = 0; i < dive.dc.samples; ++i)
+		samples.emplace_back(dive.dc.sample[i].time.seconds, dive.dc.sample[i].depth.mm);
+	free_dps(&testPlan);
+	free(cache);
+}
+
+void TestPlan::testBuehlmannStopSolver()
+{
+	void (*setups[])(struct diveplan *) = {
+		setupPlan, setupPlanSeveralGases, setupPlanVpmb45m30mTx, setupPlanVpmb60m30minAir,
+		setupPlanVpmb60m30minEan50, setupPlanVpmb100m60min, setupPlanVpmbMultiLevelAir,
+		setupPlanVpmb100mTo70m30min
+	};
+	const short gfs[][2] = { { 30, 75 }, { 50, 80 }, { 100, 100 } };
+
+	for (auto gf: gfs) {
+		for (auto setup: setups) {
+			setupPrefs();
+			prefs.unit_system = METRIC;
+			prefs.units.length = units::METERS;
+			prefs.planner_deco_mode = BUEHLMANN;
+
+			std::vector<decostop> searchedStops, estimatedStops;
+			std::vector<std::pair<int, int>> searchedSamples, estimatedSamples;
+			planWithSolver(setup, gf, STOP_SOLVER_SEARCH, searchedStops, searchedSamples);
+			planWithSolver(setup, gf, STOP_SOLVER_ESTIMATE, estimatedStops, estimatedSamples);
+
+			QVERIFY(!searchedStops.empty());
+			QCOMPARE(estimatedStops.size(), searchedStops.size());
+			for (size_t i = 0; i < searchedStops.size(); ++i) {
+				QCOMPARE(estimatedStops[i].depth, searchedStops[i].depth);
+				QCOMPARE(estimatedStops[i].time, searchedStops[i].time);
+			}
+			QVERIFY(estimatedSamples == searchedSamples);
+		}
+	}
+}
+
+// Every plan of a table must be the same as when planned on its own
+void TestPlan::testDecoTable()
+{
+	const int depths[] = { 30000, 45000, 60000 };
+	const int times[] = { 40 * 60, 10 * 60, 60, 20 * 60, 30 * 60 };
+	const deco_table_gases gases[] = { { { { 210 }, { 350 } }, 2, { { { 500 }, { 0 } }, { { 1000 }, { 0 } } } } };
+	const deco_table_setting settings[] = { { 30, 70, 0 }, { 50, 80, 2 } };
+	const deco_table_request request = { 3, depths, 5, times, 1, gases, 2, settings };
+
+	for (enum deco_mode mode: { BUEHLMANN, VPMB }) {
+		setupPrefs();
+		prefs.unit_system = METRIC;
+		prefs.units.length = units::METERS;
+		prefs.planner_deco_mode = mode;
+
+		deco_table table;
+		calculate_deco_table(&request, &table);
+		dive.surface_pressure.mbar = SURFACE_PRESSURE;
+		dive.salinity = SEAWATER_SALINITY;
+		for (int setting = 0; setting < 2; ++setting) {
+			for (int depth = 0; depth < 3; ++depth) {
+				for (int time = 0; time < 5; ++time) {
+					const deco_table_cell *cell = get_deco_table_cell(&table, setting, 0, depth, time);
+					int descent = depths[depth] / prefs.descrate;
+					QCOMPARE(cell->valid, times[time] > descent);
+					if (!cell->valid)
+						continue;
+
+					struct deco_state *cache = NULL;
+					struct diveplan testPlan = {};
+					pressure_t po2 = { prefs.decopo2 };
+					testPlan.salinity = SEAWATER_SALINITY;
+					testPlan.surface_pressure = SURFACE_PRESSURE;
+					testPlan.gflow = settings[setting].gflow;
+					testPlan.gfhigh = settings[setting].gfhigh;
+					testPlan.vpmb_conservatism = settings[setting].vpmb_conservatism;
+					testPlan.bottomsac = prefs.bottomsac;
+					testPlan.decosac = prefs.decosac;
+					get_or_create_cylinder(&dive, 0)->gasmix = gases[0].bottom;
+					for (int i = 0; i < gases[0].nr_deco; ++i) {
+						get_or_create_cylinder(&dive, i + 1)->gasmix = gases[0].deco[i];
+						plan_add_segment(&testPlan, 0, gas_mod(gases[0].deco[i], po2, &dive, M_OR_FT(3, 10)).mm, i + 1, 0, 1, OC);
+					}
+					plan_add_segment(&testPlan, descent, depths[depth], 0, 0, 1, OC);
+					plan_add_segment(&testPlan, times[time] - descent, depths[depth], 0, 0, 1, OC);
+					plan(&test_deco_state, &testPlan, &dive, 60, stoptable, &cache, 1, 0);
+
+					QCOMPARE(cell->runtime, (int)dive.dc.duration.seconds);
+					int stopTime = 0, cellStopTime = 0;
+					for (const decostop *stop = stoptable; stop->depth; ++stop)
+						stopTime += stop->time;
+					for (int i = 0; i < cell->nr_stops; ++i)
+						cellStopTime += cell->stops[i].time;
+					QCOMPARE(cellStopTime, stopTime);
+					free_dps(&testPlan);
+					free(cache);
+				}
+			}
+		}
+		free_deco_table(&table);
+	}
+}
+
+// The trial ascents dominate the run time of trimix plans with long deco
+void TestPlan::benchmarkVpmbTrimix()
+{
+	struct deco_state *cache = NULL;
+
+	setupPrefsVpmb();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+
+	struct diveplan testPlan = {};
+	QBENCHMARK {
+		setupPlanVpmb100m60min(&testPlan);
+		plan(&test_deco_state, &testPlan, &dive, 60, stoptable, &cache, 1, 0);
+	}
+	QVERIFY(compareDecoTime(dive.dc.duration.seconds, 311u * 60u + 20u, 315u * 60u + 20u));
+	free_dps(&testPlan);
+	free(cache);
+}
+
+void TestPlan::benchmarkBuehlmannTrimix_data()
+{
+	QTest::addColumn<int>("solver");
+	QTest::newRow("search") << (int)STOP_SOLVER_SEARCH;
+	QTest::newRow("estimate") << (int)STOP_SOLVER_ESTIMATE;
+}
+
+void TestPlan::benchmarkBuehlmannTrimix()
+{
+	QFETCH(int, solver);
+	struct deco_state *cache = NULL;
+
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	prefs.planner_deco_mode = BUEHLMANN;
+	set_stop_solver((enum stop_solver)solver);
+
+	struct diveplan testPlan = {};
+	QBENCHMARK {
+		setupPlanVpmb100m60min(&testPlan);
+		testPlan.gflow = 30;
+		testPlan.gfhigh = 75;
+		plan(&test_deco_state, &testPlan, &dive, 60, stoptable, &cache, 1, 0);
+	}
+	set_stop_solver(STOP_SOLVER_ESTIMATE);
+	QVERIFY(dive.dc.duration.seconds > 60 * 60);
+	free_dps(&testPlan);
+	free(cache);
+}
+
 QTEST_GUILESS_MAIN(TestPlan)
@@ -20,6 +20,11 @@ private slots:
 	void testVpmbMetricRepeat();
 	void testMultipleGases();
 	void testCcrBailoutGasSelection();
+	void testBuehlmannStopSolver();
+	void testDecoTable();
+	void benchmarkVpmbTrimix();
+	void benchmarkBuehlmannTrimix_data();
+	void benchmarkBuehlmannTrimix();
 };
 
 #endif // TESTPLAN_H
@@ -27,6 +27,7 @@ void TestQPrefCloudStorage::test_struct_get()
 	prefs.cloud_storage_email_encoded = copy_qstring("encodedMyEMail");
 	prefs.cloud_storage_password = copy_qstring("more secret");
 	prefs.cloud_storage_pin = copy_qstring("a pin");
+	prefs.cloud_shallow_clone = true;
 	prefs.cloud_timeout = 117;
 	prefs.cloud_verification_status = qPrefCloudStorage::CS_NOCLOUD;
 	prefs.save_password_local = true;
@@ -37,6 +38,7 @@ void TestQPrefCloudStorage::test_struct_get()
 	QCOMPARE(tst->cloud_storage_email_encoded(), QString(prefs.cloud_storage_email_encoded));
 	QCOMPARE(tst->cloud_storage_password(), QString(prefs.cloud_storage_password));
 	QCOMPARE(tst->cloud_storage_pin(), QString(prefs.cloud_storage_pin));
+	QCOMPARE(tst->cloud_shallow_clone(), prefs.cloud_shallow_clone);
 	QCOMPARE(tst->cloud_timeout(), (int)prefs.cloud_timeout);
 	QCOMPARE(tst->cloud_verification_status(), (int)prefs.cloud_verification_status);
 	QCOMPARE(tst->save_password_local(), prefs.save_password_local);
@@ -54,6 +56,7 @@ void TestQPrefCloudStorage::test_set_struct()
 	tst->set_cloud_storage_email_encoded("t2 email2");
 	tst->set_cloud_storage_password("t2 pass2");
 	tst->set_cloud_storage_pin("t2 pin");
+	tst->set_cloud_shallow_clone(false);
 	tst->set_cloud_timeout(123);
 	tst->set_cloud_verification_status(qPrefCloudStorage::CS_VERIFIED);
 	tst->set_save_password_local(false);
@@ -64,6 +67,7 @@ void TestQPrefCloudStorage::test_set_struct()
 	QCOMPARE(QString(prefs.cloud_storage_email_encoded), QString("t2 email2"));
 	QCOMPARE(QString(prefs.cloud_storage_password), QString("t2 pass2"));
 	QCOMPARE(QString(prefs.cloud_storage_pin), QString("t2 pin"));
+	QCOMPARE(prefs.cloud_shallow_clone, false);
 	QCOMPARE((int)prefs.cloud_timeout, 123);
 	QCOMPARE((int)prefs.cloud_verification_status, (int)qPrefCloudStorage::CS_VERIFIED);
 	QCOMPARE(prefs.save_password_local, false);
@@ -83,6 +87,7 @@ void TestQPrefCloudStorage::test_set_load_struct()
 	tst->set_cloud_auto_sync(true);
 	tst->set_cloud_storage_password("t3 pass2");
 	tst->set_cloud_storage_pin("t3 pin");
+	tst->set_cloud_shallow_clone(true);
 	tst->set_cloud_timeout(321);
 	tst->set_cloud_verification_status(qPrefCloudStorage::CS_NOCLOUD);
 
@@ -92,6 +97,7 @@ void TestQPrefCloudStorage::test_set_load_struct()
 	prefs.cloud_storage_email_encoded = copy_qstring("error1");
 	prefs.cloud_storage_password = copy_qstring("error1");
 	prefs.cloud_storage_pin = copy_qstring("error1");
+	prefs.cloud_shallow_clone = false;
 	prefs.cloud_timeout = 324;
 	prefs.cloud_verification_status = qPrefCloudStorage::CS_VERIFIED;
 	prefs.save_password_local = false;
@@ -103,6 +109,7 @@ void TestQPrefCloudStorage::test_set_load_struct()
 	QCOMPARE(QString(prefs.cloud_storage_email_encoded), QString("t3 email2"));
 	QCOMPARE(QString(prefs.cloud_storage_password), QString("t3 pass2"));
 	QCOMPARE(QString(prefs.cloud_storage_pin), QString("t3 pin"));
+	QCOMPARE(prefs.cloud_shallow_clone, true);
 	QCOMPARE((int)prefs.cloud_timeout, 321);
 	QCOMPARE((int)prefs.cloud_verification_status, (int)qPrefCloudStorage::CS_NOCLOUD);
 	QCOMPARE(prefs.save_password_local, true);
@@ -215,6 +222,7 @@ void TestQPrefCloudStorage::test_signals()
 	QSignalSpy spy7(qPrefCloudStorage::instance(), &qPrefCloudStorage::cloud_verification_statusChanged);
 	QSignalSpy spy9(qPrefCloudStorage::instance(), &qPrefCloudStorage::save_password_localChanged);
 	QSignalSpy spy10(qPrefCloudStorage::instance(), &qPrefCloudStorage::cloud_auto_syncChanged);
+	QSignalSpy spy11(qPrefCloudStorage::instance(), &qPrefCloudStorage::cloud_shallow_cloneChanged);
 
 	qPrefCloudStorage::set_cloud_base_url("signal url");
 	qPrefCloudStorage::set_cloud_storage_email("signal myEmail");
@@ -225,6 +233,7 @@ void TestQPrefCloudStorage::test_signals()
 	qPrefCloudStorage::set_cloud_verification_status(qPrefCloudStorage::CS_VERIFIED);
 	qPrefCloudStorage::set_save_password_local(true);
 	qPrefCloudStorage::set_cloud_auto_sync(true);
+	qPrefCloudStorage::set_cloud_shallow_clone(false);
 
 	QCOMPARE(spy1.count(), 1);
 	QCOMPARE(spy2.count(), 1);
@@ -235,6 +244,7 @@ void TestQPrefCloudStorage::test_signals()
 	QCOMPARE(spy7.count(), 1);
 	QCOMPARE(spy9.count(), 1);
 	QCOMPARE(spy10.count(), 1);
+	QCOMPARE(spy11.count(), 1);
 
 	QVERIFY(spy1.takeFirst().at(0).toString() == "signal url");
 	QVERIFY(spy2.takeFirst().at(0).toString() == "signal myEmail");
@@ -245,6 +255,7 @@ void TestQPrefCloudStorage::test_signals()
 	QVERIFY(spy7.takeFirst().at(0).toInt() == qPrefCloudStorage::CS_VERIFIED);
 	QVERIFY(spy9.takeFirst().at(0).toBool() == true);
 	QVERIFY(spy10.takeFirst().at(0).toBool() == true);
+	QVERIFY(spy11.takeFirst().at(0).toBool() == false);
 }
 
 QTEST_MAIN(TestQPrefCloudStorage)
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testsamplesharing.h"
+#include "core/dive.h"
+#include "core/divecomputer.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/sample.h"
+#include <vector>
+
+static void addSamples(struct divecomputer *dc, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		struct sample *s = prepare_sample(dc);
+		s->time.seconds = i * 10;
+		s->depth.mm = i * 1000;
+		finish_sample(dc);
+	}
+}
+
+static struct dive *createDive(int count)
+{
+	struct dive *d = alloc_dive();
+	addSamples(&d->dc, count);
+	return d;
+}
+
+void TestSampleSharing::testCopyShares()
+{
+	struct dive *d1 = createDive(100);
+	size_t unsharedMemory = dive_memory_usage(d1);
+	struct dive *d2 = alloc_dive();
+	copy_dive(d1, d2);
+
+	QCOMPARE(d2->dc.samples, 100);
+	QCOMPARE(d2->dc.sample, d1->dc.sample);
+	QVERIFY(samples_shared(&d1->dc));
+	QVERIFY(samples_shared(&d2->dc));
+	QVERIFY(dive_memory_usage(d1) < unsharedMemory);
+
+	free_dive(d1);
+	free_dive(d2);
+}
+
+void TestSampleSharing::testWriteUnshares()
+{
+	struct dive *d1 = createDive(100);
+	struct dive *d2 = alloc_dive();
+	copy_dive(d1, d2);
+
+	// Adding a sample must not modify the original
+	addSamples(&d2->dc, 1);
+	QVERIFY(d2->dc.sample != d1->dc.sample);
+	QCOMPARE(d1->dc.samples, 100);
+	QCOMPARE(d2->dc.samples, 101);
+	QVERIFY(!samples_shared(&d1->dc));
+	QVERIFY(!samples_shared(&d2->dc));
+
+	// Neither must modifying an existing one
+	struct dive *d3 = alloc_dive();
+	copy_dive(d1, d3);
+	unshare_samples(&d3->dc);
+	d3->dc.sample[0].depth.mm = 42;
+	QCOMPARE(d1->dc.sample[0].depth.mm, 0);
+	QCOMPARE(d3->dc.samples, 100);
+
+	free_dive(d1);
+	free_dive(d2);
+	free_dive(d3);
+}
+
+void TestSampleSharing::testFreeKeepsCopy()
+{
+	struct dive *d1 = createDive(100);
+	struct dive *d2 = alloc_dive();
+	copy_dive(d1, d2);
+	free_dive(d1);
+
+	QVERIFY(!samples_shared(&d2->dc));
+	QCOMPARE(d2->dc.samples, 100);
+	QCOMPARE(d2->dc.sample[99].depth.mm, 99000);
+
+	free_dive(d2);
+}
+
+void TestSampleSharing::testShareEqual()
+{
+	struct dive *d1 = createDive(100);
+	struct dive *d2 = alloc_dive();
+	copy_dive(d1, d2);
+	unshare_samples(&d2->dc);
+	QVERIFY(d2->dc.sample != d1->dc.sample);
+
+	share_equal_samples(&d2->dc, &d1->dc);
+	QCOMPARE(d2->dc.sample, d1->dc.sample);
+
+	// Different samples are not shared
+	unshare_samples(&d2->dc);
+	d2->dc.sample[0].depth.mm = 42;
+	share_equal_samples(&d2->dc, &d1->dc);
+	QVERIFY(d2->dc.sample != d1->dc.sample);
+
+	free_dive(d1);
+	free_dive(d2);
+}
+
+void TestSampleSharing::testSplitKeepsOriginal()
+{
+	// Splitting a dive must not modify the original dive, which is kept by the undo command
+	struct dive *d = createDive(100);
+	struct divecomputer *dc2 = (struct divecomputer *)calloc(1, sizeof(*dc2));
+	copy_samples(&d->dc, dc2);
+	d->dc.next = dc2;
+	add_to_dive_table(divelog.dives, divelog.dives->nr, d);
+	std::vector<struct sample> samples(d->dc.sample, d->dc.sample + d->dc.samples);
+
+	struct dive *new1, *new2;
+	duration_t time;
+	time.seconds = 500;
+	QVERIFY(split_dive_at_time(d, time, &new1, &new2) >= 0);
+	QVERIFY(new2->dc.sample[0].time.seconds < 10);
+	for (const struct divecomputer *dc = &d->dc; dc; dc = dc->next) {
+		QCOMPARE(dc->samples, 100);
+		QVERIFY(!memcmp(dc->sample, samples.data(), 100 * sizeof(struct sample)));
+	}
+
+	// Undoing frees the split dives, which must leave the original intact
+	free_dive(new1);
+	free_dive(new2);
+	for (const struct divecomputer *dc = &d->dc; dc; dc = dc->next) {
+		QCOMPARE(dc->samples, 100);
+		QVERIFY(!memcmp(dc->sample, samples.data(), 100 * sizeof(struct sample)));
+	}
+
+	clear_dive_file_data();
+}
+
+QTEST_GUILESS_MAIN(TestSampleSharing)
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTSAMPLESHARING_H
+#define TESTSAMPLESHARING_H
+
+#include <QtTest>
+
+class TestSampleSharing : public QObject {
+	Q_OBJECT
+private slots:
+	void testCopyShares();
+	void testWriteUnshares();
+	void testFreeKeepsCopy();
+	void testShareEqual();
+	void testSplitKeepsOriginal();
+};
+
+#endif
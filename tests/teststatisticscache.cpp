@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "teststatisticscache.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/pref.h"
+#include "core/statisticscache.h"
+#include "core/subsurface-qt/divelistnotifier.h"
+#include "core/trip.h"
+
+static void compareStats(const stats_t &s1, const stats_t &s2)
+{
+	QCOMPARE(s1.period, s2.period);
+	QCOMPARE(s1.selection_size, s2.selection_size);
+	QCOMPARE(s1.total_time.seconds, s2.total_time.seconds);
+	QCOMPARE(s1.total_average_depth_time.seconds, s2.total_average_depth_time.seconds);
+	QCOMPARE(s1.shortest_time.seconds, s2.shortest_time.seconds);
+	QCOMPARE(s1.longest_time.seconds, s2.longest_time.seconds);
+	QCOMPARE(s1.max_depth.mm, s2.max_depth.mm);
+	QCOMPARE(s1.min_depth.mm, s2.min_depth.mm);
+	QCOMPARE(s1.avg_depth.mm, s2.avg_depth.mm);
+	QCOMPARE(s1.combined_max_depth.mm, s2.combined_max_depth.mm);
+	QCOMPARE(s1.max_sac.mliter, s2.max_sac.mliter);
+	QCOMPARE(s1.min_sac.mliter, s2.min_sac.mliter);
+	QCOMPARE(s1.avg_sac.mliter, s2.avg_sac.mliter);
+	QCOMPARE(s1.max_temp.mkelvin, s2.max_temp.mkelvin);
+	QCOMPARE(s1.min_temp.mkelvin, s2.min_temp.mkelvin);
+	QCOMPARE(s1.combined_temp.mkelvin, s2.combined_temp.mkelvin);
+	QCOMPARE(s1.combined_count, s2.combined_count);
+	QCOMPARE(s1.total_sac_time.seconds, s2.total_sac_time.seconds);
+	QCOMPARE(s1.depth_time_sum, s2.depth_time_sum);
+	QCOMPARE(s1.sac_time_sum, s2.sac_time_sum);
+	QCOMPARE(s1.is_year, s2.is_year);
+	QCOMPARE(s1.is_trip, s2.is_trip);
+	QCOMPARE(QString(s1.location), QString(s2.location));
+}
+
+// The cached statistics must be exactly the same as the statistics calculated from scratch
+static void compareWithFullCalculation()
+{
+	stats_summary_auto_free cached, full;
+	StatisticsCache::instance()->summary(&cached);
+	calculate_stats_summary(&full, false);
+
+	int i;
+	for (i = 0; full.stats_yearly[i].period; ++i)
+		compareStats(cached.stats_yearly[i], full.stats_yearly[i]);
+	QCOMPARE(cached.stats_yearly[i].period, 0);
+	for (i = 0; full.stats_monthly[i].selection_size; ++i)
+		compareStats(cached.stats_monthly[i], full.stats_monthly[i]);
+	QCOMPARE(cached.stats_monthly[i].selection_size, 0u);
+	for (i = 0; full.stats_by_trip[i].is_trip; ++i)
+		compareStats(cached.stats_by_trip[i], full.stats_by_trip[i]);
+	QCOMPARE(cached.stats_by_trip[i].is_trip, false);
+	for (i = 0; i <= NUM_DIVEMODE; ++i)
+		compareStats(cached.stats_by_type[i], full.stats_by_type[i]);
+	for (i = 0; i <= STATS_MAX_DEPTH / STATS_DEPTH_BUCKET; ++i)
+		compareStats(cached.stats_by_depth[i], full.stats_by_depth[i]);
+	for (i = 0; i <= STATS_MAX_TEMP / STATS_TEMP_BUCKET; ++i)
+		compareStats(cached.stats_by_temp[i], full.stats_by_temp[i]);
+}
+
+void TestStatisticsCache::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+}
+
+void TestStatisticsCache::init()
+{
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	process_loaded_dives();
+	QVERIFY(divelog.dives->nr > 2);
+}
+
+void TestStatisticsCache::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestStatisticsCache::testLoad()
+{
+	compareWithFullCalculation();
+}
+
+void TestStatisticsCache::testEditDive()
+{
+	compareWithFullCalculation();
+	struct dive *d = get_dive(1);
+	d->maxdepth.mm += 25000;
+	d->duration.seconds += 600;
+	d->mintemp.mkelvin = C_to_mkelvin(31.0);
+	emit diveListNotifier.divesChanged(QVector<dive *>{ d }, DiveField::DEPTH | DiveField::DURATION | DiveField::WATER_TEMP);
+	compareWithFullCalculation();
+
+	// removing the extreme values makes the buckets recalculate their statistics
+	d->maxdepth.mm -= 25000;
+	d->duration.seconds -= 600;
+	d->mintemp.mkelvin = 0;
+	emit diveListNotifier.divesChanged(QVector<dive *>{ d }, DiveField::DEPTH | DiveField::DURATION | DiveField::WATER_TEMP);
+	compareWithFullCalculation();
+}
+
+void TestStatisticsCache::testChangeTime()
+{
+	compareWithFullCalculation();
+	struct dive *d = get_dive(0);
+	const timestamp_t delta = 3 * 365 * 24 * 3600;
+	d->when += delta;
+	sort_dive_table(divelog.dives);
+	emit diveListNotifier.divesTimeChanged(delta, QVector<dive *>{ d });
+	compareWithFullCalculation();
+}
+
+void TestStatisticsCache::testInvalidate()
+{
+	compareWithFullCalculation();
+	struct dive *d = get_dive(2);
+	d->invalid = true;
+	emit diveListNotifier.divesChanged(QVector<dive *>{ d }, DiveField::INVALID);
+	compareWithFullCalculation();
+	d->invalid = false;
+	emit diveListNotifier.divesChanged(QVector<dive *>{ d }, DiveField::INVALID);
+	compareWithFullCalculation();
+}
+
+void TestStatisticsCache::testRemoveDive()
+{
+	compareWithFullCalculation();
+	struct dive *d = get_dive(1);
+	emit diveListNotifier.divesDeleted(d->divetrip, false, QVector<dive *>{ d });
+	delete_single_dive(1);
+	compareWithFullCalculation();
+}
+
+// Changes that are not signalled are caught by the dive count
+void TestStatisticsCache::testReset()
+{
+	compareWithFullCalculation();
+	delete_single_dive(0);
+	compareWithFullCalculation();
+}
+
+// A log with many trips, as found in the logs of long-time divers
+static void createLargeLog()
+{
+	clear_dive_file_data();
+	timestamp_t when = 946684800;	// 2000-01-01
+	for (int i = 0; i < 500; ++i) {
+		dive_trip_t *trip = nullptr;
+		for (int j = 0; j < 20; ++j) {
+			struct dive *d = alloc_dive();
+			d->when = when;
+			d->dc.when = when;
+			d->dc.duration.seconds = (30 + (i + j) % 40) * 60;
+			d->dc.maxdepth.mm = 10000 + (i * 7 + j) % 50 * 1000;
+			d->dc.meandepth.mm = d->dc.maxdepth.mm / 2;
+			d->duration = d->dc.duration;
+			d->maxdepth = d->dc.maxdepth;
+			d->meandepth = d->dc.meandepth;
+			d->mintemp.mkelvin = C_to_mkelvin(5 + (i + j * 3) % 25);
+			add_to_dive_table(divelog.dives, divelog.dives->nr, d);
+			if (!trip)
+				trip = create_and_hookup_trip_from_dive(d, divelog.trips);
+			else
+				add_dive_to_trip(d, trip);
+			when += 4 * 3600;
+		}
+		when += 30 * 24 * 3600;
+	}
+	process_loaded_dives();
+}
+
+// Editing a dive and querying the statistics should be much cheaper than a full recalculation
+void TestStatisticsCache::benchmarkEditAndQuery()
+{
+	createLargeLog();
+	// a dive without extreme values, which would make the buckets recalculate their statistics
+	struct dive *d = get_dive(divelog.dives->nr / 2);
+	d->maxdepth.mm = 30000;
+	d->meandepth.mm = 15000;
+	d->mintemp.mkelvin = C_to_mkelvin(15);
+	compareWithFullCalculation();
+	QBENCHMARK {
+		d->duration.seconds = d->duration.seconds == 45 * 60 ? 46 * 60 : 45 * 60;
+		emit diveListNotifier.divesChanged(QVector<dive *>{ d }, DiveField::DURATION);
+		stats_summary_auto_free stats;
+		StatisticsCache::instance()->summary(&stats);
+	}
+	compareWithFullCalculation();
+}
+
+void TestStatisticsCache::benchmarkFullCalculation()
+{
+	createLargeLog();
+	QBENCHMARK {
+		stats_summary_auto_free stats;
+		calculate_stats_summary(&stats, false);
+	}
+}
+
+QTEST_GUILESS_MAIN(TestStatisticsCache)
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTSTATISTICSCACHE_H
+#define TESTSTATISTICSCACHE_H
+
+#include <QtTest>
+
+class TestStatisticsCache : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void init();
+	void cleanup();
+
+	void testLoad();
+	void testEditDive();
+	void testChangeTime();
+	void testInvalidate();
+	void testRemoveDive();
+	void testReset();
+	void benchmarkEditAndQuery();
+	void benchmarkFullCalculation();
+};
+
+#endif
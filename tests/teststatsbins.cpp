@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "teststatsbins.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divelog.h"
+#include "core/file.h"
+#include "core/pref.h"
+#include "stats/statsdives.h"
+#include "stats/statsvariables.h"
+
+#include <limits>
+#include <QThreadPool>
+
+// Binning all dives on one thread and on several threads must give the same bins
+static std::vector<dive *> allDives()
+{
+	std::vector<dive *> res;
+	for (int i = 0; i < divelog.dives->nr; ++i)
+		res.push_back(divelog.dives->dives[i]);
+	return res;
+}
+
+static void setParallel(bool parallel)
+{
+	stats_min_dives_per_thread = parallel ? 1 : std::numeric_limits<int>::max();
+}
+
+template <typename T, typename Func>
+static void compareBins(const std::vector<StatsBinValue<T>> &sequential, const std::vector<StatsBinValue<T>> &parallel, Func compareValues)
+{
+	QCOMPARE(parallel.size(), sequential.size());
+	for (size_t i = 0; i < sequential.size(); ++i) {
+		QVERIFY(*parallel[i].bin == *sequential[i].bin);
+		compareValues(parallel[i].value, sequential[i].value);
+	}
+}
+
+static void compareDives(const std::vector<dive *> &d1, const std::vector<dive *> &d2)
+{
+	QVERIFY(d1 == d2);
+}
+
+void TestStatsBins::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &divelog), 0);
+	process_loaded_dives();
+	// Make sure that the dives are split into several parts, even on a single core
+	QThreadPool::globalInstance()->setMaxThreadCount(4);
+}
+
+void TestStatsBins::cleanupTestCase()
+{
+	setParallel(false);
+	clear_dive_file_data();
+}
+
+void TestStatsBins::parallelBins()
+{
+	std::vector<dive *> dives = allDives();
+	QVERIFY(dives.size() > 4);
+	for (const StatsVariable *var: stats_variables) {
+		for (const StatsBinner *binner: var->binners()) {
+			for (bool fill_empty: { false, true }) {
+				if (fill_empty && var->type() == StatsVariable::Type::Discrete)
+					continue;
+				setParallel(false);
+				std::vector<StatsBinDives> sequential = binner->bin_dives(dives, fill_empty);
+				setParallel(true);
+				std::vector<StatsBinDives> parallel = binner->bin_dives(dives, fill_empty);
+				compareBins(sequential, parallel, &compareDives);
+			}
+		}
+	}
+}
+
+// The per-bin values of the numeric variables
+void TestStatsBins::parallelValues()
+{
+	std::vector<dive *> dives = allDives();
+	for (const StatsVariable *categoryVar: stats_variables) {
+		const StatsBinner *binner = categoryVar->getBinner(0);
+		for (const StatsVariable *var: stats_variables) {
+			if (var->type() != StatsVariable::Type::Numeric)
+				continue;
+			setParallel(false);
+			std::vector<StatsBinQuartiles> sequentialQuartiles = var->bin_quartiles(*binner, dives, false);
+			std::vector<StatsBinOp> sequentialOps = var->bin_operations(*binner, dives, false);
+			setParallel(true);
+			std::vector<StatsBinQuartiles> parallelQuartiles = var->bin_quartiles(*binner, dives, false);
+			std::vector<StatsBinOp> parallelOps = var->bin_operations(*binner, dives, false);
+
+			compareBins(sequentialQuartiles, parallelQuartiles, [](const StatsQuartiles &q1, const StatsQuartiles &q2) {
+				QVERIFY(q1.dives == q2.dives);
+				QCOMPARE(q1.min, q2.min);
+				QCOMPARE(q1.q1, q2.q1);
+				QCOMPARE(q1.q2, q2.q2);
+				QCOMPARE(q1.q3, q2.q3);
+				QCOMPARE(q1.max, q2.max);
+			});
+			compareBins(sequentialOps, parallelOps, [](const StatsOperationResults &r1, const StatsOperationResults &r2) {
+				QVERIFY(r1.dives == r2.dives);
+				QCOMPARE(r1.median, r2.median);
+				QCOMPARE(r1.mean, r2.mean);
+				QCOMPARE(r1.timeWeightedMean, r2.timeWeightedMean);
+				QCOMPARE(r1.sum, r2.sum);
+				QCOMPARE(r1.min, r2.min);
+				QCOMPARE(r1.max, r2.max);
+			});
+		}
+	}
+}
+
+// The charts bin copies of the dives. This must give the same bins and values as the dives.
+// The bins of the dive sites and trips refer to the copies, so they are compared by their names.
+void TestStatsBins::copiedDives()
+{
+	setParallel(false);
+	std::vector<dive *> dives = allDives();
+	StatsDives copies(dives);
+	QCOMPARE(copies.copies().size(), dives.size());
+	for (size_t i = 0; i < dives.size(); ++i) {
+		QVERIFY(copies.copies()[i] != dives[i]);
+		QCOMPARE(copies.original(copies.copies()[i]), dives[i]);
+	}
+
+	for (const StatsVariable *var: stats_variables) {
+		for (const StatsBinner *binner: var->binners()) {
+			std::vector<StatsBinDives> original = binner->bin_dives(dives, false);
+			std::vector<StatsBinDives> copied = binner->bin_dives(copies.copies(), false);
+			QCOMPARE(copied.size(), original.size());
+			for (size_t i = 0; i < original.size(); ++i) {
+				QCOMPARE(binner->format(*copied[i].bin), binner->format(*original[i].bin));
+				copies.toOriginals(copied[i].value);
+				QVERIFY(copied[i].value == original[i].value);
+			}
+		}
+		if (var->type() != StatsVariable::Type::Numeric)
+			continue;
+		std::vector<StatsValue> original = var->values(dives);
+		std::vector<StatsValue> copied = var->values(copies.copies());
+		QCOMPARE(copied.size(), original.size());
+		for (size_t i = 0; i < original.size(); ++i) {
+			QCOMPARE(copied[i].v, original[i].v);
+			QCOMPARE(copies.original(copied[i].d), original[i].d);
+		}
+	}
+}
+
+QTEST_GUILESS_MAIN(TestStatsBins)
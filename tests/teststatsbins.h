@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTSTATSBINS_H
+#define TESTSTATSBINS_H
+
+#include <QtTest>
+
+class TestStatsBins : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void parallelBins();
+	void parallelValues();
+	void copiedDives();
+};
+
+#endif
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testthumbnailperformance.h"
+#include "core/imagedownloader.h"
+#include <QDir>
+#include <QImage>
+#include <QPainter>
+#include <algorithm>
+
+// Benchmark thumbnail generation over a directory of large JPEGs.
+// The directory can be given in the SUBSURFACE_THUMBNAIL_BENCHMARK_DIR
+// environment variable. Otherwise, a few synthetic 24MP pictures are
+// generated.
+static const int thumbnailSize = 210;
+
+void TestThumbnailPerformance::initTestCase()
+{
+	QString dir = qEnvironmentVariable("SUBSURFACE_THUMBNAIL_BENCHMARK_DIR");
+	if (!dir.isEmpty()) {
+		for (const QString &name: QDir(dir).entryList({ "*.jpg", "*.JPG", "*.jpeg", "*.JPEG" }, QDir::Files))
+			files.push_back(dir + "/" + name);
+	} else {
+		QVERIFY(tmpDir.isValid());
+		for (int i = 0; i < 4; ++i) {
+			QImage img(6000, 4000, QImage::Format_RGB32);
+			img.fill(Qt::darkCyan);
+			QPainter painter(&img);
+			painter.setPen(QPen(Qt::yellow, 50));
+			painter.drawEllipse(500 * i, 500, 3000, 2000);
+			painter.end();
+			QString name = tmpDir.filePath(QString("picture%1.jpg").arg(i));
+			QVERIFY(img.save(name, "JPG", 90));
+			files.push_back(name);
+		}
+	}
+	if (files.isEmpty())
+		QSKIP("no pictures to benchmark");
+}
+
+void TestThumbnailPerformance::fullDecode()
+{
+	QBENCHMARK {
+		for (const QString &file: files) {
+			QImage img(file);
+			QVERIFY(!img.isNull());
+			img = img.scaled(thumbnailSize, thumbnailSize, Qt::KeepAspectRatio);
+		}
+	}
+}
+
+void TestThumbnailPerformance::scaledDecode()
+{
+	QBENCHMARK {
+		for (const QString &file: files) {
+			QImage img = loadThumbnailImage(file, thumbnailSize);
+			QVERIFY(!img.isNull());
+			QVERIFY(std::max(img.width(), img.height()) == thumbnailSize);
+		}
+	}
+}
+
+QTEST_GUILESS_MAIN(TestThumbnailPerformance)
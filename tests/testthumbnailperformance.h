@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTTHUMBNAILPERFORMANCE_H
+#define TESTTHUMBNAILPERFORMANCE_H
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+class TestThumbnailPerformance : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void fullDecode();
+	void scaledDecode();
+private:
+	QTemporaryDir tmpDir;
+	QStringList files;
+};
+
+#endif
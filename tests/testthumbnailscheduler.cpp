@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testthumbnailscheduler.h"
+#include "core/thumbnailscheduler.h"
+#include <QSemaphore>
+#include <atomic>
+
+// Runs jobs on a scheduler with one worker. The first job blocks until
+// release() is called, so that the order of the remaining jobs can be checked.
+struct Recorder {
+	QSemaphore blocker;
+	QSemaphore done;
+	QMutex lock;
+	QStringList order;
+	ThumbnailScheduler scheduler;	// Declared last, so that it waits for the jobs before the rest is destroyed
+
+	Recorder() : scheduler(1, 1)
+	{
+		scheduler.add(this, "blocker", ThumbnailScheduler::JOB_PICTURE, ThumbnailScheduler::PRIORITY_NORMAL, [this]() { blocker.acquire(); });
+	}
+	void add(const QString &filename, ThumbnailScheduler::Priority priority = ThumbnailScheduler::PRIORITY_NORMAL)
+	{
+		scheduler.add(this, filename, ThumbnailScheduler::JOB_PICTURE, priority, [this, filename]() {
+			QMutexLocker l(&lock);
+			order.push_back(filename);
+			done.release();
+		});
+	}
+	QStringList run(int count)
+	{
+		blocker.release();
+		if (!done.tryAcquire(count, 10000))
+			return QStringList();
+		QMutexLocker l(&lock);
+		return order;
+	}
+};
+
+void TestThumbnailScheduler::order()
+{
+	Recorder r;
+	r.add("a");
+	r.add("b", ThumbnailScheduler::PRIORITY_BACKGROUND);
+	r.add("c");
+	QCOMPARE(r.run(3), QStringList({ "a", "c", "b" }));
+}
+
+void TestThumbnailScheduler::visibleFirst()
+{
+	Recorder r;
+	r.add("a");
+	r.add("b");
+	r.add("c", ThumbnailScheduler::PRIORITY_BACKGROUND);
+	r.add("d");
+	r.scheduler.setVisible({ "c", "d" });
+	QCOMPARE(r.run(4), QStringList({ "c", "d", "a", "b" }));
+}
+
+void TestThumbnailScheduler::cancel()
+{
+	Recorder r;
+	r.add("a");
+	r.add("b");
+	r.add("c");
+	r.scheduler.cancel(&r, "b");
+	r.scheduler.cancel(nullptr, "c");	// Different owner -> not cancelled
+	QCOMPARE(r.run(2), QStringList({ "a", "c" }));
+
+	Recorder r2;
+	r2.add("a");
+	r2.scheduler.cancelAll(&r2);
+	r2.add("b");
+	QCOMPARE(r2.run(1), QStringList({ "b" }));
+}
+
+// Count the jobs that are running at the same time
+static void countRunning(std::atomic<int> &running, std::atomic<int> &maxRunning)
+{
+	int now = ++running;
+	int max = maxRunning;
+	while (now > max && !maxRunning.compare_exchange_weak(max, now))
+		;
+}
+
+void TestThumbnailScheduler::bounded()
+{
+	std::atomic<int> running(0), maxRunning(0);
+	QSemaphore done;
+	ThumbnailScheduler scheduler(2, 2);
+	for (int i = 0; i < 20; ++i) {
+		scheduler.add(this, QString::number(i), ThumbnailScheduler::JOB_PICTURE, ThumbnailScheduler::PRIORITY_NORMAL, [&]() {
+			countRunning(running, maxRunning);
+			QThread::msleep(5);
+			--running;
+			done.release();
+		});
+	}
+	QVERIFY(done.tryAcquire(20, 10000));
+	QVERIFY(maxRunning <= 2);
+}
+
+void TestThumbnailScheduler::pictureLimit()
+{
+	std::atomic<int> running(0), maxRunning(0), pictures(0), maxPictures(0);
+	QSemaphore done, videoStarted;
+	ThumbnailScheduler scheduler(2, 1);
+
+	// A video can be processed while a picture is decoded
+	scheduler.add(this, "picture", ThumbnailScheduler::JOB_PICTURE, ThumbnailScheduler::PRIORITY_NORMAL,
+		      [&]() { videoStarted.tryAcquire(1, 10000); done.release(); });
+	scheduler.add(this, "video", ThumbnailScheduler::JOB_VIDEO, ThumbnailScheduler::PRIORITY_NORMAL,
+		      [&]() { videoStarted.release(); done.release(); });
+	QVERIFY(done.tryAcquire(2, 10000));
+	QCOMPARE(videoStarted.available(), 0);
+
+	// But only one picture is decoded at a time
+	for (int i = 0; i < 20; ++i) {
+		ThumbnailScheduler::Kind kind = i % 2 ? ThumbnailScheduler::JOB_VIDEO : ThumbnailScheduler::JOB_PICTURE;
+		scheduler.add(this, QString::number(i), kind, ThumbnailScheduler::PRIORITY_NORMAL, [&, kind]() {
+			countRunning(running, maxRunning);
+			if (kind == ThumbnailScheduler::JOB_PICTURE)
+				countRunning(pictures, maxPictures);
+			QThread::msleep(5);
+			if (kind == ThumbnailScheduler::JOB_PICTURE)
+				--pictures;
+			--running;
+			done.release();
+		});
+	}
+	QVERIFY(done.tryAcquire(20, 10000));
+	QVERIFY(maxRunning <= 2);
+	QCOMPARE((int)maxPictures, 1);
+}
+
+QTEST_GUILESS_MAIN(TestThumbnailScheduler)
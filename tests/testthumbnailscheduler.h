@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTTHUMBNAILSCHEDULER_H
+#define TESTTHUMBNAILSCHEDULER_H
+
+#include <QtTest>
+
+class TestThumbnailScheduler : public QObject {
+	Q_OBJECT
+private slots:
+	void order();
+	void visibleFirst();
+	void cancel();
+	void bounded();
+	void pictureLimit();
+};
+
+#endif
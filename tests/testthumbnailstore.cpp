@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testthumbnailstore.h"
+#include "core/thumbnailstore.h"
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+
+static QByteArray thumbnailData(int i, int size = 100)
+{
+	return QByteArray(size, char('a' + i % 26));
+}
+
+void TestThumbnailStore::putAndGet()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	ThumbnailStore store(dir.path());
+
+	QVERIFY(store.get("/pictures/a.jpg").data.isEmpty());
+	store.put("/pictures/a.jpg", 1000, thumbnailData(0));
+	store.put("/pictures/b.jpg", 2000, thumbnailData(1));
+
+	ThumbnailStore::Entry entry = store.get("/pictures/a.jpg");
+	QCOMPARE(entry.data, thumbnailData(0));
+	QCOMPARE(entry.time, (qint64)1000);
+	QCOMPARE(store.get("/pictures/b.jpg").data, thumbnailData(1));
+
+	// Replace an entry
+	store.put("/pictures/a.jpg", 3000, thumbnailData(2, 50));
+	entry = store.get("/pictures/a.jpg");
+	QCOMPARE(entry.data, thumbnailData(2, 50));
+	QCOMPARE(entry.time, (qint64)3000);
+}
+
+void TestThumbnailStore::reopen()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	{
+		ThumbnailStore store(dir.path());
+		store.put("/pictures/a.jpg", 1000, thumbnailData(0));
+	}
+	ThumbnailStore store(dir.path());
+	ThumbnailStore::Entry entry = store.get("/pictures/a.jpg");
+	QCOMPARE(entry.data, thumbnailData(0));
+	QCOMPARE(entry.time, (qint64)1000);
+}
+
+void TestThumbnailStore::grow()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	ThumbnailStore store(dir.path());
+
+	// More entries than the initial capacity of the index
+	const int count = 5000;
+	for (int i = 0; i < count; ++i)
+		store.put(QString("/pictures/%1.jpg").arg(i), i, thumbnailData(i, 10));
+	for (int i = 0; i < count; ++i) {
+		ThumbnailStore::Entry entry = store.get(QString("/pictures/%1.jpg").arg(i));
+		QCOMPARE(entry.data, thumbnailData(i, 10));
+		QCOMPARE(entry.time, (qint64)i);
+	}
+}
+
+void TestThumbnailStore::compact()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	ThumbnailStore store(dir.path());
+
+	// Overwrite the same entries repeatedly, which produces garbage
+	// in the data file and triggers compaction.
+	for (int round = 0; round < 20; ++round) {
+		for (int i = 0; i < 10; ++i)
+			store.put(QString("/pictures/%1.jpg").arg(i), round, thumbnailData(i + round, 10000));
+	}
+	QVERIFY(QFileInfo(dir.filePath("thumbnails.dat")).size() < 20 * 10 * 10000);
+	store.compact();
+	QVERIFY(QFileInfo(dir.filePath("thumbnails.dat")).size() < 11 * 10000);
+	for (int i = 0; i < 10; ++i) {
+		ThumbnailStore::Entry entry = store.get(QString("/pictures/%1.jpg").arg(i));
+		QCOMPARE(entry.data, thumbnailData(i + 19, 10000));
+		QCOMPARE(entry.time, (qint64)19);
+	}
+}
+
+void TestThumbnailStore::importLegacy()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	// Thumbnails used to be stored in files named after the SHA1 of the picture filename
+	QByteArray hash = QCryptographicHash::hash(QString("/pictures/old.jpg").toUtf8(), QCryptographicHash::Sha1);
+	QString legacyName = dir.filePath(QString::fromLatin1(hash.toHex()));
+	QFile legacy(legacyName);
+	QVERIFY(legacy.open(QIODevice::WriteOnly));
+	legacy.write(thumbnailData(3));
+	legacy.close();
+
+	ThumbnailStore store(dir.path());
+	QCOMPARE(store.get("/pictures/old.jpg").data, thumbnailData(3));
+	QVERIFY(!QFile::exists(legacyName));
+}
+
+QTEST_GUILESS_MAIN(TestThumbnailStore)
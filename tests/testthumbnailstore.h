@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTTHUMBNAILSTORE_H
+#define TESTTHUMBNAILSTORE_H
+
+#include <QtTest>
+
+class TestThumbnailStore : public QObject {
+	Q_OBJECT
+private slots:
+	void putAndGet();
+	void reopen();
+	void grow();
+	void compact();
+	void importLegacy();
+};
+
+#endif